@@ -20,8 +20,13 @@
 #include "cmsis_os2.h"
 #include "board-model.h"
 #include "spi/spi-core.h"
+#include "timing/timing.h"
+#include "crc/crc.h"
 #include "flash-services-api.h"
+#include "flash-maint-api.h"
+#include "flash-scrub-api.h"
 #include "accel-services-api.h"
+#include "attitude-services-api.h"
 #include "fram-services-api.h"
 
 // FreeRTOS Inlcudes
@@ -54,15 +59,30 @@ int main(void)
 
 	SystemClock_Config();
 
+	// Cycle counter Init
+	TIMING_Init();
+
+	// CRC unit Init
+	CRC_Init();
+
 	// SPI Init
 	SPI_Init();
 
 	// Accel Init
 	AccelServ_Init();
 
+	// Attitude Init
+	AttitudeServ_Init();
+
 	// Flash Init
 	FlashServ_Init();
 
+	// Flash maintenance Init
+	FlashMaint_Init();
+
+	// Flash scrub Init
+	FlashScrub_Init();
+
 	// Fram init
 	FramServ_Init();
 
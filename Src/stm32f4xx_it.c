@@ -22,6 +22,7 @@
 #include "main.h"
 #include "stm32f4xx_it.h"
 #include "board-model.h"
+#include "timing/timing.h"
 
 /** @addtogroup STM32F4xx_HAL_Examples
  * @{
@@ -165,6 +166,14 @@ void EXTI0_IRQHandler(void)
   HAL_GPIO_EXTI_IRQHandler(PIN(ACCEL_INT1));
 }
 
+/**
+ * @brief This function handles TIM7 global interrupt, used by TIMING_SleepUs.
+ */
+void TIM7_IRQHandler(void)
+{
+  TIMING_SleepTimerInterruptHandler();
+}
+
 /**
  * @}
  */
@@ -0,0 +1,37 @@
+#pragma once
+
+/*
+ * crc.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Belina Sainju
+ */
+
+#include <stdint.h>
+
+// CRC-32/MPEG-2: polynomial 0x04C11DB7, initial value 0xFFFFFFFF, no reflection, no final XOR.
+// The STM32 CRC unit computes the same value when fed the data as big-endian words.
+// Until CRC_Init is called, or when built with CRC_SOFTWARE_ONLY (host builds), the table
+// driven software path is used and gives identical results.
+#define CRC_INITIAL_VALUE 0xFFFFFFFFU
+#define CRC_POLYNOMIAL 0x04C11DB7U
+
+// =============================================================================================#=
+// Enable the CRC unit. Buffers of CRC_HW_MIN_LENGTH bytes or more go through it from then on.
+// =============================================================================================#=
+void CRC_Init(void);
+
+// =============================================================================================#=
+// Compute the CRC of a buffer
+// =============================================================================================#=
+uint32_t CRC_Compute(const uint8_t *data, uint32_t length);
+
+// =============================================================================================#=
+// Continue a CRC over another buffer. Start with CRC_INITIAL_VALUE.
+// =============================================================================================#=
+uint32_t CRC_Accumulate(uint32_t crc, const uint8_t *data, uint32_t length);
+
+// =============================================================================================#=
+// Continue a CRC with the software table only, whether or not the CRC unit is enabled
+// =============================================================================================#=
+uint32_t CRC_AccumulateSoftware(uint32_t crc, const uint8_t *data, uint32_t length);
@@ -29,6 +29,9 @@
 /* Private Defines ----------------------------------------------------------*/
 #define SPI_TIMEOUT_MS 1000
 
+// Shared bus SCLK: APB1 (42MHz) / 2 = 21MHz, within the flash and FRAM limits
+#define SHARED_SPI_BAUDRATE_PRESCALER SPI_BAUDRATEPRESCALER_2
+
 /* Private Variables ----------------------------------------------------------*/
 // ACCEL SPI variables
 static SPI_HandleTypeDef xAccelSpiHandle;
@@ -36,16 +39,26 @@ static SPI_HandleTypeDef xAccelSpiHandle;
 // SHARED SPI for FLASH and FRAM variables
 static SPI_HandleTypeDef xSharedSpiHandle;
 
-// SPI mutex to support multiple devices
-static StaticSemaphore_t xSPIMutexControlBlock;
-static SemaphoreHandle_t xSPIMutex = NULL;
+// SPI mutexes, one per bus, so a long transfer on the shared bus doesn't hold up the
+// accelerometer. Recursive so a driver holding the bus for a chip select window can still
+// go through SPI_Transfer.
+static StaticSemaphore_t xAccelSpiMutexControlBlock;
+static SemaphoreHandle_t xAccelSpiMutex = NULL;
+static StaticSemaphore_t xSharedSpiMutexControlBlock;
+static SemaphoreHandle_t xSharedSpiMutex = NULL;
 
 /* Private functions ----------------------------------------------------------*/
 
-// Helper function to acquire shared SPI mutex
-static bool spiMutexAcquire(void)
+// Helper function to get the mutex of the bus a device is on
+static SemaphoreHandle_t spiBusMutex(SpiDevice_t device)
+{
+    return (device == LIS3DSH_ACCEL) ? xAccelSpiMutex : xSharedSpiMutex;
+}
+
+// Helper function to acquire the SPI mutex of a device's bus
+static bool spiMutexAcquire(SpiDevice_t device)
 {
-    if (xSemaphoreTake(xSPIMutex, pdMS_TO_TICKS(SPI_TIMEOUT_MS)))
+    if (xSemaphoreTakeRecursive(spiBusMutex(device), pdMS_TO_TICKS(SPI_TIMEOUT_MS)))
     {
         return true;
     }
@@ -53,10 +66,10 @@ static bool spiMutexAcquire(void)
     return false;
 }
 
-// Helper function to release shared SPI mutex
-static void spiMutexRelease(void)
+// Helper function to release the SPI mutex of a device's bus
+static void spiMutexRelease(SpiDevice_t device)
 {
-    xSemaphoreGive(xSPIMutex);
+    xSemaphoreGiveRecursive(spiBusMutex(device));
 }
 
 static void spi1AccelInit(void)
@@ -144,7 +157,7 @@ static void spi2SharedInit(void)
 
     // Init SPI peripheral
     xSharedSpiHandle.Instance = SHARED_SPI;
-    xSharedSpiHandle.Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_8; // 21MHz
+    xSharedSpiHandle.Init.BaudRatePrescaler = SHARED_SPI_BAUDRATE_PRESCALER;
     xSharedSpiHandle.Init.Direction = SPI_DIRECTION_2LINES;
     xSharedSpiHandle.Init.Mode = SPI_MODE_MASTER;
     xSharedSpiHandle.Init.CLKPolarity = SPI_POLARITY_LOW; // CPOL = 0
@@ -193,7 +206,7 @@ bool SPI_Transfer(SpiDevice_t device, uint8_t *dataToSend, uint16_t lengthToSend
         stat = HAL_BUSY;
     }
 
-    if ((stat == HAL_OK) && (spiMutexAcquire()))
+    if ((stat == HAL_OK) && (spiMutexAcquire(device)))
     {
         if (lengthToSend > 0)
         {
@@ -214,7 +227,7 @@ bool SPI_Transfer(SpiDevice_t device, uint8_t *dataToSend, uint16_t lengthToSend
             printf("SPI error %d", stat);
         }
 
-        spiMutexRelease();
+        spiMutexRelease(device);
     }
     else
     {
@@ -225,6 +238,36 @@ bool SPI_Transfer(SpiDevice_t device, uint8_t *dataToSend, uint16_t lengthToSend
     return stat == HAL_OK;
 }
 
+bool SPI_BusAcquire(SpiDevice_t device)
+{
+    return spiMutexAcquire(device);
+}
+
+void SPI_BusRelease(SpiDevice_t device)
+{
+    spiMutexRelease(device);
+}
+
+uint32_t SPI_GetClockHz(SpiDevice_t device)
+{
+    uint32_t pclkHz = 0;
+    uint32_t prescaler = 0;
+
+    if (device == LIS3DSH_ACCEL)
+    {
+        pclkHz = HAL_RCC_GetPCLK2Freq();
+        prescaler = xAccelSpiHandle.Init.BaudRatePrescaler;
+    }
+    else
+    {
+        pclkHz = HAL_RCC_GetPCLK1Freq();
+        prescaler = xSharedSpiHandle.Init.BaudRatePrescaler;
+    }
+
+    // BR[2:0] selects fPCLK / 2^(BR + 1)
+    return pclkHz >> ((prescaler >> SPI_CR1_BR_Pos) + 1);
+}
+
 void SPI_Init(void)
 {
     // Init Accelerometer SPI
@@ -233,6 +276,7 @@ void SPI_Init(void)
     // Init FLASH and FRAM Shared SPI
     spi2SharedInit();
 
-    // Assign SPIMutex value
-    xSPIMutex = xSemaphoreCreateMutexStatic(&xSPIMutexControlBlock);
+    // Assign the bus mutexes
+    xAccelSpiMutex = xSemaphoreCreateRecursiveMutexStatic(&xAccelSpiMutexControlBlock);
+    xSharedSpiMutex = xSemaphoreCreateRecursiveMutexStatic(&xSharedSpiMutexControlBlock);
 }
@@ -15,6 +15,8 @@
 
 #include <stdint.h>
 
+// Selects the bus and its settings. Parts of the same kind share an entry and are told
+// apart by their own chip select, which the drivers drive.
 typedef enum
 {
     LIS3DSH_ACCEL,
@@ -34,6 +36,22 @@ typedef enum
 // =============================================================================================#=
 bool SPI_Transfer(SpiDevice_t device, uint8_t *dataToSend, uint16_t lengthToSend, uint8_t *dataReceived, uint16_t lengthToReceive);
 
+// =============================================================================================#=
+// Take ownership of the device's bus for a whole chip select window. Each bus has its own
+// lock, so holding the shared flash/FRAM bus doesn't block the accelerometer. SPI_Transfer
+// calls made by the owner while the bus is held don't block. Every successful acquire must
+// be paired with SPI_BusRelease.
+//
+// Returns false if the bus could not be acquired within the SPI timeout
+// =============================================================================================#=
+bool SPI_BusAcquire(SpiDevice_t device);
+void SPI_BusRelease(SpiDevice_t device);
+
+// =============================================================================================#=
+// Get the SCLK frequency in Hz of the bus the device is connected to
+// =============================================================================================#=
+uint32_t SPI_GetClockHz(SpiDevice_t device);
+
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
 // One-time startup initialization for the spi peripheral and the associated pins
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
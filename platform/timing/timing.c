@@ -0,0 +1,135 @@
+/*
+ * timing.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Belina Sainju
+ */
+
+#include "timing.h"
+
+#include "stm32f4xx_hal.h"
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+
+#define CYCLES_PER_US (SystemCoreClock / 1000000U)
+
+// Basic timer counting microseconds in one-pulse mode for TIMING_SleepUs
+#define SLEEP_TIMER TIM7
+#define SLEEP_TIMER_IRQ TIM7_IRQn
+#define SLEEP_TIMER_IRQ_PRIORITY 6 // Numerically at or above configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY
+#define SLEEP_TIMER_MAX_US 0xFFFF  // 16 bit counter
+#define SLEEP_TIMER_MARGIN_TICKS 2 // Wait this much past the sleep before giving up on the interrupt
+
+/* Private Variables ----------------------------------------------------------*/
+static SemaphoreHandle_t xSleepMutex = NULL;
+static StaticSemaphore_t xSleepMutexControlBlock;
+static SemaphoreHandle_t xSleepDone = NULL;
+static StaticSemaphore_t xSleepDoneControlBlock;
+
+/* Private functions ----------------------------------------------------------*/
+
+// Helper function to set up the sleep timer to count in microseconds
+static void timingSleepTimerInit(void)
+{
+    uint32_t timerClockHz = HAL_RCC_GetPCLK1Freq();
+
+    // APB1 timers run at twice PCLK1 whenever APB1 is divided
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1)
+    {
+        timerClockHz *= 2;
+    }
+
+    __HAL_RCC_TIM7_CLK_ENABLE();
+
+    SLEEP_TIMER->CR1 = TIM_CR1_OPM | TIM_CR1_URS; // Stop at the update, which only overflow raises
+    SLEEP_TIMER->PSC = (timerClockHz / 1000000U) - 1;
+    SLEEP_TIMER->EGR = TIM_EGR_UG; // Load the prescaler
+    SLEEP_TIMER->SR = 0;
+    SLEEP_TIMER->DIER = TIM_DIER_UIE;
+
+    xSleepMutex = xSemaphoreCreateMutexStatic(&xSleepMutexControlBlock);
+    xSleepDone = xSemaphoreCreateBinaryStatic(&xSleepDoneControlBlock);
+
+    HAL_NVIC_SetPriority(SLEEP_TIMER_IRQ, SLEEP_TIMER_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(SLEEP_TIMER_IRQ);
+}
+
+/* Public functions ----------------------------------------------------------*/
+void TIMING_Init(void)
+{
+    // Enable trace so the DWT unit is clocked, then start the cycle counter
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    timingSleepTimerInit();
+}
+
+uint32_t TIMING_GetCycles(void)
+{
+    return DWT->CYCCNT;
+}
+
+uint32_t TIMING_CyclesToUs(uint32_t cycles)
+{
+    return cycles / CYCLES_PER_US;
+}
+
+void TIMING_DelayUs(uint32_t delayUs)
+{
+    uint32_t startCycles = DWT->CYCCNT;
+    uint32_t delayCycles = delayUs * CYCLES_PER_US;
+
+    // Unsigned subtraction handles counter wrap
+    while ((DWT->CYCCNT - startCycles) < delayCycles)
+    {
+    }
+}
+
+void TIMING_SleepUs(uint32_t sleepUs)
+{
+    uint32_t chunkUs = 0;
+
+    if (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING)
+    {
+        TIMING_DelayUs(sleepUs);
+        return;
+    }
+
+    while (sleepUs > 0)
+    {
+        chunkUs = (sleepUs > SLEEP_TIMER_MAX_US) ? SLEEP_TIMER_MAX_US : sleepUs;
+
+        xSemaphoreTake(xSleepMutex, portMAX_DELAY);
+
+        // Drop a completion left over from a sleep that gave up waiting
+        xSemaphoreTake(xSleepDone, 0);
+
+        SLEEP_TIMER->ARR = chunkUs;
+        SLEEP_TIMER->CNT = 0;
+        SLEEP_TIMER->CR1 |= TIM_CR1_CEN;
+
+        xSemaphoreTake(xSleepDone, pdMS_TO_TICKS(chunkUs / 1000) + SLEEP_TIMER_MARGIN_TICKS);
+
+        SLEEP_TIMER->CR1 &= ~TIM_CR1_CEN;
+
+        xSemaphoreGive(xSleepMutex);
+
+        sleepUs -= chunkUs;
+    }
+}
+
+void TIMING_SleepTimerInterruptHandler(void)
+{
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+
+    if (SLEEP_TIMER->SR & TIM_SR_UIF)
+    {
+        SLEEP_TIMER->SR = (uint32_t)~TIM_SR_UIF;
+        xSemaphoreGiveFromISR(xSleepDone, &higherPriorityTaskWoken);
+    }
+
+    portYIELD_FROM_ISR(higherPriorityTaskWoken);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+/*
+ * timing.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Belina Sainju
+ */
+
+#include <stdint.h>
+
+// =============================================================================================#=
+// Enable the DWT cycle counter and the sleep timer. Must be called once after the system
+// clock is configured.
+// =============================================================================================#=
+void TIMING_Init(void);
+
+// =============================================================================================#=
+// Read the free running CPU cycle counter (wraps every ~25s at 168MHz)
+// =============================================================================================#=
+uint32_t TIMING_GetCycles(void);
+
+// =============================================================================================#=
+// Convert a number of CPU cycles to microseconds
+// =============================================================================================#=
+uint32_t TIMING_CyclesToUs(uint32_t cycles);
+
+// =============================================================================================#=
+// Busy-wait for the given number of microseconds. Intended for waits well below one RTOS tick.
+// =============================================================================================#=
+void TIMING_DelayUs(uint32_t delayUs);
+
+// =============================================================================================#=
+// Block the calling task for the given number of microseconds on a hardware one-shot timer,
+// for sleeps finer than the RTOS tick. Other tasks run meanwhile. Sleeps of different tasks
+// are served one after another. Falls back to TIMING_DelayUs before the scheduler starts.
+// =============================================================================================#=
+void TIMING_SleepUs(uint32_t sleepUs);
+
+// =============================================================================================#=
+// Sleep timer interrupt, called from TIM7_IRQHandler
+// =============================================================================================#=
+void TIMING_SleepTimerInterruptHandler(void);
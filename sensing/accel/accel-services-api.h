@@ -32,3 +32,9 @@ void AccelServ_Init(void);
 //  Called from ISR to indicate data is ready
 // =============================================================================================#=
 void AccelServ_InterruptHandler(void);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Read the accelerometer every periodMs instead of on the data ready interrupt,
+// to load the CPU and SPI as a fast sampling client would. 0 returns to normal.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+void AccelServ_SetLoadPeriod(uint32_t periodMs);
@@ -18,6 +18,8 @@ See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
 
 #include "accel-services-api.h"
 
+#include "attitude-services-api.h"
+
 // FreeRTOS Includes
 #include "FreeRTOS.h"
 #include "semphr.h"
@@ -27,7 +29,6 @@ See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
 
 /*** Private Constants ***/
 
-#define WAIT_200MS_BETWEEN_POLLS 200
 #define ACCEL_CHECK_IN_INTERVAL_MS 5000
 #define ACCEL_STACK_SIZE_IN_WORDS 1024
 
@@ -44,6 +45,9 @@ static StaticTask_t xAccelTaskControlBlock;
 static SemaphoreHandle_t xBinarySemToSignalAccelTask = NULL;
 static StaticSemaphore_t xBinarySemControlBlock;
 
+// Set by AccelServ_SetLoadPeriod, 0 when reading on the interrupt
+static volatile uint32_t xLoadPeriodMs = 0;
+
 /*** Private Functions ***/
 
 // -----------------------------------------------------------------------------+-
@@ -67,17 +71,33 @@ static void accelServTaskCode(void *arg)
 
     for (;;)
     {
-        // Wait forever for someone to signal us.
-        if (xSemaphoreTake(xBinarySemToSignalAccelTask,
-                           pdMS_TO_TICKS(ACCEL_CHECK_IN_INTERVAL_MS) == pdTRUE))
+        // Sample at the requested rate while a load is asked for
+        if (xLoadPeriodMs != 0)
         {
-            if (LIS3DSH_IsModuleInitialized())
+            LIS3DSH_Data_t accelData = {0};
+
+            if (LIS3DSH_IsModuleInitialized() && LIS3DSH_ReadAccelData(&accelData))
             {
-                LIS3DSH_ReadAccelData();
+                AttitudeServ_UpdateAccel(&accelData);
             }
+
+            vTaskDelay(pdMS_TO_TICKS(xLoadPeriodMs));
+            continue;
         }
 
-        vTaskDelay(pdMS_TO_TICKS(WAIT_200MS_BETWEEN_POLLS));
+        // Wait for the data-ready interrupt, each sample goes to the filter as it arrives
+        if (xSemaphoreTake(xBinarySemToSignalAccelTask, pdMS_TO_TICKS(ACCEL_CHECK_IN_INTERVAL_MS)) == pdTRUE)
+        {
+            if (LIS3DSH_IsModuleInitialized())
+            {
+                LIS3DSH_Data_t accelData = {0};
+
+                if (LIS3DSH_ReadAccelData(&accelData))
+                {
+                    AttitudeServ_UpdateAccel(&accelData);
+                }
+            }
+        }
     }
 }
 
@@ -93,6 +113,18 @@ void AccelServ_InterruptHandler(void)
     xSemaphoreGiveFromISR(xBinarySemToSignalAccelTask, pdFALSE);
 }
 
+/*
+ * Function:       Set the load sampling period
+ * Arguments:      periodMs, time between reads, 0 to read on the interrupt again
+ * Description:    Wakes the accel task so the new period takes effect at once
+ * Return Message: void
+ */
+void AccelServ_SetLoadPeriod(uint32_t periodMs)
+{
+    xLoadPeriodMs = periodMs;
+    xSemaphoreGive(xBinarySemToSignalAccelTask);
+}
+
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
 // Init the accel services module
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
@@ -270,14 +270,12 @@ bool LIS3DSH_PerformSoftReset(void)
 
 /*
  * Function:       Read Accel Output data
- * Arguments:      void
+ * Arguments:      accelData, buffer to store accel data in mg
  * Description:    Reads XYZ Output registers, converts raw data to mg
  * Return Message: bool
  */
-bool LIS3DSH_ReadAccelData(void)
+bool LIS3DSH_ReadAccelData(LIS3DSH_Data_t *accelData)
 {
-	LIS3DSH_Data_t accelData = {0};
-
 	uint8_t data[ACCEL_DATA_NUM_BYTES];
 
 	uint8_t reg1 = LIS3DSH_OUT_X_L_REGISTER_ADDR;
@@ -288,26 +286,22 @@ bool LIS3DSH_ReadAccelData(void)
 
 	if (status)
 	{
-		accelData.accelX_mg = accelConvertDataToMg((int16_t)data[ACCEL_X_LSB] | ((int16_t)data[ACCEL_X_MSB] << 8));
+		accelData->accelX_mg = accelConvertDataToMg((int16_t)data[ACCEL_X_LSB] | ((int16_t)data[ACCEL_X_MSB] << 8));
 
-		accelData.accelY_mg = accelConvertDataToMg((int16_t)data[ACCEL_Y_LSB] | ((int16_t)data[ACCEL_Y_MSB] << 8));
+		accelData->accelY_mg = accelConvertDataToMg((int16_t)data[ACCEL_Y_LSB] | ((int16_t)data[ACCEL_Y_MSB] << 8));
 
-		accelData.accelZ_mg = accelConvertDataToMg((int16_t)data[ACCEL_Z_LSB] | ((int16_t)data[ACCEL_Z_MSB] << 8));
+		accelData->accelZ_mg = accelConvertDataToMg((int16_t)data[ACCEL_Z_LSB] | ((int16_t)data[ACCEL_Z_MSB] << 8));
 	}
 	else
 	{
 		// Reset accel data if failed to read new accel data
-		accelData.accelX_mg = 0;
-		accelData.accelY_mg = 0;
-		accelData.accelZ_mg = 0;
+		accelData->accelX_mg = 0;
+		accelData->accelY_mg = 0;
+		accelData->accelZ_mg = 0;
 
 		printf("Failed to read ACCEL data\n");
 	}
 
-	printf("\r\nAccel X: %d\n", accelData.accelX_mg);
-	printf("Accel Y: %d\n", accelData.accelY_mg);
-	printf("Accel Z: %d\n", accelData.accelZ_mg);
-
 	return status;
 }
 
@@ -55,11 +55,11 @@ extern "C"
     bool LIS3DSH_EnableInterrupt(void);
 
     // =============================================================================================#=
-    // Reads the accelerometer and gyroscope data from the IMU
+    // Reads the accelerometer data and returns it in mg through accelData
     //
-    // TODO: Return ICM42688_ImuData_t holding accel (mg) and gyro (dps) data
+    // accelData is zeroed if the read fails
     // =============================================================================================#=
-    bool LIS3DSH_ReadAccelData(void);
+    bool LIS3DSH_ReadAccelData(LIS3DSH_Data_t *accelData);
 
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
     // One-time startup initialization for the LIS3DSH accelerometer
@@ -0,0 +1,84 @@
+#pragma once
+/*
+================================================================================================#=
+FILE:
+attitude-services-api.h
+
+DESCRIPTION:
+    The AttitudeServ module fuses accelerometer and gyroscope samples into a
+    roll/pitch/yaw estimate and publishes it to subscribers at their requested rate.
+    This file defines the API to access those services.
+
+Adaptations Notes:  Accel samples come from the LIS3DSH through accel services.
+                    Gyro samples are pushed by the gyro owner in the same layout returned by
+                    L3GD20_ReadXYZAngRate (X, Y, Z in mdps). If no gyro is fitted, roll and
+                    pitch are tracked from the accelerometer alone and yaw holds.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+// ATTITUDE information other modules may need to access:
+#include "lis3dsh.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ATTITUDE_MAX_SUBSCRIBERS 4
+
+// Attitude published to subscribers
+typedef struct
+{
+    float RollDeg;
+    float PitchDeg;
+    float YawDeg;
+    uint32_t TimestampMs;
+} AttitudeEuler_t;
+
+// Filter timing statistics
+typedef struct
+{
+    uint32_t UpdateCount;
+    uint32_t LastUpdateCycles;
+    uint32_t MaxUpdateCycles;
+    uint32_t BudgetOverruns;
+} AttitudeStats_t;
+
+typedef void (*AttitudeCallback_t)(const AttitudeEuler_t *attitude);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Does the needful to initialize the module.
+// This should be called only once.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+void AttitudeServ_Init(void);
+
+// =============================================================================================#=
+// Feed one accelerometer sample, at the sensor data rate. Runs one filter step in the
+// caller's context. Only one task may feed samples.
+// =============================================================================================#=
+void AttitudeServ_UpdateAccel(const LIS3DSH_Data_t *accelData);
+
+// =============================================================================================#=
+// Feed the latest gyro sample (3 floats, X/Y/Z in mdps). Used by the next accel update.
+// =============================================================================================#=
+void AttitudeServ_UpdateGyro(const float *angularRateMdps);
+
+// =============================================================================================#=
+// Register a callback to receive the attitude every periodMs. Callbacks run in the
+// attitude task and must not block.
+//
+// Returns false if the subscriber table is full
+// =============================================================================================#=
+bool AttitudeServ_Subscribe(uint32_t periodMs, AttitudeCallback_t callback);
+
+// =============================================================================================#=
+// Get the current attitude on demand
+// =============================================================================================#=
+void AttitudeServ_GetEuler(AttitudeEuler_t *attitude);
+
+// =============================================================================================#=
+// Get per-update cycle statistics of the filter
+// =============================================================================================#=
+void AttitudeServ_GetStats(AttitudeStats_t *stats);
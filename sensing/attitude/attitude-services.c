@@ -0,0 +1,468 @@
+/*
+================================================================================================#=
+FILE:
+attitude-services.c
+
+DESCRIPTION:
+    The AttitudeServ module fuses accelerometer and gyroscope samples into a
+    roll/pitch/yaw estimate and publishes it to subscribers at their requested rate.
+    This file implements those services.
+
+Adaptations Notes:  The filter step runs in the context of the accel task for every sample so
+                    it tracks the sensor rate. Euler conversion (trig) only runs in the
+                    attitude task at the fastest subscribed rate, keeping the per-sample cost
+                    within ATTITUDE_UPDATE_BUDGET_US.
+
+Copyright 2022-2023 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+#include "attitude-services-api.h"
+
+#include "mahony.h"
+#include "timing/timing.h"
+
+#include "stm32f4xx.h"
+
+// FreeRTOS Includes
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/*** Private Constants ***/
+
+#define ATTITUDE_STACK_SIZE_IN_WORDS 512
+#define ATTITUDE_IDLE_PERIOD_MS 100
+#define ATTITUDE_UPDATE_BUDGET_US 2
+#define ATTITUDE_MAX_DT_S 0.1f
+#define ATTITUDE_DEG_TO_RAD 0.01745329f
+#define ATTITUDE_MDPS_TO_RAD_PER_S (ATTITUDE_DEG_TO_RAD / 1000.0f)
+
+// Self-test on synthetic samples
+#define ATTITUDE_TEST_RATE_HZ 100
+#define ATTITUDE_TEST_STEP_MS (1000 / ATTITUDE_TEST_RATE_HZ)
+#define ATTITUDE_TEST_DT_S (1.0f / ATTITUDE_TEST_RATE_HZ)
+#define ATTITUDE_TEST_GRAVITY_MG 1000.0f
+#define ATTITUDE_TEST_TILT_ROLL_DEG 30.0f
+#define ATTITUDE_TEST_TILT_PITCH_DEG -20.0f
+#define ATTITUDE_TEST_SETTLED_DEG 1.0f // Roll/pitch error counted as converged
+#define ATTITUDE_TEST_CONVERGE_MAX_MS 5000
+#define ATTITUDE_TEST_DRIFT_S 60
+#define ATTITUDE_TEST_GYRO_BIAS_DPS 0.5f
+#define ATTITUDE_TEST_DRIFT_MAX_DEG 0.5f
+#define ATTITUDE_TEST_YAW_DRIFT_MAX_DEG 1.0f
+#define ATTITUDE_TEST_YAW_TURN_S 4 // Full turn at the yaw rate
+#define ATTITUDE_TEST_YAW_RATE_DPS 90.0f
+#define ATTITUDE_TEST_ROLL_S 2 // To 60 degrees at the roll rate
+#define ATTITUDE_TEST_ROLL_RATE_DPS 30.0f
+#define ATTITUDE_TEST_TRACK_MAX_DEG 2.0f
+
+/*** Private Types ***/
+
+typedef struct
+{
+    AttitudeCallback_t Callback;
+    uint32_t PeriodMs;
+    TickType_t LastPublishTick;
+} AttitudeSubscriber_t;
+
+/*** Private Variables ***/
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// TASK MEMORY
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+static StackType_t xAttitudeTaskStack[ATTITUDE_STACK_SIZE_IN_WORDS];
+static StaticTask_t xAttitudeTaskControlBlock;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Internal Private Data
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+static MAHONY_Filter_t xFilter;
+static float xGyroRadPerS[3] = {0};
+static uint32_t xLastUpdateCycles = 0;
+static bool xHaveLastUpdate = false;
+static AttitudeStats_t xStats = {0};
+static AttitudeSubscriber_t xSubscribers[ATTITUDE_MAX_SUBSCRIBERS] = {0};
+
+/*** Private Functions ***/
+
+// Take a consistent copy of the filter quaternion and convert it to Euler angles
+static void attitudeSnapshot(AttitudeEuler_t *attitude)
+{
+    MAHONY_Filter_t filterCopy;
+    MAHONY_Euler_t euler;
+
+    taskENTER_CRITICAL();
+    filterCopy = xFilter;
+    taskEXIT_CRITICAL();
+
+    MAHONY_GetEuler(&filterCopy, &euler);
+
+    attitude->RollDeg = euler.RollDeg;
+    attitude->PitchDeg = euler.PitchDeg;
+    attitude->YawDeg = euler.YawDeg;
+    attitude->TimestampMs = xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+// Fastest subscribed period, used as the attitude task wake-up interval
+static uint32_t attitudeTaskPeriodMs(void)
+{
+    uint32_t periodMs = ATTITUDE_IDLE_PERIOD_MS;
+
+    for (uint8_t i = 0; i < ATTITUDE_MAX_SUBSCRIBERS; i++)
+    {
+        if ((xSubscribers[i].Callback != NULL) && (xSubscribers[i].PeriodMs < periodMs))
+        {
+            periodMs = xSubscribers[i].PeriodMs;
+        }
+    }
+
+    return periodMs;
+}
+
+// Helper function to get the accelerometer reading of gravity, in mg, at a roll and pitch
+static void attitudeTestGravity(float rollDeg, float pitchDeg, float *accelMg)
+{
+    float roll = rollDeg * ATTITUDE_DEG_TO_RAD;
+    float pitch = pitchDeg * ATTITUDE_DEG_TO_RAD;
+
+    accelMg[0] = -ATTITUDE_TEST_GRAVITY_MG * sinf(pitch);
+    accelMg[1] = ATTITUDE_TEST_GRAVITY_MG * sinf(roll) * cosf(pitch);
+    accelMg[2] = ATTITUDE_TEST_GRAVITY_MG * cosf(roll) * cosf(pitch);
+}
+
+// Helper function to get the size of the difference of two angles in degrees, across the wrap
+static float attitudeTestError(float estimateDeg, float trueDeg)
+{
+    float error = fmodf(estimateDeg - trueDeg, 360.0f);
+
+    if (error > 180.0f)
+    {
+        error -= 360.0f;
+    }
+    else if (error < -180.0f)
+    {
+        error += 360.0f;
+    }
+
+    return fabsf(error);
+}
+
+/*
+ * Run a filter for a number of samples at a fixed roll rate and yaw rate (deg/s), one at a
+ * time, with a constant gyro bias on the X and Y axes. The true attitude starts at truth and is
+ * advanced with the rates. Returns the largest roll/pitch error seen.
+ */
+static float attitudeTestRun(MAHONY_Filter_t *filter, MAHONY_Euler_t *truth, uint32_t samples, float rollRateDps,
+                             float yawRateDps, float biasDps)
+{
+    MAHONY_Euler_t euler;
+    float accelMg[3];
+    float maxError = 0.0f;
+    float error = 0.0f;
+    uint32_t i = 0;
+
+    for (i = 0; i < samples; i++)
+    {
+        truth->RollDeg += rollRateDps * ATTITUDE_TEST_DT_S;
+        truth->YawDeg += yawRateDps * ATTITUDE_TEST_DT_S;
+        attitudeTestGravity(truth->RollDeg, truth->PitchDeg, accelMg);
+
+        MAHONY_Update(filter, (rollRateDps + biasDps) * ATTITUDE_DEG_TO_RAD, biasDps * ATTITUDE_DEG_TO_RAD,
+                      yawRateDps * ATTITUDE_DEG_TO_RAD, accelMg[0], accelMg[1], accelMg[2],
+                      ATTITUDE_TEST_DT_S);
+
+        MAHONY_GetEuler(filter, &euler);
+        error = attitudeTestError(euler.RollDeg, truth->RollDeg);
+        if (attitudeTestError(euler.PitchDeg, truth->PitchDeg) > error)
+        {
+            error = attitudeTestError(euler.PitchDeg, truth->PitchDeg);
+        }
+        if (error > maxError)
+        {
+            maxError = error;
+        }
+    }
+
+    return maxError;
+}
+
+/*
+ * Filter self-test on synthetic samples at ATTITUDE_TEST_RATE_HZ:
+ *  - convergence from identity to a static tilt within ATTITUDE_TEST_CONVERGE_MAX_MS
+ *  - roll/pitch drift over ATTITUDE_TEST_DRIFT_S with a gyro bias on X and Y, which gravity
+ *    makes observable, and no yaw drift leaking from it. A Z bias can't be corrected
+ *    without a magnetometer and drifts yaw at the bias rate.
+ *  - tracking of a full turn in yaw and a 60 degree roll
+ */
+static bool attitudeSelfTest(void)
+{
+    MAHONY_Filter_t filter;
+    MAHONY_Euler_t truth = {0};
+    MAHONY_Euler_t euler;
+    uint32_t convergeMs = 0;
+    float driftDeg = 0.0f;
+    float yawDriftDeg = 0.0f;
+    float yawTrackDeg = 0.0f;
+    float trackDeg = 0.0f;
+    float rollTrackDeg = 0.0f;
+    bool result = true;
+
+    // Convergence: the first sample after which roll and pitch stay within the bound
+    MAHONY_Init(&filter, MAHONY_DEFAULT_KP, MAHONY_DEFAULT_KI);
+    truth.RollDeg = ATTITUDE_TEST_TILT_ROLL_DEG;
+    truth.PitchDeg = ATTITUDE_TEST_TILT_PITCH_DEG;
+    for (convergeMs = 0; convergeMs < ATTITUDE_TEST_CONVERGE_MAX_MS; convergeMs += ATTITUDE_TEST_STEP_MS)
+    {
+        if (attitudeTestRun(&filter, &truth, 1, 0.0f, 0.0f, 0.0f) <= ATTITUDE_TEST_SETTLED_DEG)
+        {
+            break;
+        }
+    }
+
+    if ((convergeMs >= ATTITUDE_TEST_CONVERGE_MAX_MS) ||
+        (attitudeTestRun(&filter, &truth, ATTITUDE_TEST_RATE_HZ, 0.0f, 0.0f, 0.0f) > ATTITUDE_TEST_SETTLED_DEG))
+    {
+        printf("Attitude did not converge to a static tilt\n");
+        result = false;
+    }
+
+    // Drift: level and still, with a gyro bias the integral term has to learn
+    MAHONY_Init(&filter, MAHONY_DEFAULT_KP, MAHONY_DEFAULT_KI);
+    memset(&truth, 0, sizeof(truth));
+    attitudeTestRun(&filter, &truth, ATTITUDE_TEST_DRIFT_S * ATTITUDE_TEST_RATE_HZ, 0.0f, 0.0f,
+                    ATTITUDE_TEST_GYRO_BIAS_DPS);
+    driftDeg = attitudeTestRun(&filter, &truth, ATTITUDE_TEST_RATE_HZ, 0.0f, 0.0f, ATTITUDE_TEST_GYRO_BIAS_DPS);
+    MAHONY_GetEuler(&filter, &euler);
+    yawDriftDeg = attitudeTestError(euler.YawDeg, truth.YawDeg);
+
+    if ((driftDeg > ATTITUDE_TEST_DRIFT_MAX_DEG) || (yawDriftDeg > ATTITUDE_TEST_YAW_DRIFT_MAX_DEG))
+    {
+        printf("Attitude drifted with a gyro bias\n");
+        result = false;
+    }
+
+    // Rotation: a full turn in yaw, then a roll to 60 degrees
+    MAHONY_Init(&filter, MAHONY_DEFAULT_KP, MAHONY_DEFAULT_KI);
+    memset(&truth, 0, sizeof(truth));
+    trackDeg = attitudeTestRun(&filter, &truth, ATTITUDE_TEST_YAW_TURN_S * ATTITUDE_TEST_RATE_HZ, 0.0f,
+                               ATTITUDE_TEST_YAW_RATE_DPS, 0.0f);
+    MAHONY_GetEuler(&filter, &euler);
+    yawTrackDeg = attitudeTestError(euler.YawDeg, truth.YawDeg);
+    rollTrackDeg = attitudeTestRun(&filter, &truth, ATTITUDE_TEST_ROLL_S * ATTITUDE_TEST_RATE_HZ,
+                                   ATTITUDE_TEST_ROLL_RATE_DPS, 0.0f, 0.0f);
+    if (rollTrackDeg > trackDeg)
+    {
+        trackDeg = rollTrackDeg;
+    }
+
+    if ((trackDeg > ATTITUDE_TEST_TRACK_MAX_DEG) || (yawTrackDeg > ATTITUDE_TEST_TRACK_MAX_DEG))
+    {
+        printf("Attitude did not track a rotation\n");
+        result = false;
+    }
+
+    printf("Attitude self-test: converged in %lu ms, drift %lu mdeg (yaw %lu mdeg) over %u s, "
+           "tracking error %lu mdeg (yaw %lu mdeg)\n",
+           (unsigned long)convergeMs, (unsigned long)(driftDeg * 1000.0f), (unsigned long)(yawDriftDeg * 1000.0f),
+           ATTITUDE_TEST_DRIFT_S, (unsigned long)(trackDeg * 1000.0f), (unsigned long)(yawTrackDeg * 1000.0f));
+
+    return result;
+}
+
+// -----------------------------------------------------------------------------+-
+// Wake at the fastest subscribed rate and publish the attitude to every
+// subscriber whose period has elapsed.
+// -----------------------------------------------------------------------------+-
+static void attitudeTaskCode(void *arg)
+{
+    TickType_t lastWakeTime = 0;
+    AttitudeEuler_t attitude;
+    bool result = false;
+
+    result = attitudeSelfTest();
+
+    if (result == false)
+    {
+        printf("Attitude self-test failed\n");
+    }
+    else
+    {
+        printf("Attitude self-test passed\n");
+    }
+
+    lastWakeTime = xTaskGetTickCount();
+
+    for (;;)
+    {
+        vTaskDelayUntil(&lastWakeTime, pdMS_TO_TICKS(attitudeTaskPeriodMs()));
+
+        bool haveSnapshot = false;
+        TickType_t now = xTaskGetTickCount();
+
+        for (uint8_t i = 0; i < ATTITUDE_MAX_SUBSCRIBERS; i++)
+        {
+            AttitudeSubscriber_t *subscriber = &xSubscribers[i];
+
+            if ((subscriber->Callback == NULL) ||
+                ((now - subscriber->LastPublishTick) < pdMS_TO_TICKS(subscriber->PeriodMs)))
+            {
+                continue;
+            }
+
+            if (!haveSnapshot)
+            {
+                attitudeSnapshot(&attitude);
+                haveSnapshot = true;
+            }
+
+            subscriber->LastPublishTick = now;
+            subscriber->Callback(&attitude);
+        }
+    }
+}
+
+/*** Public Functions ***/
+
+/*
+ * Function:       AttitudeServ_UpdateAccel
+ * Arguments:      accelData, accel sample in mg
+ * Description:    Runs one filter step using the latest gyro sample and the time
+ *                 elapsed since the previous accel sample
+ * Return Message: None
+ */
+void AttitudeServ_UpdateAccel(const LIS3DSH_Data_t *accelData)
+{
+    uint32_t startCycles = TIMING_GetCycles();
+    MAHONY_Filter_t filter = xFilter; // Only this function writes the filter, no lock needed to read it
+    float gyroRadPerS[3] = {0};
+    float dt = 0.0f;
+
+    if (xHaveLastUpdate)
+    {
+        dt = (float)(startCycles - xLastUpdateCycles) / (float)SystemCoreClock;
+
+        // Samples arrive at the sensor data rate, a larger step means the stream stalled: don't integrate it
+        if (dt > ATTITUDE_MAX_DT_S)
+        {
+            dt = ATTITUDE_MAX_DT_S;
+        }
+    }
+    xLastUpdateCycles = startCycles;
+    xHaveLastUpdate = true;
+
+    taskENTER_CRITICAL();
+    memcpy(gyroRadPerS, xGyroRadPerS, sizeof(gyroRadPerS));
+    taskEXIT_CRITICAL();
+
+    // Step a copy so readers only wait for the result to be published
+    MAHONY_Update(&filter, gyroRadPerS[0], gyroRadPerS[1], gyroRadPerS[2],
+                  (float)accelData->accelX_mg, (float)accelData->accelY_mg, (float)accelData->accelZ_mg, dt);
+
+    taskENTER_CRITICAL();
+    xFilter = filter;
+    taskEXIT_CRITICAL();
+
+    uint32_t updateCycles = TIMING_GetCycles() - startCycles;
+
+    xStats.UpdateCount++;
+    xStats.LastUpdateCycles = updateCycles;
+    if (updateCycles > xStats.MaxUpdateCycles)
+    {
+        xStats.MaxUpdateCycles = updateCycles;
+    }
+    if (TIMING_CyclesToUs(updateCycles) >= ATTITUDE_UPDATE_BUDGET_US)
+    {
+        xStats.BudgetOverruns++;
+    }
+}
+
+/*
+ * Function:       AttitudeServ_UpdateGyro
+ * Arguments:      angularRateMdps, X/Y/Z angular rate in mdps
+ * Description:    Stores the latest gyro sample for the next filter step
+ * Return Message: None
+ */
+void AttitudeServ_UpdateGyro(const float *angularRateMdps)
+{
+    taskENTER_CRITICAL();
+    xGyroRadPerS[0] = angularRateMdps[0] * ATTITUDE_MDPS_TO_RAD_PER_S;
+    xGyroRadPerS[1] = angularRateMdps[1] * ATTITUDE_MDPS_TO_RAD_PER_S;
+    xGyroRadPerS[2] = angularRateMdps[2] * ATTITUDE_MDPS_TO_RAD_PER_S;
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * Function:       AttitudeServ_Subscribe
+ * Arguments:      periodMs, callback
+ * Description:    Adds a subscriber to the publish table
+ * Return Message: true, false if the table is full or arguments are invalid
+ */
+bool AttitudeServ_Subscribe(uint32_t periodMs, AttitudeCallback_t callback)
+{
+    if ((callback == NULL) || (periodMs == 0))
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < ATTITUDE_MAX_SUBSCRIBERS; i++)
+    {
+        if (xSubscribers[i].Callback == NULL)
+        {
+            xSubscribers[i].PeriodMs = periodMs;
+            xSubscribers[i].LastPublishTick = xTaskGetTickCount();
+            xSubscribers[i].Callback = callback;
+            return true;
+        }
+    }
+
+    printf("Attitude subscriber table full\n");
+    return false;
+}
+
+/*
+ * Function:       AttitudeServ_GetEuler
+ * Arguments:      attitude
+ * Description:    Returns the current attitude estimate
+ * Return Message: None
+ */
+void AttitudeServ_GetEuler(AttitudeEuler_t *attitude)
+{
+    attitudeSnapshot(attitude);
+}
+
+/*
+ * Function:       AttitudeServ_GetStats
+ * Arguments:      stats
+ * Description:    Returns filter update cycle statistics
+ * Return Message: None
+ */
+void AttitudeServ_GetStats(AttitudeStats_t *stats)
+{
+    taskENTER_CRITICAL();
+    *stats = xStats;
+    taskEXIT_CRITICAL();
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Init the attitude services module
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+void AttitudeServ_Init(void)
+{
+    MAHONY_Init(&xFilter, MAHONY_DEFAULT_KP, MAHONY_DEFAULT_KI);
+
+    // ---------------------------------------------------------------------+-
+    // Create attitude task to publish to subscribers.
+    // ---------------------------------------------------------------------+--
+    const char *const attitudeTaskName = "attitude";
+    void *attitudeTaskNoParams = NULL;
+    UBaseType_t attitudeTaskPriority = tskIDLE_PRIORITY + 1;
+
+    xTaskCreateStatic(attitudeTaskCode, attitudeTaskName, ATTITUDE_STACK_SIZE_IN_WORDS,
+                      attitudeTaskNoParams, attitudeTaskPriority, xAttitudeTaskStack,
+                      &xAttitudeTaskControlBlock);
+}
@@ -0,0 +1,140 @@
+/*
+ * mahony.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Belina Sainju
+ */
+
+#include "mahony.h"
+
+#include <math.h>
+
+#define MAHONY_RAD_TO_DEG 57.29578f
+
+/*** Private Functions ***/
+
+static float mahonyInvSqrt(float value)
+{
+    return 1.0f / sqrtf(value);
+}
+
+/*** Public Functions ***/
+
+/*
+ * Function:       MAHONY_Init
+ * Arguments:      filter, kp, ki
+ * Description:    Reset quaternion to identity and clear the integral term
+ * Return Message: None
+ */
+void MAHONY_Init(MAHONY_Filter_t *filter, float kp, float ki)
+{
+    filter->Q0 = 1.0f;
+    filter->Q1 = 0.0f;
+    filter->Q2 = 0.0f;
+    filter->Q3 = 0.0f;
+    filter->IntegralX = 0.0f;
+    filter->IntegralY = 0.0f;
+    filter->IntegralZ = 0.0f;
+    filter->Kp = kp;
+    filter->Ki = ki;
+}
+
+/*
+ * Function:       MAHONY_Update
+ * Arguments:      filter, gx, gy, gz (rad/s), ax, ay, az, dt (s)
+ * Description:    Correct the gyro rate with the error between measured and estimated
+ *                 gravity, then integrate the quaternion. Straight-line float code so
+ *                 one step stays within a few hundred cycles on the Cortex-M4F.
+ * Return Message: None
+ */
+void MAHONY_Update(MAHONY_Filter_t *filter, float gx, float gy, float gz,
+                   float ax, float ay, float az, float dt)
+{
+    float q0 = filter->Q0;
+    float q1 = filter->Q1;
+    float q2 = filter->Q2;
+    float q3 = filter->Q3;
+    float accelNormSq = ax * ax + ay * ay + az * az;
+
+    // Skip the correction if the accelerometer reading is invalid (free fall or read failure)
+    if (accelNormSq > 0.0f)
+    {
+        float recipNorm = mahonyInvSqrt(accelNormSq);
+        ax *= recipNorm;
+        ay *= recipNorm;
+        az *= recipNorm;
+
+        // Estimated direction of gravity in the body frame
+        float vx = 2.0f * (q1 * q3 - q0 * q2);
+        float vy = 2.0f * (q0 * q1 + q2 * q3);
+        float vz = q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3;
+
+        // Error is the cross product between measured and estimated gravity
+        float ex = ay * vz - az * vy;
+        float ey = az * vx - ax * vz;
+        float ez = ax * vy - ay * vx;
+
+        if (filter->Ki > 0.0f)
+        {
+            filter->IntegralX += filter->Ki * ex * dt;
+            filter->IntegralY += filter->Ki * ey * dt;
+            filter->IntegralZ += filter->Ki * ez * dt;
+            gx += filter->IntegralX;
+            gy += filter->IntegralY;
+            gz += filter->IntegralZ;
+        }
+
+        gx += filter->Kp * ex;
+        gy += filter->Kp * ey;
+        gz += filter->Kp * ez;
+    }
+
+    // Integrate rate of change of quaternion
+    float halfDt = 0.5f * dt;
+    gx *= halfDt;
+    gy *= halfDt;
+    gz *= halfDt;
+
+    float qa = q0;
+    float qb = q1;
+    float qc = q2;
+    q0 += (-qb * gx - qc * gy - q3 * gz);
+    q1 += (qa * gx + qc * gz - q3 * gy);
+    q2 += (qa * gy - qb * gz + q3 * gx);
+    q3 += (qa * gz + qb * gy - qc * gx);
+
+    float recipNorm = mahonyInvSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+    filter->Q0 = q0 * recipNorm;
+    filter->Q1 = q1 * recipNorm;
+    filter->Q2 = q2 * recipNorm;
+    filter->Q3 = q3 * recipNorm;
+}
+
+/*
+ * Function:       MAHONY_GetEuler
+ * Arguments:      filter, euler
+ * Description:    Convert the quaternion to roll/pitch/yaw in degrees
+ * Return Message: None
+ */
+void MAHONY_GetEuler(const MAHONY_Filter_t *filter, MAHONY_Euler_t *euler)
+{
+    float q0 = filter->Q0;
+    float q1 = filter->Q1;
+    float q2 = filter->Q2;
+    float q3 = filter->Q3;
+    float sinPitch = 2.0f * (q0 * q2 - q3 * q1);
+
+    // Clamp to avoid NaN from rounding when pitch is near +/-90 degrees
+    if (sinPitch > 1.0f)
+    {
+        sinPitch = 1.0f;
+    }
+    else if (sinPitch < -1.0f)
+    {
+        sinPitch = -1.0f;
+    }
+
+    euler->RollDeg = atan2f(2.0f * (q0 * q1 + q2 * q3), 1.0f - 2.0f * (q1 * q1 + q2 * q2)) * MAHONY_RAD_TO_DEG;
+    euler->PitchDeg = asinf(sinPitch) * MAHONY_RAD_TO_DEG;
+    euler->YawDeg = atan2f(2.0f * (q0 * q3 + q1 * q2), 1.0f - 2.0f * (q2 * q2 + q3 * q3)) * MAHONY_RAD_TO_DEG;
+}
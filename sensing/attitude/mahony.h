@@ -0,0 +1,76 @@
+#pragma once
+/**
+ *  @file                   sensing/attitude/mahony.h
+ *  @brief                  Single-precision quaternion Mahony filter fusing
+ *                          accelerometer and gyroscope samples into an attitude estimate
+ *  @date                   Oct 18, 2026
+ *  @author                 Belina Sainju
+ *  @remark                 Without a magnetometer yaw is gyro-integrated only and will drift
+ */
+
+#ifndef MAHONY_H_
+#define MAHONY_H_
+
+/* This ifdef allows the header to be used from both C and C++. */
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+    // Default proportional and integral feedback gains
+#define MAHONY_DEFAULT_KP 1.0f
+#define MAHONY_DEFAULT_KI 0.02f
+
+    // Filter state: unit quaternion (Q0 is the scalar part) and gyro bias integral
+    typedef struct
+    {
+        float Q0;
+        float Q1;
+        float Q2;
+        float Q3;
+        float IntegralX;
+        float IntegralY;
+        float IntegralZ;
+        float Kp;
+        float Ki;
+    } MAHONY_Filter_t;
+
+    // Euler angles in degrees (ZYX convention)
+    typedef struct
+    {
+        float RollDeg;
+        float PitchDeg;
+        float YawDeg;
+    } MAHONY_Euler_t;
+
+    // =============================================================================================#=
+    // Public API Functions
+    // =============================================================================================#=
+
+    // =============================================================================================#=
+    // Reset the filter to identity attitude with the given gains
+    // =============================================================================================#=
+    void MAHONY_Init(MAHONY_Filter_t *filter, float kp, float ki);
+
+    // =============================================================================================#=
+    // Run one filter step.
+    //
+    // gx/gy/gz: angular rate in rad/s
+    // ax/ay/az: acceleration in any consistent unit (only the direction is used)
+    // dt:       time since the previous update in seconds
+    // =============================================================================================#=
+    void MAHONY_Update(MAHONY_Filter_t *filter, float gx, float gy, float gz,
+                       float ax, float ay, float az, float dt);
+
+    // =============================================================================================#=
+    // Convert the filter quaternion to roll/pitch/yaw. Uses libm trig, keep out of the sample path.
+    // =============================================================================================#=
+    void MAHONY_GetEuler(const MAHONY_Filter_t *filter, MAHONY_Euler_t *euler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAHONY_H_ */
@@ -0,0 +1,87 @@
+#pragma once
+/*
+================================================================================================#=
+FILE:
+flash-bench-api.h
+
+DESCRIPTION:
+    The FlashBench module measures a flash device with a fixed table of cases: sequential
+    and random read and program across block sizes, erase at each granularity, and mixed
+    read/program with and without a concurrent background load. Each case reports
+    throughput, IOPS and p50/p99/max latency, timed with the DWT cycle counter or the
+    device's own clock. The device is reached through a table of functions, so the same
+    suite runs on the MX25 through flash-services and on the simulated MX25 of flash-sim.
+    This file defines the API to access those services.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+// FLASH information other modules may need to access:
+#include "flash-services-api.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FLASH_BENCH_MAX_OPS 256 // Latency samples kept per case
+#define FLASH_BENCH_MAX_RESULTS 16 // Cases in the table
+#define FLASH_BENCH_MAX_BLOCK SECTOR_OFFSET
+
+// What a case does on each operation
+typedef enum
+{
+    FLASH_BENCH_READ,
+    FLASH_BENCH_PROGRAM,
+    FLASH_BENCH_ERASE,
+    FLASH_BENCH_MIXED // Reads and programs of BlockSize, ReadPercent of them reads
+} FlashBenchKind_t;
+
+// Device the suite runs against
+typedef struct
+{
+    const char *Name;
+    uint32_t Start; // Region the suite may erase and program, sector aligned
+    uint32_t Size;
+    flashReturnMsg_t (*Read)(uint32_t address, uint8_t *data, uint32_t length);
+    flashReturnMsg_t (*Program)(uint32_t address, const uint8_t *data, uint32_t length);
+    flashReturnMsg_t (*Erase)(uint32_t address, uint32_t size); // One aligned region of size
+    void (*SetLoad)(bool enabled); // Optional background load for the mixed cases
+    uint32_t (*GetNowUs)(void); // Optional clock, such as a simulated one. The cycle counter if NULL
+} FlashBenchDevice_t;
+
+// One entry of the case table
+typedef struct
+{
+    const char *Name;
+    FlashBenchKind_t Kind;
+    uint32_t BlockSize;
+    uint32_t Ops; // Capped at FLASH_BENCH_MAX_OPS and at what fits in the region
+    bool Random;
+    uint8_t ReadPercent;
+    bool Load;
+} FlashBenchCase_t;
+
+// Result of one case
+typedef struct
+{
+    const FlashBenchCase_t *Case;
+    uint32_t Ops;
+    uint32_t Errors;
+    uint32_t ElapsedUs;
+    uint32_t KBps;
+    uint32_t Iops;
+    uint32_t P50Us;
+    uint32_t P99Us;
+    uint32_t MaxUs;
+} FlashBenchResult_t;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Run every case of the table against the device, filling up to maxResults results.
+// The device region is erased and overwritten. Returns the number of results filled.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+uint32_t FlashBench_Run(const FlashBenchDevice_t *device, FlashBenchResult_t *results, uint32_t maxResults);
+
+// Print the results as a table, one line per case
+void FlashBench_Print(const FlashBenchDevice_t *device, const FlashBenchResult_t *results, uint32_t count);
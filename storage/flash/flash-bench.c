@@ -0,0 +1,305 @@
+/*
+================================================================================================#=
+FILE:
+flash-bench.c
+
+DESCRIPTION:
+    The FlashBench module measures a flash device with a fixed table of cases.
+    This file implements those services.
+
+Adaptations Notes:  Each operation is timed on its own with the cycle counter and kept, so
+                    percentiles come from the sorted samples rather than a histogram. Throughput
+                    and IOPS use the wall time of the whole case, which includes the time lost
+                    to the background load in the mixed cases.
+
+                    Random cases visit block slots in the order (i * BENCH_SLOT_STRIDE) modulo
+                    the slot count. The stride is prime, so no slot repeats and random programs
+                    never hit a block already programmed in the same pass.
+
+                    A device with its own clock is timed on it rather than on the cycle counter,
+                    so a simulated device reports the time of its model, not of the simulation.
+
+                    The module only uses the device table, the timing module and the C library,
+                    so a host build can link it with a simulated device and stub timing.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+#include "flash-bench-api.h"
+
+#include "timing/timing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_SLOT_STRIDE 7919 // Prime, so the visiting order is a permutation
+#define BENCH_PATTERN_SEED 0x5A
+#define US_PER_SECOND 1000000
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Case table
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+static const FlashBenchCase_t xCases[] = {
+    {"seq read", FLASH_BENCH_READ, 16, 256, false, 0, false},
+    {"seq read", FLASH_BENCH_READ, PAGE_OFFSET, 256, false, 0, false},
+    {"seq read", FLASH_BENCH_READ, SECTOR_OFFSET, 64, false, 0, false},
+    {"rand read", FLASH_BENCH_READ, 16, 256, true, 0, false},
+    {"rand read", FLASH_BENCH_READ, PAGE_OFFSET, 256, true, 0, false},
+    {"rand read", FLASH_BENCH_READ, SECTOR_OFFSET, 64, true, 0, false},
+    {"seq program", FLASH_BENCH_PROGRAM, 16, 256, false, 0, false},
+    {"seq program", FLASH_BENCH_PROGRAM, PAGE_OFFSET, 256, false, 0, false},
+    {"seq program", FLASH_BENCH_PROGRAM, SECTOR_OFFSET, 32, false, 0, false},
+    {"rand program", FLASH_BENCH_PROGRAM, 16, 256, true, 0, false},
+    {"rand program", FLASH_BENCH_PROGRAM, PAGE_OFFSET, 256, true, 0, false},
+    {"erase", FLASH_BENCH_ERASE, SECTOR_OFFSET, 32, false, 0, false},
+    {"erase", FLASH_BENCH_ERASE, BLOCK_32K_OFFSET, 8, false, 0, false},
+    {"erase", FLASH_BENCH_ERASE, BLOCK_OFFSET, 4, false, 0, false},
+    {"mixed 70r", FLASH_BENCH_MIXED, PAGE_OFFSET, 256, true, 70, false},
+    {"mixed 70r load", FLASH_BENCH_MIXED, PAGE_OFFSET, 256, true, 70, true},
+};
+
+#define BENCH_CASES (sizeof(xCases) / sizeof(xCases[0]))
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Internal Private Data
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+static uint32_t xLatencyUs[FLASH_BENCH_MAX_OPS];
+static uint8_t xBlock[FLASH_BENCH_MAX_BLOCK];
+
+/*** Private Functions ***/
+
+// Helper function to order latency samples for qsort
+static int benchCompareUs(const void *a, const void *b)
+{
+    uint32_t left = *(const uint32_t *)a;
+    uint32_t right = *(const uint32_t *)b;
+
+    return (left > right) - (left < right);
+}
+
+// Helper function to get the address of the i-th block a case visits
+static uint32_t benchAddress(const FlashBenchDevice_t *device, uint32_t blockSize, bool random, uint32_t i)
+{
+    uint32_t slots = device->Size / blockSize;
+    uint32_t slot = random ? (uint32_t)(((uint64_t)i * BENCH_SLOT_STRIDE) % slots) : (i % slots);
+
+    return device->Start + (slot * blockSize);
+}
+
+/*
+ * Erase the first length bytes of the device region with the largest aligned erases
+ */
+static bool benchEraseRegion(const FlashBenchDevice_t *device, uint32_t length)
+{
+    uint32_t address = device->Start;
+    uint32_t endAddress = device->Start + length;
+    uint32_t eraseSize = 0;
+
+    while (address < endAddress)
+    {
+        eraseSize = SECTOR_OFFSET;
+        if (((address % BLOCK_OFFSET) == 0) && ((endAddress - address) >= BLOCK_OFFSET))
+        {
+            eraseSize = BLOCK_OFFSET;
+        }
+
+        if (device->Erase(address, eraseSize) != FLASH_OPERATION_SUCCESS)
+        {
+            return false;
+        }
+
+        address += eraseSize;
+    }
+
+    return true;
+}
+
+/*
+ * Run one operation of a case, returning its result
+ */
+static flashReturnMsg_t benchRunOp(const FlashBenchDevice_t *device, const FlashBenchCase_t *benchCase, uint32_t i,
+                                   uint32_t *programIndex)
+{
+    uint32_t blockSize = benchCase->BlockSize;
+    uint32_t programShare = 0;
+
+    switch (benchCase->Kind)
+    {
+    case FLASH_BENCH_READ:
+        return device->Read(benchAddress(device, blockSize, benchCase->Random, i), xBlock, blockSize);
+
+    case FLASH_BENCH_PROGRAM:
+        return device->Program(benchAddress(device, blockSize, benchCase->Random, i), xBlock, blockSize);
+
+    case FLASH_BENCH_ERASE:
+        return device->Erase(benchAddress(device, blockSize, benchCase->Random, i), blockSize);
+
+    case FLASH_BENCH_MIXED:
+    default:
+        // Spread the programs evenly through the reads, always into freshly erased blocks
+        programShare = 100 - benchCase->ReadPercent;
+        if ((((i + 1) * programShare) / 100) == ((i * programShare) / 100))
+        {
+            return device->Read(benchAddress(device, blockSize, benchCase->Random, i), xBlock, blockSize);
+        }
+        return device->Program(benchAddress(device, blockSize, false, (*programIndex)++), xBlock, blockSize);
+    }
+}
+
+// Helper function to read the clock a device is timed on
+static uint32_t benchNow(const FlashBenchDevice_t *device)
+{
+    return (device->GetNowUs != NULL) ? device->GetNowUs() : TIMING_GetCycles();
+}
+
+// Helper function to get the microseconds since a reading of the clock a device is timed on
+static uint32_t benchElapsedUs(const FlashBenchDevice_t *device, uint32_t start)
+{
+    if (device->GetNowUs != NULL)
+    {
+        return device->GetNowUs() - start;
+    }
+
+    return TIMING_CyclesToUs(TIMING_GetCycles() - start);
+}
+
+/*
+ * Run one case and fill its result
+ */
+static void benchRunCase(const FlashBenchDevice_t *device, const FlashBenchCase_t *benchCase,
+                         FlashBenchResult_t *result)
+{
+    uint32_t ops = benchCase->Ops;
+    uint32_t eraseLength = 0;
+    uint32_t programIndex = 0;
+    uint32_t startTime = 0;
+    uint32_t opTime = 0;
+    uint64_t bytes = 0;
+    uint32_t i = 0;
+
+    memset(result, 0, sizeof(*result));
+    result->Case = benchCase;
+
+    // Erases move no data, so only they may be larger than the block buffer
+    if ((benchCase->BlockSize == 0) || ((device->Start % benchCase->BlockSize) != 0) ||
+        ((benchCase->Kind != FLASH_BENCH_ERASE) && (benchCase->BlockSize > FLASH_BENCH_MAX_BLOCK)))
+    {
+        return;
+    }
+
+    if (ops > FLASH_BENCH_MAX_OPS)
+    {
+        ops = FLASH_BENCH_MAX_OPS;
+    }
+    if (ops > (device->Size / benchCase->BlockSize))
+    {
+        ops = device->Size / benchCase->BlockSize;
+    }
+
+    // Programs need erased blocks, done up front so they aren't timed
+    if ((benchCase->Kind == FLASH_BENCH_PROGRAM) || (benchCase->Kind == FLASH_BENCH_MIXED))
+    {
+        eraseLength = device->Size;
+        if (!benchCase->Random || (benchCase->Kind == FLASH_BENCH_MIXED))
+        {
+            eraseLength = ((ops * benchCase->BlockSize) + SECTOR_OFFSET - 1) & ~(SECTOR_OFFSET - 1);
+        }
+
+        if (!benchEraseRegion(device, eraseLength))
+        {
+            result->Errors = ops;
+            return;
+        }
+    }
+
+    for (i = 0; i < sizeof(xBlock); i++)
+    {
+        xBlock[i] = (uint8_t)(BENCH_PATTERN_SEED + i);
+    }
+
+    if (benchCase->Load && (device->SetLoad != NULL))
+    {
+        device->SetLoad(true);
+    }
+
+    startTime = benchNow(device);
+    for (i = 0; i < ops; i++)
+    {
+        opTime = benchNow(device);
+        if (benchRunOp(device, benchCase, i, &programIndex) != FLASH_OPERATION_SUCCESS)
+        {
+            result->Errors++;
+        }
+        xLatencyUs[i] = benchElapsedUs(device, opTime);
+    }
+    result->ElapsedUs = benchElapsedUs(device, startTime);
+
+    if (benchCase->Load && (device->SetLoad != NULL))
+    {
+        device->SetLoad(false);
+    }
+
+    result->Ops = ops;
+    if ((ops == 0) || (result->ElapsedUs == 0))
+    {
+        return;
+    }
+
+    bytes = (uint64_t)ops * benchCase->BlockSize;
+    result->KBps = (uint32_t)((bytes * 1000) / result->ElapsedUs);
+    result->Iops = (uint32_t)(((uint64_t)ops * US_PER_SECOND) / result->ElapsedUs);
+
+    qsort(xLatencyUs, ops, sizeof(xLatencyUs[0]), benchCompareUs);
+    result->P50Us = xLatencyUs[((ops - 1) * 50) / 100];
+    result->P99Us = xLatencyUs[((ops - 1) * 99) / 100];
+    result->MaxUs = xLatencyUs[ops - 1];
+}
+
+/*** Public Functions ***/
+
+/*
+ * Function to run the case table against a device
+ */
+uint32_t FlashBench_Run(const FlashBenchDevice_t *device, FlashBenchResult_t *results, uint32_t maxResults)
+{
+    uint32_t count = 0;
+
+    if ((device == NULL) || (device->Read == NULL) || (device->Program == NULL) || (device->Erase == NULL) ||
+        (device->Size < BLOCK_OFFSET))
+    {
+        return 0;
+    }
+
+    for (count = 0; (count < BENCH_CASES) && (count < maxResults); count++)
+    {
+        benchRunCase(device, &xCases[count], &results[count]);
+    }
+
+    return count;
+}
+
+/*
+ * Function to print the results table
+ */
+void FlashBench_Print(const FlashBenchDevice_t *device, const FlashBenchResult_t *results, uint32_t count)
+{
+    uint32_t i = 0;
+
+    printf("Flash bench on %s, %lu KB at 0x%06lX\n", device->Name, (unsigned long)(device->Size / 1024),
+           (unsigned long)device->Start);
+    printf("%-16s %6s %5s %4s %8s %7s %7s %7s %7s\n", "case", "block", "ops", "err", "MB/s", "IOPS", "p50us",
+           "p99us", "maxus");
+
+    for (i = 0; i < count; i++)
+    {
+        printf("%-16s %6lu %5lu %4lu %4lu.%03lu %7lu %7lu %7lu %7lu\n", results[i].Case->Name,
+               (unsigned long)results[i].Case->BlockSize, (unsigned long)results[i].Ops,
+               (unsigned long)results[i].Errors, (unsigned long)(results[i].KBps / 1000),
+               (unsigned long)(results[i].KBps % 1000), (unsigned long)results[i].Iops,
+               (unsigned long)results[i].P50Us, (unsigned long)results[i].P99Us, (unsigned long)results[i].MaxUs);
+    }
+}
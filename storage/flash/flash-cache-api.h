@@ -0,0 +1,61 @@
+#pragma once
+/*
+================================================================================================#=
+FILE:
+flash-cache-api.h
+
+DESCRIPTION:
+    The FlashCache module keeps recently read 256 byte pages of the MX25 flash in CCMRAM,
+    so repeated small reads of hot data skip the SPI transaction. It sits between
+    flash-services and MX25_READ; flash-services invalidates it on every program and erase.
+    This file defines the API to access those services.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+// FLASH information other modules may need to access:
+#include "mx25v1635f.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Cached pages. The lines and their tags live in the 64KB CCMRAM.
+#define FLASH_CACHE_PAGES 128
+#define FLASH_CACHE_LINE_SIZE PAGE_OFFSET
+
+#if FLASH_CACHE_PAGES > 240
+#error "Flash cache does not fit in CCMRAM"
+#endif
+
+// Hit and miss counters, counted per page touched
+typedef struct
+{
+    uint32_t Hits;
+    uint32_t Misses;
+    uint32_t Bypasses; // Reads longer than a page go straight to the device
+    uint32_t Evictions;
+    uint32_t Invalidations;
+} FlashCacheStats_t;
+
+// Clear the cache and enable it in front of the given part
+void FlashCache_Init(Mx25Device_t *device);
+
+// Enable or disable the cache. Disabling drops every cached page.
+void FlashCache_SetEnabled(bool enabled);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Read through the cache. Missed pages are read whole and kept unless fill is false,
+// which is used while a program or erase is suspended and pages may be half written.
+// The caller must hold the flash-services lock.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+flashReturnMsg_t FlashCache_Read(uint32_t address, uint8_t *data, uint32_t length, bool fill);
+
+// Drop any cached page overlapping the range. Call before programming or erasing it.
+void FlashCache_Invalidate(uint32_t address, uint32_t length);
+
+// Get and clear the hit and miss counters
+void FlashCache_GetStats(FlashCacheStats_t *stats);
+void FlashCache_ResetStats(void);
@@ -0,0 +1,272 @@
+/*
+================================================================================================#=
+FILE:
+flash-cache.c
+
+DESCRIPTION:
+    The FlashCache module keeps recently read pages of the MX25 flash in CCMRAM.
+    This file implements those services.
+
+Adaptations Notes:  Lines are found through a hash of the page address with chained buckets,
+                    and evicted with the CLOCK algorithm: each hit sets a referenced bit and the
+                    clock hand passes over referenced lines once, clearing the bit, before
+                    taking one. This approximates LRU without reordering a list on every hit.
+
+                    CCMRAM is not initialized by the startup code and is not reachable by DMA;
+                    the cache clears it in FlashCache_Init and only the CPU copies in and out.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+#include "flash-cache-api.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+
+// Not loaded or cleared at startup, cacheClear sets up the tags before any line is used
+#define CACHE_CCMRAM __attribute__((section(".ccmbss")))
+#define CACHE_INVALID_TAG 0xFFFFFFFF
+#define CACHE_NO_LINE 0xFF
+#define CACHE_BUCKETS FLASH_CACHE_PAGES
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Internal Private Data
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+static uint8_t xLines[FLASH_CACHE_PAGES][FLASH_CACHE_LINE_SIZE] CACHE_CCMRAM;
+static uint32_t xTags[FLASH_CACHE_PAGES] CACHE_CCMRAM;
+static uint8_t xNextInBucket[FLASH_CACHE_PAGES] CACHE_CCMRAM;
+static uint8_t xBuckets[CACHE_BUCKETS] CACHE_CCMRAM;
+static uint8_t xReferenced[FLASH_CACHE_PAGES] CACHE_CCMRAM;
+
+// Part the missed pages are read from
+static Mx25Device_t *xDevice = NULL;
+
+static uint8_t xClockHand = 0;
+static bool xEnabled = false;
+static FlashCacheStats_t xStats = {0};
+
+/*** Private Functions ***/
+
+// Helper function to get the bucket of a page address
+static uint32_t cacheBucket(uint32_t pageAddress)
+{
+    return (pageAddress / FLASH_CACHE_LINE_SIZE) % CACHE_BUCKETS;
+}
+
+// Helper function to find the line holding a page
+static uint8_t cacheFind(uint32_t pageAddress)
+{
+    uint8_t line = xBuckets[cacheBucket(pageAddress)];
+
+    while ((line != CACHE_NO_LINE) && (xTags[line] != pageAddress))
+    {
+        line = xNextInBucket[line];
+    }
+
+    return line;
+}
+
+// Helper function to drop a line from its bucket
+static void cacheRemove(uint8_t line)
+{
+    uint8_t *link = &xBuckets[cacheBucket(xTags[line])];
+
+    while ((*link != CACHE_NO_LINE) && (*link != line))
+    {
+        link = &xNextInBucket[*link];
+    }
+
+    if (*link == line)
+    {
+        *link = xNextInBucket[line];
+    }
+
+    xTags[line] = CACHE_INVALID_TAG;
+    xReferenced[line] = 0;
+}
+
+/*
+ * Pick a line to reuse with the CLOCK algorithm
+ */
+static uint8_t cacheVictim(void)
+{
+    uint8_t line = 0;
+
+    for (;;)
+    {
+        line = xClockHand;
+        xClockHand = (xClockHand + 1) % FLASH_CACHE_PAGES;
+
+        if (xTags[line] == CACHE_INVALID_TAG)
+        {
+            return line;
+        }
+
+        if (xReferenced[line] == 0)
+        {
+            cacheRemove(line);
+            xStats.Evictions++;
+            return line;
+        }
+
+        xReferenced[line] = 0;
+    }
+}
+
+// Helper function to drop every line
+static void cacheClear(void)
+{
+    memset(xTags, 0xFF, sizeof(xTags));
+    memset(xNextInBucket, CACHE_NO_LINE, sizeof(xNextInBucket));
+    memset(xBuckets, CACHE_NO_LINE, sizeof(xBuckets));
+    memset(xReferenced, 0, sizeof(xReferenced));
+    xClockHand = 0;
+}
+
+/*** Public Functions ***/
+
+/*
+ * Function to clear and enable the cache
+ */
+void FlashCache_Init(Mx25Device_t *device)
+{
+    xDevice = device;
+    cacheClear();
+    memset(&xStats, 0, sizeof(xStats));
+    xEnabled = true;
+}
+
+/*
+ * Function to enable or disable the cache
+ */
+void FlashCache_SetEnabled(bool enabled)
+{
+    cacheClear();
+    xEnabled = enabled;
+}
+
+/*
+ * Function to read through the cache
+ */
+flashReturnMsg_t FlashCache_Read(uint32_t address, uint8_t *data, uint32_t length, bool fill)
+{
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+    uint32_t pageAddress = 0;
+    uint32_t pageOffset = 0;
+    uint32_t chunkLength = 0;
+    uint8_t line = 0;
+
+    // Long reads gain nothing from the cache and would flush it
+    if (!xEnabled || (length > FLASH_CACHE_LINE_SIZE))
+    {
+        xStats.Bypasses++;
+        return MX25_READ(xDevice, address, data, length);
+    }
+
+    while ((length > 0) && (msg == FLASH_OPERATION_SUCCESS))
+    {
+        pageAddress = address & ~(FLASH_CACHE_LINE_SIZE - 1);
+        pageOffset = address - pageAddress;
+        chunkLength = FLASH_CACHE_LINE_SIZE - pageOffset;
+        if (chunkLength > length)
+        {
+            chunkLength = length;
+        }
+
+        line = cacheFind(pageAddress);
+        if (line != CACHE_NO_LINE)
+        {
+            xStats.Hits++;
+            xReferenced[line] = 1;
+            memcpy(data, &xLines[line][pageOffset], chunkLength);
+        }
+        else if (!fill)
+        {
+            xStats.Misses++;
+            msg = MX25_READ(xDevice, address, data, chunkLength);
+        }
+        else
+        {
+            xStats.Misses++;
+            line = cacheVictim();
+            msg = MX25_READ(xDevice, pageAddress, xLines[line], FLASH_CACHE_LINE_SIZE);
+            if (msg == FLASH_OPERATION_SUCCESS)
+            {
+                xTags[line] = pageAddress;
+                xNextInBucket[line] = xBuckets[cacheBucket(pageAddress)];
+                xBuckets[cacheBucket(pageAddress)] = line;
+                memcpy(data, &xLines[line][pageOffset], chunkLength);
+            }
+        }
+
+        address += chunkLength;
+        data += chunkLength;
+        length -= chunkLength;
+    }
+
+    return msg;
+}
+
+/*
+ * Function to drop cached pages overlapping a range
+ */
+void FlashCache_Invalidate(uint32_t address, uint32_t length)
+{
+    uint32_t pageAddress = address & ~(FLASH_CACHE_LINE_SIZE - 1);
+    uint32_t endAddress = address + length;
+    uint8_t line = 0;
+
+    if (length == 0)
+    {
+        return;
+    }
+
+    xStats.Invalidations++;
+
+    // Large ranges (erases) are cheaper to check line by line than page by page
+    if ((endAddress - pageAddress) > (FLASH_CACHE_PAGES * FLASH_CACHE_LINE_SIZE))
+    {
+        for (line = 0; line < FLASH_CACHE_PAGES; line++)
+        {
+            if ((xTags[line] != CACHE_INVALID_TAG) && (xTags[line] >= pageAddress) && (xTags[line] < endAddress))
+            {
+                cacheRemove(line);
+            }
+        }
+        return;
+    }
+
+    for (; pageAddress < endAddress; pageAddress += FLASH_CACHE_LINE_SIZE)
+    {
+        line = cacheFind(pageAddress);
+        if (line != CACHE_NO_LINE)
+        {
+            cacheRemove(line);
+        }
+    }
+}
+
+/*
+ * Function to get the hit and miss counters
+ */
+void FlashCache_GetStats(FlashCacheStats_t *stats)
+{
+    taskENTER_CRITICAL();
+    *stats = xStats;
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * Function to clear the hit and miss counters
+ */
+void FlashCache_ResetStats(void)
+{
+    taskENTER_CRITICAL();
+    memset(&xStats, 0, sizeof(xStats));
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,92 @@
+#pragma once
+/*
+================================================================================================#=
+FILE:
+flash-commit-api.h
+
+DESCRIPTION:
+    The FlashCommit module stores one multi-sector object, such as a configuration image or
+    a calibration table, in the COMMIT region of the MX25 flash, and replaces it atomically.
+    A new version is written to the spare bank, then a small commit record is programmed
+    that points at it. After a power loss at any point the object reads back as either the
+    complete old version or the complete new one.
+    This file defines the API to access those services.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+// FLASH information other modules may need to access:
+#include "flash-services-api.h"
+#include "flash-layout.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FLASH_COMMIT_MAX_LENGTH BLOCK_OFFSET // One bank
+#define FLASH_COMMIT_NO_POWER_LOSS 0xFFFFFFFF
+
+// Commit statistics
+typedef struct
+{
+    uint32_t Sequence; // Of the committed version, 0 before the first commit
+    uint32_t Length;
+    uint32_t Commits;
+    uint32_t Aborts;
+    uint32_t RecordSectorSwitches; // Commit record sector erased to continue in it
+    uint32_t TornRecords;          // Found at mount and skipped
+    uint32_t MountUs;
+} FlashCommitStats_t;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Find the latest complete commit. Call once the flash is initialized. Only the commit
+// records are read, so this takes a few small reads whatever the size of the object.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashCommit_Mount(void);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Write a new version: Begin erases room for length bytes in the spare bank, Append
+// adds data in order, End checks the spare bank against the appended data and commits
+// it with one page program. Only one update can be open at a time. Until End succeeds
+// readers keep seeing the previous version; Abort drops the update.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+flashReturnMsg_t FlashCommit_Begin(uint32_t length);
+flashReturnMsg_t FlashCommit_Append(const uint8_t *data, uint32_t length);
+flashReturnMsg_t FlashCommit_End(void);
+void FlashCommit_Abort(void);
+
+// Read from the committed version. Reads past its length fail.
+flashReturnMsg_t FlashCommit_Read(uint32_t offset, uint8_t *data, uint32_t length);
+
+// Length of the committed version, 0 before the first commit
+uint32_t FlashCommit_GetLength(void);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Scrub: check the committed version against the data CRC in its commit record. The
+// object counts as one record. A failure cannot be repaired here; the next commit
+// replaces it. Returns false if the store is not available.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashCommit_Scrub(FlashServScrubReport_t *report);
+
+// Get commit statistics
+void FlashCommit_GetStats(FlashCommitStats_t *stats);
+
+#ifdef FLASH_SELF_TEST
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Test support, in FLASH_SELF_TEST builds only: mount the store on another region of
+// FLASH_LAYOUT_COMMIT_SIZE bytes, 64KB aligned, so it can be tested without touching the
+// committed object. FlashCommit_Mount mounts the last region given here.
+// Pass FLASH_LAYOUT_COMMIT_START to go back to the COMMIT region.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashCommit_MountAt(uint32_t start);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Test support, in FLASH_SELF_TEST builds only: simulate a power loss on the given flash
+// write of this module from now on, counting from 0. That program is torn halfway, or that
+// erase covers only its first sector, and every later write fails until FlashCommit_Mount
+// runs again as it would at boot. FLASH_COMMIT_NO_POWER_LOSS turns it off.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+void FlashCommit_InjectPowerLoss(uint32_t write);
+#endif
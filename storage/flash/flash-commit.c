@@ -0,0 +1,637 @@
+/*
+================================================================================================#=
+FILE:
+flash-commit.c
+
+DESCRIPTION:
+    The FlashCommit module replaces a multi-sector object in the COMMIT region atomically.
+    This file implements those services.
+
+Adaptations Notes:  The region holds two commit record sectors at the start of its first block,
+                    then bank 0 and bank 1 in the next two blocks. A commit record is
+                        Magic (4) | Sequence (4) | Bank (4) | Length (4) | Data CRC-32 (4) | CRC-32 (4)
+                    in a 32 byte slot, so it never crosses a page and is programmed in one page
+                    program. The record with the highest sequence and a good CRC is the committed
+                    version; a torn record fails its CRC and the previous one still stands.
+
+                    Records are appended to one record sector until it is full, then the other
+                    sector is erased and appending continues there. The full sector keeps the
+                    latest record until the first record lands in the new one, so there is
+                    always a good record on flash. That erase comes once every
+                    COMMIT_RECORDS_PER_SECTOR commits; every other commit costs one page program
+                    on top of the data.
+
+                    Records fill a sector from the start, so mount binary searches each sector for
+                    the first unused slot and only checks the record or two before it: a torn
+                    program can only be the last one. Mount reads about 20 slots in all.
+
+                    End reads the spare bank back and compares its CRC with the CRC of the
+                    appended data before the record is written, so a program failure never
+                    gets committed.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+#include "flash-commit-api.h"
+
+#include "crc/crc.h"
+#include "timing/timing.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define COMMIT_MAGIC 0x434D5431 // "CMT1"
+#define COMMIT_ERASED_BYTE 0xFF
+#define COMMIT_NO_BANK 0xFFFFFFFF
+#define COMMIT_MUTEX_TIMEOUT_MS 5000
+
+#define COMMIT_RECORD_SECTORS 2
+#define COMMIT_RECORD_SLOT 32
+#define COMMIT_RECORDS_PER_SECTOR (SECTOR_OFFSET / COMMIT_RECORD_SLOT)
+#define COMMIT_BANK_START(bank) (COMMIT_REGION_START + BLOCK_OFFSET + ((bank) * BLOCK_OFFSET))
+
+// Self-test builds can mount the store on another region, see FlashCommit_MountAt
+#ifdef FLASH_SELF_TEST
+#define COMMIT_REGION_START xRegionStart
+#else
+#define COMMIT_REGION_START FLASH_LAYOUT_COMMIT_START
+#endif
+
+#if FLASH_LAYOUT_COMMIT_SIZE < (3 * BLOCK_OFFSET)
+#error "Commit region too small for the record block and two banks"
+#endif
+
+#if (PAGE_OFFSET % COMMIT_RECORD_SLOT) != 0
+#error "Commit record slots must not cross a page"
+#endif
+
+typedef struct
+{
+    uint32_t Magic;
+    uint32_t Sequence;
+    uint32_t Bank;
+    uint32_t Length;
+    uint32_t DataCrc;
+    uint32_t RecordCrc; // Over the fields above
+} commitRecord_t;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Internal Private Data
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Committed version, Bank is COMMIT_NO_BANK before the first commit
+static commitRecord_t xCommitted;
+
+// Where the next record goes
+static uint32_t xRecordSector = 0;
+static uint32_t xRecordSlot = 0;
+
+// Update in progress
+static bool xUpdateOpen = false;
+static uint32_t xShadowBank = 0;
+static uint32_t xShadowLength = 0; // Erased room from Begin
+static uint32_t xShadowOffset = 0;
+static uint32_t xShadowCrc = CRC_INITIAL_VALUE;
+
+#ifdef FLASH_SELF_TEST
+// Region mounted, see FlashCommit_MountAt
+static uint32_t xRegionStart = FLASH_LAYOUT_COMMIT_START;
+
+// Simulated power loss, see FlashCommit_InjectPowerLoss
+static uint32_t xPowerLossCountdown = FLASH_COMMIT_NO_POWER_LOSS;
+static bool xPowerLost = false;
+#endif
+
+static FlashCommitStats_t xStats = {0};
+
+static SemaphoreHandle_t xCommitMutex = NULL;
+static StaticSemaphore_t xCommitMutexControlBlock;
+static bool xMounted = false;
+
+/*** Private Functions ***/
+
+// Helper function to get the flash address of a record slot
+static uint32_t commitSlotAddress(uint32_t sector, uint32_t slot)
+{
+    return COMMIT_REGION_START + (sector * SECTOR_OFFSET) + (slot * COMMIT_RECORD_SLOT);
+}
+
+// Helper function to get the CRC of a record
+static uint32_t commitRecordCrc(const commitRecord_t *record)
+{
+    return CRC_Compute((const uint8_t *)record, offsetof(commitRecord_t, RecordCrc));
+}
+
+// Helper function to take exclusive access to the store
+static bool commitLock(void)
+{
+    if (!xMounted)
+    {
+        return false;
+    }
+
+    if (xSemaphoreTake(xCommitMutex, pdMS_TO_TICKS(COMMIT_MUTEX_TIMEOUT_MS)))
+    {
+        return true;
+    }
+
+    return false;
+}
+
+// Helper function to release exclusive access to the store
+static void commitUnlock(void)
+{
+    xSemaphoreGive(xCommitMutex);
+}
+
+#ifdef FLASH_SELF_TEST
+// Helper function to count down to a simulated power loss, true when this write is hit
+static bool commitPowerLossNow(void)
+{
+    if (xPowerLossCountdown == FLASH_COMMIT_NO_POWER_LOSS)
+    {
+        return false;
+    }
+
+    if (xPowerLossCountdown-- == 0)
+    {
+        xPowerLossCountdown = FLASH_COMMIT_NO_POWER_LOSS;
+        xPowerLost = true;
+        return true;
+    }
+
+    return false;
+}
+#endif
+
+// Helper function to program through services, or tear the program on a simulated power loss
+static flashReturnMsg_t commitProgram(uint32_t address, const uint8_t *data, uint32_t length)
+{
+#ifdef FLASH_SELF_TEST
+    if (xPowerLost)
+    {
+        return FLASH_OPERATION_FAILED;
+    }
+
+    if (commitPowerLossNow())
+    {
+        FlashServ_Write(address, data, length / 2);
+        return FLASH_OPERATION_FAILED;
+    }
+#endif
+
+    return FlashServ_Write(address, data, length);
+}
+
+// Helper function to erase through services, or erase only the first sector on a simulated power loss
+static flashReturnMsg_t commitErase(uint32_t startAddress, uint32_t endAddress)
+{
+#ifdef FLASH_SELF_TEST
+    if (xPowerLost)
+    {
+        return FLASH_OPERATION_FAILED;
+    }
+
+    if (commitPowerLossNow())
+    {
+        if ((endAddress - startAddress) > SECTOR_OFFSET)
+        {
+            FlashServ_EraseRange(startAddress, startAddress + SECTOR_OFFSET, NULL);
+        }
+        return FLASH_OPERATION_FAILED;
+    }
+#endif
+
+    return FlashServ_EraseRange(startAddress, endAddress, NULL);
+}
+
+/*
+ * Read a record slot. Returns false if it could not be read; *used tells whether anything
+ * was ever programmed in it and *valid whether it holds a complete record.
+ */
+static bool commitReadSlot(uint32_t sector, uint32_t slot, commitRecord_t *record, bool *used, bool *valid)
+{
+    uint8_t raw[COMMIT_RECORD_SLOT];
+    uint32_t i = 0;
+
+    if (FlashServ_Read(commitSlotAddress(sector, slot), raw, sizeof(raw)) != FLASH_OPERATION_SUCCESS)
+    {
+        return false;
+    }
+
+    // A torn program may have set any of the bytes, so check them all
+    *used = false;
+    for (i = 0; i < sizeof(raw); i++)
+    {
+        if (raw[i] != COMMIT_ERASED_BYTE)
+        {
+            *used = true;
+            break;
+        }
+    }
+
+    memcpy(record, raw, sizeof(*record));
+    *valid = *used && (record->Magic == COMMIT_MAGIC) && (record->Bank < 2) &&
+             (record->Length <= FLASH_COMMIT_MAX_LENGTH) && (record->RecordCrc == commitRecordCrc(record));
+
+    return true;
+}
+
+/*
+ * Find the end of the records in a sector and its latest good record.
+ * Returns false on a read failure; *found is false if the sector has no good record.
+ */
+static bool commitScanSector(uint32_t sector, commitRecord_t *latest, bool *found, uint32_t *nextSlot)
+{
+    commitRecord_t record;
+    uint32_t low = 0;
+    uint32_t high = COMMIT_RECORDS_PER_SECTOR;
+    uint32_t middle = 0;
+    uint32_t slot = 0;
+    bool used = false;
+    bool valid = false;
+
+    *found = false;
+
+    // First unused slot
+    while (low < high)
+    {
+        middle = (low + high) / 2;
+        if (!commitReadSlot(sector, middle, &record, &used, &valid))
+        {
+            return false;
+        }
+
+        if (used)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    *nextSlot = low;
+
+    // Only the last record can be torn, the one before it completed before it was started
+    for (slot = low; (slot > 0) && (slot + 2 > low); slot--)
+    {
+        if (!commitReadSlot(sector, slot - 1, &record, &used, &valid))
+        {
+            return false;
+        }
+
+        if (valid)
+        {
+            *latest = record;
+            *found = true;
+            break;
+        }
+
+        xStats.TornRecords++;
+    }
+
+    return true;
+}
+
+/*
+ * Program the commit record of the spare bank, moving to the other record sector when full
+ */
+static flashReturnMsg_t commitWriteRecord(const commitRecord_t *record)
+{
+    uint32_t address = 0;
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if (xRecordSlot >= COMMIT_RECORDS_PER_SECTOR)
+    {
+        // The full sector keeps the latest record until the new one is written
+        xRecordSector = (xRecordSector + 1) % COMMIT_RECORD_SECTORS;
+        address = commitSlotAddress(xRecordSector, 0);
+
+        msg = commitErase(address, address + SECTOR_OFFSET);
+        if (msg != FLASH_OPERATION_SUCCESS)
+        {
+            // Try the erase again next time
+            xRecordSector = (xRecordSector + 1) % COMMIT_RECORD_SECTORS;
+            return msg;
+        }
+
+        xRecordSlot = 0;
+        xStats.RecordSectorSwitches++;
+    }
+
+    // A failed program leaves the slot used, so never write it again
+    address = commitSlotAddress(xRecordSector, xRecordSlot++);
+
+    return commitProgram(address, (const uint8_t *)record, sizeof(*record));
+}
+
+/*** Public Functions ***/
+
+/*
+ * Function to find the latest complete commit
+ */
+bool FlashCommit_Mount(void)
+{
+    commitRecord_t latest[COMMIT_RECORD_SECTORS];
+    bool found[COMMIT_RECORD_SECTORS] = {false};
+    uint32_t nextSlot[COMMIT_RECORD_SECTORS] = {0};
+    uint32_t startCycles = TIMING_GetCycles();
+    uint32_t sector = 0;
+
+    if (xCommitMutex == NULL)
+    {
+        xCommitMutex = xSemaphoreCreateMutexStatic(&xCommitMutexControlBlock);
+    }
+
+    xMounted = false;
+    xUpdateOpen = false;
+#ifdef FLASH_SELF_TEST
+    xPowerLost = false;
+#endif
+    memset(&xCommitted, 0, sizeof(xCommitted));
+    xCommitted.Bank = COMMIT_NO_BANK;
+
+    for (sector = 0; sector < COMMIT_RECORD_SECTORS; sector++)
+    {
+        if (!commitScanSector(sector, &latest[sector], &found[sector], &nextSlot[sector]))
+        {
+            return false;
+        }
+    }
+
+    // Continue in the sector holding the latest record, or the first one on a blank region
+    xRecordSector = 0;
+    for (sector = 0; sector < COMMIT_RECORD_SECTORS; sector++)
+    {
+        if (found[sector] && ((xCommitted.Bank == COMMIT_NO_BANK) || (latest[sector].Sequence > xCommitted.Sequence)))
+        {
+            xCommitted = latest[sector];
+            xRecordSector = sector;
+        }
+    }
+    xRecordSlot = nextSlot[xRecordSector];
+
+    xStats.Sequence = xCommitted.Sequence;
+    xStats.Length = xCommitted.Length;
+    xStats.MountUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+    xMounted = true;
+
+    return true;
+}
+
+/*
+ * Function to start writing a new version to the spare bank
+ */
+flashReturnMsg_t FlashCommit_Begin(uint32_t length)
+{
+    uint32_t bankAddress = 0;
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if ((length == 0) || (length > FLASH_COMMIT_MAX_LENGTH))
+    {
+        return FLASH_ADDRESS_INVALID;
+    }
+
+    if (!commitLock())
+    {
+        return FLASH_IS_BUSY;
+    }
+
+    if (xUpdateOpen)
+    {
+        commitUnlock();
+        return FLASH_IS_BUSY;
+    }
+
+    xShadowBank = (xCommitted.Bank == 0) ? 1 : 0;
+    xShadowLength = (length + SECTOR_OFFSET - 1) & ~(SECTOR_OFFSET - 1);
+    xShadowOffset = 0;
+    xShadowCrc = CRC_INITIAL_VALUE;
+
+    bankAddress = COMMIT_BANK_START(xShadowBank);
+    msg = commitErase(bankAddress, bankAddress + xShadowLength);
+    xUpdateOpen = (msg == FLASH_OPERATION_SUCCESS);
+
+    commitUnlock();
+
+    return msg;
+}
+
+/*
+ * Function to add data to the new version
+ */
+flashReturnMsg_t FlashCommit_Append(const uint8_t *data, uint32_t length)
+{
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if (!commitLock())
+    {
+        return FLASH_IS_BUSY;
+    }
+
+    if (!xUpdateOpen || ((xShadowOffset + length) > xShadowLength))
+    {
+        commitUnlock();
+        return FLASH_ADDRESS_INVALID;
+    }
+
+    msg = commitProgram(COMMIT_BANK_START(xShadowBank) + xShadowOffset, data, length);
+    xShadowCrc = CRC_Accumulate(xShadowCrc, data, length);
+    xShadowOffset += length;
+
+    commitUnlock();
+
+    return msg;
+}
+
+/*
+ * Function to check the new version on flash and commit it
+ */
+flashReturnMsg_t FlashCommit_End(void)
+{
+    commitRecord_t record;
+    uint32_t storedCrc = 0;
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if (!commitLock())
+    {
+        return FLASH_IS_BUSY;
+    }
+
+    if (!xUpdateOpen)
+    {
+        commitUnlock();
+        return FLASH_OPERATION_FAILED;
+    }
+
+#ifdef FLASH_SELF_TEST
+    if (xPowerLost)
+    {
+        commitUnlock();
+        return FLASH_OPERATION_FAILED;
+    }
+#endif
+
+    // Only commit what is actually on flash
+    msg = FlashServ_ComputeCrc(COMMIT_BANK_START(xShadowBank), xShadowOffset, &storedCrc);
+    if ((msg == FLASH_OPERATION_SUCCESS) && (storedCrc != xShadowCrc))
+    {
+        msg = FLASH_OPERATION_FAILED;
+    }
+
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        record.Magic = COMMIT_MAGIC;
+        record.Sequence = xCommitted.Sequence + 1;
+        record.Bank = xShadowBank;
+        record.Length = xShadowOffset;
+        record.DataCrc = xShadowCrc;
+        record.RecordCrc = commitRecordCrc(&record);
+
+        msg = commitWriteRecord(&record);
+    }
+
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        xCommitted = record;
+        xStats.Commits++;
+        xStats.Sequence = record.Sequence;
+        xStats.Length = record.Length;
+    }
+    else
+    {
+        xStats.Aborts++;
+    }
+
+    xUpdateOpen = false;
+    commitUnlock();
+
+    return msg;
+}
+
+/*
+ * Function to drop the update in progress
+ */
+void FlashCommit_Abort(void)
+{
+    if (!commitLock())
+    {
+        return;
+    }
+
+    if (xUpdateOpen)
+    {
+        xUpdateOpen = false;
+        xStats.Aborts++;
+    }
+
+    commitUnlock();
+}
+
+/*
+ * Function to read from the committed version
+ */
+flashReturnMsg_t FlashCommit_Read(uint32_t offset, uint8_t *data, uint32_t length)
+{
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if (!commitLock())
+    {
+        return FLASH_IS_BUSY;
+    }
+
+    if ((xCommitted.Bank == COMMIT_NO_BANK) || (offset > xCommitted.Length) ||
+        (length > (xCommitted.Length - offset)))
+    {
+        msg = FLASH_ADDRESS_INVALID;
+    }
+    else
+    {
+        msg = FlashServ_Read(COMMIT_BANK_START(xCommitted.Bank) + offset, data, length);
+    }
+
+    commitUnlock();
+
+    return msg;
+}
+
+/*
+ * Function to get the length of the committed version
+ */
+uint32_t FlashCommit_GetLength(void)
+{
+    return (xCommitted.Bank == COMMIT_NO_BANK) ? 0 : xCommitted.Length;
+}
+
+/*
+ * Function to check the committed version
+ */
+bool FlashCommit_Scrub(FlashServScrubReport_t *report)
+{
+    uint32_t storedCrc = 0;
+
+    if ((report == NULL) || !commitLock())
+    {
+        return false;
+    }
+
+    memset(report, 0, sizeof(*report));
+    report->Address = COMMIT_REGION_START;
+
+    if (xCommitted.Bank != COMMIT_NO_BANK)
+    {
+        report->Address = COMMIT_BANK_START(xCommitted.Bank);
+        report->Checked = 1;
+        if ((FlashServ_ComputeCrc(report->Address, xCommitted.Length, &storedCrc) != FLASH_OPERATION_SUCCESS) ||
+            (storedCrc != xCommitted.DataCrc))
+        {
+            report->Failed = 1;
+        }
+    }
+
+    commitUnlock();
+
+    return true;
+}
+
+/*
+ * Function to get commit statistics
+ */
+void FlashCommit_GetStats(FlashCommitStats_t *stats)
+{
+    taskENTER_CRITICAL();
+    *stats = xStats;
+    taskEXIT_CRITICAL();
+}
+
+#ifdef FLASH_SELF_TEST
+/*
+ * Function to mount the store on another region
+ */
+bool FlashCommit_MountAt(uint32_t start)
+{
+    if (((start % BLOCK_OFFSET) != 0) || (start > (FLASH_SIZE - FLASH_LAYOUT_COMMIT_SIZE)))
+    {
+        return false;
+    }
+
+    xRegionStart = start;
+
+    return FlashCommit_Mount();
+}
+
+/*
+ * Function to simulate a power loss on a later flash write
+ */
+void FlashCommit_InjectPowerLoss(uint32_t write)
+{
+    xPowerLossCountdown = write;
+}
+#endif
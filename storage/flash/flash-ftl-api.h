@@ -0,0 +1,84 @@
+#pragma once
+/*
+================================================================================================#=
+FILE:
+flash-ftl-api.h
+
+DESCRIPTION:
+    The FlashFtl module is a wear-leveling flash translation layer over the FTL region
+    of the MX25 flash. Clients read and write fixed size logical pages; every write is
+    appended to a fresh physical page so no client update costs a sector erase.
+    This file defines the API to access those services.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+// FLASH information other modules may need to access:
+#include "flash-services-api.h"
+#include "flash-layout.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Each 4KB sector holds a header page and 15 data pages
+#define FTL_PAGE_SIZE PAGE_OFFSET
+#define FTL_PAGES_PER_SECTOR ((SECTOR_OFFSET / PAGE_OFFSET) - 1)
+#define FTL_SECTOR_COUNT (FLASH_LAYOUT_FTL_SIZE / SECTOR_OFFSET)
+
+// Sectors held back from the logical capacity for garbage collection and wear leveling
+#define FTL_SPARE_SECTORS 16
+#define FTL_LOGICAL_PAGES ((FTL_SECTOR_COUNT - FTL_SPARE_SECTORS) * FTL_PAGES_PER_SECTOR)
+
+// Wear and garbage collection statistics
+typedef struct
+{
+    uint32_t HostPageWrites;  // Pages written by clients
+    uint32_t FlashPageWrites; // Pages programmed, including garbage collection copies
+    uint32_t GcPageCopies;
+    uint32_t SectorErases;
+    uint32_t StaticWearMoves; // Cold sectors reclaimed to even out wear
+    uint32_t MinEraseCount;
+    uint32_t MaxEraseCount;
+    uint32_t FreeSectors;
+} FlashFtlStats_t;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Rebuild the mapping table from the sector headers. Sectors that were never
+// formatted or were left half erased are erased. Call once the flash is initialized.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashFtl_Mount(void);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Erase the whole FTL region and start with every logical page unmapped.
+// Erase counts are carried over from the mounted region.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashFtl_Format(void);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Read or write one FTL_PAGE_SIZE logical page. Unwritten pages read as 0xFF.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+flashReturnMsg_t FlashFtl_Read(uint32_t logicalPage, uint8_t *data);
+flashReturnMsg_t FlashFtl_Write(uint32_t logicalPage, const uint8_t *data);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Background garbage collection, copying at most copyBudget pages forward.
+// Returns the number of pages copied.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+uint32_t FlashFtl_Collect(uint32_t copyBudget);
+
+// Get wear and garbage collection statistics
+void FlashFtl_GetStats(FlashFtlStats_t *stats);
+
+#ifdef FLASH_SELF_TEST
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Test support, in FLASH_SELF_TEST builds only: mount the FTL on another region of up to
+// FLASH_LAYOUT_FTL_SIZE bytes, sector aligned, so it can be tested without touching the
+// FTL region. The region holds (size / SECTOR_OFFSET - FTL_SPARE_SECTORS) *
+// FTL_PAGES_PER_SECTOR logical pages. FlashFtl_Mount mounts the last region given here.
+// Pass FLASH_LAYOUT_FTL_START and FLASH_LAYOUT_FTL_SIZE to go back to the FTL region.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashFtl_MountAt(uint32_t start, uint32_t size);
+#endif
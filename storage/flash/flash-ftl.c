@@ -0,0 +1,836 @@
+/*
+================================================================================================#=
+FILE:
+flash-ftl.c
+
+DESCRIPTION:
+    The FlashFtl module is a wear-leveling flash translation layer over the FTL region
+    of the MX25 flash. This file implements those services.
+
+Adaptations Notes:  Mapping is kept per 256 byte page so a small update is a single page
+                    program appended to the open sector, never a read-modify-erase-write.
+
+                    Sector layout: page 0 is a header holding a magic number, the sequence
+                    number the sector was opened with, its erase count and one slot per data
+                    page. A slot is claimed with the logical page number before the data page is
+                    programmed and committed after, so a write torn by power loss is ignored.
+                    Slots are programmed into the erased header one at a time, which NOR allows.
+
+                    At mount the headers alone rebuild the mapping: for a logical page written
+                    more than once the highest (sector sequence, slot) wins.
+
+                    RAM use is one uint16 per logical page plus a few bytes per sector
+                    (about 4KB for the 512KB region).
+
+                    Wear leveling:
+                        Dynamic - a new sector is always the free sector with the lowest erase count.
+                        Static  - when the erase count spread grows past a threshold, the least worn
+                                  sector still holding data is collected, so cold data moves off it
+                                  and the sector goes back into rotation.
+
+                    Garbage collection picks the full sector with the fewest valid pages, copies
+                    those forward into a sector of their own (kept apart from client writes so
+                    cold data settles together) and erases it. Background collection runs a few pages per client
+                    write once free sectors run low; it is only forced to completion when the last
+                    spare sector is needed.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+#include "flash-ftl-api.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define FTL_MAGIC 0x46544C31 // "FTL1"
+#define FTL_ERASED_WORD 0xFFFFFFFF
+#define FTL_SLOT_FREE 0xFFFF
+#define FTL_SLOT_COMMITTED 0x0000
+#define FTL_UNMAPPED 0xFFFF
+#define FTL_NO_SECTOR 0xFFFF
+
+#define FTL_GC_START_FREE_SECTORS 4  // Background collection starts below this
+#define FTL_GC_RESERVE_SECTORS 1     // Held back for collection copies
+#define FTL_GC_COPY_BUDGET 2         // Pages copied per client write while collecting
+#define FTL_STATIC_WEAR_THRESHOLD 32 // Erase count spread that triggers a cold sector move
+#define FTL_STATIC_WEAR_INTERVAL 64  // Min erases between cold sector moves
+
+#define FTL_MUTEX_TIMEOUT_MS 5000
+
+// Self-test builds can mount the FTL on a smaller region, see FlashFtl_MountAt
+#ifdef FLASH_SELF_TEST
+#define FTL_REGION_START xRegionStart
+#define FTL_REGION_SECTORS xRegionSectors
+#else
+#define FTL_REGION_START FLASH_LAYOUT_FTL_START
+#define FTL_REGION_SECTORS FTL_SECTOR_COUNT
+#endif
+#define FTL_REGION_PAGES ((FTL_REGION_SECTORS - FTL_SPARE_SECTORS) * FTL_PAGES_PER_SECTOR)
+
+// One slot per data page in the sector header
+typedef struct
+{
+    uint16_t LogicalPage;
+    uint16_t Commit;
+} ftlSlot_t;
+
+typedef struct
+{
+    uint32_t Magic;
+    uint32_t Seq; // Erased while the sector is free
+    uint32_t EraseCount;
+    uint32_t Reserved;
+    ftlSlot_t Slots[FTL_PAGES_PER_SECTOR];
+} ftlSectorHeader_t;
+
+typedef enum
+{
+    FTL_SECTOR_FREE,
+    FTL_SECTOR_ACTIVE,
+    FTL_SECTOR_FULL,
+    FTL_SECTOR_DIRTY // Needs an erase before use
+} ftlSectorState_t;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Internal Private Data
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Logical page -> physical page (sector * FTL_PAGES_PER_SECTOR + slot)
+static uint16_t xL2P[FTL_LOGICAL_PAGES];
+
+static uint32_t xSectorSeq[FTL_SECTOR_COUNT];
+static uint32_t xEraseCount[FTL_SECTOR_COUNT];
+static uint8_t xValidCount[FTL_SECTOR_COUNT];
+static uint8_t xSectorState[FTL_SECTOR_COUNT];
+
+// Client writes and collection copies fill separate sectors so hot and cold data don't mix
+typedef enum
+{
+    FTL_STREAM_CLIENT,
+    FTL_STREAM_GC,
+    FTL_STREAM_COUNT
+} ftlStream_t;
+
+static uint16_t xActiveSector[FTL_STREAM_COUNT];
+static uint16_t xActiveSlot[FTL_STREAM_COUNT];
+static uint32_t xNextSeq = 1;
+static uint32_t xFreeSectors = 0;
+
+// Collection in progress, resumed by the next call
+static uint16_t xGcVictim = FTL_NO_SECTOR;
+static uint16_t xGcSlot = 0;
+static ftlSectorHeader_t xGcHeader;
+static uint32_t xErasesSinceStaticMove = 0;
+
+static uint8_t xPageBuffer[FTL_PAGE_SIZE];
+static FlashFtlStats_t xStats = {0};
+
+static SemaphoreHandle_t xFtlMutex = NULL;
+static StaticSemaphore_t xFtlMutexControlBlock;
+static bool xMounted = false;
+
+#ifdef FLASH_SELF_TEST
+// Region mounted, see FlashFtl_MountAt
+static uint32_t xRegionStart = FLASH_LAYOUT_FTL_START;
+static uint32_t xRegionSectors = FTL_SECTOR_COUNT;
+#endif
+
+/*** Private Functions ***/
+
+// Helper function to get the flash address of a sector
+static uint32_t ftlSectorAddress(uint16_t sector)
+{
+    return FTL_REGION_START + ((uint32_t)sector * SECTOR_OFFSET);
+}
+
+// Helper function to get the flash address of a physical data page
+static uint32_t ftlPageAddress(uint16_t physicalPage)
+{
+    uint16_t sector = physicalPage / FTL_PAGES_PER_SECTOR;
+    uint16_t slot = physicalPage % FTL_PAGES_PER_SECTOR;
+
+    // Page 0 of the sector is the header
+    return ftlSectorAddress(sector) + ((uint32_t)(slot + 1) * PAGE_OFFSET);
+}
+
+// Helper function to get the flash address of a header slot
+static uint32_t ftlSlotAddress(uint16_t sector, uint16_t slot)
+{
+    return ftlSectorAddress(sector) + offsetof(ftlSectorHeader_t, Slots) + (slot * sizeof(ftlSlot_t));
+}
+
+/*
+ * Erase a sector and write a free header carrying its erase count
+ */
+static flashReturnMsg_t ftlEraseSector(uint16_t sector)
+{
+    ftlSectorHeader_t header;
+    uint32_t address = ftlSectorAddress(sector);
+    flashReturnMsg_t msg = FLASH_OPERATION_FAILED;
+
+    msg = FlashServ_EraseRange(address, address + SECTOR_OFFSET, NULL);
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        xSectorState[sector] = FTL_SECTOR_DIRTY;
+        return msg;
+    }
+
+    xEraseCount[sector]++;
+    xStats.SectorErases++;
+    xErasesSinceStaticMove++;
+
+    memset(&header, 0xFF, sizeof(header));
+    header.Magic = FTL_MAGIC;
+    header.EraseCount = xEraseCount[sector];
+
+    msg = FlashServ_Write(address, (const uint8_t *)&header, offsetof(ftlSectorHeader_t, Slots));
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        xSectorState[sector] = FTL_SECTOR_DIRTY;
+        return msg;
+    }
+
+    xSectorSeq[sector] = FTL_ERASED_WORD;
+    xValidCount[sector] = 0;
+    xSectorState[sector] = FTL_SECTOR_FREE;
+    xFreeSectors++;
+
+    return FLASH_OPERATION_SUCCESS;
+}
+
+/*
+ * Open the least worn free sector for writing
+ */
+static flashReturnMsg_t ftlOpenSector(ftlStream_t stream)
+{
+    uint16_t sector = FTL_NO_SECTOR;
+    uint32_t seq = xNextSeq;
+    flashReturnMsg_t msg = FLASH_OPERATION_FAILED;
+    uint16_t i = 0;
+
+    for (i = 0; i < FTL_REGION_SECTORS; i++)
+    {
+        if ((xSectorState[i] == FTL_SECTOR_FREE) &&
+            ((sector == FTL_NO_SECTOR) || (xEraseCount[i] < xEraseCount[sector])))
+        {
+            sector = i;
+        }
+    }
+
+    if (sector == FTL_NO_SECTOR)
+    {
+        return FLASH_OPERATION_FAILED;
+    }
+
+    msg = FlashServ_Write(ftlSectorAddress(sector) + offsetof(ftlSectorHeader_t, Seq),
+                          (const uint8_t *)&seq, sizeof(seq));
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        return msg;
+    }
+
+    xNextSeq++;
+    xFreeSectors--;
+    xSectorSeq[sector] = seq;
+    xSectorState[sector] = FTL_SECTOR_ACTIVE;
+    xActiveSector[stream] = sector;
+    xActiveSlot[stream] = 0;
+
+    return FLASH_OPERATION_SUCCESS;
+}
+
+/*
+ * Append a logical page to the open sector and remap it
+ */
+static flashReturnMsg_t ftlProgram(ftlStream_t stream, uint16_t logicalPage, const uint8_t *data)
+{
+    uint16_t sector = xActiveSector[stream];
+    uint16_t slot = xActiveSlot[stream];
+    uint16_t physicalPage = (sector * FTL_PAGES_PER_SECTOR) + slot;
+    uint16_t commit = FTL_SLOT_COMMITTED;
+    uint16_t oldPage = xL2P[logicalPage];
+    flashReturnMsg_t msg = FLASH_OPERATION_FAILED;
+
+    // The slot is used up whether or not the program completes
+    xActiveSlot[stream]++;
+    if (xActiveSlot[stream] >= FTL_PAGES_PER_SECTOR)
+    {
+        xSectorState[sector] = FTL_SECTOR_FULL;
+        xActiveSector[stream] = FTL_NO_SECTOR;
+    }
+
+    // Claim, program, commit
+    msg = FlashServ_Write(ftlSlotAddress(sector, slot) + offsetof(ftlSlot_t, LogicalPage),
+                          (const uint8_t *)&logicalPage, sizeof(logicalPage));
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        msg = FlashServ_Write(ftlPageAddress(physicalPage), data, FTL_PAGE_SIZE);
+    }
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        msg = FlashServ_Write(ftlSlotAddress(sector, slot) + offsetof(ftlSlot_t, Commit),
+                              (const uint8_t *)&commit, sizeof(commit));
+    }
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        return msg;
+    }
+
+    if (oldPage != FTL_UNMAPPED)
+    {
+        xValidCount[oldPage / FTL_PAGES_PER_SECTOR]--;
+    }
+    xL2P[logicalPage] = physicalPage;
+    xValidCount[sector]++;
+    xStats.FlashPageWrites++;
+
+    return FLASH_OPERATION_SUCCESS;
+}
+
+/*
+ * Choose the next sector to collect.
+ * A forced collection only takes a sector that frees space.
+ */
+static uint16_t ftlPickVictim(bool forced)
+{
+    uint16_t victim = FTL_NO_SECTOR;
+    uint16_t coldest = FTL_NO_SECTOR;
+    uint32_t maxErase = 0;
+    uint16_t i = 0;
+
+    for (i = 0; i < FTL_REGION_SECTORS; i++)
+    {
+        if (xEraseCount[i] > maxErase)
+        {
+            maxErase = xEraseCount[i];
+        }
+
+        if (xSectorState[i] != FTL_SECTOR_FULL)
+        {
+            continue;
+        }
+
+        if ((coldest == FTL_NO_SECTOR) || (xEraseCount[i] < xEraseCount[coldest]))
+        {
+            coldest = i;
+        }
+
+        // Fewest valid pages, least worn on a tie
+        if ((victim == FTL_NO_SECTOR) || (xValidCount[i] < xValidCount[victim]) ||
+            ((xValidCount[i] == xValidCount[victim]) && (xEraseCount[i] < xEraseCount[victim])))
+        {
+            victim = i;
+        }
+    }
+
+    // Move cold data off the least worn sector
+    if (!forced && (coldest != FTL_NO_SECTOR) &&
+        ((maxErase - xEraseCount[coldest]) > FTL_STATIC_WEAR_THRESHOLD) &&
+        (xErasesSinceStaticMove >= FTL_STATIC_WEAR_INTERVAL))
+    {
+        xErasesSinceStaticMove = 0;
+        xStats.StaticWearMoves++;
+        return coldest;
+    }
+
+    if ((victim == FTL_NO_SECTOR) || (xValidCount[victim] >= FTL_PAGES_PER_SECTOR))
+    {
+        return FTL_NO_SECTOR;
+    }
+
+    if (!forced && (xFreeSectors >= FTL_GC_START_FREE_SECTORS))
+    {
+        return FTL_NO_SECTOR;
+    }
+
+    return victim;
+}
+
+static flashReturnMsg_t ftlEnsureActive(ftlStream_t stream);
+
+/*
+ * Copy valid pages forward out of the victim and erase it.
+ * Stops after copyBudget pages unless forced, resuming on the next call.
+ * Returns the number of pages copied.
+ */
+static uint32_t ftlCollect(uint32_t copyBudget, bool forced)
+{
+    ftlSlot_t slot;
+    uint16_t physicalPage = 0;
+    uint32_t copied = 0;
+
+    if (xGcVictim == FTL_NO_SECTOR)
+    {
+        xGcVictim = ftlPickVictim(forced);
+        if (xGcVictim == FTL_NO_SECTOR)
+        {
+            return 0;
+        }
+
+        if (FlashServ_Read(ftlSectorAddress(xGcVictim), (uint8_t *)&xGcHeader, sizeof(xGcHeader)) !=
+            FLASH_OPERATION_SUCCESS)
+        {
+            xGcVictim = FTL_NO_SECTOR;
+            return 0;
+        }
+        xGcSlot = 0;
+    }
+
+    while (xGcSlot < FTL_PAGES_PER_SECTOR)
+    {
+        slot = xGcHeader.Slots[xGcSlot];
+        physicalPage = (xGcVictim * FTL_PAGES_PER_SECTOR) + xGcSlot;
+
+        // Only pages still mapped here need to move
+        if ((slot.Commit == FTL_SLOT_COMMITTED) && (slot.LogicalPage < FTL_REGION_PAGES) &&
+            (xL2P[slot.LogicalPage] == physicalPage))
+        {
+            if (!forced && (copied >= copyBudget))
+            {
+                return copied;
+            }
+
+            // Background collection leaves the reserve to a forced one
+            if (!forced && (xActiveSector[FTL_STREAM_GC] == FTL_NO_SECTOR) &&
+                (xFreeSectors <= FTL_GC_RESERVE_SECTORS))
+            {
+                return copied;
+            }
+
+            if ((ftlEnsureActive(FTL_STREAM_GC) != FLASH_OPERATION_SUCCESS) ||
+                (FlashServ_Read(ftlPageAddress(physicalPage), xPageBuffer, FTL_PAGE_SIZE) !=
+                 FLASH_OPERATION_SUCCESS) ||
+                (ftlProgram(FTL_STREAM_GC, slot.LogicalPage, xPageBuffer) != FLASH_OPERATION_SUCCESS))
+            {
+                return copied;
+            }
+
+            copied++;
+            xStats.GcPageCopies++;
+        }
+
+        xGcSlot++;
+    }
+
+    if (ftlEraseSector(xGcVictim) == FLASH_OPERATION_SUCCESS)
+    {
+        xGcVictim = FTL_NO_SECTOR;
+    }
+
+    return copied;
+}
+
+/*
+ * Make sure the stream has an open sector with a free slot.
+ * Client writes first reclaim space so the reserve is left for collection copies.
+ */
+static flashReturnMsg_t ftlEnsureActive(ftlStream_t stream)
+{
+    uint32_t erases = 0;
+
+    if (xActiveSector[stream] != FTL_NO_SECTOR)
+    {
+        return FLASH_OPERATION_SUCCESS;
+    }
+
+    while ((stream == FTL_STREAM_CLIENT) && (xFreeSectors <= FTL_GC_RESERVE_SECTORS))
+    {
+        erases = xStats.SectorErases;
+        ftlCollect(0, true);
+
+        // Collection can't free a sector
+        if (xStats.SectorErases == erases)
+        {
+            return FLASH_OPERATION_FAILED;
+        }
+    }
+
+    return ftlOpenSector(stream);
+}
+
+// Helper function to take exclusive access to the FTL
+static bool ftlLock(void)
+{
+    if (!xMounted)
+    {
+        return false;
+    }
+
+    if (xSemaphoreTake(xFtlMutex, pdMS_TO_TICKS(FTL_MUTEX_TIMEOUT_MS)))
+    {
+        return true;
+    }
+
+    return false;
+}
+
+// Helper function to release exclusive access to the FTL
+static void ftlUnlock(void)
+{
+    xSemaphoreGive(xFtlMutex);
+}
+
+// Helper function to create the FTL mutex on first use
+static void ftlCreateMutex(void)
+{
+    if (xFtlMutex == NULL)
+    {
+        xFtlMutex = xSemaphoreCreateMutexStatic(&xFtlMutexControlBlock);
+    }
+}
+
+// Helper function to clear the RAM tables before a mount or format
+static void ftlResetTables(void)
+{
+    memset(xL2P, 0xFF, sizeof(xL2P));
+    memset(xValidCount, 0, sizeof(xValidCount));
+    memset(xSectorSeq, 0xFF, sizeof(xSectorSeq));
+
+    xActiveSector[FTL_STREAM_CLIENT] = FTL_NO_SECTOR;
+    xActiveSector[FTL_STREAM_GC] = FTL_NO_SECTOR;
+    xActiveSlot[FTL_STREAM_CLIENT] = 0;
+    xActiveSlot[FTL_STREAM_GC] = 0;
+    xNextSeq = 1;
+    xFreeSectors = 0;
+    xGcVictim = FTL_NO_SECTOR;
+    xErasesSinceStaticMove = 0;
+}
+
+/*** Public Functions ***/
+
+/*
+ * Function to rebuild the mapping table from the sector headers
+ */
+bool FlashFtl_Mount(void)
+{
+    ftlSectorHeader_t header;
+    uint16_t openSector[FTL_STREAM_COUNT] = {FTL_NO_SECTOR, FTL_NO_SECTOR};
+    uint16_t openSlots[FTL_STREAM_COUNT] = {0};
+    uint16_t physicalPage = 0;
+    uint16_t current = FTL_UNMAPPED;
+    uint16_t sector = 0;
+    uint16_t slot = 0;
+    uint32_t knownCount = 0;
+    uint64_t eraseTotal = 0;
+    uint32_t i = 0;
+
+    ftlCreateMutex();
+
+    xMounted = false;
+    ftlResetTables();
+
+    for (sector = 0; sector < FTL_REGION_SECTORS; sector++)
+    {
+        if (FlashServ_Read(ftlSectorAddress(sector), (uint8_t *)&header, sizeof(header)) != FLASH_OPERATION_SUCCESS)
+        {
+            return false;
+        }
+
+        // Never formatted, or power was lost between erase and header
+        if (header.Magic != FTL_MAGIC)
+        {
+            xEraseCount[sector] = 0;
+            xSectorState[sector] = FTL_SECTOR_DIRTY;
+            continue;
+        }
+
+        xEraseCount[sector] = header.EraseCount;
+        eraseTotal += header.EraseCount;
+        knownCount++;
+
+        if (header.Seq == FTL_ERASED_WORD)
+        {
+            xSectorState[sector] = FTL_SECTOR_FREE;
+            xFreeSectors++;
+            continue;
+        }
+
+        xSectorSeq[sector] = header.Seq;
+        if (header.Seq >= xNextSeq)
+        {
+            xNextSeq = header.Seq + 1;
+        }
+
+        for (slot = 0; slot < FTL_PAGES_PER_SECTOR; slot++)
+        {
+            if (header.Slots[slot].LogicalPage == FTL_SLOT_FREE)
+            {
+                break;
+            }
+
+            // Claimed but never committed: the write was torn
+            if ((header.Slots[slot].Commit != FTL_SLOT_COMMITTED) ||
+                (header.Slots[slot].LogicalPage >= FTL_REGION_PAGES))
+            {
+                continue;
+            }
+
+            // Keep the newest copy of each logical page
+            physicalPage = (sector * FTL_PAGES_PER_SECTOR) + slot;
+            current = xL2P[header.Slots[slot].LogicalPage];
+            if ((current == FTL_UNMAPPED) ||
+                (xSectorSeq[current / FTL_PAGES_PER_SECTOR] < header.Seq) ||
+                ((xSectorSeq[current / FTL_PAGES_PER_SECTOR] == header.Seq) && (current < physicalPage)))
+            {
+                xL2P[header.Slots[slot].LogicalPage] = physicalPage;
+            }
+        }
+
+        xSectorState[sector] = FTL_SECTOR_FULL;
+
+        // Only the newest sector of each stream can still be open for writing
+        if (slot < FTL_PAGES_PER_SECTOR)
+        {
+            if ((openSector[0] == FTL_NO_SECTOR) || (header.Seq > xSectorSeq[openSector[0]]))
+            {
+                openSector[1] = openSector[0];
+                openSlots[1] = openSlots[0];
+                openSector[0] = sector;
+                openSlots[0] = slot;
+            }
+            else if ((openSector[1] == FTL_NO_SECTOR) || (header.Seq > xSectorSeq[openSector[1]]))
+            {
+                openSector[1] = sector;
+                openSlots[1] = slot;
+            }
+        }
+    }
+
+    for (i = 0; i < FTL_REGION_PAGES; i++)
+    {
+        if (xL2P[i] != FTL_UNMAPPED)
+        {
+            xValidCount[xL2P[i] / FTL_PAGES_PER_SECTOR]++;
+        }
+    }
+
+    // Which stream a sector was opened for isn't recorded, the newest goes to clients
+    for (i = 0; i < FTL_STREAM_COUNT; i++)
+    {
+        if (openSector[i] != FTL_NO_SECTOR)
+        {
+            xSectorState[openSector[i]] = FTL_SECTOR_ACTIVE;
+            xActiveSector[i] = openSector[i];
+            xActiveSlot[i] = openSlots[i];
+        }
+    }
+
+    // Unknown sectors start at the average wear of the rest
+    for (sector = 0; sector < FTL_REGION_SECTORS; sector++)
+    {
+        if (xSectorState[sector] == FTL_SECTOR_DIRTY)
+        {
+            xEraseCount[sector] = (knownCount > 0) ? (uint32_t)(eraseTotal / knownCount) : 0;
+            if (ftlEraseSector(sector) != FLASH_OPERATION_SUCCESS)
+            {
+                return false;
+            }
+        }
+    }
+
+    xMounted = true;
+
+    return true;
+}
+
+/*
+ * Function to erase the FTL region and unmap every logical page
+ */
+bool FlashFtl_Format(void)
+{
+    ftlSectorHeader_t header;
+    uint16_t sector = 0;
+    bool wasMounted = xMounted;
+
+    ftlCreateMutex();
+
+    if (wasMounted && !ftlLock())
+    {
+        return false;
+    }
+
+    xMounted = false;
+    ftlResetTables();
+
+    // Block erases cover the region far faster than sector by sector
+    if (FlashServ_EraseRange(FTL_REGION_START, FTL_REGION_START + (FTL_REGION_SECTORS * SECTOR_OFFSET), NULL) !=
+        FLASH_OPERATION_SUCCESS)
+    {
+        if (wasMounted)
+        {
+            ftlUnlock();
+        }
+        return false;
+    }
+
+    memset(&header, 0xFF, sizeof(header));
+    header.Magic = FTL_MAGIC;
+
+    for (sector = 0; sector < FTL_REGION_SECTORS; sector++)
+    {
+        xEraseCount[sector]++;
+        header.EraseCount = xEraseCount[sector];
+        xSectorState[sector] = FTL_SECTOR_DIRTY;
+
+        if (FlashServ_Write(ftlSectorAddress(sector), (const uint8_t *)&header,
+                            offsetof(ftlSectorHeader_t, Slots)) == FLASH_OPERATION_SUCCESS)
+        {
+            xSectorState[sector] = FTL_SECTOR_FREE;
+            xFreeSectors++;
+        }
+    }
+
+    xStats.SectorErases += FTL_REGION_SECTORS;
+    xMounted = true;
+
+    if (wasMounted)
+    {
+        ftlUnlock();
+    }
+
+    return true;
+}
+
+/*
+ * Function to read one logical page
+ */
+flashReturnMsg_t FlashFtl_Read(uint32_t logicalPage, uint8_t *data)
+{
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if ((logicalPage >= FTL_REGION_PAGES) || (data == NULL))
+    {
+        return FLASH_ADDRESS_INVALID;
+    }
+
+    if (!ftlLock())
+    {
+        return FLASH_IS_BUSY;
+    }
+
+    if (xL2P[logicalPage] == FTL_UNMAPPED)
+    {
+        memset(data, 0xFF, FTL_PAGE_SIZE);
+    }
+    else
+    {
+        msg = FlashServ_Read(ftlPageAddress(xL2P[logicalPage]), data, FTL_PAGE_SIZE);
+    }
+
+    ftlUnlock();
+
+    return msg;
+}
+
+/*
+ * Function to write one logical page
+ */
+flashReturnMsg_t FlashFtl_Write(uint32_t logicalPage, const uint8_t *data)
+{
+    flashReturnMsg_t msg = FLASH_OPERATION_FAILED;
+
+    if ((logicalPage >= FTL_REGION_PAGES) || (data == NULL))
+    {
+        return FLASH_ADDRESS_INVALID;
+    }
+
+    if (!ftlLock())
+    {
+        return FLASH_IS_BUSY;
+    }
+
+    msg = ftlEnsureActive(FTL_STREAM_CLIENT);
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        msg = ftlProgram(FTL_STREAM_CLIENT, (uint16_t)logicalPage, data);
+    }
+
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        xStats.HostPageWrites++;
+
+        // Spread collection over client writes instead of stalling one of them
+        ftlCollect(FTL_GC_COPY_BUDGET, false);
+    }
+
+    ftlUnlock();
+
+    return msg;
+}
+
+/*
+ * Function to run background garbage collection
+ */
+uint32_t FlashFtl_Collect(uint32_t copyBudget)
+{
+    uint32_t copied = 0;
+
+    if (!ftlLock())
+    {
+        return 0;
+    }
+
+    copied = ftlCollect(copyBudget, false);
+
+    ftlUnlock();
+
+    return copied;
+}
+
+/*
+ * Function to get wear and garbage collection statistics
+ */
+void FlashFtl_GetStats(FlashFtlStats_t *stats)
+{
+    uint16_t sector = 0;
+
+    if (!ftlLock())
+    {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    *stats = xStats;
+    stats->FreeSectors = xFreeSectors;
+    stats->MinEraseCount = xEraseCount[0];
+    stats->MaxEraseCount = xEraseCount[0];
+
+    for (sector = 1; sector < FTL_REGION_SECTORS; sector++)
+    {
+        if (xEraseCount[sector] < stats->MinEraseCount)
+        {
+            stats->MinEraseCount = xEraseCount[sector];
+        }
+        if (xEraseCount[sector] > stats->MaxEraseCount)
+        {
+            stats->MaxEraseCount = xEraseCount[sector];
+        }
+    }
+
+    ftlUnlock();
+}
+
+#ifdef FLASH_SELF_TEST
+/*
+ * Function to mount the FTL on another region
+ */
+bool FlashFtl_MountAt(uint32_t start, uint32_t size)
+{
+    if (((start % SECTOR_OFFSET) != 0) || ((size % SECTOR_OFFSET) != 0) || (size > FLASH_LAYOUT_FTL_SIZE) ||
+        ((size / SECTOR_OFFSET) <= (FTL_SPARE_SECTORS + FTL_GC_START_FREE_SECTORS)) || (start > (FLASH_SIZE - size)))
+    {
+        return false;
+    }
+
+    xRegionStart = start;
+    xRegionSectors = size / SECTOR_OFFSET;
+
+    return FlashFtl_Mount();
+}
+#endif
@@ -0,0 +1,98 @@
+#pragma once
+/*
+================================================================================================#=
+FILE:
+flash-kv-api.h
+
+DESCRIPTION:
+    The FlashKv module is a persistent key-value store in the KV region of the MX25 flash,
+    for calibration, configuration and counters. Keys are 32 bit identifiers and values
+    are small blobs. Lookups go through a RAM index rebuilt at mount, so a get costs a
+    single flash read. A put replaces a value atomically: after a power loss the key holds
+    either the old or the new value.
+    This file defines the API to access those services.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+// FLASH information other modules may need to access:
+#include "flash-services-api.h"
+#include "flash-layout.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FLASH_KV_MAX_KEYS 2048 // 5 bytes of RAM index each
+#define FLASH_KV_MAX_VALUE_LENGTH 240
+#define FLASH_KV_INVALID_KEY 0xFFFFFFFF // Reads as erased flash
+
+// Store statistics
+typedef struct
+{
+    uint32_t Keys;
+    uint32_t LiveBytes; // Flash held by current values
+    uint32_t FreeSectors;
+    uint32_t ReadySectors; // Free and already erased
+    uint32_t BlankCheckFailures;
+    uint32_t Puts;
+    uint32_t PutsSkipped; // Value already stored
+    uint32_t Collections;
+    uint32_t RecordsCopied; // Moved forward by garbage collection
+    uint32_t RecordsLost;   // Unreadable when collected, dropped from the index
+    uint32_t SectorErases;
+    uint32_t MountUs;
+} FlashKvStats_t;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Rebuild the RAM index from flash. Call once the flash is initialized.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashKv_Mount(void);
+
+// Erase the whole KV region, deleting every key
+bool FlashKv_Format(void);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Get the value of a key. Values longer than maxLength are truncated; length is
+// the full size. Returns false if the key is not stored.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashKv_Get(uint32_t key, uint8_t *value, uint16_t maxLength, uint16_t *length);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Store 1 to FLASH_KV_MAX_VALUE_LENGTH bytes under a key, replacing any previous value.
+// Storing the value a key already holds writes nothing.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+flashReturnMsg_t FlashKv_Put(uint32_t key, const uint8_t *value, uint16_t length);
+
+// Remove a key. Removing a key that is not stored succeeds.
+flashReturnMsg_t FlashKv_Delete(uint32_t key);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Background preparation of free space: erases up to maxSectors sectors left dirty,
+// then collects the oldest sectors until readySectors can be opened without a collection.
+// Erased sectors are checked blank. Returns the number of sectors erased.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+uint32_t FlashKv_PreErase(uint32_t maxSectors, uint32_t readySectors);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Scrub: check the CRC of every live record in one sector, counting from 0 at the start
+// of the region. If any fails, the good ones are copied forward so the sector holds no
+// live data by the time collection reaches it. Returns false if the sector is out of
+// range or the store is not available.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashKv_Scrub(uint32_t sector, FlashServScrubReport_t *report);
+
+// Get store statistics
+void FlashKv_GetStats(FlashKvStats_t *stats);
+
+#ifdef FLASH_SELF_TEST
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Test support, in FLASH_SELF_TEST builds only: mount the store on another region of
+// FLASH_LAYOUT_KV_SIZE bytes, sector aligned, so it can be tested without touching the
+// KV region. FlashKv_Mount mounts the last region given here.
+// Pass FLASH_LAYOUT_KV_START to go back to the KV region.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashKv_MountAt(uint32_t start);
+#endif
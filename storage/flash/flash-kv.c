@@ -0,0 +1,1137 @@
+/*
+================================================================================================#=
+FILE:
+flash-kv.c
+
+DESCRIPTION:
+    The FlashKv module is a persistent key-value store in the KV region of the MX25 flash.
+    This file implements those services.
+
+Adaptations Notes:  The store is log structured. Every put or delete appends a record to the
+                    newest sector:
+                        Key (4) | Length (2) | ~Length (2) | Value, padded to 4 bytes | CRC-32 (4)
+                    A delete is a record with no value. A record is programmed in one write and
+                    only counts once its CRC checks, so a torn put leaves the previous value in
+                    place. Sectors are stamped with a sequence number when opened; at mount the
+                    records are replayed oldest sector first and the last record of a key wins.
+
+                    Garbage collection always reclaims the oldest sector, copying the records
+                    the index still points at to the newest sector before erasing it. Because
+                    sectors are reclaimed oldest first, a delete record can be dropped by then:
+                    any older record of that key was in the same or an already erased sector.
+                    One sector is kept free so collection always has somewhere to copy to.
+
+                    The RAM index is an open addressing table of 4 byte slots: a 16 bit hash tag
+                    and the record location in words. Tag matches are confirmed by reading the
+                    key from flash, which keeps 2k keys in 10KB of RAM. The limit is set by the
+                    RAM the index may take, not by the region, which holds far more records.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+#include "flash-kv-api.h"
+
+#include "crc/crc.h"
+#include "timing/timing.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define KV_MAGIC 0x4B565331 // "KVS1"
+#define KV_ERASED_WORD 0xFFFFFFFF
+#define KV_ERASED_HALFWORD 0xFFFF
+#define KV_NO_SECTOR 0xFFFF
+#define KV_RESERVE_SECTORS 1
+#define KV_MUTEX_TIMEOUT_MS 5000
+
+#define KV_SECTOR_COUNT (FLASH_LAYOUT_KV_SIZE / SECTOR_OFFSET)
+
+// Self-test builds can mount the store on another region, see FlashKv_MountAt
+#ifdef FLASH_SELF_TEST
+#define KV_REGION_START xRegionStart
+#else
+#define KV_REGION_START FLASH_LAYOUT_KV_START
+#endif
+
+// Index slots, sized for FLASH_KV_MAX_KEYS at no more than 5/6 load
+#define KV_INDEX_SLOTS 2560
+#define KV_TAG_EMPTY 0x0000
+#define KV_TAG_DELETED 0xFFFF
+#define KV_NO_SLOT 0xFFFFFFFF
+
+#define KV_HASH_MULTIPLIER 2654435761U // Knuth multiplicative hash
+
+// Round a value length up to whole words
+#define KV_ALIGN(x) (((x) + 3U) & ~3U)
+
+typedef struct
+{
+    uint32_t Magic;
+    uint32_t SectorSeq; // Erased while the sector is ready to be written
+    uint32_t Reserved[2];
+} kvSectorHeader_t;
+
+typedef struct
+{
+    uint32_t Key;
+    uint16_t Length;
+    uint16_t LengthCheck;
+} kvRecordHeader_t;
+
+typedef struct
+{
+    uint16_t Tag;
+    uint16_t Location; // Record offset in the region, in words
+} kvSlot_t;
+
+#define KV_DATA_START sizeof(kvSectorHeader_t)
+#define KV_RECORD_SIZE(length) (sizeof(kvRecordHeader_t) + KV_ALIGN(length) + sizeof(uint32_t))
+#define KV_MAX_RECORD_SIZE KV_RECORD_SIZE(FLASH_KV_MAX_VALUE_LENGTH)
+
+// Live data is kept low enough that collection always frees a sector
+#define KV_CAPACITY ((KV_SECTOR_COUNT - KV_RESERVE_SECTORS - 1) * (SECTOR_OFFSET - KV_DATA_START - KV_MAX_RECORD_SIZE))
+
+// Record scan window, holds at least one whole record past any offset it is loaded at
+#define KV_WINDOW_SIZE (2 * PAGE_OFFSET)
+
+#if (FLASH_LAYOUT_KV_SIZE / 4) > 0x10000
+#error "KV region too large for 16 bit index locations"
+#endif
+
+#if (FLASH_KV_MAX_KEYS * 6) > (KV_INDEX_SLOTS * 5)
+#error "KV index too small for FLASH_KV_MAX_KEYS"
+#endif
+
+#if (FLASH_KV_MAX_VALUE_LENGTH + 12) > PAGE_OFFSET
+#error "KV record larger than the scan window allows"
+#endif
+
+typedef enum
+{
+    KV_SECTOR_DIRTY, // Needs an erase before use
+    KV_SECTOR_FREE,
+    KV_SECTOR_USED
+} kvSectorState_t;
+
+typedef enum
+{
+    KV_RECORD_VALID,
+    KV_RECORD_ERASED, // End of the written part of the sector
+    KV_RECORD_BAD,    // Torn or corrupt, the rest of the sector is ignored
+    KV_RECORD_NO_READ // Flash read failed, nothing is known about the record
+} kvRecordStatus_t;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Internal Private Data
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+static kvSlot_t xIndex[KV_INDEX_SLOTS];
+static uint32_t xKeyCount = 0;
+static uint32_t xLiveBytes = 0;
+
+static uint8_t xSectorState[KV_SECTOR_COUNT];
+static uint32_t xSectorSeq[KV_SECTOR_COUNT];
+static uint32_t xFreeSectors = 0;
+
+static uint16_t xHeadSector = KV_NO_SECTOR;
+static uint32_t xWriteOffset = 0;
+static uint32_t xNextSectorSeq = 1;
+
+static uint8_t xRecordBuffer[KV_MAX_RECORD_SIZE];
+
+// Flash read window used by mount and garbage collection
+static uint8_t xWindow[KV_WINDOW_SIZE];
+static uint16_t xWindowSector = KV_NO_SECTOR;
+static uint32_t xWindowOffset = 0;
+static uint32_t xWindowLength = 0;
+
+static FlashKvStats_t xStats = {0};
+
+static SemaphoreHandle_t xKvMutex = NULL;
+static StaticSemaphore_t xKvMutexControlBlock;
+static bool xMounted = false;
+
+#ifdef FLASH_SELF_TEST
+// Region mounted, see FlashKv_MountAt
+static uint32_t xRegionStart = FLASH_LAYOUT_KV_START;
+#endif
+
+/*** Private Functions ***/
+
+// Helper function to get the flash address of a sector
+static uint32_t kvSectorAddress(uint16_t sector)
+{
+    return KV_REGION_START + ((uint32_t)sector * SECTOR_OFFSET);
+}
+
+// Helper function to get the index location of a record
+static uint16_t kvLocation(uint16_t sector, uint32_t offset)
+{
+    return (uint16_t)((((uint32_t)sector * SECTOR_OFFSET) + offset) / sizeof(uint32_t));
+}
+
+// Helper function to get the flash address of an index location
+static uint32_t kvLocationAddress(uint16_t location)
+{
+    return KV_REGION_START + ((uint32_t)location * sizeof(uint32_t));
+}
+
+// Helper function to hash a key
+static uint32_t kvHash(uint32_t key)
+{
+    return key * KV_HASH_MULTIPLIER;
+}
+
+// Helper function to get the index tag of a hash, never one of the reserved tags
+static uint16_t kvTag(uint32_t hash)
+{
+    uint16_t tag = (uint16_t)(hash >> 16);
+
+    if ((tag == KV_TAG_EMPTY) || (tag == KV_TAG_DELETED))
+    {
+        tag = 1;
+    }
+
+    return tag;
+}
+
+// Helper function to take exclusive access to the store
+static bool kvLock(void)
+{
+    if (!xMounted)
+    {
+        return false;
+    }
+
+    if (xSemaphoreTake(xKvMutex, pdMS_TO_TICKS(KV_MUTEX_TIMEOUT_MS)))
+    {
+        return true;
+    }
+
+    return false;
+}
+
+// Helper function to release exclusive access to the store
+static void kvUnlock(void)
+{
+    xSemaphoreGive(xKvMutex);
+}
+
+// Helper function to check whether an index slot points into a sector, and where
+static bool kvSlotInSector(uint32_t slot, uint16_t sector, uint32_t *offset)
+{
+    uint32_t regionOffset = (uint32_t)xIndex[slot].Location * sizeof(uint32_t);
+
+    if ((xIndex[slot].Tag == KV_TAG_EMPTY) || (xIndex[slot].Tag == KV_TAG_DELETED) ||
+        ((regionOffset / SECTOR_OFFSET) != sector))
+    {
+        return false;
+    }
+
+    *offset = regionOffset % SECTOR_OFFSET;
+    return true;
+}
+
+/*
+ * Look a key up in the index. Returns true with the slot holding the key and the length
+ * of its value, or false with the first slot a new key can take (KV_NO_SLOT if full).
+ */
+static bool kvFind(uint32_t key, uint32_t *slot, uint16_t *length)
+{
+    kvRecordHeader_t header;
+    uint32_t hash = kvHash(key);
+    uint16_t tag = kvTag(hash);
+    uint32_t index = hash % KV_INDEX_SLOTS;
+    uint32_t probes = 0;
+
+    *slot = KV_NO_SLOT;
+
+    for (probes = 0; probes < KV_INDEX_SLOTS; probes++)
+    {
+        if (xIndex[index].Tag == KV_TAG_EMPTY)
+        {
+            if (*slot == KV_NO_SLOT)
+            {
+                *slot = index;
+            }
+            return false;
+        }
+
+        if ((xIndex[index].Tag == KV_TAG_DELETED) && (*slot == KV_NO_SLOT))
+        {
+            *slot = index;
+        }
+        else if (xIndex[index].Tag == tag)
+        {
+            // Confirm the key on flash
+            if ((FlashServ_Read(kvLocationAddress(xIndex[index].Location), (uint8_t *)&header, sizeof(header)) ==
+                 FLASH_OPERATION_SUCCESS) &&
+                (header.Key == key))
+            {
+                *slot = index;
+                if (length != NULL)
+                {
+                    *length = header.Length;
+                }
+                return true;
+            }
+        }
+
+        index = (index + 1) % KV_INDEX_SLOTS;
+    }
+
+    return false;
+}
+
+// Helper function to point a key at a record, adding it to the index if new
+static void kvIndexSet(uint32_t key, uint32_t slot, bool found, uint16_t location)
+{
+    if (!found)
+    {
+        xIndex[slot].Tag = kvTag(kvHash(key));
+        xKeyCount++;
+    }
+
+    xIndex[slot].Location = location;
+}
+
+// Helper function to remove a key from the index
+static void kvIndexRemove(uint32_t slot)
+{
+    // The slot can go back to empty if no probe sequence runs through it
+    if (xIndex[(slot + 1) % KV_INDEX_SLOTS].Tag == KV_TAG_EMPTY)
+    {
+        xIndex[slot].Tag = KV_TAG_EMPTY;
+    }
+    else
+    {
+        xIndex[slot].Tag = KV_TAG_DELETED;
+    }
+
+    xKeyCount--;
+}
+
+/*
+ * Parse the record at an offset of a sector through the read window.
+ * On success the value is at xWindow[*valueIndex].
+ */
+static kvRecordStatus_t kvParseRecord(uint16_t sector, uint32_t offset, kvRecordHeader_t *header,
+                                      uint32_t *valueIndex)
+{
+    uint32_t recordSize = 0;
+    uint32_t storedCrc = 0;
+    uint32_t crc = 0;
+    uint32_t start = 0;
+
+    if ((offset + KV_RECORD_SIZE(0)) > SECTOR_OFFSET)
+    {
+        return KV_RECORD_ERASED;
+    }
+
+    // Reload unless the largest possible record at this offset is already in the window
+    if ((xWindowSector != sector) || (offset < xWindowOffset) ||
+        ((offset + KV_MAX_RECORD_SIZE) > (xWindowOffset + xWindowLength) &&
+         ((xWindowOffset + xWindowLength) < SECTOR_OFFSET)))
+    {
+        xWindowLength = SECTOR_OFFSET - offset;
+        if (xWindowLength > KV_WINDOW_SIZE)
+        {
+            xWindowLength = KV_WINDOW_SIZE;
+        }
+
+        xWindowSector = KV_NO_SECTOR;
+        if (FlashServ_Read(kvSectorAddress(sector) + offset, xWindow, xWindowLength) != FLASH_OPERATION_SUCCESS)
+        {
+            return KV_RECORD_NO_READ;
+        }
+        xWindowSector = sector;
+        xWindowOffset = offset;
+    }
+
+    start = offset - xWindowOffset;
+    memcpy(header, &xWindow[start], sizeof(*header));
+
+    if ((header->Key == KV_ERASED_WORD) && (header->Length == KV_ERASED_HALFWORD) &&
+        (header->LengthCheck == KV_ERASED_HALFWORD))
+    {
+        return KV_RECORD_ERASED;
+    }
+
+    recordSize = KV_RECORD_SIZE(header->Length);
+    if ((((uint32_t)header->Length + header->LengthCheck) != KV_ERASED_HALFWORD) ||
+        (header->Length > FLASH_KV_MAX_VALUE_LENGTH) || ((offset + recordSize) > SECTOR_OFFSET))
+    {
+        return KV_RECORD_BAD;
+    }
+
+    crc = CRC_Compute(&xWindow[start], sizeof(*header) + header->Length);
+    memcpy(&storedCrc, &xWindow[start + recordSize - sizeof(storedCrc)], sizeof(storedCrc));
+    if (crc != storedCrc)
+    {
+        return KV_RECORD_BAD;
+    }
+
+    *valueIndex = start + sizeof(*header);
+
+    return KV_RECORD_VALID;
+}
+
+/*
+ * Erase a sector and stamp it ready to be opened.
+ * With verify set the sector is read back blank before it is stamped.
+ */
+static flashReturnMsg_t kvEraseSector(uint16_t sector, bool verify)
+{
+    uint32_t address = kvSectorAddress(sector);
+    uint32_t magic = KV_MAGIC;
+    flashReturnMsg_t msg = FLASH_OPERATION_FAILED;
+
+    if (xSectorState[sector] == KV_SECTOR_USED)
+    {
+        xFreeSectors++;
+    }
+
+    xSectorState[sector] = KV_SECTOR_DIRTY;
+    xSectorSeq[sector] = KV_ERASED_WORD;
+    if (xWindowSector == sector)
+    {
+        xWindowSector = KV_NO_SECTOR;
+    }
+
+    msg = FlashServ_EraseRange(address, address + SECTOR_OFFSET, NULL);
+    if ((msg == FLASH_OPERATION_SUCCESS) && verify && !FlashServ_IsBlank(address, SECTOR_OFFSET))
+    {
+        xStats.BlankCheckFailures++;
+        msg = FLASH_OPERATION_FAILED;
+    }
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        msg = FlashServ_Write(address + offsetof(kvSectorHeader_t, Magic), (const uint8_t *)&magic, sizeof(magic));
+    }
+
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        xSectorState[sector] = KV_SECTOR_FREE;
+        xStats.SectorErases++;
+    }
+
+    return msg;
+}
+
+// Helper function to find the oldest sector holding records
+static uint16_t kvOldestSector(void)
+{
+    uint16_t oldest = KV_NO_SECTOR;
+    uint16_t i = 0;
+
+    for (i = 0; i < KV_SECTOR_COUNT; i++)
+    {
+        if ((xSectorState[i] == KV_SECTOR_USED) && ((oldest == KV_NO_SECTOR) || (xSectorSeq[i] < xSectorSeq[oldest])))
+        {
+            oldest = i;
+        }
+    }
+
+    return oldest;
+}
+
+/*
+ * Open the next sector after the newest one that holds no records
+ */
+static flashReturnMsg_t kvOpenNextSector(void)
+{
+    uint16_t sector = (xHeadSector == KV_NO_SECTOR) ? 0 : ((xHeadSector + 1) % KV_SECTOR_COUNT);
+    uint16_t i = 0;
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    for (i = 0; (i < KV_SECTOR_COUNT) && (xSectorState[sector] == KV_SECTOR_USED); i++)
+    {
+        sector = (sector + 1) % KV_SECTOR_COUNT;
+    }
+
+    if (xSectorState[sector] == KV_SECTOR_USED)
+    {
+        return FLASH_OPERATION_FAILED;
+    }
+
+    if (xSectorState[sector] != KV_SECTOR_FREE)
+    {
+        msg = kvEraseSector(sector, false);
+        if (msg != FLASH_OPERATION_SUCCESS)
+        {
+            return msg;
+        }
+    }
+
+    msg = FlashServ_Write(kvSectorAddress(sector) + offsetof(kvSectorHeader_t, SectorSeq),
+                          (const uint8_t *)&xNextSectorSeq, sizeof(xNextSectorSeq));
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        xSectorState[sector] = KV_SECTOR_DIRTY;
+        return msg;
+    }
+
+    xSectorState[sector] = KV_SECTOR_USED;
+    xSectorSeq[sector] = xNextSectorSeq++;
+    xFreeSectors--;
+
+    xHeadSector = sector;
+    xWriteOffset = KV_DATA_START;
+
+    return FLASH_OPERATION_SUCCESS;
+}
+
+/*
+ * Append a record to the newest sector and return its location
+ */
+static flashReturnMsg_t kvAppend(uint32_t key, const uint8_t *value, uint16_t length, uint16_t *location)
+{
+    kvRecordHeader_t header;
+    uint32_t recordSize = KV_RECORD_SIZE(length);
+    uint32_t crc = 0;
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if ((xHeadSector == KV_NO_SECTOR) || ((xWriteOffset + recordSize) > SECTOR_OFFSET))
+    {
+        msg = kvOpenNextSector();
+        if (msg != FLASH_OPERATION_SUCCESS)
+        {
+            return msg;
+        }
+    }
+
+    header.Key = key;
+    header.Length = length;
+    header.LengthCheck = KV_ERASED_HALFWORD - length;
+
+    memset(xRecordBuffer, 0xFF, recordSize);
+    memcpy(xRecordBuffer, &header, sizeof(header));
+    if (length > 0)
+    {
+        memcpy(&xRecordBuffer[sizeof(header)], value, length);
+    }
+
+    crc = CRC_Compute(xRecordBuffer, sizeof(header) + length);
+    memcpy(&xRecordBuffer[recordSize - sizeof(crc)], &crc, sizeof(crc));
+
+    if (xWindowSector == xHeadSector)
+    {
+        xWindowSector = KV_NO_SECTOR;
+    }
+
+    msg = FlashServ_Write(kvSectorAddress(xHeadSector) + xWriteOffset, xRecordBuffer, recordSize);
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        // Don't write over the failed bytes, continue in a new sector
+        xWriteOffset = SECTOR_OFFSET;
+        return msg;
+    }
+
+    *location = kvLocation(xHeadSector, xWriteOffset);
+    xWriteOffset += recordSize;
+
+    return FLASH_OPERATION_SUCCESS;
+}
+
+/*
+ * Reclaim the oldest sector, copying forward the records the index still points at.
+ * Records the index points at that no longer read back are dropped from the index.
+ */
+static flashReturnMsg_t kvCollect(bool verify)
+{
+    kvRecordHeader_t header;
+    kvRecordStatus_t status = KV_RECORD_VALID;
+    uint16_t victim = kvOldestSector();
+    uint32_t offset = KV_DATA_START;
+    uint32_t valueIndex = 0;
+    uint32_t slot = 0;
+    uint16_t location = 0;
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if (victim == KV_NO_SECTOR)
+    {
+        return FLASH_OPERATION_FAILED;
+    }
+
+    // Copies must not land in the sector being reclaimed
+    if (victim == xHeadSector)
+    {
+        xWriteOffset = SECTOR_OFFSET;
+    }
+
+    // Walk the records in flash order first, so the read window is reused
+    while (kvParseRecord(victim, offset, &header, &valueIndex) == KV_RECORD_VALID)
+    {
+        if ((header.Length > 0) && kvFind(header.Key, &slot, NULL) &&
+            (xIndex[slot].Location == kvLocation(victim, offset)))
+        {
+            msg = kvAppend(header.Key, &xWindow[valueIndex], header.Length, &location);
+            if (msg != FLASH_OPERATION_SUCCESS)
+            {
+                return msg;
+            }
+
+            xIndex[slot].Location = location;
+            xStats.RecordsCopied++;
+        }
+
+        offset += KV_RECORD_SIZE(header.Length);
+    }
+
+    // The walk stops at a torn or corrupt record, pick up any live record past it from the index
+    for (slot = 0; slot < KV_INDEX_SLOTS; slot++)
+    {
+        if (!kvSlotInSector(slot, victim, &offset))
+        {
+            continue;
+        }
+
+        status = kvParseRecord(victim, offset, &header, &valueIndex);
+        if (status == KV_RECORD_NO_READ)
+        {
+            return FLASH_OPERATION_FAILED;
+        }
+        if (status != KV_RECORD_VALID)
+        {
+            // Nothing left to copy. Its live bytes stay counted until the next mount.
+            kvIndexRemove(slot);
+            xStats.RecordsLost++;
+            continue;
+        }
+
+        msg = kvAppend(header.Key, &xWindow[valueIndex], header.Length, &location);
+        if (msg != FLASH_OPERATION_SUCCESS)
+        {
+            return msg;
+        }
+
+        xIndex[slot].Location = location;
+        xStats.RecordsCopied++;
+    }
+
+    // Never erase a record the index still points at
+    for (slot = 0; slot < KV_INDEX_SLOTS; slot++)
+    {
+        if (kvSlotInSector(slot, victim, &offset))
+        {
+            return FLASH_OPERATION_FAILED;
+        }
+    }
+
+    xStats.Collections++;
+
+    return kvEraseSector(victim, verify);
+}
+
+/*
+ * Collect until a sector can be opened for new records without using the reserve
+ */
+static flashReturnMsg_t kvMakeRoom(uint32_t recordSize)
+{
+    uint16_t attempts = 0;
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if ((xHeadSector != KV_NO_SECTOR) && ((xWriteOffset + recordSize) <= SECTOR_OFFSET))
+    {
+        return FLASH_OPERATION_SUCCESS;
+    }
+
+    while ((xFreeSectors <= KV_RESERVE_SECTORS) && (msg == FLASH_OPERATION_SUCCESS))
+    {
+        if (++attempts > KV_SECTOR_COUNT)
+        {
+            return FLASH_OPERATION_FAILED;
+        }
+        msg = kvCollect(false);
+    }
+
+    return msg;
+}
+
+/*
+ * Replay the records of a sector into the index. Returns the offset after the last good record.
+ */
+static uint32_t kvReplaySector(uint16_t sector, kvRecordStatus_t *status)
+{
+    kvRecordHeader_t header;
+    uint32_t offset = KV_DATA_START;
+    uint32_t valueIndex = 0;
+    uint32_t slot = 0;
+    uint16_t oldLength = 0;
+    bool found = false;
+
+    while ((*status = kvParseRecord(sector, offset, &header, &valueIndex)) == KV_RECORD_VALID)
+    {
+        found = kvFind(header.Key, &slot, &oldLength);
+        if (found)
+        {
+            xLiveBytes -= KV_RECORD_SIZE(oldLength);
+        }
+
+        if (header.Length == 0)
+        {
+            if (found)
+            {
+                kvIndexRemove(slot);
+            }
+        }
+        else if (slot != KV_NO_SLOT)
+        {
+            kvIndexSet(header.Key, slot, found, kvLocation(sector, offset));
+            xLiveBytes += KV_RECORD_SIZE(header.Length);
+        }
+
+        offset += KV_RECORD_SIZE(header.Length);
+    }
+
+    return offset;
+}
+
+// Helper function to create the store mutex on first use
+static void kvCreateMutex(void)
+{
+    if (xKvMutex == NULL)
+    {
+        xKvMutex = xSemaphoreCreateMutexStatic(&xKvMutexControlBlock);
+    }
+}
+
+// Helper function to clear the RAM state
+static void kvReset(void)
+{
+    memset(xIndex, 0, sizeof(xIndex));
+    xKeyCount = 0;
+    xLiveBytes = 0;
+    xFreeSectors = 0;
+    xHeadSector = KV_NO_SECTOR;
+    xWriteOffset = 0;
+    xNextSectorSeq = 1;
+    xWindowSector = KV_NO_SECTOR;
+}
+
+/*** Public Functions ***/
+
+/*
+ * Function to rebuild the index from flash
+ */
+bool FlashKv_Mount(void)
+{
+    kvSectorHeader_t header;
+    kvRecordStatus_t status = KV_RECORD_ERASED;
+    uint32_t startCycles = TIMING_GetCycles();
+    uint32_t lastSeq = 0;
+    uint16_t sector = 0;
+    uint16_t next = 0;
+    uint16_t i = 0;
+
+    kvCreateMutex();
+
+    xMounted = false;
+    kvReset();
+
+    for (sector = 0; sector < KV_SECTOR_COUNT; sector++)
+    {
+        if (FlashServ_Read(kvSectorAddress(sector), (uint8_t *)&header, sizeof(header)) != FLASH_OPERATION_SUCCESS)
+        {
+            return false;
+        }
+
+        xSectorSeq[sector] = KV_ERASED_WORD;
+
+        if (header.Magic != KV_MAGIC)
+        {
+            xSectorState[sector] = KV_SECTOR_DIRTY;
+            xFreeSectors++;
+        }
+        else if (header.SectorSeq == KV_ERASED_WORD)
+        {
+            xSectorState[sector] = KV_SECTOR_FREE;
+            xFreeSectors++;
+        }
+        else
+        {
+            xSectorState[sector] = KV_SECTOR_USED;
+            xSectorSeq[sector] = header.SectorSeq;
+        }
+    }
+
+    // Replay oldest to newest
+    for (i = 0; i < KV_SECTOR_COUNT; i++)
+    {
+        next = KV_NO_SECTOR;
+        for (sector = 0; sector < KV_SECTOR_COUNT; sector++)
+        {
+            if ((xSectorState[sector] == KV_SECTOR_USED) && (xSectorSeq[sector] >= lastSeq) &&
+                ((next == KV_NO_SECTOR) || (xSectorSeq[sector] < xSectorSeq[next])))
+            {
+                next = sector;
+            }
+        }
+
+        if (next == KV_NO_SECTOR)
+        {
+            break;
+        }
+
+        xWriteOffset = kvReplaySector(next, &status);
+        xHeadSector = next;
+        lastSeq = xSectorSeq[next] + 1;
+    }
+
+    if (xHeadSector != KV_NO_SECTOR)
+    {
+        xNextSectorSeq = lastSeq;
+
+        // Something other than erased flash follows the last good record: don't write over it
+        if (status != KV_RECORD_ERASED)
+        {
+            xWriteOffset = SECTOR_OFFSET;
+        }
+    }
+
+    xStats.MountUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+    xMounted = true;
+
+    return true;
+}
+
+/*
+ * Function to erase the whole store
+ */
+bool FlashKv_Format(void)
+{
+    uint32_t magic = KV_MAGIC;
+    uint16_t sector = 0;
+    bool wasMounted = xMounted;
+
+    kvCreateMutex();
+
+    if (wasMounted && !kvLock())
+    {
+        return false;
+    }
+
+    xMounted = false;
+    kvReset();
+
+    if (FlashServ_EraseRange(KV_REGION_START, KV_REGION_START + FLASH_LAYOUT_KV_SIZE, NULL) !=
+        FLASH_OPERATION_SUCCESS)
+    {
+        memset(xSectorState, KV_SECTOR_DIRTY, sizeof(xSectorState));
+    }
+    else
+    {
+        for (sector = 0; sector < KV_SECTOR_COUNT; sector++)
+        {
+            xSectorSeq[sector] = KV_ERASED_WORD;
+            xSectorState[sector] = KV_SECTOR_DIRTY;
+
+            if (FlashServ_Write(kvSectorAddress(sector), (const uint8_t *)&magic, sizeof(magic)) ==
+                FLASH_OPERATION_SUCCESS)
+            {
+                xSectorState[sector] = KV_SECTOR_FREE;
+            }
+        }
+        xStats.SectorErases += KV_SECTOR_COUNT;
+    }
+
+    xFreeSectors = KV_SECTOR_COUNT;
+    xMounted = true;
+
+    if (wasMounted)
+    {
+        kvUnlock();
+    }
+
+    return true;
+}
+
+/*
+ * Function to get the value of a key
+ */
+bool FlashKv_Get(uint32_t key, uint8_t *value, uint16_t maxLength, uint16_t *length)
+{
+    uint32_t slot = 0;
+    uint16_t storedLength = 0;
+    bool found = false;
+
+    if ((value == NULL) || !kvLock())
+    {
+        return false;
+    }
+
+    found = kvFind(key, &slot, &storedLength);
+    if (found)
+    {
+        if (FlashServ_Read(kvLocationAddress(xIndex[slot].Location) + sizeof(kvRecordHeader_t), value,
+                           (storedLength < maxLength) ? storedLength : maxLength) != FLASH_OPERATION_SUCCESS)
+        {
+            found = false;
+        }
+        else if (length != NULL)
+        {
+            *length = storedLength;
+        }
+    }
+
+    kvUnlock();
+
+    return found;
+}
+
+/*
+ * Function to store the value of a key
+ */
+flashReturnMsg_t FlashKv_Put(uint32_t key, const uint8_t *value, uint16_t length)
+{
+    uint32_t slot = 0;
+    uint32_t liveBytes = 0;
+    uint16_t oldLength = 0;
+    uint16_t location = 0;
+    bool found = false;
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if ((key == FLASH_KV_INVALID_KEY) || (value == NULL) || (length == 0) || (length > FLASH_KV_MAX_VALUE_LENGTH))
+    {
+        return FLASH_ADDRESS_INVALID;
+    }
+
+    if (!kvLock())
+    {
+        return FLASH_IS_BUSY;
+    }
+
+    found = kvFind(key, &slot, &oldLength);
+    liveBytes = xLiveBytes + KV_RECORD_SIZE(length) - (found ? KV_RECORD_SIZE(oldLength) : 0);
+
+    if (found && (oldLength == length))
+    {
+        // Skip rewriting a value that is already stored
+        if ((FlashServ_Read(kvLocationAddress(xIndex[slot].Location) + sizeof(kvRecordHeader_t), xRecordBuffer,
+                            length) == FLASH_OPERATION_SUCCESS) &&
+            (memcmp(xRecordBuffer, value, length) == 0))
+        {
+            xStats.PutsSkipped++;
+            kvUnlock();
+            return FLASH_OPERATION_SUCCESS;
+        }
+    }
+
+    if ((!found && ((slot == KV_NO_SLOT) || (xKeyCount >= FLASH_KV_MAX_KEYS))) || (liveBytes > KV_CAPACITY))
+    {
+        msg = FLASH_OPERATION_FAILED;
+    }
+
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        msg = kvMakeRoom(KV_RECORD_SIZE(length));
+    }
+
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        msg = kvAppend(key, value, length, &location);
+    }
+
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        // Collection may have moved the slot's record, but not the slot
+        kvIndexSet(key, slot, found, location);
+        xLiveBytes = liveBytes;
+        xStats.Puts++;
+    }
+
+    kvUnlock();
+
+    return msg;
+}
+
+/*
+ * Function to remove a key
+ */
+flashReturnMsg_t FlashKv_Delete(uint32_t key)
+{
+    uint32_t slot = 0;
+    uint16_t oldLength = 0;
+    uint16_t location = 0;
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if (!kvLock())
+    {
+        return FLASH_IS_BUSY;
+    }
+
+    if (kvFind(key, &slot, &oldLength))
+    {
+        msg = kvMakeRoom(KV_RECORD_SIZE(0));
+        if (msg == FLASH_OPERATION_SUCCESS)
+        {
+            msg = kvAppend(key, NULL, 0, &location);
+        }
+
+        if (msg == FLASH_OPERATION_SUCCESS)
+        {
+            kvIndexRemove(slot);
+            xLiveBytes -= KV_RECORD_SIZE(oldLength);
+        }
+    }
+
+    kvUnlock();
+
+    return msg;
+}
+
+/*
+ * Function to prepare free sectors ahead of the writer
+ */
+uint32_t FlashKv_PreErase(uint32_t maxSectors, uint32_t readySectors)
+{
+    uint32_t erased = 0;
+    uint16_t sector = 0;
+
+    if (!kvLock())
+    {
+        return 0;
+    }
+
+    // Sectors left half erased or never formatted
+    for (sector = 0; (sector < KV_SECTOR_COUNT) && (erased < maxSectors); sector++)
+    {
+        if (xSectorState[sector] == KV_SECTOR_DIRTY)
+        {
+            if (kvEraseSector(sector, true) != FLASH_OPERATION_SUCCESS)
+            {
+                break;
+            }
+            erased++;
+        }
+    }
+
+    // Collect now rather than in a put that opens a sector
+    while ((erased < maxSectors) && (xFreeSectors < (readySectors + KV_RESERVE_SECTORS)) && (xLiveBytes < KV_CAPACITY))
+    {
+        if (kvCollect(true) != FLASH_OPERATION_SUCCESS)
+        {
+            break;
+        }
+        erased++;
+    }
+
+    kvUnlock();
+
+    return erased;
+}
+
+/*
+ * Function to check the live records of a sector, copying them forward if any is corrupt
+ */
+bool FlashKv_Scrub(uint32_t sector, FlashServScrubReport_t *report)
+{
+    kvRecordHeader_t header;
+    uint32_t valueIndex = 0;
+    uint32_t offset = 0;
+    uint32_t slot = 0;
+    uint16_t location = 0;
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if ((report == NULL) || (sector >= KV_SECTOR_COUNT) || !kvLock())
+    {
+        return false;
+    }
+
+    memset(report, 0, sizeof(*report));
+    report->Address = kvSectorAddress((uint16_t)sector);
+
+    // Live records are the ones the index points at
+    for (slot = 0; slot < KV_INDEX_SLOTS; slot++)
+    {
+        if (kvSlotInSector(slot, (uint16_t)sector, &offset))
+        {
+            report->Checked++;
+            if (kvParseRecord((uint16_t)sector, offset, &header, &valueIndex) != KV_RECORD_VALID)
+            {
+                report->Failed++;
+            }
+        }
+    }
+
+    if (report->Failed > 0)
+    {
+        // Move the good ones off now rather than when collection reaches the sector
+        if (sector == xHeadSector)
+        {
+            xWriteOffset = SECTOR_OFFSET;
+        }
+
+        for (slot = 0; (slot < KV_INDEX_SLOTS) && (msg == FLASH_OPERATION_SUCCESS); slot++)
+        {
+            if (!kvSlotInSector(slot, (uint16_t)sector, &offset) ||
+                (kvParseRecord((uint16_t)sector, offset, &header, &valueIndex) != KV_RECORD_VALID))
+            {
+                continue;
+            }
+
+            // Making room may collect this sector and move the record itself
+            msg = kvMakeRoom(KV_RECORD_SIZE(header.Length));
+            if ((msg == FLASH_OPERATION_SUCCESS) && kvSlotInSector(slot, (uint16_t)sector, &offset) &&
+                (kvParseRecord((uint16_t)sector, offset, &header, &valueIndex) == KV_RECORD_VALID))
+            {
+                msg = kvAppend(header.Key, &xWindow[valueIndex], header.Length, &location);
+                if (msg == FLASH_OPERATION_SUCCESS)
+                {
+                    xIndex[slot].Location = location;
+                    xStats.RecordsCopied++;
+                    report->Relocated++;
+                }
+            }
+        }
+    }
+
+    kvUnlock();
+
+    return true;
+}
+
+/*
+ * Function to get store statistics
+ */
+void FlashKv_GetStats(FlashKvStats_t *stats)
+{
+    uint32_t ready = 0;
+    uint16_t sector = 0;
+
+    for (sector = 0; sector < KV_SECTOR_COUNT; sector++)
+    {
+        ready += (xSectorState[sector] == KV_SECTOR_FREE) ? 1 : 0;
+    }
+
+    taskENTER_CRITICAL();
+    *stats = xStats;
+    stats->Keys = xKeyCount;
+    stats->LiveBytes = xLiveBytes;
+    stats->FreeSectors = xFreeSectors;
+    stats->ReadySectors = ready;
+    taskEXIT_CRITICAL();
+}
+
+#ifdef FLASH_SELF_TEST
+/*
+ * Function to mount the store on another region
+ */
+bool FlashKv_MountAt(uint32_t start)
+{
+    if (((start % SECTOR_OFFSET) != 0) || (start > (FLASH_SIZE - FLASH_LAYOUT_KV_SIZE)))
+    {
+        return false;
+    }
+
+    xRegionStart = start;
+
+    return FlashKv_Mount();
+}
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+/*
+================================================================================================#=
+FILE:
+flash-layout.h
+
+DESCRIPTION:
+    Partitioning of the MX25 flash between the modules that store data on it.
+    Every region starts and ends on a 64KB block boundary so a region can be
+    erased with block erases without touching its neighbours.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+#include "mx25v1635f.h"
+
+// Scratch area used by the flash-services self-tests and benchmarks
+#define FLASH_LAYOUT_SCRATCH_START 0x000000
+#define FLASH_LAYOUT_SCRATCH_SIZE 0x040000 // 256KB
+
+// Flash translation layer
+#define FLASH_LAYOUT_FTL_START (FLASH_LAYOUT_SCRATCH_START + FLASH_LAYOUT_SCRATCH_SIZE)
+#define FLASH_LAYOUT_FTL_SIZE 0x080000 // 512KB
+
+// Append-only record log
+#define FLASH_LAYOUT_LOG_START (FLASH_LAYOUT_FTL_START + FLASH_LAYOUT_FTL_SIZE)
+#define FLASH_LAYOUT_LOG_SIZE 0x080000 // 512KB
+
+// Key-value store
+#define FLASH_LAYOUT_KV_START (FLASH_LAYOUT_LOG_START + FLASH_LAYOUT_LOG_SIZE)
+#define FLASH_LAYOUT_KV_SIZE 0x040000 // 256KB
+
+// Shadow-copy commit area: one 64KB block of commit records, then two 64KB banks
+#define FLASH_LAYOUT_COMMIT_START (FLASH_LAYOUT_KV_START + FLASH_LAYOUT_KV_SIZE)
+#define FLASH_LAYOUT_COMMIT_SIZE 0x030000 // 192KB
+
+// Time-series store
+#define FLASH_LAYOUT_TS_START (FLASH_LAYOUT_COMMIT_START + FLASH_LAYOUT_COMMIT_SIZE)
+#define FLASH_LAYOUT_TS_SIZE 0x030000 // 192KB
+
+#define FLASH_LAYOUT_END (FLASH_LAYOUT_TS_START + FLASH_LAYOUT_TS_SIZE)
+
+#if FLASH_LAYOUT_END > FLASH_SIZE
+#error "Flash layout exceeds the size of the device"
+#endif
@@ -0,0 +1,109 @@
+#pragma once
+/*
+================================================================================================#=
+FILE:
+flash-log-api.h
+
+DESCRIPTION:
+    The FlashLog module is an append-only record log in the LOG region of the MX25 flash,
+    meant for high rate telemetry. Records are numbered with a sequence number and read
+    back in order from any sequence number still held. When the region is full the oldest
+    sector of records is dropped.
+    This file defines the API to access those services.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+// FLASH information other modules may need to access:
+#include "flash-services-api.h"
+#include "flash-layout.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FLASH_LOG_MAX_RECORD_LENGTH 1024
+#define FLASH_LOG_SECTOR_COUNT (FLASH_LAYOUT_LOG_SIZE / SECTOR_OFFSET)
+
+// Position of a reader in the log
+typedef struct
+{
+    uint16_t Sector;
+    uint16_t Offset;
+    uint32_t SectorSeq; // Detects the sector being recycled under the reader
+} FlashLogCursor_t;
+
+// Ingest and recovery statistics
+typedef struct
+{
+    uint32_t RecordsAppended;
+    uint32_t BytesAppended;
+    uint32_t PagesProgrammed;
+    uint32_t SectorsErased;
+    uint32_t SectorsDropped; // Erased while still holding records
+    uint32_t PreErasedSectors;
+    uint32_t ReadySectors; // Erased sectors ahead of the writer
+    uint32_t BlankCheckFailures;
+    uint32_t MountUs;
+} FlashLogStats_t;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Recover the log from the sector headers and the newest sector.
+// Call once the flash is initialized.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashLog_Mount(void);
+
+// Erase the whole log region, leaving every sector ready to be written
+bool FlashLog_Format(void);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Append a record of 1 to FLASH_LOG_MAX_RECORD_LENGTH bytes and return its sequence number.
+// Records are batched in RAM and programmed a full page at a time; call FlashLog_Flush
+// to make them durable sooner.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+flashReturnMsg_t FlashLog_Append(const uint8_t *data, uint16_t length, uint32_t *seq);
+flashReturnMsg_t FlashLog_Flush(void);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Erase up to maxSectors sectors ahead of the writer so appends don't wait on an erase.
+// Each sector is checked blank before use. Erasing ahead drops the oldest records once
+// the log has wrapped.
+// Returns the number of sectors erased.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+uint32_t FlashLog_PreErase(uint32_t maxSectors);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Position a cursor at the first record with a sequence number >= seq, or at the
+// oldest record if seq has already been dropped. Returns false if the log is empty.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashLog_Seek(FlashLogCursor_t *cursor, uint32_t seq);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Read the record at the cursor and advance it. Returns false at the end of the
+// flushed log. Records longer than maxLength are truncated; length is the full size.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashLog_ReadNext(FlashLogCursor_t *cursor, uint8_t *data, uint16_t maxLength, uint16_t *length, uint32_t *seq);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Scrub: check the CRC of every record in one sector, counting from 0 at the start of
+// the region. Records are never moved: the log keeps them in sequence order, and a
+// corrupt record ends its sector for readers. A torn record left by a power loss, with
+// nothing programmed after it, is not counted as failed. Returns false if the sector is
+// out of range or the log is not available.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashLog_Scrub(uint32_t sector, FlashServScrubReport_t *report);
+
+// Get ingest and recovery statistics
+void FlashLog_GetStats(FlashLogStats_t *stats);
+
+#ifdef FLASH_SELF_TEST
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Test support, in FLASH_SELF_TEST builds only: mount the log on another region of up to
+// FLASH_LAYOUT_LOG_SIZE bytes, sector aligned, so it can be tested without touching the
+// LOG region. FlashLog_Mount mounts the last region given here.
+// Pass FLASH_LAYOUT_LOG_START and FLASH_LAYOUT_LOG_SIZE to go back to the LOG region.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashLog_MountAt(uint32_t start, uint32_t size);
+#endif
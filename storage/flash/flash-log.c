@@ -0,0 +1,961 @@
+/*
+================================================================================================#=
+FILE:
+flash-log.c
+
+DESCRIPTION:
+    The FlashLog module is an append-only record log in the LOG region of the MX25 flash.
+    This file implements those services.
+
+Adaptations Notes:  Sectors are used in ring order. Each starts with a 16 byte header holding
+                    a magic number, the sequence number the sector was opened with and the
+                    sequence number of its first record. A sector is only opened after it was
+                    erased and stamped with the magic number, so a half erased sector is never
+                    written to.
+
+                    Records follow the header back to back:
+                        Seq (4) | Length (2) | ~Length (2) | Data, padded to 4 bytes | CRC-32 (4)
+                    The CRC covers the record header and data. A record never spans sectors.
+
+                    Appends are staged in a page buffer and programmed when the page fills, so
+                    the device sees full 256 byte page programs. Flush programs the partial page;
+                    the rest of that page is programmed by the next flush, which NOR allows.
+
+                    Mount reads only the sector headers plus the records of the newest sector,
+                    so recovery time is bounded by the sector count whether or not the log is full.
+                    A torn record in the newest sector closes that sector.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+#include "flash-log-api.h"
+
+#include "crc/crc.h"
+#include "timing/timing.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define LOG_MAGIC 0x4C4F4731 // "LOG1"
+#define LOG_ERASED_WORD 0xFFFFFFFF
+#define LOG_ERASED_HALFWORD 0xFFFF
+#define LOG_NO_SECTOR 0xFFFF
+#define LOG_PRE_ERASE_WINDOW 8 // Furthest ahead of the writer a sector is pre-erased
+#define LOG_CHUNK_SIZE 64      // Read size when checking a record without a caller buffer
+#define LOG_MUTEX_TIMEOUT_MS 5000
+
+// Self-test builds can mount the log on a smaller region, see FlashLog_MountAt
+#ifdef FLASH_SELF_TEST
+#define LOG_REGION_START xRegionStart
+#define LOG_REGION_SECTORS xRegionSectors
+#else
+#define LOG_REGION_START FLASH_LAYOUT_LOG_START
+#define LOG_REGION_SECTORS FLASH_LOG_SECTOR_COUNT
+#endif
+
+// Round a record length up to whole words
+#define LOG_ALIGN(x) (((x) + 3U) & ~3U)
+
+typedef struct
+{
+    uint32_t Magic;
+    uint32_t SectorSeq;      // Erased while the sector is ready to be written
+    uint32_t FirstRecordSeq; // Erased while the sector is ready to be written
+    uint32_t Reserved;
+} logSectorHeader_t;
+
+typedef struct
+{
+    uint32_t Seq;
+    uint16_t Length;
+    uint16_t LengthCheck;
+} logRecordHeader_t;
+
+#define LOG_DATA_START sizeof(logSectorHeader_t)
+#define LOG_RECORD_SIZE(length) (sizeof(logRecordHeader_t) + LOG_ALIGN(length) + sizeof(uint32_t))
+
+typedef enum
+{
+    LOG_SECTOR_DIRTY, // Needs an erase before use
+    LOG_SECTOR_FREE,
+    LOG_SECTOR_USED
+} logSectorState_t;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Internal Private Data
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+static uint8_t xSectorState[FLASH_LOG_SECTOR_COUNT];
+static uint32_t xSectorSeq[FLASH_LOG_SECTOR_COUNT];
+static uint32_t xFirstRecordSeq[FLASH_LOG_SECTOR_COUNT];
+
+// Writer position in the newest sector
+static uint16_t xHeadSector = LOG_NO_SECTOR;
+static uint32_t xWriteOffset = 0;      // Next byte to stage
+static uint32_t xProgrammedOffset = 0; // Bytes before this are on flash
+static uint32_t xNextSectorSeq = 1;
+static uint32_t xNextRecordSeq = 1;
+
+// Page containing xWriteOffset
+static uint8_t xPageBuffer[PAGE_OFFSET];
+static uint8_t xChunkBuffer[LOG_CHUNK_SIZE];
+
+static FlashLogStats_t xStats = {0};
+
+static SemaphoreHandle_t xLogMutex = NULL;
+static StaticSemaphore_t xLogMutexControlBlock;
+static bool xMounted = false;
+
+#ifdef FLASH_SELF_TEST
+// Region mounted, see FlashLog_MountAt
+static uint32_t xRegionStart = FLASH_LAYOUT_LOG_START;
+static uint32_t xRegionSectors = FLASH_LOG_SECTOR_COUNT;
+#endif
+
+/*** Private Functions ***/
+
+// Helper function to get the flash address of a sector
+static uint32_t logSectorAddress(uint16_t sector)
+{
+    return LOG_REGION_START + ((uint32_t)sector * SECTOR_OFFSET);
+}
+
+// Helper function to get the sector after this one in ring order
+static uint16_t logNextSector(uint16_t sector)
+{
+    return (sector + 1) % LOG_REGION_SECTORS;
+}
+
+// Helper function to take exclusive access to the log
+static bool logLock(void)
+{
+    if (!xMounted)
+    {
+        return false;
+    }
+
+    if (xSemaphoreTake(xLogMutex, pdMS_TO_TICKS(LOG_MUTEX_TIMEOUT_MS)))
+    {
+        return true;
+    }
+
+    return false;
+}
+
+// Helper function to release exclusive access to the log
+static void logUnlock(void)
+{
+    xSemaphoreGive(xLogMutex);
+}
+
+/*
+ * Erase a sector and stamp it ready to be opened.
+ * With verify set the sector is read back blank before it is stamped.
+ */
+static flashReturnMsg_t logEraseSector(uint16_t sector, bool verify)
+{
+    uint32_t address = logSectorAddress(sector);
+    uint32_t magic = LOG_MAGIC;
+    flashReturnMsg_t msg = FLASH_OPERATION_FAILED;
+
+    if (xSectorState[sector] == LOG_SECTOR_USED)
+    {
+        xStats.SectorsDropped++;
+    }
+
+    xSectorState[sector] = LOG_SECTOR_DIRTY;
+    xSectorSeq[sector] = LOG_ERASED_WORD;
+
+    msg = FlashServ_EraseRange(address, address + SECTOR_OFFSET, NULL);
+    if ((msg == FLASH_OPERATION_SUCCESS) && verify && !FlashServ_IsBlank(address, SECTOR_OFFSET))
+    {
+        xStats.BlankCheckFailures++;
+        msg = FLASH_OPERATION_FAILED;
+    }
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        msg = FlashServ_Write(address + offsetof(logSectorHeader_t, Magic), (const uint8_t *)&magic, sizeof(magic));
+    }
+
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        xSectorState[sector] = LOG_SECTOR_FREE;
+        xStats.SectorsErased++;
+    }
+
+    return msg;
+}
+
+/*
+ * Program the staged bytes of the current page
+ */
+static flashReturnMsg_t logProgramStaged(void)
+{
+    uint32_t length = xWriteOffset - xProgrammedOffset;
+    flashReturnMsg_t msg = FLASH_OPERATION_FAILED;
+
+    if (length == 0)
+    {
+        return FLASH_OPERATION_SUCCESS;
+    }
+
+    msg = FlashServ_Write(logSectorAddress(xHeadSector) + xProgrammedOffset,
+                          &xPageBuffer[xProgrammedOffset % PAGE_OFFSET], length);
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        // Don't write over the failed bytes, continue in a new sector
+        xWriteOffset = SECTOR_OFFSET;
+        xProgrammedOffset = SECTOR_OFFSET;
+        return msg;
+    }
+
+    xProgrammedOffset = xWriteOffset;
+    xStats.PagesProgrammed++;
+
+    return FLASH_OPERATION_SUCCESS;
+}
+
+/*
+ * Stage bytes into the page buffer, programming each page as it fills
+ */
+static flashReturnMsg_t logStage(const uint8_t *data, uint32_t length)
+{
+    uint32_t pageOffset = 0;
+    uint32_t chunkLength = 0;
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    while ((length > 0) && (msg == FLASH_OPERATION_SUCCESS))
+    {
+        pageOffset = xWriteOffset % PAGE_OFFSET;
+        chunkLength = PAGE_OFFSET - pageOffset;
+        if (chunkLength > length)
+        {
+            chunkLength = length;
+        }
+
+        memcpy(&xPageBuffer[pageOffset], data, chunkLength);
+        xWriteOffset += chunkLength;
+        data += chunkLength;
+        length -= chunkLength;
+
+        if ((xWriteOffset % PAGE_OFFSET) == 0)
+        {
+            msg = logProgramStaged();
+        }
+    }
+
+    return msg;
+}
+
+/*
+ * Close the newest sector and open the next one in ring order
+ */
+static flashReturnMsg_t logOpenNextSector(void)
+{
+    logSectorHeader_t header;
+    uint16_t sector = 0;
+    uint16_t i = 0;
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if (xHeadSector != LOG_NO_SECTOR)
+    {
+        msg = logProgramStaged();
+        sector = logNextSector(xHeadSector);
+    }
+    else
+    {
+        // Empty log: start on a sector that is already erased if there is one
+        for (i = 0; i < LOG_REGION_SECTORS; i++)
+        {
+            if (xSectorState[i] == LOG_SECTOR_FREE)
+            {
+                sector = i;
+                break;
+            }
+        }
+    }
+
+    if (xSectorState[sector] != LOG_SECTOR_FREE)
+    {
+        msg = logEraseSector(sector, false);
+        if (msg != FLASH_OPERATION_SUCCESS)
+        {
+            return msg;
+        }
+    }
+
+    header.SectorSeq = xNextSectorSeq;
+    header.FirstRecordSeq = xNextRecordSeq;
+
+    msg = FlashServ_Write(logSectorAddress(sector) + offsetof(logSectorHeader_t, SectorSeq),
+                          (const uint8_t *)&header.SectorSeq, sizeof(header.SectorSeq) + sizeof(header.FirstRecordSeq));
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        xSectorState[sector] = LOG_SECTOR_DIRTY;
+        return msg;
+    }
+
+    xSectorState[sector] = LOG_SECTOR_USED;
+    xSectorSeq[sector] = xNextSectorSeq++;
+    xFirstRecordSeq[sector] = xNextRecordSeq;
+
+    xHeadSector = sector;
+    xWriteOffset = LOG_DATA_START;
+    xProgrammedOffset = LOG_DATA_START;
+
+    return FLASH_OPERATION_SUCCESS;
+}
+
+// Helper function to check whether a cursor still points into the sector it was set in
+static bool logCursorValid(const FlashLogCursor_t *cursor)
+{
+    return (cursor->Sector < LOG_REGION_SECTORS) && (xSectorState[cursor->Sector] == LOG_SECTOR_USED) &&
+           (xSectorSeq[cursor->Sector] == cursor->SectorSeq);
+}
+
+// Helper function to place a cursor at the start of the oldest sector
+static bool logCursorAtOldest(FlashLogCursor_t *cursor)
+{
+    uint16_t oldest = LOG_NO_SECTOR;
+    uint16_t i = 0;
+
+    for (i = 0; i < LOG_REGION_SECTORS; i++)
+    {
+        if ((xSectorState[i] == LOG_SECTOR_USED) && ((oldest == LOG_NO_SECTOR) || (xSectorSeq[i] < xSectorSeq[oldest])))
+        {
+            oldest = i;
+        }
+    }
+
+    if (oldest == LOG_NO_SECTOR)
+    {
+        return false;
+    }
+
+    cursor->Sector = oldest;
+    cursor->Offset = LOG_DATA_START;
+    cursor->SectorSeq = xSectorSeq[oldest];
+
+    return true;
+}
+
+/*
+ * Read and check the record at the cursor, moving on to the next sector at the end of one.
+ * Only flushed records are returned. Returns false at the end of the log.
+ */
+static bool logReadRecord(FlashLogCursor_t *cursor, uint8_t *data, uint16_t maxLength, uint16_t *length, uint32_t *seq)
+{
+    logRecordHeader_t header;
+    uint32_t address = 0;
+    uint32_t recordSize = 0;
+    uint32_t crc = 0;
+    uint32_t storedCrc = 0;
+    uint32_t remaining = 0;
+    uint32_t chunkLength = 0;
+    uint32_t copied = 0;
+    uint16_t next = 0;
+    bool endOfSector = false;
+
+    if (!logCursorValid(cursor) && !logCursorAtOldest(cursor))
+    {
+        return false;
+    }
+
+    for (;;)
+    {
+        endOfSector = true;
+
+        // Unflushed bytes of the newest sector are not on flash yet
+        if ((cursor->Sector == xHeadSector) && (cursor->Offset >= xProgrammedOffset))
+        {
+            return false;
+        }
+
+        if ((cursor->Offset + LOG_RECORD_SIZE(0)) <= SECTOR_OFFSET)
+        {
+            address = logSectorAddress(cursor->Sector) + cursor->Offset;
+            if (FlashServ_Read(address, (uint8_t *)&header, sizeof(header)) != FLASH_OPERATION_SUCCESS)
+            {
+                return false;
+            }
+
+            recordSize = LOG_RECORD_SIZE(header.Length);
+            if ((((uint32_t)header.Length + header.LengthCheck) == LOG_ERASED_HALFWORD) &&
+                (header.Length <= FLASH_LOG_MAX_RECORD_LENGTH) &&
+                ((cursor->Offset + recordSize) <= SECTOR_OFFSET))
+            {
+                endOfSector = false;
+            }
+        }
+
+        if (!endOfSector)
+        {
+            if ((cursor->Sector == xHeadSector) && ((cursor->Offset + recordSize) > xProgrammedOffset))
+            {
+                return false;
+            }
+
+            // Check the CRC, copying as much as the caller has room for
+            crc = CRC_Compute((const uint8_t *)&header, sizeof(header));
+            address += sizeof(header);
+            remaining = header.Length;
+            copied = 0;
+
+            while (remaining > 0)
+            {
+                if ((data != NULL) && (copied < maxLength))
+                {
+                    chunkLength = maxLength - copied;
+                    if (chunkLength > remaining)
+                    {
+                        chunkLength = remaining;
+                    }
+                    if (FlashServ_Read(address, &data[copied], chunkLength) != FLASH_OPERATION_SUCCESS)
+                    {
+                        return false;
+                    }
+                    crc = CRC_Accumulate(crc, &data[copied], chunkLength);
+                    copied += chunkLength;
+                }
+                else
+                {
+                    chunkLength = (remaining > LOG_CHUNK_SIZE) ? LOG_CHUNK_SIZE : remaining;
+                    if (FlashServ_Read(address, xChunkBuffer, chunkLength) != FLASH_OPERATION_SUCCESS)
+                    {
+                        return false;
+                    }
+                    crc = CRC_Accumulate(crc, xChunkBuffer, chunkLength);
+                }
+
+                address += chunkLength;
+                remaining -= chunkLength;
+            }
+
+            address = logSectorAddress(cursor->Sector) + cursor->Offset + recordSize - sizeof(storedCrc);
+            if (FlashServ_Read(address, (uint8_t *)&storedCrc, sizeof(storedCrc)) != FLASH_OPERATION_SUCCESS)
+            {
+                return false;
+            }
+
+            if (crc == storedCrc)
+            {
+                cursor->Offset += recordSize;
+                *length = header.Length;
+                *seq = header.Seq;
+                return true;
+            }
+
+            // A torn record ends the sector
+        }
+
+        if (cursor->Sector == xHeadSector)
+        {
+            return false;
+        }
+
+        // Sectors are opened in ring order with consecutive sequence numbers
+        next = logNextSector(cursor->Sector);
+        if ((xSectorState[next] != LOG_SECTOR_USED) || (xSectorSeq[next] != (cursor->SectorSeq + 1)))
+        {
+            return false;
+        }
+
+        cursor->Sector = next;
+        cursor->Offset = LOG_DATA_START;
+        cursor->SectorSeq = xSectorSeq[next];
+    }
+}
+
+/*
+ * Find where the writer stopped in the newest sector
+ */
+static void logRecoverHead(void)
+{
+    FlashLogCursor_t cursor;
+    uint16_t length = 0;
+    uint32_t seq = 0;
+    uint32_t expectedSeq = xFirstRecordSeq[xHeadSector];
+
+    cursor.Sector = xHeadSector;
+    cursor.Offset = LOG_DATA_START;
+    cursor.SectorSeq = xSectorSeq[xHeadSector];
+
+    // Treat the whole sector as flushed while walking it
+    xProgrammedOffset = SECTOR_OFFSET;
+
+    while (logReadRecord(&cursor, NULL, 0, &length, &seq) && (seq == expectedSeq))
+    {
+        expectedSeq++;
+    }
+
+    xNextRecordSeq = expectedSeq;
+    xWriteOffset = cursor.Offset;
+    xProgrammedOffset = cursor.Offset;
+
+    // Something other than erased flash follows the last good record: don't write over it
+    if ((cursor.Offset + sizeof(logRecordHeader_t)) <= SECTOR_OFFSET)
+    {
+        logRecordHeader_t header;
+
+        if ((FlashServ_Read(logSectorAddress(xHeadSector) + cursor.Offset, (uint8_t *)&header, sizeof(header)) !=
+             FLASH_OPERATION_SUCCESS) ||
+            (header.Seq != LOG_ERASED_WORD) || (header.Length != LOG_ERASED_HALFWORD))
+        {
+            xWriteOffset = SECTOR_OFFSET;
+            xProgrammedOffset = SECTOR_OFFSET;
+        }
+    }
+}
+
+// Helper function to create the log mutex on first use
+static void logCreateMutex(void)
+{
+    if (xLogMutex == NULL)
+    {
+        xLogMutex = xSemaphoreCreateMutexStatic(&xLogMutexControlBlock);
+    }
+}
+
+/*** Public Functions ***/
+
+/*
+ * Function to recover the log from flash
+ */
+bool FlashLog_Mount(void)
+{
+    logSectorHeader_t header;
+    uint32_t startCycles = TIMING_GetCycles();
+    uint16_t sector = 0;
+
+    logCreateMutex();
+
+    xMounted = false;
+    xHeadSector = LOG_NO_SECTOR;
+    xNextSectorSeq = 1;
+    xNextRecordSeq = 1;
+
+    for (sector = 0; sector < LOG_REGION_SECTORS; sector++)
+    {
+        if (FlashServ_Read(logSectorAddress(sector), (uint8_t *)&header, sizeof(header)) != FLASH_OPERATION_SUCCESS)
+        {
+            return false;
+        }
+
+        xSectorSeq[sector] = LOG_ERASED_WORD;
+
+        if (header.Magic != LOG_MAGIC)
+        {
+            xSectorState[sector] = LOG_SECTOR_DIRTY;
+        }
+        else if (header.SectorSeq == LOG_ERASED_WORD)
+        {
+            xSectorState[sector] = LOG_SECTOR_FREE;
+        }
+        else
+        {
+            xSectorState[sector] = LOG_SECTOR_USED;
+            xSectorSeq[sector] = header.SectorSeq;
+            xFirstRecordSeq[sector] = header.FirstRecordSeq;
+
+            if ((xHeadSector == LOG_NO_SECTOR) || (header.SectorSeq > xSectorSeq[xHeadSector]))
+            {
+                xHeadSector = sector;
+            }
+        }
+    }
+
+    if (xHeadSector != LOG_NO_SECTOR)
+    {
+        xNextSectorSeq = xSectorSeq[xHeadSector] + 1;
+        logRecoverHead();
+    }
+
+    xStats.MountUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+    xMounted = true;
+
+    return true;
+}
+
+/*
+ * Function to erase the whole log region
+ */
+bool FlashLog_Format(void)
+{
+    uint32_t magic = LOG_MAGIC;
+    uint16_t sector = 0;
+    bool wasMounted = xMounted;
+
+    logCreateMutex();
+
+    if (wasMounted && !logLock())
+    {
+        return false;
+    }
+
+    xMounted = false;
+    xHeadSector = LOG_NO_SECTOR;
+    xNextSectorSeq = 1;
+    xNextRecordSeq = 1;
+
+    // Block erases cover the region far faster than sector by sector
+    if (FlashServ_EraseRange(LOG_REGION_START, LOG_REGION_START + (LOG_REGION_SECTORS * SECTOR_OFFSET), NULL) !=
+        FLASH_OPERATION_SUCCESS)
+    {
+        memset(xSectorState, LOG_SECTOR_DIRTY, sizeof(xSectorState));
+    }
+    else
+    {
+        for (sector = 0; sector < LOG_REGION_SECTORS; sector++)
+        {
+            xSectorSeq[sector] = LOG_ERASED_WORD;
+            xSectorState[sector] = LOG_SECTOR_DIRTY;
+
+            if (FlashServ_Write(logSectorAddress(sector), (const uint8_t *)&magic, sizeof(magic)) ==
+                FLASH_OPERATION_SUCCESS)
+            {
+                xSectorState[sector] = LOG_SECTOR_FREE;
+            }
+        }
+        xStats.SectorsErased += LOG_REGION_SECTORS;
+    }
+
+    xMounted = true;
+
+    if (wasMounted)
+    {
+        logUnlock();
+    }
+
+    return true;
+}
+
+/*
+ * Function to append a record
+ */
+flashReturnMsg_t FlashLog_Append(const uint8_t *data, uint16_t length, uint32_t *seq)
+{
+    logRecordHeader_t header;
+    uint32_t crc = 0;
+    uint32_t padding = LOG_ERASED_WORD;
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if ((data == NULL) || (length == 0) || (length > FLASH_LOG_MAX_RECORD_LENGTH))
+    {
+        return FLASH_ADDRESS_INVALID;
+    }
+
+    if (!logLock())
+    {
+        return FLASH_IS_BUSY;
+    }
+
+    if ((xHeadSector == LOG_NO_SECTOR) || ((xWriteOffset + LOG_RECORD_SIZE(length)) > SECTOR_OFFSET))
+    {
+        msg = logOpenNextSector();
+    }
+
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        header.Seq = xNextRecordSeq;
+        header.Length = length;
+        header.LengthCheck = length ^ LOG_ERASED_HALFWORD;
+
+        crc = CRC_Compute((const uint8_t *)&header, sizeof(header));
+        crc = CRC_Accumulate(crc, data, length);
+
+        msg = logStage((const uint8_t *)&header, sizeof(header));
+        if (msg == FLASH_OPERATION_SUCCESS)
+        {
+            msg = logStage(data, length);
+        }
+        if (msg == FLASH_OPERATION_SUCCESS)
+        {
+            msg = logStage((const uint8_t *)&padding, LOG_ALIGN(length) - length);
+        }
+        if (msg == FLASH_OPERATION_SUCCESS)
+        {
+            msg = logStage((const uint8_t *)&crc, sizeof(crc));
+        }
+    }
+
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        if (seq != NULL)
+        {
+            *seq = xNextRecordSeq;
+        }
+        xNextRecordSeq++;
+        xStats.RecordsAppended++;
+        xStats.BytesAppended += length;
+    }
+
+    logUnlock();
+
+    return msg;
+}
+
+/*
+ * Function to program the records staged in RAM
+ */
+flashReturnMsg_t FlashLog_Flush(void)
+{
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if (!logLock())
+    {
+        return FLASH_IS_BUSY;
+    }
+
+    if (xHeadSector != LOG_NO_SECTOR)
+    {
+        msg = logProgramStaged();
+    }
+
+    logUnlock();
+
+    return msg;
+}
+
+/*
+ * Function to erase sectors ahead of the writer
+ */
+uint32_t FlashLog_PreErase(uint32_t maxSectors)
+{
+    uint32_t erased = 0;
+    uint16_t sector = 0;
+    uint16_t i = 0;
+
+    if (!logLock())
+    {
+        return 0;
+    }
+
+    sector = (xHeadSector == LOG_NO_SECTOR) ? 0 : logNextSector(xHeadSector);
+
+    for (i = 0; (i < LOG_PRE_ERASE_WINDOW) && (erased < maxSectors); i++)
+    {
+        if (sector == xHeadSector)
+        {
+            break;
+        }
+
+        if (xSectorState[sector] != LOG_SECTOR_FREE)
+        {
+            if (logEraseSector(sector, true) != FLASH_OPERATION_SUCCESS)
+            {
+                break;
+            }
+            erased++;
+        }
+
+        sector = logNextSector(sector);
+    }
+
+    xStats.PreErasedSectors += erased;
+
+    logUnlock();
+
+    return erased;
+}
+
+/*
+ * Function to position a cursor at a sequence number
+ */
+bool FlashLog_Seek(FlashLogCursor_t *cursor, uint32_t seq)
+{
+    FlashLogCursor_t previous;
+    uint16_t best = LOG_NO_SECTOR;
+    uint16_t length = 0;
+    uint32_t recordSeq = 0;
+    uint16_t i = 0;
+    bool result = false;
+
+    if ((cursor == NULL) || !logLock())
+    {
+        return false;
+    }
+
+    // Newest sector whose first record is at or before seq
+    for (i = 0; i < LOG_REGION_SECTORS; i++)
+    {
+        if ((xSectorState[i] == LOG_SECTOR_USED) && (xFirstRecordSeq[i] <= seq) &&
+            ((best == LOG_NO_SECTOR) || (xSectorSeq[i] > xSectorSeq[best])))
+        {
+            best = i;
+        }
+    }
+
+    if (best != LOG_NO_SECTOR)
+    {
+        cursor->Sector = best;
+        cursor->Offset = LOG_DATA_START;
+        cursor->SectorSeq = xSectorSeq[best];
+        result = true;
+    }
+    else
+    {
+        result = logCursorAtOldest(cursor);
+    }
+
+    // Walk forward to the record itself, leaving the cursor in front of it
+    if (result)
+    {
+        previous = *cursor;
+        while (logReadRecord(cursor, NULL, 0, &length, &recordSeq) && (recordSeq < seq))
+        {
+            previous = *cursor;
+        }
+        *cursor = previous;
+    }
+
+    logUnlock();
+
+    return result;
+}
+
+/*
+ * Function to read the record at a cursor
+ */
+bool FlashLog_ReadNext(FlashLogCursor_t *cursor, uint8_t *data, uint16_t maxLength, uint16_t *length, uint32_t *seq)
+{
+    uint16_t recordLength = 0;
+    uint32_t recordSeq = 0;
+    bool result = false;
+
+    if ((cursor == NULL) || !logLock())
+    {
+        return false;
+    }
+
+    result = logReadRecord(cursor, data, maxLength, &recordLength, &recordSeq);
+
+    if (result)
+    {
+        if (length != NULL)
+        {
+            *length = recordLength;
+        }
+        if (seq != NULL)
+        {
+            *seq = recordSeq;
+        }
+    }
+
+    logUnlock();
+
+    return result;
+}
+
+/*
+ * Function to check the records of a sector
+ */
+bool FlashLog_Scrub(uint32_t sector, FlashServScrubReport_t *report)
+{
+    FlashLogCursor_t cursor;
+    logRecordHeader_t header;
+    uint32_t address = 0;
+    uint32_t end = LOG_DATA_START;
+    uint32_t restOffset = 0;
+    uint16_t length = 0;
+    uint32_t seq = 0;
+
+    if ((report == NULL) || (sector >= LOG_REGION_SECTORS) || !logLock())
+    {
+        return false;
+    }
+
+    memset(report, 0, sizeof(*report));
+    report->Address = logSectorAddress((uint16_t)sector);
+
+    if (xSectorState[sector] != LOG_SECTOR_USED)
+    {
+        logUnlock();
+        return true;
+    }
+
+    cursor.Sector = (uint16_t)sector;
+    cursor.Offset = LOG_DATA_START;
+    cursor.SectorSeq = xSectorSeq[sector];
+
+    // Reading moves on to the next sector at the end of this one
+    while (logReadRecord(&cursor, NULL, 0, &length, &seq) && (cursor.Sector == sector))
+    {
+        report->Checked++;
+        end = cursor.Offset;
+    }
+
+    // Anything but erased flash where the records stop is a bad record
+    address = report->Address + end;
+    if (((sector != xHeadSector) || (end < xProgrammedOffset)) && ((end + LOG_RECORD_SIZE(0)) <= SECTOR_OFFSET) &&
+        (FlashServ_Read(address, (uint8_t *)&header, sizeof(header)) == FLASH_OPERATION_SUCCESS) &&
+        ((header.Seq != LOG_ERASED_WORD) || (header.Length != LOG_ERASED_HALFWORD)))
+    {
+        restOffset = end + sizeof(header);
+        if ((((uint32_t)header.Length + header.LengthCheck) == LOG_ERASED_HALFWORD) &&
+            ((end + LOG_RECORD_SIZE(header.Length)) <= SECTOR_OFFSET))
+        {
+            restOffset = end + LOG_RECORD_SIZE(header.Length);
+        }
+
+        report->Checked++;
+        if ((restOffset < SECTOR_OFFSET) &&
+            !FlashServ_IsBlank(report->Address + restOffset, SECTOR_OFFSET - restOffset))
+        {
+            report->Failed++;
+        }
+    }
+
+    logUnlock();
+
+    return true;
+}
+
+/*
+ * Function to get ingest and recovery statistics
+ */
+void FlashLog_GetStats(FlashLogStats_t *stats)
+{
+    uint16_t sector = 0;
+    uint16_t ready = 0;
+
+    // Erased sectors the writer will reach next
+    if (xMounted)
+    {
+        sector = (xHeadSector == LOG_NO_SECTOR) ? 0 : logNextSector(xHeadSector);
+        while ((ready < LOG_REGION_SECTORS) && (xSectorState[sector] == LOG_SECTOR_FREE))
+        {
+            ready++;
+            sector = logNextSector(sector);
+        }
+    }
+
+    taskENTER_CRITICAL();
+    *stats = xStats;
+    stats->ReadySectors = ready;
+    taskEXIT_CRITICAL();
+}
+
+#ifdef FLASH_SELF_TEST
+/*
+ * Function to mount the log on another region
+ */
+bool FlashLog_MountAt(uint32_t start, uint32_t size)
+{
+    if (((start % SECTOR_OFFSET) != 0) || ((size % SECTOR_OFFSET) != 0) || (size > FLASH_LAYOUT_LOG_SIZE) ||
+        ((size / SECTOR_OFFSET) <= LOG_PRE_ERASE_WINDOW) || (start > (FLASH_SIZE - size)))
+    {
+        return false;
+    }
+
+    xRegionStart = start;
+    xRegionSectors = size / SECTOR_OFFSET;
+
+    return FlashLog_Mount();
+}
+#endif
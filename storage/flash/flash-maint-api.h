@@ -0,0 +1,51 @@
+#pragma once
+/*
+================================================================================================#=
+FILE:
+flash-maint-api.h
+
+DESCRIPTION:
+    The FlashMaint module runs a low priority task that keeps erased, blank checked sectors
+    ready ahead of the flash stores, so their writes pay for a page program and not an erase.
+    It only works while no foreground task has used the flash for FLASH_MAINT_IDLE_MS.
+    This file defines the API to access those services.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Pool depths kept ready for each store
+#define FLASH_MAINT_LOG_READY_SECTORS 4
+#define FLASH_MAINT_KV_READY_SECTORS 2
+#define FLASH_MAINT_FTL_FREE_SECTORS 4
+
+#define FLASH_MAINT_PERIOD_MS 10
+#define FLASH_MAINT_IDLE_MS 50 // Foreground quiet time before erasing
+
+// Pool depth and activity metrics
+typedef struct
+{
+    uint32_t LogReadySectors;
+    uint32_t KvReadySectors;
+    uint32_t FtlFreeSectors;
+    uint32_t SectorsPrepared;
+    uint32_t FtlPagesCopied;
+    uint32_t Deferrals; // Passes skipped for foreground I/O
+} FlashMaintStats_t;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Does the needful to initialize the module.
+// This should be called only once.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+void FlashMaint_Init(void);
+
+// Start maintenance once the stores are mounted
+void FlashMaint_Start(void);
+
+// Get pool depth and activity metrics
+void FlashMaint_GetStats(FlashMaintStats_t *stats);
@@ -0,0 +1,161 @@
+/*
+================================================================================================#=
+FILE:
+flash-maint.c
+
+DESCRIPTION:
+    The FlashMaint module keeps erased sectors ready ahead of the flash stores.
+    This file implements those services.
+
+Adaptations Notes:  Each store already decides which of its sectors is written next, so the pool
+                    is kept in the stores rather than handed out from here: the log ring has sectors
+                    erased ahead of its writer, the key-value store has its dirty sectors erased and
+                    its next collection done early, and the FTL has free sectors reclaimed by
+                    background collection. Taking the next sector stays O(1) in each store.
+
+                    Each pass does at most one sector of work and holds the flash for one erase, so
+                    a foreground client arriving mid pass waits at most one tSE. The task runs at
+                    idle priority and skips passes until the flash has been quiet for
+                    FLASH_MAINT_IDLE_MS.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+#include "flash-maint-api.h"
+#include "flash-services-api.h"
+#include "flash-log-api.h"
+#include "flash-kv-api.h"
+#include "flash-ftl-api.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define FLASH_MAINT_FTL_COPY_BUDGET FTL_PAGES_PER_SECTOR // One sector's worth per pass
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Internal Private Data
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+#define FLASH_MAINT_STACK_SIZE_IN_WORDS 256
+static StackType_t xFlashMaintTaskStack[FLASH_MAINT_STACK_SIZE_IN_WORDS];
+static StaticTask_t xFlashMaintTaskControlBlock;
+static TaskHandle_t xFlashMaintTask = NULL;
+
+static FlashMaintStats_t xStats = {0};
+
+/*** Private Functions ***/
+
+/*
+ * Do one unit of work for the first store found below its pool depth.
+ * Returns false when every pool is full.
+ */
+static bool flashMaintPass(void)
+{
+    FlashLogStats_t logStats = {0};
+    FlashKvStats_t kvStats = {0};
+    FlashFtlStats_t ftlStats = {0};
+    uint32_t prepared = 0;
+    uint32_t copied = 0;
+
+    FlashLog_GetStats(&logStats);
+    FlashKv_GetStats(&kvStats);
+    FlashFtl_GetStats(&ftlStats);
+
+    if (logStats.ReadySectors < FLASH_MAINT_LOG_READY_SECTORS)
+    {
+        prepared = FlashLog_PreErase(1);
+    }
+
+    if ((prepared == 0) && ((kvStats.ReadySectors < kvStats.FreeSectors) ||
+                            (kvStats.FreeSectors <= FLASH_MAINT_KV_READY_SECTORS)))
+    {
+        prepared = FlashKv_PreErase(1, FLASH_MAINT_KV_READY_SECTORS);
+    }
+
+    if ((prepared == 0) && (ftlStats.FreeSectors < FLASH_MAINT_FTL_FREE_SECTORS))
+    {
+        copied = FlashFtl_Collect(FLASH_MAINT_FTL_COPY_BUDGET);
+    }
+
+    FlashLog_GetStats(&logStats);
+    FlashKv_GetStats(&kvStats);
+    FlashFtl_GetStats(&ftlStats);
+
+    taskENTER_CRITICAL();
+    xStats.LogReadySectors = logStats.ReadySectors;
+    xStats.KvReadySectors = kvStats.ReadySectors;
+    xStats.FtlFreeSectors = ftlStats.FreeSectors;
+    xStats.SectorsPrepared += prepared;
+    xStats.FtlPagesCopied += copied;
+    taskEXIT_CRITICAL();
+
+    return (prepared > 0) || (copied > 0);
+}
+
+// -----------------------------------------------------------------------------+-
+// Wait for the stores to be mounted, then top up their pools whenever the
+// flash is idle.
+// -----------------------------------------------------------------------------+-
+static void flashMaintTaskCode(void *arg)
+{
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    FlashServ_MarkBackgroundTask();
+
+    for (;;)
+    {
+        vTaskDelay(pdMS_TO_TICKS(FLASH_MAINT_PERIOD_MS));
+
+        if (FlashServ_MsSinceForegroundAccess() < FLASH_MAINT_IDLE_MS)
+        {
+            taskENTER_CRITICAL();
+            xStats.Deferrals++;
+            taskEXIT_CRITICAL();
+            continue;
+        }
+
+        flashMaintPass();
+    }
+}
+
+/*** Public Functions ***/
+
+/*
+ * Function to start maintenance
+ */
+void FlashMaint_Start(void)
+{
+    if (xFlashMaintTask != NULL)
+    {
+        xTaskNotifyGive(xFlashMaintTask);
+    }
+}
+
+/*
+ * Function to get pool depth and activity metrics
+ */
+void FlashMaint_GetStats(FlashMaintStats_t *stats)
+{
+    taskENTER_CRITICAL();
+    *stats = xStats;
+    taskEXIT_CRITICAL();
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Init the flash maintenance module
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+void FlashMaint_Init(void)
+{
+    // ---------------------------------------------------------------------+-
+    // Create the maintenance task below every foreground task
+    // ---------------------------------------------------------------------+-
+    const char *const flashMaintTaskName = "flash-maint";
+    void *flashMaintTaskNoParams = NULL;
+    UBaseType_t flashMaintTaskPriority = tskIDLE_PRIORITY;
+
+    xFlashMaintTask = xTaskCreateStatic(flashMaintTaskCode, flashMaintTaskName, FLASH_MAINT_STACK_SIZE_IN_WORDS,
+                                        flashMaintTaskNoParams, flashMaintTaskPriority, xFlashMaintTaskStack,
+                                        &xFlashMaintTaskControlBlock);
+}
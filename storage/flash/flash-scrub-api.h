@@ -0,0 +1,67 @@
+#pragma once
+/*
+================================================================================================#=
+FILE:
+flash-scrub-api.h
+
+DESCRIPTION:
+    The FlashScrub module runs a low priority task that walks the written regions of the
+    MX25 flash, checks the CRC of every record the stores hold and has the stores move data
+    off sectors where records fail. It keeps the erase count and error history of every
+    sector across resets and sums them up in a health summary. The task holds the flash for
+    at most FLASH_SCRUB_BUDGET_PERCENT of the time.
+    This file defines the API to access those services.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FLASH_SCRUB_BUDGET_PERCENT 5 // Default share of flash time the scrub may use
+#define FLASH_SCRUB_MIN_PERIOD_MS 10
+#define FLASH_SCRUB_IDLE_MS 50 // Foreground quiet time before scrubbing
+
+// First of the key-value keys the sector health is saved under
+#define FLASH_SCRUB_KV_KEY_BASE 0x7F000000
+
+// Health summary
+typedef struct
+{
+    uint32_t Passes; // Complete walks over every store
+    uint32_t SectorsScrubbed;
+    uint32_t RecordsChecked;
+    uint32_t RecordsFailed;
+    uint32_t RecordsRelocated;
+    uint32_t SectorsWithErrors;
+    uint32_t TotalErases;
+    uint32_t EraseCountMin;
+    uint32_t EraseCountMax;
+    uint32_t EraseCountAverage;
+    uint32_t MostWornSector;
+    uint32_t Deferrals; // Steps skipped for foreground I/O
+    uint32_t BusyUs;    // Flash time spent scrubbing
+    uint32_t BudgetPercent;
+    uint32_t LastPassMs;
+} FlashScrubHealth_t;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Does the needful to initialize the module.
+// This should be called only once.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+void FlashScrub_Init(void);
+
+// Start scrubbing once the stores are mounted. The saved sector health is restored first.
+void FlashScrub_Start(void);
+
+// Set the share of flash time the scrub may use, 1 to 100 percent
+void FlashScrub_SetBudget(uint32_t percent);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Get the health summary. The erase and error figures cover every sector of the device;
+// FlashServ_GetSectorHealth gives the detail of one sector.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+void FlashScrub_GetHealth(FlashScrubHealth_t *health);
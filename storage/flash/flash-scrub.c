@@ -0,0 +1,349 @@
+/*
+================================================================================================#=
+FILE:
+flash-scrub.c
+
+DESCRIPTION:
+    The FlashScrub module checks the records the flash stores hold and tracks sector health.
+    This file implements those services.
+
+Adaptations Notes:  Only the stores know where their records start and what a good record is, so
+                    each store checks its own sectors and this module walks them in turn: the
+                    log ring, the key-value store, the commit object and the time-series chunks.
+                    The key-value store copies the good live records off a sector where one fails,
+                    so collection can erase it. Log and time-series records stay where they are
+                    until their sector is reused, and a failed commit object is only replaced by
+                    the next commit, so those are reported and counted. The FTL keeps no CRCs
+                    and is not scrubbed.
+
+                    Each step scrubs one sector and is timed; the task then sleeps long enough
+                    that the steps take at most the budget share of the flash time. Steps are
+                    skipped while foreground tasks are using the flash.
+
+                    The erase and error counts live in the flash services. They are saved to the
+                    key-value store after every pass, 60 sectors to a key, each as one word of
+                    errors (8 bits) and erases (24 bits), and restored when scrubbing starts.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+#include "flash-scrub-api.h"
+#include "flash-services-api.h"
+#include "flash-layout.h"
+#include "flash-log-api.h"
+#include "flash-kv-api.h"
+#include "flash-commit-api.h"
+#include "flash-ts-api.h"
+
+#include "timing/timing.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define SCRUB_HEALTH_PER_KEY (FLASH_KV_MAX_VALUE_LENGTH / sizeof(uint32_t))
+#define SCRUB_HEALTH_KEYS ((FLASH_SERV_SECTOR_COUNT + SCRUB_HEALTH_PER_KEY - 1) / SCRUB_HEALTH_PER_KEY)
+#define SCRUB_ERASE_BITS 24
+#define SCRUB_ERASE_MASK ((1UL << SCRUB_ERASE_BITS) - 1)
+#define SCRUB_ERRORS_MAX 0xFF
+#define US_PER_MS 1000
+
+// One store and the number of sectors it scrubs
+typedef struct
+{
+    bool (*Scrub)(uint32_t sector, FlashServScrubReport_t *report);
+    uint32_t Sectors;
+} scrubStore_t;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Internal Private Data
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+#define FLASH_SCRUB_STACK_SIZE_IN_WORDS 256
+static StackType_t xFlashScrubTaskStack[FLASH_SCRUB_STACK_SIZE_IN_WORDS];
+static StaticTask_t xFlashScrubTaskControlBlock;
+static TaskHandle_t xFlashScrubTask = NULL;
+
+static bool scrubCommit(uint32_t sector, FlashServScrubReport_t *report);
+
+static const scrubStore_t xStores[] = {
+    {FlashLog_Scrub, FLASH_LAYOUT_LOG_SIZE / SECTOR_OFFSET},
+    {FlashKv_Scrub, FLASH_LAYOUT_KV_SIZE / SECTOR_OFFSET},
+    {scrubCommit, 1},
+    {FlashTs_Scrub, FLASH_TS_CHUNK_COUNT},
+};
+
+#define SCRUB_STORES (sizeof(xStores) / sizeof(xStores[0]))
+
+// Next sector to scrub
+static uint32_t xStore = 0;
+static uint32_t xSector = 0;
+static TickType_t xPassStartTick = 0;
+
+static uint32_t xBudgetPercent = FLASH_SCRUB_BUDGET_PERCENT;
+static FlashScrubHealth_t xStats = {0};
+
+// Packed sector health of one key
+static uint32_t xHealthWords[SCRUB_HEALTH_PER_KEY];
+
+/*** Private Functions ***/
+
+// Helper function to fit the commit object, which is a single unit, into the store table
+static bool scrubCommit(uint32_t sector, FlashServScrubReport_t *report)
+{
+    (void)sector;
+
+    return FlashCommit_Scrub(report);
+}
+
+/*
+ * Restore the sector health saved by an earlier boot
+ */
+static void scrubLoadHealth(void)
+{
+    FlashServSectorHealth_t health;
+    uint16_t length = 0;
+    uint32_t key = 0;
+    uint32_t i = 0;
+    uint32_t sector = 0;
+
+    for (key = 0; key < SCRUB_HEALTH_KEYS; key++)
+    {
+        memset(xHealthWords, 0, sizeof(xHealthWords));
+        if (!FlashKv_Get(FLASH_SCRUB_KV_KEY_BASE + key, (uint8_t *)xHealthWords, sizeof(xHealthWords), &length))
+        {
+            continue;
+        }
+
+        for (i = 0; (i < SCRUB_HEALTH_PER_KEY) && ((i * sizeof(uint32_t)) < length); i++)
+        {
+            sector = (key * SCRUB_HEALTH_PER_KEY) + i;
+            health.EraseCount = xHealthWords[i] & SCRUB_ERASE_MASK;
+            health.Errors = xHealthWords[i] >> SCRUB_ERASE_BITS;
+            FlashServ_RestoreSectorHealth(sector, &health);
+        }
+    }
+}
+
+/*
+ * Save the sector health so it outlives a reset. Keys whose sectors have not
+ * changed cost no write.
+ */
+static void scrubSaveHealth(void)
+{
+    FlashServSectorHealth_t health;
+    uint32_t key = 0;
+    uint32_t i = 0;
+    uint32_t sector = 0;
+    uint32_t count = 0;
+
+    for (key = 0; key < SCRUB_HEALTH_KEYS; key++)
+    {
+        count = 0;
+        for (i = 0; i < SCRUB_HEALTH_PER_KEY; i++)
+        {
+            sector = (key * SCRUB_HEALTH_PER_KEY) + i;
+            if (sector >= FLASH_SERV_SECTOR_COUNT)
+            {
+                break;
+            }
+
+            FlashServ_GetSectorHealth(sector, &health);
+            if (health.EraseCount > SCRUB_ERASE_MASK)
+            {
+                health.EraseCount = SCRUB_ERASE_MASK;
+            }
+            if (health.Errors > SCRUB_ERRORS_MAX)
+            {
+                health.Errors = SCRUB_ERRORS_MAX;
+            }
+            xHealthWords[i] = (health.Errors << SCRUB_ERASE_BITS) | health.EraseCount;
+            count++;
+        }
+
+        FlashKv_Put(FLASH_SCRUB_KV_KEY_BASE + key, (const uint8_t *)xHealthWords,
+                    (uint16_t)(count * sizeof(uint32_t)));
+    }
+}
+
+/*
+ * Scrub the next sector and move on, saving the health at the end of a pass.
+ * Returns the time spent in us.
+ */
+static uint32_t flashScrubStep(void)
+{
+    FlashServScrubReport_t report = {0};
+    uint32_t startCycles = TIMING_GetCycles();
+    uint32_t busyUs = 0;
+    bool scrubbed = false;
+
+    scrubbed = xStores[xStore].Scrub(xSector, &report);
+    if (scrubbed && (report.Failed > 0))
+    {
+        FlashServ_RecordSectorErrors(report.Address, report.Failed);
+    }
+
+    if (++xSector >= xStores[xStore].Sectors)
+    {
+        xSector = 0;
+        xStore++;
+    }
+
+    if (xStore >= SCRUB_STORES)
+    {
+        xStore = 0;
+        scrubSaveHealth();
+    }
+
+    busyUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+
+    taskENTER_CRITICAL();
+    if (scrubbed)
+    {
+        xStats.SectorsScrubbed++;
+        xStats.RecordsChecked += report.Checked;
+        xStats.RecordsFailed += report.Failed;
+        xStats.RecordsRelocated += report.Relocated;
+    }
+    if ((xStore == 0) && (xSector == 0))
+    {
+        xStats.Passes++;
+        xStats.LastPassMs = (xTaskGetTickCount() - xPassStartTick) * portTICK_PERIOD_MS;
+        xPassStartTick = xTaskGetTickCount();
+    }
+    xStats.BusyUs += busyUs;
+    taskEXIT_CRITICAL();
+
+    return busyUs;
+}
+
+// -----------------------------------------------------------------------------+-
+// Wait for the stores to be mounted, restore the saved health, then scrub one
+// sector at a time within the budget whenever the flash is idle.
+// -----------------------------------------------------------------------------+-
+static void flashScrubTaskCode(void *arg)
+{
+    uint32_t busyUs = 0;
+    uint32_t percent = 0;
+    uint32_t restMs = 0;
+    uint32_t periodMs = FLASH_SCRUB_MIN_PERIOD_MS;
+
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    FlashServ_MarkBackgroundTask();
+    scrubLoadHealth();
+    xPassStartTick = xTaskGetTickCount();
+
+    for (;;)
+    {
+        vTaskDelay(pdMS_TO_TICKS(periodMs));
+        periodMs = FLASH_SCRUB_MIN_PERIOD_MS;
+
+        if (FlashServ_MsSinceForegroundAccess() < FLASH_SCRUB_IDLE_MS)
+        {
+            taskENTER_CRITICAL();
+            xStats.Deferrals++;
+            taskEXIT_CRITICAL();
+            continue;
+        }
+
+        busyUs = flashScrubStep();
+
+        // Rest for (100 - p) / p of the time just spent so the scrub keeps to p percent
+        percent = xBudgetPercent;
+        restMs = (uint32_t)(((uint64_t)busyUs * (100 - percent)) / ((uint64_t)percent * US_PER_MS));
+        if (restMs > periodMs)
+        {
+            periodMs = restMs;
+        }
+    }
+}
+
+/*** Public Functions ***/
+
+/*
+ * Function to start scrubbing
+ */
+void FlashScrub_Start(void)
+{
+    if (xFlashScrubTask != NULL)
+    {
+        xTaskNotifyGive(xFlashScrubTask);
+    }
+}
+
+/*
+ * Function to set the share of flash time the scrub may use
+ */
+void FlashScrub_SetBudget(uint32_t percent)
+{
+    if ((percent == 0) || (percent > 100))
+    {
+        return;
+    }
+
+    xBudgetPercent = percent;
+}
+
+/*
+ * Function to get the health summary
+ */
+void FlashScrub_GetHealth(FlashScrubHealth_t *health)
+{
+    FlashServSectorHealth_t sectorHealth;
+    uint32_t sector = 0;
+
+    taskENTER_CRITICAL();
+    *health = xStats;
+    taskEXIT_CRITICAL();
+
+    health->BudgetPercent = xBudgetPercent;
+    health->SectorsWithErrors = 0;
+    health->TotalErases = 0;
+    health->EraseCountMin = 0xFFFFFFFF;
+    health->EraseCountMax = 0;
+    health->MostWornSector = 0;
+
+    for (sector = 0; sector < FLASH_SERV_SECTOR_COUNT; sector++)
+    {
+        FlashServ_GetSectorHealth(sector, &sectorHealth);
+
+        health->TotalErases += sectorHealth.EraseCount;
+        if (sectorHealth.Errors > 0)
+        {
+            health->SectorsWithErrors++;
+        }
+        if (sectorHealth.EraseCount < health->EraseCountMin)
+        {
+            health->EraseCountMin = sectorHealth.EraseCount;
+        }
+        if (sectorHealth.EraseCount > health->EraseCountMax)
+        {
+            health->EraseCountMax = sectorHealth.EraseCount;
+            health->MostWornSector = sector;
+        }
+    }
+
+    health->EraseCountAverage = health->TotalErases / FLASH_SERV_SECTOR_COUNT;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Init the flash scrub module
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+void FlashScrub_Init(void)
+{
+    // ---------------------------------------------------------------------+-
+    // Create the scrub task below every foreground task
+    // ---------------------------------------------------------------------+-
+    const char *const flashScrubTaskName = "flash-scrub";
+    void *flashScrubTaskNoParams = NULL;
+    UBaseType_t flashScrubTaskPriority = tskIDLE_PRIORITY;
+
+    xFlashScrubTask = xTaskCreateStatic(flashScrubTaskCode, flashScrubTaskName, FLASH_SCRUB_STACK_SIZE_IN_WORDS,
+                                        flashScrubTaskNoParams, flashScrubTaskPriority, xFlashScrubTaskStack,
+                                        &xFlashScrubTaskControlBlock);
+}
@@ -0,0 +1,24 @@
+#pragma once
+/*
+================================================================================================#=
+FILE:
+flash-selftest-api.h
+
+DESCRIPTION:
+    The FlashSelfTest module checks the flash part, the flash services and the stores built
+    on them, and measures their performance.
+    This file defines the API to access those services.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Run the self-tests and benchmarks, printing the outcome of each. Called by the flash
+// task once the stores are mounted and before it serves the asynchronous queue.
+// Benchmarks that format a store, wiping its contents, only run in builds with
+// FLASH_SELF_TEST defined.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+void FlashSelfTest_Run(void);
@@ -0,0 +1,2562 @@
+/*
+================================================================================================#=
+FILE:
+flash-selftest.c
+
+DESCRIPTION:
+    The FlashSelfTest module checks the flash part, the flash services and the stores built
+    on them, and measures their performance.
+    This file implements those services.
+
+Adaptations Notes:  The tests run on the flash task before it starts serving the asynchronous
+                    queue, so they call the services directly and never wait on the queue. The
+                    suspend test starts its erase through FlashServ_StartEraseSector for the
+                    same reason.
+
+                    Tests that need the part itself (ID, wait and volume benchmarks) take the
+                    services lock and use the device from FlashServ_GetDevice, invalidating the
+                    page cache over what they program or erase.
+
+                    Raw programs and erases are kept to the scratch region of the flash layout.
+
+                    The commit, FTL, log, KV and time-series tests mount their store on a stand-in
+                    area of scratch with its MountAt function, and mount the real region again when
+                    done. They are only built with FLASH_SELF_TEST defined, for bench boards, as are
+                    the read, CRC, wait and volume benchmarks and the benchmark suite, which take
+                    seconds at boot and load the accelerometer.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+#include "flash-selftest-api.h"
+#include "flash-services-api.h"
+#include "flash-bench-api.h"
+#include "flash-cache-api.h"
+#include "flash-ftl-api.h"
+#include "flash-log-api.h"
+#include "flash-kv-api.h"
+#include "flash-commit-api.h"
+#include "flash-ts-api.h"
+#include "flash-volume-api.h"
+#include "flash-sim-api.h"
+#include "flash-layout.h"
+
+#include "accel-services-api.h"
+#include "spi/spi-core.h"
+#include "timing/timing.h"
+#include "crc/crc.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define FLASH_TARGET_ADDR 0x00000000
+#define RANDOM_SEED 106
+#define TRANS_LENGTH 16
+
+#define FLASH_BENCH_ACCEL_LOAD_MS 5 // Accel read period during the loaded mixed case
+
+#define FLASH_BENCH_READ_COUNT 256
+#define FLASH_BENCH_READ_BYTES 16
+#define FLASH_BENCH_READ_STRIDE 0x1F30 // Spread reads over different pages and sectors
+#define US_PER_SECOND 1000000
+
+#define CACHE_BENCH_READ_COUNT 4096
+#define CACHE_BENCH_HOT_PERCENT 80 // Share of reads going to the hot pages
+#define CACHE_BENCH_HOT_PAGES 32
+#define BITS_PER_BYTE 8
+
+#define FLASH_LARGE_WRITE_TEST_ADDR 0x000010F3 // Unaligned, spans several pages
+#define FLASH_LARGE_WRITE_TEST_LENGTH 700
+
+#define SIM_WRITE_TEST_BYTES (8 * PAGE_OFFSET)      // Contents of the simulated part
+#define SIM_WRITE_TEST_MAX_LENGTH (5 * PAGE_OFFSET) // Longest write of the cases
+
+#define FLASH_SUSPEND_TEST_ERASE_ADDR 0x00002000
+#define FLASH_SUSPEND_TEST_READ_ADDR 0x00003000
+#define FLASH_SUSPEND_TEST_POLL_MS 1
+
+#define FLASH_ERASE_RANGE_TEST_START 0x00007000 // Sector + 32KB block + sector
+#define FLASH_ERASE_RANGE_TEST_END 0x00011000
+
+#define FTL_TEST_START FLASH_LAYOUT_SCRATCH_START // Stand-in FTL region
+#define FTL_TEST_SIZE FLASH_LAYOUT_SCRATCH_SIZE
+#define FTL_TEST_PAGES (((FTL_TEST_SIZE / SECTOR_OFFSET) - FTL_SPARE_SECTORS) * FTL_PAGES_PER_SECTOR)
+#define FTL_BENCH_PASSES 2       // Logical capacity written this many times
+#define FTL_BENCH_HOT_PERCENT 80 // Share of random writes going to the hot fifth of pages
+#define FTL_BENCH_HOT_PAGES (FTL_TEST_PAGES / 5)
+
+#define LOG_BENCH_RECORD_LENGTH 48 // Typical telemetry sample
+#define LOG_BENCH_BYTES 0x10000    // Payload appended, also programmed raw for comparison
+#define LOG_TEST_START (FLASH_LAYOUT_SCRATCH_START + (FLASH_LAYOUT_SCRATCH_SIZE / 2)) // Past the raw programs
+#define LOG_TEST_SIZE (FLASH_LAYOUT_SCRATCH_SIZE / 2)
+
+#define WRITE_BUFFER_BENCH_BYTES 0x8000 // Per path, each in its own half of a 64KB block
+#define WRITE_BUFFER_BENCH_MIN_RECORD 6
+#define WRITE_BUFFER_BENCH_MAX_RECORD 64
+
+#define CRC_BENCH_PASSES 16 // Times the bench buffer is checksummed per path
+
+#define WAIT_BENCH_PAGES 64 // Pages programmed per wait mode, in the first 32KB of scratch
+
+#define VOLUME_BENCH_BYTES 0x20000 // Erased, programmed and read per chip count
+
+#define COMMIT_TEST_START FLASH_LAYOUT_SCRATCH_START // Stand-in commit area
+#define COMMIT_TEST_LENGTH 9000                      // Spans three sectors
+#define COMMIT_TEST_CHUNK 500                        // Appended per call, not page aligned
+#define COMMIT_TEST_OLD_SEED 0xA0
+#define COMMIT_TEST_NEW_SEED 0x5B
+#define COMMIT_TEST_FILL_LENGTH 64                       // One sector erase per commit
+#define COMMIT_TEST_MAX_FILLS ((SECTOR_OFFSET / 16) + 1) // More commits than a record sector can take
+
+#define TS_TEST_START FLASH_LAYOUT_SCRATCH_START // Stand-in time-series region
+#define TS_BENCH_SAMPLES 5000         // One per second, about 40 chunks
+#define TS_BENCH_FIRST_TS 32400       // 09:00:00 in seconds of the day
+#define TS_BENCH_QUERY_START_TS 36000 // 10:00:00
+#define TS_BENCH_QUERY_END_TS 36300   // 10:05:00
+
+#define KV_TEST_START FLASH_LAYOUT_SCRATCH_START // Stand-in KV region
+#define KV_BENCH_SMALL_KEYS 1000
+#define KV_BENCH_LARGE_KEYS 2000 // Close to FLASH_KV_MAX_KEYS
+#define KV_BENCH_KEY_BASE 0x1000
+#define KV_COLLECT_TEST_KEYS 16
+#define KV_COLLECT_TEST_KEY_BASE 0x2000
+#define KV_COLLECT_TEST_BAD_KEY (KV_COLLECT_TEST_KEY_BASE + (KV_COLLECT_TEST_KEYS / 2))
+
+#if (SIM_WRITE_TEST_BYTES + SIM_WRITE_TEST_MAX_LENGTH + PAGE_OFFSET) > SECTOR_OFFSET
+#error "Simulated write test doesn't fit the bench buffer"
+#endif
+
+#if (LOG_BENCH_BYTES > (FLASH_LAYOUT_SCRATCH_SIZE / 2)) || ((LOG_BENCH_BYTES * 2) > LOG_TEST_SIZE)
+#error "Scratch region too small for the log benchmark"
+#endif
+
+#if FLASH_LAYOUT_SCRATCH_SIZE < FLASH_LAYOUT_TS_SIZE
+#error "Scratch region too small for the time-series test area"
+#endif
+
+#if FLASH_LAYOUT_SCRATCH_SIZE < FLASH_LAYOUT_KV_SIZE
+#error "Scratch region too small for the KV test area"
+#endif
+
+#if FLASH_LAYOUT_SCRATCH_SIZE < FLASH_LAYOUT_COMMIT_SIZE
+#error "Scratch region too small for the commit test area"
+#endif
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Internal Private Data
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Scratch buffer for benchmarks, kept off the flash task stack
+static uint8_t xFlashBenchBuffer[SECTOR_OFFSET];
+
+/*** Private Functions ***/
+
+/*
+ * Simple flash ID test
+ */
+static bool flashIdTest(void)
+{
+    uint32_t flashId = 0;
+    uint8_t resId = 0;
+    uint16_t remsId = 0;
+
+    flashReturnMsg_t msg = FLASH_WRITE_REG_FAILED;
+
+    // Read Manufacturer ID, Memory Type, and Memory Density
+    msg = MX25_RDID(FlashServ_GetDevice(), &flashId);
+
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        return false;
+    }
+    else
+    {
+        if (flashId != FLASH_DEVICE_ID)
+        {
+            printf("Flash ID invalid.\n");
+        }
+    }
+
+    // Read Electronic ID
+    msg = MX25_RES(FlashServ_GetDevice(), &resId);
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        return false;
+    }
+    else
+    {
+        if (resId != ELECTRONIC_ID)
+        {
+            printf("Electronic ID invalid.\n");
+        }
+    }
+
+    // Read Manufacturer ID and Device ID
+    /* Decide remsId order. 0: { manufacturer id, device id }
+                             1: { device id,  manufacturer id } */
+    FlashStatus_t flashState = {0};
+    flashState.ArrangeOpt = 0;
+    msg = MX25_REMS(FlashServ_GetDevice(), &remsId, &flashState);
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        return false;
+    }
+    else
+    {
+        if (flashState.ArrangeOpt)
+        {
+            if (remsId != REMS_ID_1)
+            {
+                printf("REMS ID invalid.\n");
+                return false;
+            }
+        }
+        else
+        {
+            if (remsId != REMS_ID_0)
+            {
+                printf("REMS ID invalid.\n");
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Simple flash read/write test
+ */
+static bool flashReadWriteTest(void)
+{
+    flashReturnMsg_t msg = FLASH_WRITE_REG_FAILED;
+
+    uint32_t flashAddr = FLASH_TARGET_ADDR;
+    uint32_t transLen = TRANS_LENGTH;
+    uint8_t memoryAddr[TRANS_LENGTH] = {0};
+    uint8_t memoryAddrCmp[TRANS_LENGTH] = {0};
+
+    uint16_t i = 0;
+
+    // Generate data to write to flash
+    // Seed the random number generator
+    srand(RANDOM_SEED);
+    for (i = 0; i < transLen; i = i + 1)
+    {
+        // Generate random byte data
+        memoryAddr[i] = rand() % 256;
+    }
+
+    // Erase 4K sector of flash memory
+    msg = MX25_SE(FlashServ_GetDevice(), flashAddr);
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        printf("Failed to erase flash memory.\n");
+        return false;
+    }
+
+    // Program data to flash memory
+    msg = MX25_PP(FlashServ_GetDevice(), flashAddr, memoryAddr, transLen);
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        printf("Failed to program flash memory.\n");
+        return false;
+    }
+
+    msg = MX25_READ(FlashServ_GetDevice(), flashAddr, memoryAddrCmp, transLen);
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        printf("Failed to read flash memory.\n");
+        return false;
+    }
+
+    // Compare original data and flash data
+    for (i = 0; i < (transLen); i = i + 1)
+    {
+        if (memoryAddr[i] != memoryAddrCmp[i])
+        {
+            printf("Data written to flash memory doesn't match data read.\n");
+            return false;
+        }
+    }
+
+    // Erase 4K sector of flash memory
+    msg = MX25_SE(FlashServ_GetDevice(), flashAddr);
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        printf("Failed to reset flash memory.\n");
+        return false;
+    }
+
+    return true;
+}
+
+#ifdef FLASH_SELF_TEST
+/*
+ * Small read IOPS benchmark.
+ * Also times the previous RDSCUR + READ sequence per read so the gain from caching
+ * the address mode at init can be compared on the same hardware.
+ */
+static void flashSmallReadBenchmark(void)
+{
+    uint8_t readBuffer[FLASH_BENCH_READ_BYTES] = {0};
+    uint8_t securityReg = 0;
+    uint32_t flashAddr = 0;
+    uint32_t startCycles = 0;
+    uint32_t legacyUs = 0;
+    uint32_t cachedUs = 0;
+    uint32_t i = 0;
+
+    // Before: address mode read from the security register ahead of every read
+    startCycles = TIMING_GetCycles();
+    for (i = 0; i < FLASH_BENCH_READ_COUNT; i++)
+    {
+        flashAddr = (i * FLASH_BENCH_READ_STRIDE) % FLASH_SIZE;
+        MX25_RDSCUR(FlashServ_GetDevice(), &securityReg);
+        MX25_READ(FlashServ_GetDevice(), flashAddr, readBuffer, FLASH_BENCH_READ_BYTES);
+    }
+    legacyUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+
+    // After: address mode cached at init
+    startCycles = TIMING_GetCycles();
+    for (i = 0; i < FLASH_BENCH_READ_COUNT; i++)
+    {
+        flashAddr = (i * FLASH_BENCH_READ_STRIDE) % FLASH_SIZE;
+        MX25_READ(FlashServ_GetDevice(), flashAddr, readBuffer, FLASH_BENCH_READ_BYTES);
+    }
+    cachedUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+
+    if ((legacyUs == 0) || (cachedUs == 0))
+    {
+        return;
+    }
+
+    printf("Flash %d byte reads: RDSCUR+READ %lu IOPS, cached mode READ %lu IOPS\n",
+           FLASH_BENCH_READ_BYTES,
+           (unsigned long)((FLASH_BENCH_READ_COUNT * US_PER_SECOND) / legacyUs),
+           (unsigned long)((FLASH_BENCH_READ_COUNT * US_PER_SECOND) / cachedUs));
+}
+
+/*
+ * Page cache benchmark.
+ * Replays the same skewed trace of small reads with the cache off and on. Most reads go to a
+ * few hot pages, like metadata lookups, the rest are spread over the whole device.
+ */
+static void flashPageCacheBenchmark(void)
+{
+    FlashCacheStats_t stats = {0};
+    uint8_t readBuffer[FLASH_BENCH_READ_BYTES] = {0};
+    uint32_t elapsedUs[2] = {0};
+    uint32_t flashAddr = 0;
+    uint32_t startCycles = 0;
+    uint32_t pass = 0;
+    uint32_t i = 0;
+
+    for (pass = 0; pass < 2; pass++)
+    {
+        FlashCache_SetEnabled(pass == 1);
+        FlashCache_ResetStats();
+        srand(RANDOM_SEED);
+
+        startCycles = TIMING_GetCycles();
+        for (i = 0; i < CACHE_BENCH_READ_COUNT; i++)
+        {
+            if ((uint32_t)(rand() % 100) < CACHE_BENCH_HOT_PERCENT)
+            {
+                flashAddr = ((rand() % CACHE_BENCH_HOT_PAGES) * FLASH_BENCH_READ_STRIDE) % FLASH_SIZE;
+            }
+            else
+            {
+                flashAddr = rand() % (FLASH_SIZE - FLASH_BENCH_READ_BYTES);
+            }
+
+            FlashServ_Read(flashAddr, readBuffer, FLASH_BENCH_READ_BYTES);
+        }
+        elapsedUs[pass] = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+    }
+
+    FlashCache_GetStats(&stats);
+    if ((stats.Hits + stats.Misses) == 0)
+    {
+        return;
+    }
+
+    printf("Flash page cache: %lu byte reads avg %lu.%02lu us uncached, %lu.%02lu us cached, %lu%% hits\n",
+           (unsigned long)FLASH_BENCH_READ_BYTES,
+           (unsigned long)(elapsedUs[0] / CACHE_BENCH_READ_COUNT),
+           (unsigned long)(((elapsedUs[0] % CACHE_BENCH_READ_COUNT) * 100) / CACHE_BENCH_READ_COUNT),
+           (unsigned long)(elapsedUs[1] / CACHE_BENCH_READ_COUNT),
+           (unsigned long)(((elapsedUs[1] % CACHE_BENCH_READ_COUNT) * 100) / CACHE_BENCH_READ_COUNT),
+           (unsigned long)((stats.Hits * 100) / (stats.Hits + stats.Misses)));
+}
+
+/*
+ * Sequential read throughput benchmark.
+ * Reads the whole device in sector sized commands and compares against the bus wire speed.
+ */
+static void flashSequentialReadBenchmark(void)
+{
+    uint32_t flashAddr = 0;
+    uint32_t startCycles = 0;
+    uint32_t elapsedUs = 0;
+    flashReturnMsg_t msg = FLASH_OPERATION_FAILED;
+
+    startCycles = TIMING_GetCycles();
+    for (flashAddr = 0; flashAddr < FLASH_SIZE; flashAddr += sizeof(xFlashBenchBuffer))
+    {
+        msg = MX25_READ(FlashServ_GetDevice(), flashAddr, xFlashBenchBuffer, sizeof(xFlashBenchBuffer));
+        if (msg != FLASH_OPERATION_SUCCESS)
+        {
+            printf("Failed to read flash at 0x%lX\n", (unsigned long)flashAddr);
+            return;
+        }
+    }
+    elapsedUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+
+    if (elapsedUs == 0)
+    {
+        return;
+    }
+
+    // bytes/us is MB/s, scale to kB/s to keep integer precision
+    printf("Flash full read: %lu ms, %lu kB/s (wire speed %lu kB/s)\n",
+           (unsigned long)(elapsedUs / 1000),
+           (unsigned long)(((uint64_t)FLASH_SIZE * 1000) / elapsedUs),
+           (unsigned long)(SPI_GetClockHz(FlashServ_GetDevice()->Bus) / BITS_PER_BYTE / 1000));
+}
+
+/*
+ * CRC throughput benchmark.
+ * Checksums the same buffer with the software table and the CRC unit, then checks a
+ * copy of it on the flash with FlashServ_VerifyCrc, which streams it through the unit.
+ */
+static bool flashCrcBenchmark(void)
+{
+    uint32_t address = FLASH_LAYOUT_SCRATCH_START;
+    uint32_t softwareCrc = 0;
+    uint32_t hardwareCrc = 0;
+    uint32_t startCycles = 0;
+    uint32_t softwareUs = 0;
+    uint32_t hardwareUs = 0;
+    uint32_t verifyUs = 0;
+    uint32_t i = 0;
+
+    srand(RANDOM_SEED);
+    for (i = 0; i < sizeof(xFlashBenchBuffer); i++)
+    {
+        xFlashBenchBuffer[i] = (uint8_t)rand();
+    }
+
+    startCycles = TIMING_GetCycles();
+    for (i = 0; i < CRC_BENCH_PASSES; i++)
+    {
+        softwareCrc = CRC_AccumulateSoftware(CRC_INITIAL_VALUE, xFlashBenchBuffer, sizeof(xFlashBenchBuffer));
+    }
+    softwareUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+
+    startCycles = TIMING_GetCycles();
+    for (i = 0; i < CRC_BENCH_PASSES; i++)
+    {
+        hardwareCrc = CRC_Compute(xFlashBenchBuffer, sizeof(xFlashBenchBuffer));
+    }
+    hardwareUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+
+    if (hardwareCrc != softwareCrc)
+    {
+        printf("CRC unit result 0x%08lX doesn't match software 0x%08lX\n", (unsigned long)hardwareCrc,
+               (unsigned long)softwareCrc);
+        return false;
+    }
+
+    if ((FlashServ_EraseRange(address, address + SECTOR_OFFSET, NULL) != FLASH_OPERATION_SUCCESS) ||
+        (FlashServ_Write(address, xFlashBenchBuffer, sizeof(xFlashBenchBuffer)) != FLASH_OPERATION_SUCCESS))
+    {
+        printf("Failed to write CRC benchmark data\n");
+        return false;
+    }
+
+    startCycles = TIMING_GetCycles();
+    if (!FlashServ_VerifyCrc(address, sizeof(xFlashBenchBuffer), softwareCrc))
+    {
+        printf("Flash CRC verify failed on good data\n");
+        return false;
+    }
+    verifyUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+
+    // A single flipped bit must be caught
+    if (FlashServ_VerifyCrc(address, sizeof(xFlashBenchBuffer), softwareCrc ^ 1U))
+    {
+        printf("Flash CRC verify passed a wrong CRC\n");
+        return false;
+    }
+
+    if ((softwareUs == 0) || (hardwareUs == 0) || (verifyUs == 0))
+    {
+        return true;
+    }
+
+    // bytes/us is MB/s, scale to kB/s to keep integer precision
+    printf("CRC32: software %lu kB/s, CRC unit %lu kB/s, flash verify %lu kB/s\n",
+           (unsigned long)(((uint64_t)sizeof(xFlashBenchBuffer) * CRC_BENCH_PASSES * 1000) / softwareUs),
+           (unsigned long)(((uint64_t)sizeof(xFlashBenchBuffer) * CRC_BENCH_PASSES * 1000) / hardwareUs),
+           (unsigned long)(((uint64_t)sizeof(xFlashBenchBuffer) * 1000) / verifyUs));
+
+    return true;
+}
+
+/*
+ * Busy wait benchmark.
+ * Programs the same number of pages with the tick polled wait and the adaptive wait and
+ * compares the time per page program and the status reads each wait costs.
+ */
+static bool flashWaitBenchmark(void)
+{
+    FlashWaitStats_t stats = {0};
+    uint32_t endAddress = FLASH_LAYOUT_SCRATCH_START + (2 * WAIT_BENCH_PAGES * PAGE_OFFSET);
+    uint32_t baseAddress = 0;
+    uint32_t startCycles = 0;
+    uint32_t elapsedUs[2] = {0};
+    uint32_t polls[2] = {0};
+    uint32_t pass = 0;
+    uint32_t page = 0;
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if (FlashServ_EraseRange(FLASH_LAYOUT_SCRATCH_START, endAddress, NULL) != FLASH_OPERATION_SUCCESS)
+    {
+        printf("Failed to erase wait benchmark area\n");
+        return false;
+    }
+
+    memset(xFlashBenchBuffer, 0xA5, PAGE_OFFSET);
+
+    if (!FlashServ_Lock())
+    {
+        return false;
+    }
+
+    // Pass 0 polls every tick, pass 1 sleeps on the learned program time
+    for (pass = 0; (pass < 2) && (msg == FLASH_OPERATION_SUCCESS); pass++)
+    {
+        MX25_SetAdaptiveWait(FlashServ_GetDevice(), pass == 1);
+        MX25_GetWaitStats(FlashServ_GetDevice(), FLASH_WAIT_PROGRAM, &stats);
+        polls[pass] = stats.Polls;
+        baseAddress = FLASH_LAYOUT_SCRATCH_START + (pass * WAIT_BENCH_PAGES * PAGE_OFFSET);
+
+        startCycles = TIMING_GetCycles();
+        for (page = 0; (page < WAIT_BENCH_PAGES) && (msg == FLASH_OPERATION_SUCCESS); page++)
+        {
+            msg = MX25_PP(FlashServ_GetDevice(), baseAddress + (page * PAGE_OFFSET), xFlashBenchBuffer, PAGE_OFFSET);
+        }
+        elapsedUs[pass] = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+
+        MX25_GetWaitStats(FlashServ_GetDevice(), FLASH_WAIT_PROGRAM, &stats);
+        polls[pass] = stats.Polls - polls[pass];
+    }
+
+    MX25_SetAdaptiveWait(FlashServ_GetDevice(), true);
+    FlashServ_Unlock();
+
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        printf("Failed to program wait benchmark page\n");
+        return false;
+    }
+
+    printf("Page program wait: tick poll %lu us/page %lu polls, adaptive %lu us/page %lu polls "
+           "(learned %lu us, min %lu max %lu)\n",
+           (unsigned long)(elapsedUs[0] / WAIT_BENCH_PAGES), (unsigned long)polls[0],
+           (unsigned long)(elapsedUs[1] / WAIT_BENCH_PAGES), (unsigned long)polls[1],
+           (unsigned long)stats.AverageUs, (unsigned long)stats.MinUs, (unsigned long)stats.MaxUs);
+
+    return true;
+}
+
+
+// Helper function for a volume part on an MX25 device: read
+static flashReturnMsg_t flashVolumeMx25Read(void *context, uint32_t address, uint8_t *data, uint32_t length)
+{
+    return MX25_READ(context, address, data, length);
+}
+
+// Helper function for a volume part on an MX25 device: start a page program
+static flashReturnMsg_t flashVolumeMx25ProgramStart(void *context, uint32_t address, const uint8_t *data,
+                                                    uint32_t length)
+{
+    return MX25_PPStart(context, address, (uint8_t *)data, length);
+}
+
+// Helper function for a volume part on an MX25 device: start an erase, counted in the sector health
+static flashReturnMsg_t flashVolumeMx25EraseStart(void *context, uint32_t address, uint32_t size)
+{
+    flashReturnMsg_t msg = MX25_EraseStart(context, address, size);
+
+    FlashServ_CountErase(address, size, msg);
+
+    return msg;
+}
+
+// Helper function for a volume part on an MX25 device: wait for the cycle and check its result
+static flashReturnMsg_t flashVolumeMx25Wait(void *context)
+{
+    flashReturnMsg_t msg = MX25_WaitReady(context, MX25_GetGeometry(context)->Erase[0].MaxMs);
+
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        msg = MX25_CheckResult(context);
+    }
+
+    return msg;
+}
+
+// Helper function to turn a volume benchmark time into kB/s
+static uint32_t flashVolumeBenchKBps(uint32_t elapsedUs)
+{
+    if (elapsedUs == 0)
+    {
+        return 0;
+    }
+
+    return (uint32_t)(((uint64_t)VOLUME_BENCH_BYTES * 1000) / elapsedUs);
+}
+
+/*
+ * Erase, program and read back the start of a volume, timing each step on the virtual
+ * clock for simulated parts or the cycle counter for real ones. elapsedUs gets the erase,
+ * program and read times in that order. Real parts are read back and compared.
+ */
+static bool flashVolumeBenchRun(FlashVolume_t *volume, bool simulated, uint32_t *elapsedUs)
+{
+    const uint32_t chunkLength = sizeof(xFlashBenchBuffer) / 2;
+    uint8_t *writeData = xFlashBenchBuffer;
+    uint8_t *readData = &xFlashBenchBuffer[chunkLength];
+    uint32_t offset = 0;
+    uint32_t start = 0;
+    uint32_t step = 0;
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    memset(writeData, 0x3C, chunkLength);
+
+    for (step = 0; (step < 3) && (msg == FLASH_OPERATION_SUCCESS); step++)
+    {
+        start = simulated ? FlashSim_GetNowUs() : TIMING_GetCycles();
+
+        if (step == 0)
+        {
+            msg = FlashVolume_Erase(volume, 0, VOLUME_BENCH_BYTES);
+        }
+
+        for (offset = 0; (step > 0) && (offset < VOLUME_BENCH_BYTES) && (msg == FLASH_OPERATION_SUCCESS);
+             offset += chunkLength)
+        {
+            if (step == 1)
+            {
+                msg = FlashVolume_Program(volume, offset, writeData, chunkLength);
+            }
+            else
+            {
+                msg = FlashVolume_Read(volume, offset, readData, chunkLength);
+                if ((msg == FLASH_OPERATION_SUCCESS) && !simulated && (memcmp(readData, writeData, chunkLength) != 0))
+                {
+                    printf("Flash volume read back mismatch at 0x%lX\n", (unsigned long)offset);
+                    msg = FLASH_OPERATION_FAILED;
+                }
+            }
+        }
+
+        if (msg == FLASH_OPERATION_SUCCESS)
+        {
+            msg = FlashVolume_Sync(volume);
+        }
+
+        elapsedUs[step] = simulated ? (FlashSim_GetNowUs() - start) : TIMING_CyclesToUs(TIMING_GetCycles() - start);
+    }
+
+    return msg == FLASH_OPERATION_SUCCESS;
+}
+
+/*
+ * Striped volume benchmark.
+ * The board has a single flash part, so the scaling with the number of parts is measured
+ * on simulated parts with the SPI clock and typical timings of the part on the board.
+ * The same run on the real part checks the model: its rates should be close to the
+ * simulated single part.
+ */
+static bool flashVolumeBenchmark(void)
+{
+    static FlashVolume_t volume;
+    FlashVolumeChip_t chips[FLASH_VOLUME_MAX_CHIPS];
+    FlashVolumeStats_t stats = {0};
+    uint32_t elapsedUs[3] = {0};
+    uint32_t singleKBps = 0;
+    uint32_t programKBps = 0;
+    uint32_t chipCount = 0;
+    uint32_t chip = 0;
+    bool result = false;
+
+    for (chip = 0; chip < FLASH_VOLUME_MAX_CHIPS; chip++)
+    {
+        FlashSim_GetVolumeChip(chip, &chips[chip]);
+    }
+
+    for (chipCount = 1; chipCount <= FLASH_VOLUME_MAX_CHIPS; chipCount *= 2)
+    {
+        FlashSim_Reset(MX25_GetGeometry(FlashServ_GetDevice()), SPI_GetClockHz(FlashServ_GetDevice()->Bus));
+
+        if (!FlashVolume_Init(&volume, chips, chipCount, FLASH_LAYOUT_SCRATCH_START, FLASH_LAYOUT_SCRATCH_SIZE) ||
+            !flashVolumeBenchRun(&volume, true, elapsedUs))
+        {
+            printf("Flash volume benchmark failed on %lu simulated parts\n", (unsigned long)chipCount);
+            return false;
+        }
+
+        FlashVolume_GetStats(&volume, &stats);
+        programKBps = flashVolumeBenchKBps(elapsedUs[1]);
+        if (chipCount == 1)
+        {
+            singleKBps = programKBps;
+        }
+
+        printf("Flash volume, %lu simulated parts: program %lu kB/s, erase %lu kB/s, read %lu kB/s, "
+               "%lu overlapped starts\n",
+               (unsigned long)chipCount, (unsigned long)programKBps,
+               (unsigned long)flashVolumeBenchKBps(elapsedUs[0]), (unsigned long)flashVolumeBenchKBps(elapsedUs[2]),
+               (unsigned long)stats.OverlappedStarts);
+    }
+
+    // Striping has to pay off once parts can overlap
+    result = programKBps > singleKBps;
+
+    chips[0].Context = FlashServ_GetDevice();
+    chips[0].Read = flashVolumeMx25Read;
+    chips[0].ProgramStart = flashVolumeMx25ProgramStart;
+    chips[0].EraseStart = flashVolumeMx25EraseStart;
+    chips[0].Wait = flashVolumeMx25Wait;
+
+    if (!FlashVolume_Init(&volume, chips, 1, FLASH_LAYOUT_SCRATCH_START, FLASH_LAYOUT_SCRATCH_SIZE) ||
+        !FlashServ_Lock())
+    {
+        return false;
+    }
+
+    if (!flashVolumeBenchRun(&volume, false, elapsedUs))
+    {
+        result = false;
+    }
+
+    FlashServ_Unlock();
+    FlashCache_Invalidate(FLASH_LAYOUT_SCRATCH_START, VOLUME_BENCH_BYTES);
+
+    printf("Flash volume, 1 part on the board: program %lu kB/s, erase %lu kB/s, read %lu kB/s\n",
+           (unsigned long)flashVolumeBenchKBps(elapsedUs[1]), (unsigned long)flashVolumeBenchKBps(elapsedUs[0]),
+           (unsigned long)flashVolumeBenchKBps(elapsedUs[2]));
+
+    return result;
+}
+#endif
+
+// Reference SFDP images for the self-test, built from each part's datasheet parameters
+static const uint8_t xSfdpImageMx25v1635f[] = {
+    0x53, 0x46, 0x44, 0x50, 0x06, 0x01, 0x00, 0xFF, 0x00, 0x06, 0x01, 0x10,
+    0x30, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xE5, 0x20, 0xF1, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x44, 0xEB, 0x08, 0x6B,
+    0x08, 0x3B, 0x04, 0xBB, 0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF,
+    0xFF, 0xFF, 0x00, 0xFF, 0x0C, 0x20, 0x0F, 0x52, 0x10, 0xD8, 0x00, 0xFF,
+    0x84, 0x41, 0xC9, 0x00, 0x83, 0x27, 0x00, 0xB2, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+static const uint8_t xSfdpImageW25q16jv[] = {
+    0x53, 0x46, 0x44, 0x50, 0x06, 0x01, 0x00, 0xFF, 0x00, 0x06, 0x01, 0x10,
+    0x40, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xE5, 0x20, 0xF1, 0xFF, 0xFF, 0xFF, 0xFF, 0x00,
+    0x44, 0xEB, 0x08, 0x6B, 0x08, 0x3B, 0x04, 0xBB, 0xFE, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0x00, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0x0C, 0x20, 0x0F, 0x52,
+    0x10, 0xD8, 0x00, 0xFF, 0x23, 0x3A, 0xA5, 0x00, 0x83, 0x25, 0x00, 0xB3,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+// JESD216 rev 1.0 table: no timings or page size, only 4KB and 64KB erases
+static const uint8_t xSfdpImageJesd216[] = {
+    0x53, 0x46, 0x44, 0x50, 0x00, 0x01, 0x00, 0xFF, 0x00, 0x00, 0x01, 0x09,
+    0x30, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xE5, 0x20, 0x89, 0xFF, 0xFF, 0xFF, 0x7F, 0x00, 0x44, 0xEB, 0x08, 0x6B,
+    0x08, 0x3B, 0x04, 0xBB, 0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF,
+    0xFF, 0xFF, 0x00, 0xFF, 0x0C, 0x20, 0x10, 0xD8, 0x00, 0xFF, 0x00, 0xFF,
+};
+
+/*
+ * Parse reference SFDP images and check the geometry derived from each
+ */
+static bool flashSfdpTest(void)
+{
+    typedef struct
+    {
+        const uint8_t *Image;
+        uint32_t Length;
+        uint32_t DeviceSize;
+        uint32_t EraseSizes[SFDP_ERASE_TYPES];
+        uint32_t SectorEraseTypicalMs;
+        uint32_t SectorEraseMaxMs;
+        uint32_t ProgramMaxUs;
+        uint8_t FastReadModes;
+    } sfdpCase_t;
+
+    const sfdpCase_t cases[] = {
+        {xSfdpImageMx25v1635f, sizeof(xSfdpImageMx25v1635f), 0x200000, {BLOCK_OFFSET, BLOCK_32K_OFFSET, SECTOR_OFFSET, 0},
+         25, 250, 4096, SFDP_READ_1_1_2 | SFDP_READ_1_2_2 | SFDP_READ_1_1_4 | SFDP_READ_1_4_4},
+        {xSfdpImageW25q16jv, sizeof(xSfdpImageW25q16jv), 0x200000, {BLOCK_OFFSET, BLOCK_32K_OFFSET, SECTOR_OFFSET, 0},
+         48, 384, 3072, SFDP_READ_1_1_2 | SFDP_READ_1_2_2 | SFDP_READ_1_1_4 | SFDP_READ_1_4_4},
+        // Without timings in the table the defaults are kept
+        {xSfdpImageJesd216, sizeof(xSfdpImageJesd216), 0x100000, {BLOCK_OFFSET, SECTOR_OFFSET, 0, 0},
+         tSE_TYP, SECTOR_ERASE_CYCLE_TIME, PAGE_PROGRAM_CYCLE_TIME * 1000, SFDP_READ_1_1_2},
+    };
+    const FlashEraseType_t defaultErase[SFDP_ERASE_TYPES] = {
+        {BLOCK_OFFSET, FLASH_CMD_BE, tBE_TYP, BLOCK_ERASE_CYCLE_TIME},
+        {BLOCK_32K_OFFSET, FLASH_CMD_BE32K, tBE32K_TYP, BLOCK_32K_ERASE_CYCLE_TIME},
+        {SECTOR_OFFSET, FLASH_CMD_SE, tSE_TYP, SECTOR_ERASE_CYCLE_TIME},
+    };
+    FlashGeometry_t geometry = {0};
+    const FlashEraseType_t *sectorErase = NULL;
+    uint8_t image[sizeof(xSfdpImageMx25v1635f)];
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    for (i = 0; i < (sizeof(cases) / sizeof(cases[0])); i++)
+    {
+        memset(&geometry, 0, sizeof(geometry));
+        memcpy(geometry.Erase, defaultErase, sizeof(defaultErase));
+        geometry.PageSize = PAGE_OFFSET;
+        geometry.ProgramMaxUs = PAGE_PROGRAM_CYCLE_TIME * 1000;
+
+        if (!SFDP_Parse(cases[i].Image, cases[i].Length, &geometry) || (geometry.DeviceSize != cases[i].DeviceSize) ||
+            (geometry.PageSize != PAGE_OFFSET) || (geometry.ProgramMaxUs != cases[i].ProgramMaxUs) ||
+            (geometry.FastReadModes != cases[i].FastReadModes))
+        {
+            printf("SFDP image %lu parsed wrong\n", (unsigned long)i);
+            return false;
+        }
+
+        for (j = 0; j < SFDP_ERASE_TYPES; j++)
+        {
+            if (geometry.Erase[j].Size != cases[i].EraseSizes[j])
+            {
+                printf("SFDP image %lu erase type %lu is %lu bytes\n", (unsigned long)i, (unsigned long)j,
+                       (unsigned long)geometry.Erase[j].Size);
+                return false;
+            }
+        }
+
+        sectorErase = SFDP_FindErase(&geometry, SECTOR_OFFSET);
+        if ((sectorErase == NULL) || (sectorErase->Opcode != FLASH_CMD_SE) ||
+            (sectorErase->TypicalMs != cases[i].SectorEraseTypicalMs) ||
+            (sectorErase->MaxMs != cases[i].SectorEraseMaxMs))
+        {
+            printf("SFDP image %lu sector erase timing wrong\n", (unsigned long)i);
+            return false;
+        }
+    }
+
+    // A damaged signature or a table pointer past the end is rejected
+    memcpy(image, xSfdpImageMx25v1635f, sizeof(image));
+    image[0] ^= 0x01;
+    if (SFDP_Parse(image, sizeof(image), &geometry) ||
+        SFDP_Parse(xSfdpImageMx25v1635f, SFDP_HEADER_LENGTH + 8, &geometry))
+    {
+        printf("SFDP parser accepted a bad image\n");
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Check the erase planner against known ranges
+ */
+static bool flashErasePlannerTest(void)
+{
+    typedef struct
+    {
+        uint32_t Start;
+        uint32_t End;
+        uint32_t BlockErases;
+        uint32_t Block32KErases;
+        uint32_t SectorErases;
+    } planCase_t;
+
+    const planCase_t cases[] = {
+        {0x00000000, 0x00100000, 16, 0, 0}, // 1MB aligned
+        {0x00000000, FLASH_SIZE, 32, 0, 0}, // Whole device
+        {0x00001000, 0x00020000, 1, 1, 7},  // Sectors up to a 32KB boundary
+        {0x00009000, 0x0001B000, 0, 1, 10}, // 64KB boundary but not a full block
+        {0x00018000, 0x00030000, 1, 1, 0},  // 32KB then 64KB
+        {0x0001F000, 0x00020000, 0, 0, 1},  // Single sector
+        {0x00010000, 0x00010000, 0, 0, 0},  // Empty range
+    };
+    FlashServErasePlan_t plan = {0};
+    uint32_t i = 0;
+
+    for (i = 0; i < (sizeof(cases) / sizeof(cases[0])); i++)
+    {
+        if (!FlashServ_PlanErase(cases[i].Start, cases[i].End, &plan) ||
+            (plan.BlockErases != cases[i].BlockErases) ||
+            (plan.Block32KErases != cases[i].Block32KErases) ||
+            (plan.SectorErases != cases[i].SectorErases))
+        {
+            printf("Erase plan mismatch for 0x%lX-0x%lX\n", (unsigned long)cases[i].Start,
+                   (unsigned long)cases[i].End);
+            return false;
+        }
+    }
+
+    // Unaligned ranges are rejected
+    if (FlashServ_PlanErase(0x00000100, 0x00001000, &plan) ||
+        FlashServ_PlanErase(0x00001000, FLASH_SIZE + SECTOR_OFFSET, &plan))
+    {
+        printf("Erase planner accepted an invalid range\n");
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Erase a range that needs all but the 64KB erase and confirm it reads back blank
+ */
+static bool flashEraseRangeTest(void)
+{
+    FlashServErasePlan_t plan = {0};
+    uint8_t marker = 0;
+    flashReturnMsg_t msg = FLASH_OPERATION_FAILED;
+    uint32_t address = 0;
+    uint32_t i = 0;
+
+    // Mark the first and last byte so the erase has something to clear
+    msg = FlashServ_Write(FLASH_ERASE_RANGE_TEST_START, &marker, sizeof(marker));
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        msg = FlashServ_Write(FLASH_ERASE_RANGE_TEST_END - 1, &marker, sizeof(marker));
+    }
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        printf("Failed to write flash memory.\n");
+        return false;
+    }
+
+    msg = FlashServ_EraseRange(FLASH_ERASE_RANGE_TEST_START, FLASH_ERASE_RANGE_TEST_END, &plan);
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        printf("Failed to erase flash range.\n");
+        return false;
+    }
+
+    for (address = FLASH_ERASE_RANGE_TEST_START; address < FLASH_ERASE_RANGE_TEST_END; address += sizeof(xFlashBenchBuffer))
+    {
+        msg = FlashServ_Read(address, xFlashBenchBuffer, sizeof(xFlashBenchBuffer));
+        if (msg != FLASH_OPERATION_SUCCESS)
+        {
+            printf("Failed to read flash memory.\n");
+            return false;
+        }
+
+        for (i = 0; i < sizeof(xFlashBenchBuffer); i++)
+        {
+            if (xFlashBenchBuffer[i] != 0xFF)
+            {
+                printf("Flash not erased at 0x%lX\n", (unsigned long)(address + i));
+                return false;
+            }
+        }
+    }
+
+    printf("Flash erase range: %lu x 64KB, %lu x 32KB, %lu x 4KB, estimated %lu ms, actual %lu ms\n",
+           (unsigned long)plan.BlockErases, (unsigned long)plan.Block32KErases,
+           (unsigned long)plan.SectorErases, (unsigned long)plan.EstimatedMs,
+           (unsigned long)plan.ActualMs);
+
+    return true;
+}
+
+/*
+ * Unaligned multi-page write test through FlashServ_Write
+ */
+static bool flashLargeWriteTest(void)
+{
+    uint8_t *writeData = xFlashBenchBuffer;
+    uint8_t *readData = &xFlashBenchBuffer[FLASH_LARGE_WRITE_TEST_LENGTH];
+    uint32_t sectorAddr = FLASH_LARGE_WRITE_TEST_ADDR & ~(SECTOR_OFFSET - 1);
+    flashReturnMsg_t msg = FLASH_OPERATION_FAILED;
+    FlashServWriteStats_t stats = {0};
+    uint32_t i = 0;
+
+    for (i = 0; i < FLASH_LARGE_WRITE_TEST_LENGTH; i++)
+    {
+        writeData[i] = (uint8_t)(i * 7 + 3);
+    }
+
+    // Test region fits in one sector
+    msg = FlashServ_EraseRange(sectorAddr, sectorAddr + SECTOR_OFFSET, NULL);
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        printf("Failed to erase flash memory.\n");
+        return false;
+    }
+
+    msg = FlashServ_Write(FLASH_LARGE_WRITE_TEST_ADDR, writeData, FLASH_LARGE_WRITE_TEST_LENGTH);
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        printf("Failed to write flash memory.\n");
+        return false;
+    }
+
+    msg = FlashServ_Read(FLASH_LARGE_WRITE_TEST_ADDR, readData, FLASH_LARGE_WRITE_TEST_LENGTH);
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        printf("Failed to read flash memory.\n");
+        return false;
+    }
+
+    for (i = 0; i < FLASH_LARGE_WRITE_TEST_LENGTH; i++)
+    {
+        if (writeData[i] != readData[i])
+        {
+            printf("Large write mismatch at offset %lu\n", (unsigned long)i);
+            return false;
+        }
+    }
+
+    FlashServ_GetWriteStats(&stats);
+    printf("Flash write: %lu bytes in %lu pages, %lu.%03lu MB/s\n",
+           (unsigned long)stats.BytesWritten, (unsigned long)stats.PagesProgrammed,
+           (unsigned long)(stats.ThroughputKBps / 1000), (unsigned long)(stats.ThroughputKBps % 1000));
+
+    msg = FlashServ_EraseRange(sectorAddr, sectorAddr + SECTOR_OFFSET, NULL);
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        printf("Failed to reset flash memory.\n");
+        return false;
+    }
+
+    return true;
+}
+
+// Helper function to program a simulated part, split on page boundaries or as one program
+static flashReturnMsg_t flashSimWrite(const FlashVolumeChip_t *part, uint32_t address, const uint8_t *data,
+                                      uint32_t length, bool split)
+{
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+    uint32_t chunkLength = 0;
+    uint32_t offset = 0;
+
+    for (offset = 0; (offset < length) && (msg == FLASH_OPERATION_SUCCESS); offset += chunkLength)
+    {
+        chunkLength = split ? FlashServ_PageChunk(address + offset, length - offset) : length;
+        msg = part->ProgramStart(part->Context, address + offset, &data[offset], chunkLength);
+        if (msg == FLASH_OPERATION_SUCCESS)
+        {
+            msg = part->Wait(part->Context);
+        }
+    }
+
+    return msg;
+}
+
+// Helper function to check a simulated part holds data at address and is erased everywhere else
+static bool flashSimWriteCheck(const FlashVolumeChip_t *part, uint32_t address, const uint8_t *data,
+                               uint32_t length)
+{
+    uint8_t *readData = &xFlashBenchBuffer[SIM_WRITE_TEST_BYTES + SIM_WRITE_TEST_MAX_LENGTH];
+    uint32_t pageAddress = 0;
+    uint32_t byteAddress = 0;
+    uint8_t expected = 0;
+    uint32_t i = 0;
+
+    for (pageAddress = 0; pageAddress < SIM_WRITE_TEST_BYTES; pageAddress += PAGE_OFFSET)
+    {
+        if (part->Read(part->Context, pageAddress, readData, PAGE_OFFSET) != FLASH_OPERATION_SUCCESS)
+        {
+            return false;
+        }
+
+        for (i = 0; i < PAGE_OFFSET; i++)
+        {
+            byteAddress = pageAddress + i;
+            expected = ((byteAddress >= address) && (byteAddress < (address + length))) ? data[byteAddress - address]
+                                                                                        : 0xFF;
+            if (readData[i] != expected)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Helper function to start a simulated MX25 with its contents kept at the start of the bench buffer
+static bool flashSimWriteSetup(FlashVolumeChip_t *part)
+{
+    FlashSim_Reset(MX25_GetGeometry(FlashServ_GetDevice()), SPI_GetClockHz(FlashServ_GetDevice()->Bus));
+    FlashSim_GetVolumeChip(0, part);
+
+    return FlashSim_AttachData(0, xFlashBenchBuffer, SIM_WRITE_TEST_BYTES);
+}
+
+/*
+ * Unaligned multi-page writes against a simulated MX25 that keeps its contents.
+ * Each write is split with FlashServ_PageChunk, as FlashServ_Write splits it, and must
+ * read back exactly with everything around it still erased. The same write issued as one
+ * program must read back corrupt, which shows the model wraps within the page as the part does.
+ */
+static bool flashSimWriteTest(void)
+{
+    typedef struct
+    {
+        uint32_t Address;
+        uint32_t Length;
+    } simWriteCase_t;
+
+    const simWriteCase_t cases[] = {
+        {0x0F3, 700},                       // Unaligned start and end, four pages
+        {0x100, PAGE_OFFSET},               // One whole page
+        {0x1FF, 2},                         // Two bytes across a page boundary
+        {0x010, SIM_WRITE_TEST_MAX_LENGTH}, // Whole pages worth from an unaligned start
+        {0x280, PAGE_OFFSET / 2},           // Up to the end of a page
+    };
+    uint8_t *writeData = &xFlashBenchBuffer[SIM_WRITE_TEST_BYTES];
+    FlashVolumeChip_t part;
+    uint32_t elapsedUs = 0;
+    uint32_t bytes = 0;
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    for (i = 0; i < (sizeof(cases) / sizeof(cases[0])); i++)
+    {
+        for (j = 0; j < cases[i].Length; j++)
+        {
+            writeData[j] = (uint8_t)((j * 13) + i + 1);
+        }
+
+        if (!flashSimWriteSetup(&part) ||
+            (flashSimWrite(&part, cases[i].Address, writeData, cases[i].Length, true) != FLASH_OPERATION_SUCCESS) ||
+            !flashSimWriteCheck(&part, cases[i].Address, writeData, cases[i].Length))
+        {
+            printf("Simulated MX25 write of %lu bytes at 0x%lX failed\n", (unsigned long)cases[i].Length,
+                   (unsigned long)cases[i].Address);
+            return false;
+        }
+
+        elapsedUs += FlashSim_GetNowUs();
+        bytes += cases[i].Length;
+
+        if (FlashServ_PageChunk(cases[i].Address, cases[i].Length) == cases[i].Length)
+        {
+            continue;
+        }
+
+        if (!flashSimWriteSetup(&part) ||
+            (flashSimWrite(&part, cases[i].Address, writeData, cases[i].Length, false) != FLASH_OPERATION_SUCCESS) ||
+            flashSimWriteCheck(&part, cases[i].Address, writeData, cases[i].Length))
+        {
+            printf("Simulated MX25 didn't wrap an unsplit write at 0x%lX\n", (unsigned long)cases[i].Address);
+            return false;
+        }
+    }
+
+    if (elapsedUs > 0)
+    {
+        printf("Flash simulated writes: %lu bytes, %lu kB/s\n", (unsigned long)bytes,
+               (unsigned long)(((uint64_t)bytes * 1000) / elapsedUs));
+    }
+
+    return true;
+}
+
+/*
+ * Write-combining benchmark.
+ * Writes the same stream of 6-64 byte records once with a FlashServ_Write per record and
+ * once through FlashServ_WriteBuffered, and compares page programs issued and throughput.
+ */
+static bool flashWriteBufferBenchmark(void)
+{
+    FlashServWriteStats_t writeStats = {0};
+    uint8_t *record = xFlashBenchBuffer;
+    uint8_t *readBack = &xFlashBenchBuffer[PAGE_OFFSET];
+    uint32_t programs[2] = {0};
+    uint32_t elapsedMs[2] = {0};
+    uint32_t baseAddress = 0;
+    uint32_t offset = 0;
+    uint32_t length = 0;
+    uint32_t pass = 0;
+    uint32_t i = 0;
+    TickType_t startTick = 0;
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if (FlashServ_EraseRange(FLASH_LAYOUT_SCRATCH_START, FLASH_LAYOUT_SCRATCH_START + (2 * WRITE_BUFFER_BENCH_BYTES),
+                             NULL) != FLASH_OPERATION_SUCCESS)
+    {
+        printf("Failed to erase scratch region.\n");
+        return false;
+    }
+
+    for (pass = 0; pass < 2; pass++)
+    {
+        baseAddress = FLASH_LAYOUT_SCRATCH_START + (pass * WRITE_BUFFER_BENCH_BYTES);
+        FlashServ_GetWriteStats(&writeStats);
+        programs[pass] = writeStats.PagesProgrammed;
+        srand(RANDOM_SEED);
+        startTick = xTaskGetTickCount();
+
+        for (offset = 0; offset < WRITE_BUFFER_BENCH_BYTES; offset += length)
+        {
+            length = WRITE_BUFFER_BENCH_MIN_RECORD +
+                     (rand() % (WRITE_BUFFER_BENCH_MAX_RECORD - WRITE_BUFFER_BENCH_MIN_RECORD + 1));
+            if ((offset + length) > WRITE_BUFFER_BENCH_BYTES)
+            {
+                length = WRITE_BUFFER_BENCH_BYTES - offset;
+            }
+
+            for (i = 0; i < length; i++)
+            {
+                record[i] = (uint8_t)(offset + i);
+            }
+
+            if (pass == 0)
+            {
+                msg = FlashServ_Write(baseAddress + offset, record, length);
+            }
+            else
+            {
+                msg = FlashServ_WriteBuffered(baseAddress + offset, record, length);
+            }
+
+            if (msg != FLASH_OPERATION_SUCCESS)
+            {
+                printf("Failed to write flash memory.\n");
+                return false;
+            }
+        }
+
+        if (FlashServ_Flush() != FLASH_OPERATION_SUCCESS)
+        {
+            return false;
+        }
+
+        elapsedMs[pass] = (xTaskGetTickCount() - startTick) * portTICK_PERIOD_MS;
+        FlashServ_GetWriteStats(&writeStats);
+        programs[pass] = writeStats.PagesProgrammed - programs[pass];
+
+        // Both paths must leave the same bytes on flash
+        for (offset = 0; offset < WRITE_BUFFER_BENCH_BYTES; offset += PAGE_OFFSET)
+        {
+            if (FlashServ_Read(baseAddress + offset, readBack, PAGE_OFFSET) != FLASH_OPERATION_SUCCESS)
+            {
+                return false;
+            }
+
+            for (i = 0; i < PAGE_OFFSET; i++)
+            {
+                if (readBack[i] != (uint8_t)(offset + i))
+                {
+                    printf("Write buffer mismatch at 0x%lX\n", (unsigned long)(baseAddress + offset + i));
+                    return false;
+                }
+            }
+        }
+    }
+
+    if ((elapsedMs[0] == 0) || (elapsedMs[1] == 0) || (programs[1] == 0))
+    {
+        return false;
+    }
+
+    printf("Flash small writes: per call %lu programs %lu kB/s, combined %lu programs %lu kB/s (%lu.%02lux fewer)\n",
+           (unsigned long)programs[0], (unsigned long)(WRITE_BUFFER_BENCH_BYTES / elapsedMs[0]),
+           (unsigned long)programs[1], (unsigned long)(WRITE_BUFFER_BENCH_BYTES / elapsedMs[1]),
+           (unsigned long)(programs[0] / programs[1]), (unsigned long)(((programs[0] % programs[1]) * 100) / programs[1]));
+
+    return true;
+}
+
+/*
+ * Deep power-down test.
+ * A read issued while the flash is powered down must wake it and return the same data.
+ */
+static bool flashPowerDownTest(void)
+{
+    FlashServPowerStats_t before = {0};
+    FlashServPowerStats_t after = {0};
+    uint8_t expected[TRANS_LENGTH] = {0};
+    uint8_t data[TRANS_LENGTH] = {0};
+    bool result = false;
+
+    // Reads must reach the device, not the page cache
+    FlashCache_SetEnabled(false);
+    FlashServ_GetPowerStats(&before);
+
+    if (FlashServ_Read(FLASH_TARGET_ADDR, expected, sizeof(expected)) == FLASH_OPERATION_SUCCESS)
+    {
+        FlashServ_LowPowerMode();
+        result = (FlashServ_Read(FLASH_TARGET_ADDR, data, sizeof(data)) == FLASH_OPERATION_SUCCESS) &&
+                 (memcmp(expected, data, sizeof(data)) == 0);
+    }
+
+    FlashServ_GetPowerStats(&after);
+    FlashCache_SetEnabled(true);
+
+    if ((after.Entries != (before.Entries + 1)) || (after.Wakes != (before.Wakes + 1)))
+    {
+        return false;
+    }
+
+    printf("Flash deep power-down wake added %lu us\n",
+           (unsigned long)(after.WakeLatencyUs - before.WakeLatencyUs));
+
+    return result;
+}
+
+/*
+ * Read test while a sector erase is in progress.
+ * Each read suspends the erase, so its latency should stay far below tSE.
+ */
+static bool flashSuspendReadTest(void)
+{
+    uint8_t *writeData = xFlashBenchBuffer;
+    uint8_t *readData = &xFlashBenchBuffer[PAGE_OFFSET];
+    flashReturnMsg_t msg = FLASH_OPERATION_FAILED;
+    uint32_t startCycles = 0;
+    uint32_t latencyUs = 0;
+    uint32_t maxLatencyUs = 0;
+    uint32_t readCount = 0;
+    uint32_t i = 0;
+
+    for (i = 0; i < PAGE_OFFSET; i++)
+    {
+        writeData[i] = (uint8_t)(i ^ 0x5A);
+    }
+
+    // Known data in a sector the erase doesn't touch
+    msg = FlashServ_EraseRange(FLASH_SUSPEND_TEST_READ_ADDR, FLASH_SUSPEND_TEST_READ_ADDR + SECTOR_OFFSET, NULL);
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        msg = FlashServ_Write(FLASH_SUSPEND_TEST_READ_ADDR, writeData, PAGE_OFFSET);
+    }
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        printf("Failed to prepare flash memory.\n");
+        return false;
+    }
+
+    msg = FlashServ_StartEraseSector(FLASH_SUSPEND_TEST_ERASE_ADDR);
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        printf("Failed to start flash erase.\n");
+        return false;
+    }
+
+    do
+    {
+        startCycles = TIMING_GetCycles();
+        msg = FlashServ_Read(FLASH_SUSPEND_TEST_READ_ADDR, readData, PAGE_OFFSET);
+        latencyUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+
+        if ((msg != FLASH_OPERATION_SUCCESS) || (memcmp(writeData, readData, PAGE_OFFSET) != 0))
+        {
+            printf("Read during erase failed.\n");
+            return false;
+        }
+
+        readCount++;
+        if (latencyUs > maxLatencyUs)
+        {
+            maxLatencyUs = latencyUs;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(FLASH_SUSPEND_TEST_POLL_MS));
+    } while (!FlashServ_PollOp(&msg));
+
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        printf("Flash erase failed.\n");
+        return false;
+    }
+
+    printf("Flash reads during erase: %lu, max latency %lu us\n",
+           (unsigned long)readCount, (unsigned long)maxLatencyUs);
+
+    msg = FlashServ_EraseRange(FLASH_SUSPEND_TEST_READ_ADDR, FLASH_SUSPEND_TEST_READ_ADDR + SECTOR_OFFSET, NULL);
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        printf("Failed to reset flash memory.\n");
+        return false;
+    }
+
+    return true;
+}
+
+#ifdef FLASH_SELF_TEST
+// Helper function to fill an FTL benchmark page tagged with its logical page and write number
+static void flashFtlBenchFill(uint8_t *page, uint32_t logicalPage, uint32_t writeNumber)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < FTL_PAGE_SIZE; i++)
+    {
+        page[i] = (uint8_t)(logicalPage + writeNumber + i);
+    }
+
+    memcpy(&page[0], &logicalPage, sizeof(logicalPage));
+    memcpy(&page[sizeof(logicalPage)], &writeNumber, sizeof(writeNumber));
+}
+
+// Helper function to check every FTL page holds the tag it was written with.
+// Returns a sum of the write numbers so two passes can be compared.
+static bool flashFtlBenchVerify(uint32_t *writeSum)
+{
+    uint8_t *readPage = xFlashBenchBuffer;
+    uint8_t *expectPage = &xFlashBenchBuffer[FTL_PAGE_SIZE];
+    uint32_t writeNumber = 0;
+    uint32_t logicalPage = 0;
+
+    *writeSum = 0;
+
+    for (logicalPage = 0; logicalPage < FTL_TEST_PAGES; logicalPage++)
+    {
+        if (FlashFtl_Read(logicalPage, readPage) != FLASH_OPERATION_SUCCESS)
+        {
+            return false;
+        }
+
+        memcpy(&writeNumber, &readPage[sizeof(logicalPage)], sizeof(writeNumber));
+        flashFtlBenchFill(expectPage, logicalPage, writeNumber);
+        if (memcmp(readPage, expectPage, FTL_PAGE_SIZE) != 0)
+        {
+            printf("FTL page %lu corrupt\n", (unsigned long)logicalPage);
+            return false;
+        }
+
+        *writeSum += writeNumber;
+    }
+
+    return true;
+}
+
+/*
+ * FTL endurance and throughput benchmark steps, on the FTL test area.
+ * Fills the logical space, then overwrites with a hot/cold skew and reports write
+ * amplification and wear spread. Remounts to check the mapping rebuilds from flash.
+ */
+static bool flashFtlBenchSteps(void)
+{
+    FlashFtlStats_t stats = {0};
+    uint32_t logicalPage = 0;
+    uint32_t writeNumber = 0;
+    uint32_t writeSum = 0;
+    uint32_t remountSum = 0;
+    uint32_t elapsedMs = 0;
+    TickType_t startTick = 0;
+
+    if (!FlashFtl_Format())
+    {
+        printf("Failed to format FTL.\n");
+        return false;
+    }
+
+    srand(RANDOM_SEED);
+    startTick = xTaskGetTickCount();
+
+    for (writeNumber = 0; writeNumber < (FTL_TEST_PAGES * FTL_BENCH_PASSES); writeNumber++)
+    {
+        if (writeNumber < FTL_TEST_PAGES)
+        {
+            logicalPage = writeNumber;
+        }
+        else if ((uint32_t)(rand() % 100) < FTL_BENCH_HOT_PERCENT)
+        {
+            logicalPage = rand() % FTL_BENCH_HOT_PAGES;
+        }
+        else
+        {
+            logicalPage = FTL_BENCH_HOT_PAGES + (rand() % (FTL_TEST_PAGES - FTL_BENCH_HOT_PAGES));
+        }
+
+        flashFtlBenchFill(xFlashBenchBuffer, logicalPage, writeNumber);
+        if (FlashFtl_Write(logicalPage, xFlashBenchBuffer) != FLASH_OPERATION_SUCCESS)
+        {
+            printf("FTL write %lu failed\n", (unsigned long)writeNumber);
+            return false;
+        }
+    }
+
+    elapsedMs = (xTaskGetTickCount() - startTick) * portTICK_PERIOD_MS;
+
+    if (!flashFtlBenchVerify(&writeSum) || !FlashFtl_Mount() || !flashFtlBenchVerify(&remountSum) ||
+        (writeSum != remountSum))
+    {
+        printf("FTL data lost across remount\n");
+        return false;
+    }
+
+    FlashFtl_GetStats(&stats);
+    if ((stats.HostPageWrites == 0) || (elapsedMs == 0))
+    {
+        return false;
+    }
+
+    printf("FTL: %lu writes, %lu kB/s, write amplification %lu.%02lu, erase count %lu-%lu, %lu static moves\n",
+           (unsigned long)stats.HostPageWrites,
+           (unsigned long)(((uint64_t)stats.HostPageWrites * FTL_PAGE_SIZE) / elapsedMs),
+           (unsigned long)(stats.FlashPageWrites / stats.HostPageWrites),
+           (unsigned long)(((stats.FlashPageWrites % stats.HostPageWrites) * 100) / stats.HostPageWrites),
+           (unsigned long)stats.MinEraseCount, (unsigned long)stats.MaxEraseCount,
+           (unsigned long)stats.StaticWearMoves);
+
+    return true;
+}
+
+/*
+ * FTL benchmark on a stand-in region at the start of scratch, so the FTL region keeps its data
+ */
+static bool flashFtlBenchmark(void)
+{
+    bool result = false;
+
+    if (!FlashFtl_MountAt(FTL_TEST_START, FTL_TEST_SIZE))
+    {
+        printf("Failed to set up the FTL test area\n");
+        return false;
+    }
+
+    result = flashFtlBenchSteps();
+
+    if (!FlashFtl_MountAt(FLASH_LAYOUT_FTL_START, FLASH_LAYOUT_FTL_SIZE))
+    {
+        printf("Failed to mount FTL.\n");
+        result = false;
+    }
+
+    return result;
+}
+
+// Helper function to fill a log benchmark record from its sequence number
+static void flashLogBenchFill(uint8_t *record, uint32_t seq)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < LOG_BENCH_RECORD_LENGTH; i++)
+    {
+        record[i] = (uint8_t)(seq + i);
+    }
+}
+
+/*
+ * Append log ingest and recovery benchmark steps, on the log test area.
+ * Compares record ingest with raw page programs of the same amount of data, times a
+ * remount, then reads back from the middle of the log checking sequence and contents.
+ */
+static bool flashLogBenchSteps(void)
+{
+    FlashLogStats_t stats = {0};
+    FlashLogCursor_t cursor = {0};
+    uint8_t *record = xFlashBenchBuffer;
+    uint8_t *expect = &xFlashBenchBuffer[LOG_BENCH_RECORD_LENGTH];
+    uint32_t recordCount = LOG_BENCH_BYTES / LOG_BENCH_RECORD_LENGTH;
+    uint32_t firstSeq = 0;
+    uint32_t seq = 0;
+    uint32_t expectSeq = 0;
+    uint32_t address = 0;
+    uint32_t rawMs = 0;
+    uint32_t logMs = 0;
+    uint16_t length = 0;
+    uint32_t i = 0;
+    TickType_t startTick = 0;
+
+    // Raw page programs to the scratch region
+    if (FlashServ_EraseRange(FLASH_LAYOUT_SCRATCH_START, FLASH_LAYOUT_SCRATCH_START + LOG_BENCH_BYTES, NULL) !=
+        FLASH_OPERATION_SUCCESS)
+    {
+        printf("Failed to erase scratch region.\n");
+        return false;
+    }
+
+    memset(xFlashBenchBuffer, 0x5A, PAGE_OFFSET);
+    startTick = xTaskGetTickCount();
+    for (address = 0; address < LOG_BENCH_BYTES; address += PAGE_OFFSET)
+    {
+        if (FlashServ_Write(FLASH_LAYOUT_SCRATCH_START + address, xFlashBenchBuffer, PAGE_OFFSET) !=
+            FLASH_OPERATION_SUCCESS)
+        {
+            printf("Failed to write flash memory.\n");
+            return false;
+        }
+    }
+    rawMs = (xTaskGetTickCount() - startTick) * portTICK_PERIOD_MS;
+
+    // Same data through the log, every sector already erased
+    if (!FlashLog_Format())
+    {
+        printf("Failed to format log.\n");
+        return false;
+    }
+
+    startTick = xTaskGetTickCount();
+    for (i = 0; i < recordCount; i++)
+    {
+        flashLogBenchFill(record, i + 1);
+        if (FlashLog_Append(record, LOG_BENCH_RECORD_LENGTH, &seq) != FLASH_OPERATION_SUCCESS)
+        {
+            printf("Log append %lu failed\n", (unsigned long)i);
+            return false;
+        }
+        if (i == 0)
+        {
+            firstSeq = seq;
+        }
+    }
+    if (FlashLog_Flush() != FLASH_OPERATION_SUCCESS)
+    {
+        return false;
+    }
+    logMs = (xTaskGetTickCount() - startTick) * portTICK_PERIOD_MS;
+
+    if (!FlashLog_Mount())
+    {
+        printf("Failed to mount log.\n");
+        return false;
+    }
+
+    // Read back the second half
+    expectSeq = firstSeq + (recordCount / 2);
+    if (!FlashLog_Seek(&cursor, expectSeq))
+    {
+        printf("Log seek failed\n");
+        return false;
+    }
+
+    while (FlashLog_ReadNext(&cursor, record, LOG_BENCH_RECORD_LENGTH, &length, &seq))
+    {
+        flashLogBenchFill(expect, seq - firstSeq + 1);
+        if ((seq != expectSeq) || (length != LOG_BENCH_RECORD_LENGTH) ||
+            (memcmp(record, expect, LOG_BENCH_RECORD_LENGTH) != 0))
+        {
+            printf("Log record %lu corrupt\n", (unsigned long)expectSeq);
+            return false;
+        }
+        expectSeq++;
+    }
+
+    if (expectSeq != (firstSeq + recordCount))
+    {
+        printf("Log lost records across remount\n");
+        return false;
+    }
+
+    FlashLog_GetStats(&stats);
+    if ((rawMs == 0) || (logMs == 0))
+    {
+        return false;
+    }
+
+    printf("Log: %lu records, %lu kB/s ingest vs %lu kB/s raw page programs, %lu pages, mount %lu us\n",
+           (unsigned long)recordCount, (unsigned long)(LOG_BENCH_BYTES / logMs), (unsigned long)(LOG_BENCH_BYTES / rawMs),
+           (unsigned long)stats.PagesProgrammed, (unsigned long)stats.MountUs);
+
+    return true;
+}
+
+/*
+ * Log benchmark on a stand-in region in the second half of scratch, so the LOG region keeps its data
+ */
+static bool flashLogBenchmark(void)
+{
+    bool result = false;
+
+    if (!FlashLog_MountAt(LOG_TEST_START, LOG_TEST_SIZE))
+    {
+        printf("Failed to set up the log test area\n");
+        return false;
+    }
+
+    result = flashLogBenchSteps();
+
+    if (!FlashLog_MountAt(FLASH_LAYOUT_LOG_START, FLASH_LAYOUT_LOG_SIZE))
+    {
+        printf("Failed to mount log.\n");
+        result = false;
+    }
+
+    return result;
+}
+
+// Helper function to get byte i of a commit test version
+static uint8_t flashCommitTestByte(uint8_t seed, uint32_t i)
+{
+    return (uint8_t)(seed + (i * 7) + (i >> 8));
+}
+
+/*
+ * Write and commit a whole commit test version
+ */
+static flashReturnMsg_t flashCommitTestWrite(uint8_t seed, uint32_t length)
+{
+    uint32_t offset = 0;
+    uint32_t chunkLength = 0;
+    uint32_t i = 0;
+    flashReturnMsg_t msg = FlashCommit_Begin(length);
+
+    for (offset = 0; (offset < length) && (msg == FLASH_OPERATION_SUCCESS); offset += chunkLength)
+    {
+        chunkLength = length - offset;
+        if (chunkLength > COMMIT_TEST_CHUNK)
+        {
+            chunkLength = COMMIT_TEST_CHUNK;
+        }
+
+        for (i = 0; i < chunkLength; i++)
+        {
+            xFlashBenchBuffer[i] = flashCommitTestByte(seed, offset + i);
+        }
+
+        msg = FlashCommit_Append(xFlashBenchBuffer, chunkLength);
+    }
+
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        return FlashCommit_End();
+    }
+
+    FlashCommit_Abort();
+    return msg;
+}
+
+/*
+ * Check that the committed version is the whole commit test version of a seed
+ */
+static bool flashCommitTestCheck(uint8_t seed, uint32_t length)
+{
+    uint32_t offset = 0;
+    uint32_t chunkLength = 0;
+    uint32_t i = 0;
+
+    if (FlashCommit_GetLength() != length)
+    {
+        return false;
+    }
+
+    for (offset = 0; offset < length; offset += chunkLength)
+    {
+        chunkLength = length - offset;
+        if (chunkLength > sizeof(xFlashBenchBuffer))
+        {
+            chunkLength = sizeof(xFlashBenchBuffer);
+        }
+
+        if (FlashCommit_Read(offset, xFlashBenchBuffer, chunkLength) != FLASH_OPERATION_SUCCESS)
+        {
+            return false;
+        }
+
+        for (i = 0; i < chunkLength; i++)
+        {
+            if (xFlashBenchBuffer[i] != flashCommitTestByte(seed, offset + i))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Update the committed version of oldSeed to newSeed with a simulated power loss at each flash
+ * write of the update in turn, remounting after each as a reboot would. Every mount must find the
+ * whole old version until the update runs to the end, then the whole new one.
+ */
+static bool flashCommitPowerLossUpdate(uint8_t oldSeed, uint8_t newSeed, uint32_t length)
+{
+    FlashCommitStats_t stats = {0};
+    uint32_t mountMaxUs = 0;
+    uint32_t step = 0;
+    flashReturnMsg_t msg = FLASH_OPERATION_FAILED;
+
+    for (step = 0; msg != FLASH_OPERATION_SUCCESS; step++)
+    {
+        FlashCommit_InjectPowerLoss(step);
+        msg = flashCommitTestWrite(newSeed, length);
+        FlashCommit_InjectPowerLoss(FLASH_COMMIT_NO_POWER_LOSS);
+
+        if (!FlashCommit_Mount())
+        {
+            printf("Commit mount failed after power loss at write %lu\n", (unsigned long)step);
+            return false;
+        }
+
+        FlashCommit_GetStats(&stats);
+        if (stats.MountUs > mountMaxUs)
+        {
+            mountMaxUs = stats.MountUs;
+        }
+
+        if (!flashCommitTestCheck((msg == FLASH_OPERATION_SUCCESS) ? newSeed : oldSeed, length))
+        {
+            printf("Commit mixed or lost data after power loss at write %lu\n", (unsigned long)step);
+            return false;
+        }
+    }
+
+    printf("Commit of %lu bytes survived power loss at each of %lu writes, mount max %lu us\n",
+           (unsigned long)length, (unsigned long)(step - 1), (unsigned long)mountMaxUs);
+
+    return true;
+}
+
+// Helper function to commit small versions until the record sector has switched once more
+static bool flashCommitTestFillToSwitch(uint32_t *commits, uint8_t *seed)
+{
+    FlashCommitStats_t stats = {0};
+    uint32_t switches = 0;
+
+    FlashCommit_GetStats(&stats);
+    switches = stats.RecordSectorSwitches;
+
+    for (*commits = 0; stats.RecordSectorSwitches == switches; (*commits)++)
+    {
+        (*seed)++;
+        if ((*commits >= COMMIT_TEST_MAX_FILLS) ||
+            (flashCommitTestWrite(*seed, COMMIT_TEST_FILL_LENGTH) != FLASH_OPERATION_SUCCESS))
+        {
+            return false;
+        }
+
+        FlashCommit_GetStats(&stats);
+    }
+
+    return true;
+}
+
+/*
+ * Commit an old version and update it with a power loss at each write (see
+ * flashCommitPowerLossUpdate). Then fill the record sector and do the same with the update
+ * that switches record sectors, so the power loss also hits the erase of the other record
+ * sector and the first record programmed in it.
+ */
+static bool flashCommitPowerLossSteps(void)
+{
+    FlashCommitStats_t stats = {0};
+    uint32_t switches = 0;
+    uint32_t commits = 0;
+    uint8_t seed = COMMIT_TEST_NEW_SEED;
+
+    if ((flashCommitTestWrite(COMMIT_TEST_OLD_SEED, COMMIT_TEST_LENGTH) != FLASH_OPERATION_SUCCESS) ||
+        !flashCommitTestCheck(COMMIT_TEST_OLD_SEED, COMMIT_TEST_LENGTH))
+    {
+        printf("Failed to commit the old version\n");
+        return false;
+    }
+
+    if (!flashCommitPowerLossUpdate(COMMIT_TEST_OLD_SEED, COMMIT_TEST_NEW_SEED, COMMIT_TEST_LENGTH))
+    {
+        return false;
+    }
+
+    // Commit up to the next switch, then count the commits up to the one after: that is how
+    // many records a sector takes. The switch wrote the first, so one less fills the sector.
+    if (!flashCommitTestFillToSwitch(&commits, &seed) || !flashCommitTestFillToSwitch(&commits, &seed))
+    {
+        printf("Failed to fill the commit record sector\n");
+        return false;
+    }
+    for (; commits > 1; commits--)
+    {
+        seed++;
+        if (flashCommitTestWrite(seed, COMMIT_TEST_FILL_LENGTH) != FLASH_OPERATION_SUCCESS)
+        {
+            printf("Failed to fill the commit record sector\n");
+            return false;
+        }
+    }
+
+    FlashCommit_GetStats(&stats);
+    switches = stats.RecordSectorSwitches;
+
+    if (!flashCommitPowerLossUpdate(seed, (uint8_t)(seed + 1), COMMIT_TEST_FILL_LENGTH))
+    {
+        return false;
+    }
+
+    FlashCommit_GetStats(&stats);
+    if (stats.RecordSectorSwitches == switches)
+    {
+        printf("Commit record sector did not switch\n");
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Shadow commit power loss test.
+ * Runs on a commit area in the scratch region, so the committed object is left alone,
+ * then mounts the COMMIT region again.
+ */
+static bool flashCommitPowerLossTest(void)
+{
+    bool result = false;
+
+    if ((FlashServ_EraseRange(COMMIT_TEST_START, COMMIT_TEST_START + FLASH_LAYOUT_COMMIT_SIZE, NULL) !=
+         FLASH_OPERATION_SUCCESS) ||
+        !FlashCommit_MountAt(COMMIT_TEST_START))
+    {
+        printf("Failed to set up the commit test area\n");
+        return false;
+    }
+
+    result = flashCommitPowerLossSteps();
+
+    if (!FlashCommit_MountAt(FLASH_LAYOUT_COMMIT_START))
+    {
+        printf("Failed to mount commit area\n");
+        result = false;
+    }
+
+    return result;
+}
+
+// Helper function to fill a time-series benchmark sample
+static void flashTsBenchFill(FlashTsSample_t *sample, uint32_t timestamp)
+{
+    uint32_t i = 0;
+
+    sample->Timestamp = timestamp;
+    for (i = 0; i < FLASH_TS_DATA_LENGTH; i++)
+    {
+        sample->Data[i] = (uint8_t)(timestamp + i);
+    }
+}
+
+// Helper function to check that a query visits every benchmark sample of its range in order
+static bool flashTsBenchVisit(const FlashTsSample_t *sample, void *context)
+{
+    uint32_t *expectTs = (uint32_t *)context;
+    FlashTsSample_t expect;
+
+    flashTsBenchFill(&expect, *expectTs);
+    if (memcmp(sample, &expect, sizeof(expect)) != 0)
+    {
+        return false;
+    }
+
+    (*expectTs)++;
+    return true;
+}
+
+/*
+ * Time-series range query benchmark steps, on the time-series test area.
+ * Appends a sample a second from 09:00, remounts, then fetches 10:00-10:05 through the
+ * chunk index and with a scan of every chunk, checking both return the same samples.
+ */
+static bool flashTsBenchSteps(void)
+{
+    FlashTsStats_t stats = {0};
+    FlashTsSample_t sample;
+    uint32_t expectTs = 0;
+    uint32_t indexCount = 0;
+    uint32_t indexUs = 0;
+    uint32_t indexChunks = 0;
+    uint32_t scanCount = 0;
+    uint32_t i = 0;
+
+    if (!FlashTs_Format())
+    {
+        printf("Failed to format time-series store.\n");
+        return false;
+    }
+
+    for (i = 0; i < TS_BENCH_SAMPLES; i++)
+    {
+        flashTsBenchFill(&sample, TS_BENCH_FIRST_TS + i);
+        if (FlashTs_Append(&sample) != FLASH_OPERATION_SUCCESS)
+        {
+            printf("Time-series append %lu failed\n", (unsigned long)i);
+            return false;
+        }
+    }
+
+    if ((FlashTs_Flush() != FLASH_OPERATION_SUCCESS) || !FlashTs_Mount())
+    {
+        printf("Failed to mount time-series store.\n");
+        return false;
+    }
+
+    expectTs = TS_BENCH_QUERY_START_TS;
+    indexCount = FlashTs_Query(TS_BENCH_QUERY_START_TS, TS_BENCH_QUERY_END_TS, flashTsBenchVisit, &expectTs);
+    FlashTs_GetStats(&stats);
+    indexUs = stats.LastQueryUs;
+    indexChunks = stats.LastQueryChunksRead;
+
+    expectTs = TS_BENCH_QUERY_START_TS;
+    scanCount = FlashTs_QueryScan(TS_BENCH_QUERY_START_TS, TS_BENCH_QUERY_END_TS, flashTsBenchVisit, &expectTs);
+    FlashTs_GetStats(&stats);
+
+    if ((indexCount != (TS_BENCH_QUERY_END_TS - TS_BENCH_QUERY_START_TS + 1)) || (scanCount != indexCount) ||
+        (stats.Samples != TS_BENCH_SAMPLES))
+    {
+        printf("Time-series query returned %lu indexed, %lu scanned\n", (unsigned long)indexCount,
+               (unsigned long)scanCount);
+        return false;
+    }
+
+    printf("Time-series %lu of %lu samples: index %lu us over %lu chunks, scan %lu us over %lu chunks, mount %lu us\n",
+           (unsigned long)indexCount, (unsigned long)stats.Samples, (unsigned long)indexUs, (unsigned long)indexChunks,
+           (unsigned long)stats.LastQueryUs, (unsigned long)stats.LastQueryChunksRead, (unsigned long)stats.MountUs);
+
+    return true;
+}
+
+/*
+ * Time-series benchmark on a stand-in region in scratch, so the time-series region keeps its data
+ */
+static bool flashTsBenchmark(void)
+{
+    bool result = false;
+
+    if (!FlashTs_MountAt(TS_TEST_START))
+    {
+        printf("Failed to set up the time-series test area\n");
+        return false;
+    }
+
+    result = flashTsBenchSteps();
+
+    if (!FlashTs_MountAt(FLASH_LAYOUT_TS_START))
+    {
+        printf("Failed to mount time-series store.\n");
+        result = false;
+    }
+
+    return result;
+}
+
+/*
+ * Key-value store benchmark steps, on the KV test area.
+ * Puts keyCount keys into an empty store, reads them all back and times the index
+ * rebuild at mount. Reports average and worst case put and get latency.
+ */
+static bool flashKvBenchSteps(uint32_t keyCount)
+{
+    FlashKvStats_t stats = {0};
+    uint32_t key = 0;
+    uint32_t value = 0;
+    uint32_t elapsedUs = 0;
+    uint32_t putTotalUs = 0;
+    uint32_t putMaxUs = 0;
+    uint32_t getTotalUs = 0;
+    uint32_t getMaxUs = 0;
+    uint32_t startCycles = 0;
+    uint16_t length = 0;
+    uint32_t i = 0;
+
+    if (!FlashKv_Format())
+    {
+        printf("Failed to format KV store.\n");
+        return false;
+    }
+
+    for (i = 0; i < keyCount; i++)
+    {
+        key = KV_BENCH_KEY_BASE + i;
+        startCycles = TIMING_GetCycles();
+        if (FlashKv_Put(key, (const uint8_t *)&key, sizeof(key)) != FLASH_OPERATION_SUCCESS)
+        {
+            printf("KV put %lu failed\n", (unsigned long)i);
+            return false;
+        }
+        elapsedUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+        putTotalUs += elapsedUs;
+        putMaxUs = (elapsedUs > putMaxUs) ? elapsedUs : putMaxUs;
+    }
+
+    if (!FlashKv_Mount())
+    {
+        printf("Failed to mount KV store.\n");
+        return false;
+    }
+
+    for (i = 0; i < keyCount; i++)
+    {
+        key = KV_BENCH_KEY_BASE + i;
+        startCycles = TIMING_GetCycles();
+        if (!FlashKv_Get(key, (uint8_t *)&value, sizeof(value), &length))
+        {
+            printf("KV key 0x%lX missing\n", (unsigned long)key);
+            return false;
+        }
+        elapsedUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+        getTotalUs += elapsedUs;
+        getMaxUs = (elapsedUs > getMaxUs) ? elapsedUs : getMaxUs;
+
+        if ((length != sizeof(value)) || (value != key))
+        {
+            printf("KV key 0x%lX corrupt\n", (unsigned long)key);
+            return false;
+        }
+    }
+
+    FlashKv_GetStats(&stats);
+    if (stats.Keys != keyCount)
+    {
+        return false;
+    }
+
+    printf("KV %lu keys: put avg %lu us max %lu us, get avg %lu us max %lu us, mount %lu us\n",
+           (unsigned long)keyCount, (unsigned long)(putTotalUs / keyCount), (unsigned long)putMaxUs,
+           (unsigned long)(getTotalUs / keyCount), (unsigned long)getMaxUs, (unsigned long)stats.MountUs);
+
+    return true;
+}
+
+// Helper function to check the keys left by the KV collection test
+static bool flashKvCollectCheck(void)
+{
+    uint32_t key = 0;
+    uint32_t value = 0;
+    uint16_t length = 0;
+
+    for (key = KV_COLLECT_TEST_KEY_BASE; key < (KV_COLLECT_TEST_KEY_BASE + KV_COLLECT_TEST_KEYS); key++)
+    {
+        if (key == KV_COLLECT_TEST_BAD_KEY)
+        {
+            if (FlashKv_Get(key, (uint8_t *)&value, sizeof(value), &length))
+            {
+                printf("KV key 0x%lX survived corruption\n", (unsigned long)key);
+                return false;
+            }
+        }
+        else if (!FlashKv_Get(key, (uint8_t *)&value, sizeof(value), &length) || (length != sizeof(value)) ||
+                 (value != key))
+        {
+            printf("KV key 0x%lX lost by collection\n", (unsigned long)key);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Key-value store collection test, on the KV test area.
+ * Puts a few keys into the first sector, clears bits in the header of one in the middle so
+ * it no longer reads back, then collects the sector. Every other key must be copied forward,
+ * before and after a remount, and the bad one dropped.
+ */
+static bool flashKvCollectSteps(void)
+{
+    FlashKvStats_t before = {0};
+    FlashKvStats_t stats = {0};
+    const uint32_t zero = 0;
+    uint32_t key = 0;
+    uint32_t word = 0;
+    uint32_t i = 0;
+
+    if (!FlashKv_Format())
+    {
+        printf("Failed to format KV store.\n");
+        return false;
+    }
+
+    for (key = KV_COLLECT_TEST_KEY_BASE; key < (KV_COLLECT_TEST_KEY_BASE + KV_COLLECT_TEST_KEYS); key++)
+    {
+        if (FlashKv_Put(key, (const uint8_t *)&key, sizeof(key)) != FLASH_OPERATION_SUCCESS)
+        {
+            printf("KV put 0x%lX failed\n", (unsigned long)key);
+            return false;
+        }
+    }
+
+    // The record header starts with the key, ahead of the value which repeats it
+    if (FlashServ_Read(KV_TEST_START, xFlashBenchBuffer, SECTOR_OFFSET) != FLASH_OPERATION_SUCCESS)
+    {
+        return false;
+    }
+    for (i = 0; i < SECTOR_OFFSET; i += sizeof(word))
+    {
+        memcpy(&word, &xFlashBenchBuffer[i], sizeof(word));
+        if (word == KV_COLLECT_TEST_BAD_KEY)
+        {
+            break;
+        }
+    }
+    if ((i == SECTOR_OFFSET) ||
+        (FlashServ_Write(KV_TEST_START + i, (const uint8_t *)&zero, sizeof(zero)) != FLASH_OPERATION_SUCCESS))
+    {
+        printf("Failed to corrupt KV key 0x%lX\n", (unsigned long)KV_COLLECT_TEST_BAD_KEY);
+        return false;
+    }
+
+    // Asking for every sector ready collects the oldest one, the sector just written
+    FlashKv_GetStats(&before);
+    if (FlashKv_PreErase(1, FLASH_LAYOUT_KV_SIZE / SECTOR_OFFSET) != 1)
+    {
+        printf("KV collection failed\n");
+        return false;
+    }
+
+    FlashKv_GetStats(&stats);
+    if (((stats.Collections - before.Collections) != 1) || ((stats.RecordsLost - before.RecordsLost) != 1) ||
+        (stats.Keys != (KV_COLLECT_TEST_KEYS - 1)) || !flashKvCollectCheck())
+    {
+        printf("KV collection lost records\n");
+        return false;
+    }
+
+    if (!FlashKv_Mount() || !flashKvCollectCheck())
+    {
+        printf("KV records lost at mount after collection\n");
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Key-value store collection test and benchmark on a stand-in region covering scratch, so the KV
+ * region keeps its data
+ */
+static bool flashKvBenchmark(void)
+{
+    bool result = false;
+
+    if (!FlashKv_MountAt(KV_TEST_START))
+    {
+        printf("Failed to set up the KV test area\n");
+        return false;
+    }
+
+    result = flashKvCollectSteps() && flashKvBenchSteps(KV_BENCH_SMALL_KEYS) &&
+             flashKvBenchSteps(KV_BENCH_LARGE_KEYS);
+
+    if (!FlashKv_MountAt(FLASH_LAYOUT_KV_START))
+    {
+        printf("Failed to mount KV store.\n");
+        result = false;
+    }
+
+    return result;
+}
+
+// Helper function to erase one aligned region for the benchmark suite
+static flashReturnMsg_t flashBenchErase(uint32_t address, uint32_t size)
+{
+    return FlashServ_EraseRange(address, address + size, NULL);
+}
+
+// Helper function to start and stop the accelerometer load for the benchmark suite
+static void flashBenchSetLoad(bool enabled)
+{
+    AccelServ_SetLoadPeriod(enabled ? FLASH_BENCH_ACCEL_LOAD_MS : 0);
+}
+
+// Helper function to read the simulated MX25 for the benchmark suite
+static flashReturnMsg_t flashBenchSimRead(uint32_t address, uint8_t *data, uint32_t length)
+{
+    FlashVolumeChip_t part;
+
+    FlashSim_GetVolumeChip(0, &part);
+    return part.Read(part.Context, address, data, length);
+}
+
+// Helper function to program the simulated MX25 for the benchmark suite, split on pages as FlashServ_Write does
+static flashReturnMsg_t flashBenchSimProgram(uint32_t address, const uint8_t *data, uint32_t length)
+{
+    FlashVolumeChip_t part;
+
+    FlashSim_GetVolumeChip(0, &part);
+    return flashSimWrite(&part, address, data, length, true);
+}
+
+// Helper function to erase one aligned region of the simulated MX25 for the benchmark suite
+static flashReturnMsg_t flashBenchSimErase(uint32_t address, uint32_t size)
+{
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+    FlashVolumeChip_t part;
+
+    FlashSim_GetVolumeChip(0, &part);
+    msg = part.EraseStart(part.Context, address, size);
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        msg = part.Wait(part.Context);
+    }
+
+    return msg;
+}
+
+// Helper function to print the results of the benchmark suite and check every case ran without errors
+static bool flashBenchCheck(const FlashBenchDevice_t *device, const FlashBenchResult_t *results, uint32_t count)
+{
+    uint32_t i = 0;
+    bool result = true;
+
+    FlashBench_Print(device, results, count);
+
+    for (i = 0; i < count; i++)
+    {
+        if ((results[i].Ops == 0) || (results[i].Errors != 0))
+        {
+            result = false;
+        }
+    }
+
+    return (count > 0) && result;
+}
+
+/*
+ * Run the benchmark suite on the scratch region through these services, then on the
+ * simulated MX25 with the same geometry and bus clock, so the two tables can be compared.
+ * The page cache is off for the real run so reads measure the device.
+ */
+static bool flashBenchSuite(void)
+{
+    static FlashBenchResult_t results[FLASH_BENCH_MAX_RESULTS];
+    const FlashBenchDevice_t device = {
+        .Name = "MX25 flash-services",
+        .Start = FLASH_LAYOUT_SCRATCH_START,
+        .Size = FLASH_LAYOUT_SCRATCH_SIZE,
+        .Read = FlashServ_Read,
+        .Program = FlashServ_Write,
+        .Erase = flashBenchErase,
+        .SetLoad = flashBenchSetLoad,
+    };
+    const FlashBenchDevice_t simDevice = {
+        .Name = "simulated MX25",
+        .Start = FLASH_LAYOUT_SCRATCH_START,
+        .Size = FLASH_LAYOUT_SCRATCH_SIZE,
+        .Read = flashBenchSimRead,
+        .Program = flashBenchSimProgram,
+        .Erase = flashBenchSimErase,
+        .GetNowUs = FlashSim_GetNowUs,
+    };
+    uint32_t count = 0;
+    bool result = false;
+
+    FlashCache_SetEnabled(false);
+    count = FlashBench_Run(&device, results, FLASH_BENCH_MAX_RESULTS);
+    FlashCache_SetEnabled(true);
+
+    result = flashBenchCheck(&device, results, count);
+
+    FlashSim_Reset(MX25_GetGeometry(FlashServ_GetDevice()), SPI_GetClockHz(FlashServ_GetDevice()->Bus));
+    count = FlashBench_Run(&simDevice, results, FLASH_BENCH_MAX_RESULTS);
+
+    return flashBenchCheck(&simDevice, results, count) && result;
+}
+#endif
+
+/*** Public Functions ***/
+
+/*
+ * Function to run the flash self-tests and benchmarks
+ */
+void FlashSelfTest_Run(void)
+{
+    bool result = false;
+
+    result = flashIdTest();
+    if (result == false)
+    {
+        printf("Flash ID test failed.\n");
+    }
+    else
+    {
+        printf("Flash ID test passed.\n");
+    }
+
+    result = flashReadWriteTest();
+    if (result == false)
+    {
+        printf("Flash Read Write test failed.\n");
+    }
+    else
+    {
+        printf("Flash Read Write test passed.\n");
+    }
+
+    result = flashLargeWriteTest();
+    if (result == false)
+    {
+        printf("Flash Large Write test failed.\n");
+    }
+    else
+    {
+        printf("Flash Large Write test passed.\n");
+    }
+
+    result = flashSimWriteTest();
+    if (result == false)
+    {
+        printf("Flash Simulated Write test failed.\n");
+    }
+    else
+    {
+        printf("Flash Simulated Write test passed.\n");
+    }
+
+    result = flashSuspendReadTest();
+    if (result == false)
+    {
+        printf("Flash Suspend Read test failed.\n");
+    }
+    else
+    {
+        printf("Flash Suspend Read test passed.\n");
+    }
+
+    result = flashPowerDownTest();
+    if (result == false)
+    {
+        printf("Flash Power Down test failed.\n");
+    }
+    else
+    {
+        printf("Flash Power Down test passed.\n");
+    }
+
+    result = flashSfdpTest();
+    if (result == false)
+    {
+        printf("Flash SFDP test failed.\n");
+    }
+    else
+    {
+        printf("Flash SFDP test passed.\n");
+    }
+
+    result = flashErasePlannerTest() && flashEraseRangeTest();
+    if (result == false)
+    {
+        printf("Flash Erase Range test failed.\n");
+    }
+    else
+    {
+        printf("Flash Erase Range test passed.\n");
+    }
+
+    result = flashWriteBufferBenchmark();
+    if (result == false)
+    {
+        printf("Flash Write Buffer benchmark failed.\n");
+    }
+    else
+    {
+        printf("Flash Write Buffer benchmark passed.\n");
+    }
+
+#ifdef FLASH_SELF_TEST
+    result = flashFtlBenchmark();
+    if (result == false)
+    {
+        printf("Flash FTL benchmark failed.\n");
+    }
+    else
+    {
+        printf("Flash FTL benchmark passed.\n");
+    }
+
+    result = flashLogBenchmark();
+    if (result == false)
+    {
+        printf("Flash Log benchmark failed.\n");
+    }
+    else
+    {
+        printf("Flash Log benchmark passed.\n");
+    }
+
+    result = flashCommitPowerLossTest();
+    if (result == false)
+    {
+        printf("Flash Commit Power Loss test failed.\n");
+    }
+    else
+    {
+        printf("Flash Commit Power Loss test passed.\n");
+    }
+
+    result = flashTsBenchmark();
+    if (result == false)
+    {
+        printf("Flash Time-Series benchmark failed.\n");
+    }
+    else
+    {
+        printf("Flash Time-Series benchmark passed.\n");
+    }
+
+    result = flashKvBenchmark();
+    if (result == false)
+    {
+        printf("Flash KV benchmark failed.\n");
+    }
+    else
+    {
+        printf("Flash KV benchmark passed.\n");
+    }
+
+    result = flashCrcBenchmark();
+    if (result == false)
+    {
+        printf("Flash CRC benchmark failed.\n");
+    }
+    else
+    {
+        printf("Flash CRC benchmark passed.\n");
+    }
+
+    result = flashWaitBenchmark();
+    if (result == false)
+    {
+        printf("Flash wait benchmark failed.\n");
+    }
+    else
+    {
+        printf("Flash wait benchmark passed.\n");
+    }
+
+    result = flashVolumeBenchmark();
+    if (result == false)
+    {
+        printf("Flash volume benchmark failed.\n");
+    }
+    else
+    {
+        printf("Flash volume benchmark passed.\n");
+    }
+
+    flashSmallReadBenchmark();
+    flashPageCacheBenchmark();
+    flashSequentialReadBenchmark();
+
+    result = flashBenchSuite();
+    if (result == false)
+    {
+        printf("Flash benchmark suite failed.\n");
+    }
+    else
+    {
+        printf("Flash benchmark suite passed.\n");
+    }
+#endif
+}
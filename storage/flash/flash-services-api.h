@@ -20,6 +20,72 @@ See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
 #include <stdint.h>
 #include <stdbool.h>
 
+// Write throughput statistics of FlashServ_Write
+typedef struct
+{
+    uint32_t BytesWritten;
+    uint32_t PagesProgrammed;
+    uint32_t ElapsedUs;
+    uint32_t ThroughputKBps; // Effective kB/s over all writes so far
+} FlashServWriteStats_t;
+
+// Write-combining statistics of FlashServ_WriteBuffered
+typedef struct
+{
+    uint32_t Writes;          // FlashServ_WriteBuffered calls
+    uint32_t BytesBuffered;
+    uint32_t PagePrograms;    // Programs issued to flush buffered pages
+    uint32_t FullPageFlushes; // Flushed because the whole page was written
+    uint32_t TimeoutFlushes;
+    uint32_t EvictionFlushes; // Flushed to make room for another page
+} FlashServWriteBufferStats_t;
+
+// Mix of erase commands that covers a range, and how long it should take
+typedef struct
+{
+    uint32_t BlockErases;    // 64KB
+    uint32_t Block32KErases; // 32KB
+    uint32_t SectorErases;   // 4KB
+    uint32_t EstimatedMs;    // From typical erase times
+    uint32_t ActualMs;       // Filled in by FlashServ_EraseRange
+} FlashServErasePlan_t;
+
+// Deep power-down statistics, to tune the idle time against the power budget
+typedef struct
+{
+    uint32_t IdleMs;           // Idle time before entering deep power-down, 0 when off
+    uint32_t Entries;          // Times put in deep power-down
+    uint32_t Wakes;
+    uint32_t TimeInDpMs;       // Total, including the current stay
+    uint32_t WakeLatencyUs;    // Total delay the wakes added to requests
+    uint32_t WakeLatencyMaxUs;
+} FlashServPowerStats_t;
+
+// Wear and error history of one sector
+typedef struct
+{
+    uint32_t EraseCount; // Erases issued through these services, plus the count restored at boot
+    uint32_t Errors;     // Failed programs and erases, and records a scrub found corrupt
+} FlashServSectorHealth_t;
+
+// Result of a store checking the records it holds in one of its sectors
+typedef struct
+{
+    uint32_t Address;   // Start of the sector
+    uint32_t Checked;   // Records whose CRC was checked
+    uint32_t Failed;    // Records that failed their CRC
+    uint32_t Relocated; // Good records moved off the sector because others failed
+} FlashServScrubReport_t;
+
+#define FLASH_SERV_SECTOR_COUNT (FLASH_SIZE / SECTOR_OFFSET)
+
+// Handle identifying an asynchronous program/erase
+typedef uint32_t FlashServOpHandle_t;
+#define FLASH_SERV_INVALID_HANDLE 0
+
+// Called from the flash task when an asynchronous program/erase completes
+typedef void (*FlashServOpCallback_t)(FlashServOpHandle_t handle, flashReturnMsg_t result, void *context);
+
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
 // Does the needful to initialize the module.
 // This should be called only once.
@@ -28,4 +94,116 @@ void FlashServ_Init(void);
 
 // Prep and restore functions for low power mode
 void FlashServ_LowPowerMode(void);
-void FlashServ_WakeFromLowPowerMode(void);
\ No newline at end of file
+void FlashServ_WakeFromLowPowerMode(void);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Automatic deep power-down. Once no client has used the flash for idleMs, and no
+// program, erase or buffered write is pending, the flash task puts it in deep
+// power-down. The next request wakes it first, adding about tRDP to that request.
+// 0 turns it off. The check runs every FLASH_SERV_WRITE_BUFFER_TIMEOUT_MS.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+#define FLASH_SERV_AUTO_DP_IDLE_MS 100
+void FlashServ_SetAutoPowerDown(uint32_t idleMs);
+void FlashServ_GetPowerStats(FlashServPowerStats_t *stats);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Read any number of bytes starting at any address.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+flashReturnMsg_t FlashServ_Read(uint32_t address, uint8_t *data, uint32_t length);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Write any number of bytes starting at any address. The region must already be erased.
+// The data is split on page boundaries and programmed one page at a time.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+flashReturnMsg_t FlashServ_Write(uint32_t address, const uint8_t *data, uint32_t length);
+
+// Length of the first page program of a write: up to the end of its page, at most length
+uint32_t FlashServ_PageChunk(uint32_t address, uint32_t length);
+
+// Get write throughput statistics
+void FlashServ_GetWriteStats(FlashServWriteStats_t *stats);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Write-combining write for small records. The region must already be erased.
+// Bytes are collected per page in RAM and programmed once the page is full, when
+// FlashServ_Flush is called, or after FLASH_SERV_WRITE_BUFFER_TIMEOUT_MS, at the next
+// flash access or flash task check once the part is not busy with an erase.
+// FlashServ_Read returns buffered bytes before they reach the device.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+#define FLASH_SERV_WRITE_BUFFER_TIMEOUT_MS 20
+flashReturnMsg_t FlashServ_WriteBuffered(uint32_t address, const uint8_t *data, uint32_t length);
+flashReturnMsg_t FlashServ_Flush(void);
+
+// Get write-combining statistics
+void FlashServ_GetWriteBufferStats(FlashServWriteBufferStats_t *stats);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Asynchronous program/erase. Each call queues the operation for the flash task and
+// returns at once with a handle (FLASH_SERV_INVALID_HANDLE if the queue is full).
+// The callback reports the result. Reads issued while the operation runs suspend it,
+// so they are not held up by the erase, unless they overlap what it programs or erases.
+// Those reads, and synchronous writes, flushes, erases, blank checks and CRCs, wait for
+// the operation to complete. They return FLASH_IS_BUSY (false) if it overruns its timeout,
+// or at once on the flash task itself. Write data must stay valid until the callback.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+FlashServOpHandle_t FlashServ_WriteAsync(uint32_t address, const uint8_t *data, uint32_t length,
+                                         FlashServOpCallback_t callback, void *context);
+FlashServOpHandle_t FlashServ_EraseSectorAsync(uint32_t address, FlashServOpCallback_t callback, void *context);
+FlashServOpHandle_t FlashServ_EraseAllAsync(FlashServOpCallback_t callback, void *context);
+
+// Check that a range reads back as erased (all 0xFF)
+bool FlashServ_IsBlank(uint32_t address, uint32_t length);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// CRC-32 (crc/crc.h) of a range as stored on the device, streamed a page at a time
+// so the range never has to fit in RAM. Bytes still in write buffers are not included;
+// call FlashServ_Flush first when they should be.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+flashReturnMsg_t FlashServ_ComputeCrc(uint32_t address, uint32_t length, uint32_t *crc);
+
+// Check a range against a CRC from FlashServ_ComputeCrc or CRC_Compute
+bool FlashServ_VerifyCrc(uint32_t address, uint32_t length, uint32_t expectedCrc);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Background maintenance support. Tasks that call FlashServ_MarkBackgroundTask, up to
+// FLASH_SERV_MAX_BACKGROUND_TASKS, are not counted as foreground I/O, so they can check
+// how long the flash has been idle.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+#define FLASH_SERV_MAX_BACKGROUND_TASKS 2
+void FlashServ_MarkBackgroundTask(void);
+uint32_t FlashServ_MsSinceForegroundAccess(void);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Plan the fewest 64KB, 32KB and 4KB erases that cover [startAddress, endAddress).
+// Both addresses must be sector aligned. Returns false if the range is invalid.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashServ_PlanErase(uint32_t startAddress, uint32_t endAddress, FlashServErasePlan_t *plan);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Erase [startAddress, endAddress) with the planned mix of erases.
+// The plan, if provided, is filled in with the estimated and actual erase time.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+flashReturnMsg_t FlashServ_EraseRange(uint32_t startAddress, uint32_t endAddress, FlashServErasePlan_t *plan);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Per sector wear and error history. Every erase and every failed program or erase is
+// counted here; stores add the corrupt records their scrub finds. The counts live in RAM:
+// RestoreSectorHealth adds counts saved before a reset to the ones since boot.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+void FlashServ_GetSectorHealth(uint32_t sector, FlashServSectorHealth_t *health);
+void FlashServ_RestoreSectorHealth(uint32_t sector, const FlashServSectorHealth_t *health);
+void FlashServ_RecordSectorErrors(uint32_t address, uint32_t errors);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Self-test support (flash-selftest.c). Lock gives direct use of the part from
+// GetDevice; programs and erases issued on it must invalidate the page cache, and
+// erases must be passed to CountErase. StartEraseSector runs an erase on the calling
+// task, to be polled with PollOp until it returns true, so reads can be tested
+// against it from the flash task itself.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+Mx25Device_t *FlashServ_GetDevice(void);
+bool FlashServ_Lock(void);
+void FlashServ_Unlock(void);
+void FlashServ_CountErase(uint32_t address, uint32_t size, flashReturnMsg_t msg);
+flashReturnMsg_t FlashServ_StartEraseSector(uint32_t address);
+bool FlashServ_PollOp(flashReturnMsg_t *result);
@@ -23,15 +23,42 @@ Adaptations Notes:  This flash services module was adapted to communicate
                     The length to write is specified in bytes. A single write operation
                     can only write a maximum of 256 bytes. However, this is managed
                     within flash-services. This means a client CAN provide a write buffer
-                    larger than 256 bytes in size
+                    larger than 256 bytes in size: FlashServ_Write splits it on page
+                    boundaries and issues each page program as soon as the previous one is done.
+
+                    Program and erase can also be queued with the Async functions. The flash task
+                    runs them and calls back on completion. A read arriving while one of them is in
+                    progress suspends it, reads, then resumes it, so reads wait at most the suspend
+                    latency instead of a full tSE/tCE.
+
+                    Small writes can be combined with FlashServ_WriteBuffered: bytes are collected
+                    per page in RAM, each write ANDed in as the device would, and programmed as one
+                    page program. Reads overlay the buffered bytes, and erases drop buffered pages
+                    they cover since the erase would clear them anyway.
+
+                    Reads of up to a page go through a page cache in CCMRAM (flash-cache.c). Every
+                    program and erase issued here invalidates the pages it touches first, so clients
+                    must program and erase through these services rather than the MX25 driver.
+
+                    The flash is put in deep power-down by the flash task once no client has used
+                    it for FLASH_SERV_AUTO_DP_IDLE_MS, and woken inside the lock by the next request.
+                    Clients never see the power state; the wake shows up as tRDP of added latency.
+
+                    The flash task runs the self-tests and benchmarks of flash-selftest.c once the
+                    stores are mounted. The few internals they need are exported as self-test
+                    support at the end of the API.
 
                     A write operation requires that the region of memory being written first be erased.
                     The Flash Services API defines three different region sizes performing erase operations.
                     These are, largest to smallest, Block, Page, and Sector. The API also provides an 'erase
                     all' option to erase the full flash memory.
 
-                    Due to restrictions in the Macronix MX25V driver, this implementation of Flash Services
-                    only supports two region types: Block and Sector.
+                    This implementation of Flash Services supports three region types: 64KB Block,
+                    32KB Block and Sector. FlashServ_EraseRange covers any sector aligned range with
+                    the fewest erases, using the largest aligned region that fits at each step.
+                    The erase sizes, their typical and max times, and the program times come from
+                    the part's SFDP table (MX25_GetGeometry), so a second source part with other
+                    erase types or timings is planned and polled for correctly.
 
                     The erase operation allows the caller to erase any region (Block or Sector)
                     across the full address space. The caller specifies the region to be erased by
@@ -49,19 +76,37 @@ See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
 */
 
 #include "flash-services-api.h"
+#include "flash-cache-api.h"
+#include "flash-maint-api.h"
+#include "flash-scrub-api.h"
+#include "flash-selftest-api.h"
+#include "flash-ftl-api.h"
+#include "flash-log-api.h"
+#include "flash-kv-api.h"
+#include "flash-commit-api.h"
+#include "flash-ts-api.h"
+#include "flash-layout.h"
+
+#include "board-model.h"
+#include "timing/timing.h"
+#include "crc/crc.h"
 
 #include "FreeRTOS.h"
 #include "task.h"
 #include "queue.h"
+#include "semphr.h"
 
-#include <stdlib.h>
+#include <string.h>
 
-#define FLASH_TARGET_ADDR 0x00000000
-#define RANDOM_SEED 106
-#define TRANS_LENGTH 16
+#define FLASH_SERV_MUTEX_TIMEOUT_MS 1000
 
-#define FLASH_EXERCISE_BYTES 64
-#define FLASH_EXERCISE_CYCLES 0x2000 // 2MB/256bytesPerPage = 8192 pages
+#define FLASH_OP_QUEUE_LENGTH 8
+
+#define FLASH_WRITE_BUFFER_PAGES 4
+#define FLASH_WRITE_BUFFER_EMPTY 0xFFFFFFFF
+#define FLASH_WRITE_BUFFER_MASK_WORDS (PAGE_OFFSET / 32)
+#define FLASH_OP_POLL_INTERVAL_MS 1
+#define FLASH_OP_TIMEOUT_MARGIN 2 // Multiple of the datasheet max cycle time
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
 // TASK MEMORY
@@ -69,305 +114,1474 @@ See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
 #define FLASH_STACK_SIZE_IN_WORDS 1024
 static StackType_t xFlashTaskStack[FLASH_STACK_SIZE_IN_WORDS];
 static StaticTask_t xFlashTaskControlBlock;
+static TaskHandle_t xFlashTask = NULL;
 
-/*** Private Functions ***/
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Internal Private Data
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Serializes client access to the flash
+static SemaphoreHandle_t xFlashServMutex = NULL;
+static StaticSemaphore_t xFlashServMutexControlBlock;
 
-/*
- * Simple flash ID test
- */
-static bool flashIdTest(void)
+// The flash part behind these services
+static Mx25Device_t xFlashDevice;
+
+// Set once the driver is initialized by the flash task
+static bool xFlashServReady = false;
+
+static FlashServWriteStats_t xWriteStats = {0};
+
+// Pages collecting FlashServ_WriteBuffered bytes
+typedef struct
 {
-    uint32_t flashId = 0;
-    uint8_t resId = 0;
-    uint16_t remsId = 0;
+    uint32_t PageAddress; // FLASH_WRITE_BUFFER_EMPTY when unused
+    TickType_t FirstWriteTick;
+    uint16_t DirtyCount;
+    uint32_t DirtyMask[FLASH_WRITE_BUFFER_MASK_WORDS];
+    uint8_t Data[PAGE_OFFSET]; // Erased value where not dirty
+} flashWriteBuffer_t;
 
-    flashReturnMsg_t msg = FLASH_WRITE_REG_FAILED;
+static flashWriteBuffer_t xWriteBuffers[FLASH_WRITE_BUFFER_PAGES];
+static FlashServWriteBufferStats_t xWriteBufferStats = {0};
 
-    // Read Manufacturer ID, Memory Type, and Memory Density
-    msg = MX25_RDID(&flashId);
+// Maintenance tasks, whose accesses don't count as foreground I/O
+static TaskHandle_t xBackgroundTasks[FLASH_SERV_MAX_BACKGROUND_TASKS] = {NULL};
+static TickType_t xLastForegroundTick = 0;
 
-    if (msg != FLASH_OPERATION_SUCCESS)
-    {
-        return false;
-    }
-    else
+// Deep power-down state. The last access is any client's, foreground or background.
+static bool xPoweredDown = false;
+static TickType_t xPowerDownTick = 0;
+static TickType_t xLastAccessTick = 0;
+static uint32_t xAutoPowerDownMs = FLASH_SERV_AUTO_DP_IDLE_MS;
+static FlashServPowerStats_t xPowerStats = {0};
+
+// Wear and error history, indexed by sector
+static FlashServSectorHealth_t xSectorHealth[FLASH_SERV_SECTOR_COUNT];
+
+// Page read straight from the device for blank and CRC checks
+static uint8_t xScanBuffer[PAGE_OFFSET];
+
+// Asynchronous program/erase requests
+typedef enum
+{
+    FLASH_OP_WRITE,
+    FLASH_OP_ERASE_SECTOR,
+    FLASH_OP_ERASE_ALL
+} flashOpType_t;
+
+typedef struct
+{
+    flashOpType_t Type;
+    FlashServOpHandle_t Handle;
+    uint32_t Address;
+    const uint8_t *Data;
+    uint32_t Length;
+    FlashServOpCallback_t Callback;
+    void *Context;
+} flashOp_t;
+
+static QueueHandle_t xFlashOpQueue = NULL;
+static StaticQueue_t xFlashOpQueueControlBlock;
+static uint8_t xFlashOpQueueStorage[FLASH_OP_QUEUE_LENGTH * sizeof(flashOp_t)];
+static FlashServOpHandle_t xNextOpHandle = FLASH_SERV_INVALID_HANDLE + 1;
+
+// Operation in progress on the device, only touched with the flash mutex held
+static flashOp_t xActiveOp;
+static bool xOpActive = false;
+static uint32_t xOpOffset = 0;
+static uint32_t xOpTimeoutMs = 0;
+static uint32_t xOpPollMs = FLASH_OP_POLL_INTERVAL_MS;
+static TickType_t xOpStartTick = 0;
+
+/*** Private Functions ***/
+
+// Helper function to check whether the calling task is a background maintenance task
+static bool flashServIsBackgroundTask(void)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    uint32_t i = 0;
+
+    for (i = 0; i < FLASH_SERV_MAX_BACKGROUND_TASKS; i++)
     {
-        if (flashId != FLASH_DEVICE_ID)
+        if ((xBackgroundTasks[i] != NULL) && (xBackgroundTasks[i] == task))
         {
-            printf("Flash ID invalid.\n");
+            return true;
         }
     }
 
-    // Read Electronic ID
-    msg = MX25_RES(&resId);
+    return false;
+}
+
+// Helper function to count an erase against every sector it covers, and its failure
+static void flashServCountErase(uint32_t address, uint32_t size, flashReturnMsg_t msg)
+{
+    uint32_t sector = address / SECTOR_OFFSET;
+    uint32_t endSector = (address + size) / SECTOR_OFFSET;
+
+    taskENTER_CRITICAL();
+    for (; (sector < endSector) && (sector < FLASH_SERV_SECTOR_COUNT); sector++)
+    {
+        xSectorHealth[sector].EraseCount++;
+    }
+    taskEXIT_CRITICAL();
+
     if (msg != FLASH_OPERATION_SUCCESS)
     {
-        return false;
+        FlashServ_RecordSectorErrors(address, 1);
     }
-    else
+}
+
+/*
+ * Bring the flash out of deep power-down, counting the delay it adds to the request
+ */
+static void flashServWake(void)
+{
+    uint32_t startCycles = TIMING_GetCycles();
+    uint32_t latencyUs = 0;
+
+    MX25_WAKE(&xFlashDevice);
+    latencyUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+    xPoweredDown = false;
+
+    taskENTER_CRITICAL();
+    xPowerStats.Wakes++;
+    xPowerStats.TimeInDpMs += (xTaskGetTickCount() - xPowerDownTick) * portTICK_PERIOD_MS;
+    xPowerStats.WakeLatencyUs += latencyUs;
+    if (latencyUs > xPowerStats.WakeLatencyMaxUs)
     {
-        if (resId != ELECTRONIC_ID)
-        {
-            printf("Electronic ID invalid.\n");
-        }
+        xPowerStats.WakeLatencyMaxUs = latencyUs;
     }
+    taskEXIT_CRITICAL();
+}
 
-    // Read Manufacturer ID and Device ID
-    /* Decide remsId order. 0: { manufacturer id, device id }
-                             1: { device id,  manufacturer id } */
-    FlashStatus_t flashState = {0};
-    flashState.ArrangeOpt = 0;
-    msg = MX25_REMS(&remsId, &flashState);
-    if (msg != FLASH_OPERATION_SUCCESS)
+// Helper function to put the flash in deep power-down, with the flash mutex held
+static void flashServPowerDown(void)
+{
+    if (MX25_DP(&xFlashDevice) != FLASH_OPERATION_SUCCESS)
+    {
+        return;
+    }
+
+    xPoweredDown = true;
+    xPowerDownTick = xTaskGetTickCount();
+
+    taskENTER_CRITICAL();
+    xPowerStats.Entries++;
+    taskEXIT_CRITICAL();
+}
+
+// Helper function to take exclusive access to the flash, waking it if powered down
+static bool flashServLock(void)
+{
+    if (!xFlashServReady)
     {
         return false;
     }
-    else
+
+    if (xSemaphoreTake(xFlashServMutex, pdMS_TO_TICKS(FLASH_SERV_MUTEX_TIMEOUT_MS)))
     {
-        if (flashState.ArrangeOpt)
+        xLastAccessTick = xTaskGetTickCount();
+        if (!flashServIsBackgroundTask())
         {
-            if (remsId != REMS_ID_1)
-            {
-                printf("REMS ID invalid.\n");
-                return false;
-            }
+            xLastForegroundTick = xLastAccessTick;
         }
-        else
+
+        if (xPoweredDown)
         {
-            if (remsId != REMS_ID_0)
-            {
-                printf("REMS ID invalid.\n");
-                return false;
-            }
+            flashServWake();
         }
+        return true;
     }
 
-    return true;
+    return false;
 }
 
+static flashReturnMsg_t flashServBufferFlushAll(bool agedOnly);
+
 /*
- * Simple flash read/write test
+ * Release exclusive access to the flash, first programming write buffers past the timeout if
+ * the device is free. Every access drives the timeout this way, so it holds while the flash
+ * task is held up in a long operation or the boot self-tests.
  */
-static bool flashReadWriteTest(void)
+static void flashServUnlock(void)
+{
+    if (!xPoweredDown && !xOpActive)
+    {
+        flashServBufferFlushAll(true);
+    }
+
+    xSemaphoreGive(xFlashServMutex);
+}
+
+// Helper function to get the longest a page program can take, from the part's geometry
+static uint32_t flashServProgramMaxMs(void)
 {
-    flashReturnMsg_t msg = FLASH_WRITE_REG_FAILED;
+    return (MX25_GetGeometry(&xFlashDevice)->ProgramMaxUs + 999) / 1000;
+}
 
-    uint32_t flashAddr = FLASH_TARGET_ADDR;
-    uint32_t transLen = TRANS_LENGTH;
-    uint8_t memoryAddr[TRANS_LENGTH] = {0};
-    uint8_t memoryAddrCmp[TRANS_LENGTH] = {0};
+/*
+ * Program any length of data split on page boundaries, one page program per page.
+ * Each program command goes out as soon as the wait sees the previous one done.
+ */
+static flashReturnMsg_t flashServProgram(uint32_t address, const uint8_t *data, uint32_t length)
+{
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+    uint32_t chunkLength = 0;
+    uint32_t pageAddress = address;
+    uint32_t nextAddress = address;
+    const uint8_t *nextData = data;
+    uint32_t remaining = length;
+    uint32_t startCycles = TIMING_GetCycles();
 
-    uint16_t i = 0;
+    FlashCache_Invalidate(address, length);
 
-    // Generate data to write to flash
-    // Seed the random number generator
-    srand(RANDOM_SEED);
-    for (i = 0; i < transLen; i = i + 1)
+    while (remaining > 0)
     {
-        // Generate random byte data
-        memoryAddr[i] = rand() % 256;
+        chunkLength = FlashServ_PageChunk(nextAddress, remaining);
+        pageAddress = nextAddress;
+        msg = MX25_PPStart(&xFlashDevice, nextAddress, (uint8_t *)nextData, chunkLength);
+        if (msg != FLASH_OPERATION_SUCCESS)
+        {
+            break;
+        }
+        xWriteStats.PagesProgrammed++;
+
+        nextAddress += chunkLength;
+        nextData += chunkLength;
+        remaining -= chunkLength;
+
+        msg = MX25_WaitReady(&xFlashDevice, flashServProgramMaxMs());
+        if (msg != FLASH_OPERATION_SUCCESS)
+        {
+            break;
+        }
     }
 
-    // Erase 4K sector of flash memory
-    msg = MX25_SE(flashAddr);
-    if (msg != FLASH_OPERATION_SUCCESS)
+    xWriteStats.BytesWritten += (length - remaining);
+    xWriteStats.ElapsedUs += TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+    if (xWriteStats.ElapsedUs > 0)
     {
-        printf("Failed to erase flash memory.\n");
-        return false;
+        xWriteStats.ThroughputKBps = ((uint64_t)xWriteStats.BytesWritten * 1000) / xWriteStats.ElapsedUs;
     }
 
-    // Program data to flash memory
-    msg = MX25_PP(flashAddr, memoryAddr, transLen);
     if (msg != FLASH_OPERATION_SUCCESS)
     {
-        printf("Failed to program flash memory.\n");
-        return false;
+        FlashServ_RecordSectorErrors(pageAddress, 1);
     }
 
-    msg = MX25_READ(flashAddr, memoryAddrCmp, transLen);
-    if (msg != FLASH_OPERATION_SUCCESS)
+    return msg;
+}
+
+// Helper function to check whether a byte of a write buffer holds written data
+static bool flashServBufferDirty(const flashWriteBuffer_t *buffer, uint32_t offset)
+{
+    return (buffer->DirtyMask[offset / 32] & (1UL << (offset % 32))) != 0;
+}
+
+// Helper function to return a write buffer to the free pool
+static void flashServBufferRelease(flashWriteBuffer_t *buffer)
+{
+    buffer->PageAddress = FLASH_WRITE_BUFFER_EMPTY;
+    buffer->DirtyCount = 0;
+    memset(buffer->DirtyMask, 0, sizeof(buffer->DirtyMask));
+    memset(buffer->Data, 0xFF, sizeof(buffer->Data));
+}
+
+/*
+ * Program the written span of a buffered page with a single page program.
+ * Bytes inside the span that were never written are 0xFF and leave the device unchanged.
+ */
+static flashReturnMsg_t flashServBufferFlush(flashWriteBuffer_t *buffer)
+{
+    uint32_t first = 0;
+    uint32_t last = PAGE_OFFSET - 1;
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if (buffer->PageAddress == FLASH_WRITE_BUFFER_EMPTY)
     {
-        printf("Failed to read flash memory.\n");
-        return false;
+        return FLASH_OPERATION_SUCCESS;
     }
 
-    // Compare original data and flash data
-    for (i = 0; i < (transLen); i = i + 1)
+    while (!flashServBufferDirty(buffer, first))
     {
-        if (memoryAddr[i] != memoryAddrCmp[i])
-        {
-            printf("Data written to flash memory doesn't match data read.\n");
-            return false;
-        }
+        first++;
+    }
+    while (!flashServBufferDirty(buffer, last))
+    {
+        last--;
     }
 
-    // Erase 4K sector of flash memory
-    msg = MX25_SE(flashAddr);
-    if (msg != FLASH_OPERATION_SUCCESS)
+    msg = flashServProgram(buffer->PageAddress + first, &buffer->Data[first], last - first + 1);
+    if (msg == FLASH_OPERATION_SUCCESS)
     {
-        printf("Failed to reset flash memory.\n");
-        return false;
+        xWriteBufferStats.PagePrograms++;
+        flashServBufferRelease(buffer);
     }
 
-    return true;
+    return msg;
 }
 
-/*
- * Flash exercise to write to all pages and read data back to confirm values
- */
-static bool flashReadWriteExercise(void)
+// Helper function to drop buffered pages inside an erased range
+static void flashServBufferDiscard(uint32_t address, uint32_t length)
 {
-    uint32_t dataLength = FLASH_EXERCISE_BYTES;
-    uint32_t index = 0;
-    flashReturnMsg_t msg = FLASH_OPERATION_FAILED;
-    uint8_t readBuffer[FLASH_EXERCISE_BYTES] = {0};
-    uint32_t startAddress = 0;
-    uint8_t writeBuffer[FLASH_EXERCISE_BYTES] = {0};
+    uint32_t i = 0;
 
-    // Fill up the write buffer
-    for (index = 0; index < FLASH_EXERCISE_BYTES; index++)
+    for (i = 0; i < FLASH_WRITE_BUFFER_PAGES; i++)
     {
-        writeBuffer[index] = index;
+        if ((xWriteBuffers[i].PageAddress != FLASH_WRITE_BUFFER_EMPTY) &&
+            (xWriteBuffers[i].PageAddress >= address) && (xWriteBuffers[i].PageAddress < (address + length)))
+        {
+            flashServBufferRelease(&xWriteBuffers[i]);
+        }
     }
+}
 
-    // Bulk erase
-    printf("Erasing flash\n");
-    msg = MX25_CE();
-    if (msg != FLASH_OPERATION_SUCCESS)
-    {
-        printf("Failed to Chip Erase.\n");
-        return false;
-    }
-    printf("Erase flash complete");
+// Helper function to apply buffered bytes to data read from the device
+static void flashServBufferOverlay(uint32_t address, uint8_t *data, uint32_t length)
+{
+    const flashWriteBuffer_t *buffer = NULL;
+    uint32_t start = 0;
+    uint32_t end = 0;
+    uint32_t i = 0;
+    uint32_t offset = 0;
 
-    // Cycle through all of flash
-    for (index = 0; index < FLASH_EXERCISE_CYCLES; index++)
+    for (i = 0; i < FLASH_WRITE_BUFFER_PAGES; i++)
     {
-        // Assign memory address
-        startAddress = index * FLASH_EXERCISE_BYTES;
-
-        // Write
-        msg = MX25_PP(startAddress, writeBuffer, dataLength);
-        if (msg != FLASH_OPERATION_SUCCESS)
+        buffer = &xWriteBuffers[i];
+        if ((buffer->PageAddress == FLASH_WRITE_BUFFER_EMPTY) || (buffer->PageAddress >= (address + length)) ||
+            ((buffer->PageAddress + PAGE_OFFSET) <= address))
         {
-            printf("Failed to program flash at cycle %ld\n", index);
-            return false;
+            continue;
         }
 
-        // Delay
-        vTaskDelay(pdMS_TO_TICKS(5));
+        start = (buffer->PageAddress > address) ? buffer->PageAddress : address;
+        end = buffer->PageAddress + PAGE_OFFSET;
+        if (end > (address + length))
+        {
+            end = address + length;
+        }
 
-        // Read
-        msg = MX25_READ(startAddress, readBuffer, dataLength);
-        if (msg != FLASH_OPERATION_SUCCESS)
+        for (; start < end; start++)
         {
-            printf("Failed to read flash at cycle %ld\n", index);
-            return false;
+            offset = start - buffer->PageAddress;
+            if (flashServBufferDirty(buffer, offset))
+            {
+                data[start - address] &= buffer->Data[offset];
+            }
         }
+    }
+}
 
-        // Delay
-        vTaskDelay(pdMS_TO_TICKS(3));
+/*
+ * Flush buffered pages, only those older than the timeout if agedOnly is set
+ */
+static flashReturnMsg_t flashServBufferFlushAll(bool agedOnly)
+{
+    TickType_t now = xTaskGetTickCount();
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+    uint32_t i = 0;
+
+    for (i = 0; (i < FLASH_WRITE_BUFFER_PAGES) && (msg == FLASH_OPERATION_SUCCESS); i++)
+    {
+        if (xWriteBuffers[i].PageAddress == FLASH_WRITE_BUFFER_EMPTY)
+        {
+            continue;
+        }
 
-        // Compare
-        printf("Flash Exercise Cycle: %lu\n", index);
-        for (uint32_t i = 0; i < FLASH_EXERCISE_BYTES; i++)
+        if (agedOnly)
         {
-            if (readBuffer[i] != i)
+            if ((now - xWriteBuffers[i].FirstWriteTick) < pdMS_TO_TICKS(FLASH_SERV_WRITE_BUFFER_TIMEOUT_MS))
             {
-                printf("Flash test failed: Unexpected byte at index %ld\n", i);
-                return false;
+                continue;
             }
+            xWriteBufferStats.TimeoutFlushes++;
         }
+
+        msg = flashServBufferFlush(&xWriteBuffers[i]);
     }
 
-    return true;
+    return msg;
 }
 
-// -----------------------------------------------------------------------------+-
-// Wait for semaphore to be given which signals data is available.
-// Once given, parse command and dispatch same.
-// -----------------------------------------------------------------------------+-
-static void flashTaskCode(void *arg)
+/*
+ * Find the buffer collecting a page, starting one if needed.
+ * When every buffer is in use the one started first is flushed to make room.
+ */
+static flashWriteBuffer_t *flashServBufferFor(uint32_t pageAddress, flashReturnMsg_t *msg)
 {
-    bool result = false;
+    flashWriteBuffer_t *unused = NULL;
+    flashWriteBuffer_t *oldest = NULL;
+    uint32_t i = 0;
 
-    // Initialize flash
-    result = MX25_Init();
+    *msg = FLASH_OPERATION_SUCCESS;
 
-    if (result == false)
+    for (i = 0; i < FLASH_WRITE_BUFFER_PAGES; i++)
     {
-        printf("Failed to init flash driver");
+        if (xWriteBuffers[i].PageAddress == pageAddress)
+        {
+            return &xWriteBuffers[i];
+        }
+
+        if (xWriteBuffers[i].PageAddress == FLASH_WRITE_BUFFER_EMPTY)
+        {
+            unused = (unused == NULL) ? &xWriteBuffers[i] : unused;
+        }
+        else if ((oldest == NULL) ||
+                 ((int32_t)(xWriteBuffers[i].FirstWriteTick - oldest->FirstWriteTick) < 0))
+        {
+            oldest = &xWriteBuffers[i];
+        }
     }
-    else
+
+    if (unused == NULL)
     {
-        printf("Flash Init Complete\n");
+        *msg = flashServBufferFlush(oldest);
+        if (*msg != FLASH_OPERATION_SUCCESS)
+        {
+            return NULL;
+        }
+        xWriteBufferStats.EvictionFlushes++;
+        unused = oldest;
     }
 
-    // Warm up time delay
-    vTaskDelay(pdMS_TO_TICKS(FLASH_FULL_ACCESS_TIME));
+    unused->PageAddress = pageAddress;
+    unused->FirstWriteTick = xTaskGetTickCount();
 
-    // Test Flash ID
-    result = flashIdTest();
-    if (result == false)
+    return unused;
+}
+
+
+/*
+ * Issue the page program for the next part of the active write
+ */
+static flashReturnMsg_t flashServOpNextPage(void)
+{
+    flashReturnMsg_t msg = FLASH_OPERATION_FAILED;
+    uint32_t address = xActiveOp.Address + xOpOffset;
+    uint32_t chunkLength = FlashServ_PageChunk(address, xActiveOp.Length - xOpOffset);
+
+    msg = MX25_PPStart(&xFlashDevice, address, (uint8_t *)&xActiveOp.Data[xOpOffset], chunkLength);
+    if (msg == FLASH_OPERATION_SUCCESS)
     {
-        printf("Flash ID test failed.\n");
+        xOpOffset += chunkLength;
+        xOpTimeoutMs = flashServProgramMaxMs();
+        xOpPollMs = MX25_PollIntervalMs(MX25_GetGeometry(&xFlashDevice)->ProgramTypicalUs / 1000);
+        xOpStartTick = xTaskGetTickCount();
     }
-    else
+
+    return msg;
+}
+
+/*
+ * Start an asynchronous operation on the device
+ */
+static flashReturnMsg_t flashServStartOp(const flashOp_t *op)
+{
+    const FlashGeometry_t *geometry = MX25_GetGeometry(&xFlashDevice);
+    const FlashEraseType_t *sectorErase = SFDP_FindErase(geometry, SECTOR_OFFSET);
+    flashReturnMsg_t msg = FLASH_OPERATION_FAILED;
+
+    if (!flashServLock())
     {
-        printf("Flash ID test passed.\n");
+        return FLASH_IS_BUSY;
     }
 
-    result = flashReadWriteTest();
-    if (result == false)
+    xActiveOp = *op;
+    xOpOffset = 0;
+
+    switch (op->Type)
     {
-        printf("Flash Read Write test failed.\n");
+    case FLASH_OP_WRITE:
+        FlashCache_Invalidate(op->Address, op->Length);
+        msg = flashServOpNextPage();
+        break;
+    case FLASH_OP_ERASE_SECTOR:
+        FlashCache_Invalidate(op->Address, SECTOR_OFFSET);
+        flashServBufferDiscard(op->Address, SECTOR_OFFSET);
+        msg = MX25_SEStart(&xFlashDevice, op->Address);
+        xOpTimeoutMs = sectorErase->MaxMs;
+        xOpPollMs = MX25_PollIntervalMs(sectorErase->TypicalMs);
+        break;
+    case FLASH_OP_ERASE_ALL:
+        FlashCache_Invalidate(0, FLASH_SIZE);
+        flashServBufferDiscard(0, FLASH_SIZE);
+        msg = MX25_CEStart(&xFlashDevice);
+        xOpTimeoutMs = geometry->ChipEraseMaxMs;
+        xOpPollMs = MX25_PollIntervalMs(geometry->ChipEraseTypicalMs);
+        break;
+    default:
+        break;
     }
-    else
+
+    if (op->Type == FLASH_OP_ERASE_SECTOR)
     {
-        printf("Flash Read Write test passed.\n");
+        flashServCountErase(op->Address, SECTOR_OFFSET, msg);
+    }
+    else if (op->Type == FLASH_OP_ERASE_ALL)
+    {
+        flashServCountErase(0, FLASH_SIZE, msg);
+    }
+
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        xOpStartTick = xTaskGetTickCount();
+        xOpActive = true;
     }
 
-    vTaskDelay(pdMS_TO_TICKS(1000));
+    flashServUnlock();
 
-    result = flashReadWriteExercise();
-    if (result == false)
+    return msg;
+}
+
+/*
+ * Check on the active operation and issue the next page of a write.
+ * Returns true once the operation is complete, with its outcome in result.
+ */
+static bool flashServPollOp(flashReturnMsg_t *result)
+{
+    bool done = false;
+
+    if (!flashServLock())
+    {
+        return false;
+    }
+
+    if (MX25_IsBusy(&xFlashDevice))
     {
-        printf("Flash Read Write Exercise failed.\n");
+        if ((xTaskGetTickCount() - xOpStartTick) > pdMS_TO_TICKS(xOpTimeoutMs * FLASH_OP_TIMEOUT_MARGIN))
+        {
+            *result = FLASH_TIME_OUT;
+            done = true;
+        }
     }
     else
     {
-        printf("Flash Read Write Exercise passed.\n");
+        *result = MX25_CheckResult(&xFlashDevice);
+        if ((*result == FLASH_OPERATION_SUCCESS) && (xActiveOp.Type == FLASH_OP_WRITE) &&
+            (xOpOffset < xActiveOp.Length))
+        {
+            // The device is free between pages
+            flashServBufferFlushAll(true);
+            *result = flashServOpNextPage();
+            done = (*result != FLASH_OPERATION_SUCCESS);
+        }
+        else
+        {
+            done = true;
+        }
     }
 
-    for (;;)
+    if (done)
     {
-        vTaskDelay(pdMS_TO_TICKS(200));
+        xOpActive = false;
+        if (*result != FLASH_OPERATION_SUCCESS)
+        {
+            // The page or sector the device was working on
+            FlashServ_RecordSectorErrors(xActiveOp.Address + ((xOpOffset > 0) ? (xOpOffset - 1) : 0), 1);
+        }
     }
-}
 
-/*** Public Functions ***/
+    flashServUnlock();
+
+    return done;
+}
 
 /*
- * Function to set flash to DeepPowerDown mode
+ * Run an asynchronous operation to completion, polling a few times per typical duration
  */
-void FlashServ_LowPowerMode(void)
+static flashReturnMsg_t flashServRunOp(const flashOp_t *op)
+{
+    flashReturnMsg_t msg = flashServStartOp(op);
+
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        return msg;
+    }
+
+    while (!flashServPollOp(&msg))
+    {
+        vTaskDelay(pdMS_TO_TICKS(xOpPollMs));
+    }
+
+    return msg;
+}
+
+// Helper function to check whether a range overlaps the flash the active operation changes
+static bool flashServOpOverlaps(uint32_t address, uint32_t length)
 {
-    MX25_DP();
+    uint32_t opAddress = xActiveOp.Address;
+    uint32_t opLength = xActiveOp.Length;
+
+    if (xActiveOp.Type == FLASH_OP_ERASE_SECTOR)
+    {
+        opLength = SECTOR_OFFSET;
+    }
+    else if (xActiveOp.Type == FLASH_OP_ERASE_ALL)
+    {
+        opAddress = 0;
+        opLength = FLASH_SIZE;
+    }
+
+    return (address < (opAddress + opLength)) && (opAddress < (address + length));
 }
 
 /*
- * Function to wake up the flash from DeepPowerDown mode to StandBy mode
+ * Take exclusive access to the flash once no asynchronous operation overlaps a range, waiting
+ * for the flash task to complete it. Pass the whole flash to wait for any operation.
+ * The wait ends with false past the operation's own timeout, and at once on the flash task,
+ * which runs the operations and can't wait for itself.
  */
-void FlashServ_WakeFromLowPowerMode(void)
+static bool flashServLockAfterOp(uint32_t address, uint32_t length)
 {
-    MX25_WAKE();
-}
+    uint32_t pollMs = 0;
+
+    if (!flashServLock())
+    {
+        return false;
+    }
+
+    while (xOpActive && flashServOpOverlaps(address, length))
+    {
+        if ((xTaskGetCurrentTaskHandle() == xFlashTask) ||
+            ((xTaskGetTickCount() - xOpStartTick) >
+             pdMS_TO_TICKS((xOpTimeoutMs * FLASH_OP_TIMEOUT_MARGIN) + FLASH_SERV_MUTEX_TIMEOUT_MS)))
+        {
+            flashServUnlock();
+            return false;
+        }
+
+        pollMs = xOpPollMs;
+        flashServUnlock();
+        vTaskDelay(pdMS_TO_TICKS(pollMs));
+
+        if (!flashServLock())
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Queue an asynchronous operation for the flash task
+ */
+static FlashServOpHandle_t flashServSubmitOp(flashOp_t *op)
+{
+    taskENTER_CRITICAL();
+    op->Handle = xNextOpHandle++;
+    if (xNextOpHandle == FLASH_SERV_INVALID_HANDLE)
+    {
+        xNextOpHandle++;
+    }
+    taskEXIT_CRITICAL();
+
+    if (xQueueSend(xFlashOpQueue, op, 0) != pdPASS)
+    {
+        return FLASH_SERV_INVALID_HANDLE;
+    }
+
+    return op->Handle;
+}
+
+/*
+ * Pick the largest erase of the part that is aligned at address and fits before endAddress.
+ * Erases above 64KB are left out: the flash layout regions are only 64KB aligned.
+ */
+static const FlashEraseType_t *flashServNextErase(uint32_t address, uint32_t endAddress)
+{
+    const FlashGeometry_t *geometry = MX25_GetGeometry(&xFlashDevice);
+    uint32_t i = 0;
+
+    for (i = 0; i < SFDP_ERASE_TYPES; i++)
+    {
+        if ((geometry->Erase[i].Size >= SECTOR_OFFSET) && (geometry->Erase[i].Size <= BLOCK_OFFSET) &&
+            ((address % geometry->Erase[i].Size) == 0) && ((endAddress - address) >= geometry->Erase[i].Size))
+        {
+            return &geometry->Erase[i];
+        }
+    }
+
+    return SFDP_FindErase(geometry, SECTOR_OFFSET);
+}
+
+// Helper function to check whether any write buffer holds data
+static bool flashServBufferPending(void)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < FLASH_WRITE_BUFFER_PAGES; i++)
+    {
+        if (xWriteBuffers[i].PageAddress != FLASH_WRITE_BUFFER_EMPTY)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Flash task housekeeping, with the flash mutex taken directly so it neither counts as an
+ * access nor wakes the flash: program aged write buffers, then enter deep power-down once
+ * the flash has been idle for the configured time with nothing left pending.
+ */
+static void flashServIdleWork(void)
+{
+    if (xPoweredDown || xOpActive)
+    {
+        return;
+    }
+
+    flashServBufferFlushAll(true);
+
+    if ((xAutoPowerDownMs == 0) || flashServBufferPending() || (uxQueueMessagesWaiting(xFlashOpQueue) > 0) ||
+        ((xTaskGetTickCount() - xLastAccessTick) < pdMS_TO_TICKS(xAutoPowerDownMs)))
+    {
+        return;
+    }
+
+    flashServPowerDown();
+}
+
+// -----------------------------------------------------------------------------+-
+// Wait for semaphore to be given which signals data is available.
+// Once given, parse command and dispatch same.
+// -----------------------------------------------------------------------------+-
+static void flashTaskCode(void *arg)
+{
+    bool result = false;
+    flashOp_t op = {0};
+    flashReturnMsg_t msg = FLASH_OPERATION_FAILED;
+
+    // Initialize flash
+    result = MX25_Init(&xFlashDevice, PORT(FLASH_CS), PIN(FLASH_CS), MX25_FLASH);
+
+    if (result == false)
+    {
+        printf("Failed to init flash driver");
+    }
+    else
+    {
+        printf("Flash Init Complete\n");
+        printf("Flash geometry from %s: %lu KB, %lu KB largest erase\n",
+               MX25_GetGeometry(&xFlashDevice)->FromSfdp ? "SFDP" : "defaults",
+               (unsigned long)(MX25_GetGeometry(&xFlashDevice)->DeviceSize / 1024),
+               (unsigned long)(MX25_GetGeometry(&xFlashDevice)->Erase[0].Size / 1024));
+
+        if (MX25_GetGeometry(&xFlashDevice)->DeviceSize < FLASH_SIZE)
+        {
+            printf("Flash is smaller than the flash layout\n");
+            result = false;
+        }
+    }
+
+    // Warm up time delay
+    vTaskDelay(pdMS_TO_TICKS(FLASH_FULL_ACCESS_TIME));
+
+    FlashCache_Init(&xFlashDevice);
+    xFlashServReady = result;
+
+    // Rebuild the translation layer mapping from flash
+    if (result && !FlashFtl_Mount())
+    {
+        printf("Failed to mount FTL\n");
+    }
+
+    // Find the end of the record log
+    if (result && !FlashLog_Mount())
+    {
+        printf("Failed to mount log\n");
+    }
+
+    // Rebuild the key-value index
+    if (result && !FlashKv_Mount())
+    {
+        printf("Failed to mount KV store\n");
+    }
+
+    // Find the latest complete commit
+    if (result && !FlashCommit_Mount())
+    {
+        printf("Failed to mount commit area\n");
+    }
+
+    // Rebuild the time-series chunk index
+    if (result && !FlashTs_Mount())
+    {
+        printf("Failed to mount time-series store\n");
+    }
+
+    // Check the part and the stores, and measure them
+    FlashSelfTest_Run();
+
+    // Keep sectors erased ahead of the stores from here on
+    FlashMaint_Start();
+
+    // Check the stored records in the background within the scrub budget
+    FlashScrub_Start();
+
+    for (;;)
+    {
+        if (xQueueReceive(xFlashOpQueue, &op, pdMS_TO_TICKS(FLASH_SERV_WRITE_BUFFER_TIMEOUT_MS)) == pdPASS)
+        {
+            msg = flashServRunOp(&op);
+
+            if (op.Callback != NULL)
+            {
+                op.Callback(op.Handle, msg, op.Context);
+            }
+        }
+
+        // Program buffered pages that have waited long enough, power down when idle
+        if (xFlashServReady && xSemaphoreTake(xFlashServMutex, pdMS_TO_TICKS(FLASH_SERV_MUTEX_TIMEOUT_MS)))
+        {
+            flashServIdleWork();
+            flashServUnlock();
+        }
+    }
+}
+
+/*** Public Functions ***/
+
+/*
+ * Function to set flash to DeepPowerDown mode. Buffered writes are programmed first;
+ * an asynchronous operation in progress keeps the flash awake.
+ */
+void FlashServ_LowPowerMode(void)
+{
+    if (!flashServLock())
+    {
+        return;
+    }
+
+    if (!xOpActive && (flashServBufferFlushAll(false) == FLASH_OPERATION_SUCCESS))
+    {
+        flashServPowerDown();
+    }
+
+    flashServUnlock();
+}
+
+/*
+ * Function to wake up the flash from DeepPowerDown mode to StandBy mode
+ */
+void FlashServ_WakeFromLowPowerMode(void)
+{
+    if (flashServLock())
+    {
+        flashServUnlock();
+    }
+}
+
+/*
+ * Function to set the idle time before automatic deep power-down, 0 to turn it off
+ */
+void FlashServ_SetAutoPowerDown(uint32_t idleMs)
+{
+    xAutoPowerDownMs = idleMs;
+}
+
+/*
+ * Function to get the deep power-down statistics
+ */
+void FlashServ_GetPowerStats(FlashServPowerStats_t *stats)
+{
+    taskENTER_CRITICAL();
+    *stats = xPowerStats;
+    stats->IdleMs = xAutoPowerDownMs;
+    if (xPoweredDown)
+    {
+        stats->TimeInDpMs += (xTaskGetTickCount() - xPowerDownTick) * portTICK_PERIOD_MS;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * Function to read any length of data from flash
+ */
+flashReturnMsg_t FlashServ_Read(uint32_t address, uint8_t *data, uint32_t length)
+{
+    flashReturnMsg_t msg = FLASH_OPERATION_FAILED;
+    bool suspended = false;
+    TickType_t suspendTick = 0;
+
+    if ((data == NULL) || (address + length > FLASH_SIZE))
+    {
+        return FLASH_ADDRESS_INVALID;
+    }
+
+    // Wait out a program/erase of the range, the part can't return what it is changing
+    if (!flashServLockAfterOp(address, length))
+    {
+        return FLASH_IS_BUSY;
+    }
+
+    // Suspend a program/erase elsewhere rather than wait for it
+    if (xOpActive)
+    {
+        msg = MX25_Suspend(&xFlashDevice);
+        if (msg == FLASH_OPERATION_SUCCESS)
+        {
+            suspended = true;
+            suspendTick = xTaskGetTickCount();
+        }
+        else if (msg == FLASH_TIME_OUT)
+        {
+            flashServUnlock();
+            return FLASH_IS_BUSY;
+        }
+        // Otherwise the cycle already finished and the array is readable
+    }
+
+    // Pages may be half programmed or erased until the operation completes, don't cache them
+    msg = FlashCache_Read(address, data, length, !xOpActive);
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        flashServBufferOverlay(address, data, length);
+    }
+
+    if (suspended)
+    {
+        if ((MX25_Resume(&xFlashDevice) != FLASH_OPERATION_SUCCESS) && (msg == FLASH_OPERATION_SUCCESS))
+        {
+            msg = FLASH_OPERATION_FAILED;
+        }
+
+        // Time spent suspended doesn't count towards the operation timeout
+        xOpStartTick += xTaskGetTickCount() - suspendTick;
+    }
+
+    flashServUnlock();
+
+    return msg;
+}
+
+/*
+ * Function to write any length of data to erased flash
+ */
+flashReturnMsg_t FlashServ_Write(uint32_t address, const uint8_t *data, uint32_t length)
+{
+    flashReturnMsg_t msg = FLASH_OPERATION_FAILED;
+
+    if ((data == NULL) || (address + length > FLASH_SIZE))
+    {
+        return FLASH_ADDRESS_INVALID;
+    }
+
+    // The device belongs to the asynchronous operation until it completes
+    if (!flashServLockAfterOp(0, FLASH_SIZE))
+    {
+        return FLASH_IS_BUSY;
+    }
+
+    msg = flashServProgram(address, data, length);
+
+    flashServUnlock();
+
+    return msg;
+}
+
+/*
+ * Function to get the length of the page program at the start of a write
+ */
+uint32_t FlashServ_PageChunk(uint32_t address, uint32_t length)
+{
+    uint32_t chunkLength = PAGE_OFFSET - (address % PAGE_OFFSET);
+
+    return (chunkLength < length) ? chunkLength : length;
+}
+
+/*
+ * Function to collect small writes into page programs
+ */
+flashReturnMsg_t FlashServ_WriteBuffered(uint32_t address, const uint8_t *data, uint32_t length)
+{
+    flashWriteBuffer_t *buffer = NULL;
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+    uint32_t pageAddress = 0;
+    uint32_t offset = 0;
+    uint32_t i = 0;
+
+    if ((data == NULL) || (address + length > FLASH_SIZE))
+    {
+        return FLASH_ADDRESS_INVALID;
+    }
+
+    // Buffering may need to flush, and the device belongs to the asynchronous operation
+    if (!flashServLockAfterOp(0, FLASH_SIZE))
+    {
+        return FLASH_IS_BUSY;
+    }
+
+    xWriteBufferStats.Writes++;
+
+    for (i = 0; (i < length) && (msg == FLASH_OPERATION_SUCCESS); i++)
+    {
+        pageAddress = (address + i) & ~(PAGE_OFFSET - 1);
+        if ((buffer == NULL) || (buffer->PageAddress != pageAddress))
+        {
+            buffer = flashServBufferFor(pageAddress, &msg);
+            if (buffer == NULL)
+            {
+                break;
+            }
+        }
+
+        offset = (address + i) - pageAddress;
+        if (!flashServBufferDirty(buffer, offset))
+        {
+            buffer->DirtyMask[offset / 32] |= (1UL << (offset % 32));
+            buffer->DirtyCount++;
+        }
+
+        // Programming an already written byte can only clear more bits
+        buffer->Data[offset] &= data[i];
+        xWriteBufferStats.BytesBuffered++;
+
+        if (buffer->DirtyCount == PAGE_OFFSET)
+        {
+            xWriteBufferStats.FullPageFlushes++;
+            msg = flashServBufferFlush(buffer);
+            buffer = NULL;
+        }
+    }
+
+    flashServUnlock();
+
+    return msg;
+}
+
+/*
+ * Function to program every buffered page
+ */
+flashReturnMsg_t FlashServ_Flush(void)
+{
+    flashReturnMsg_t msg = FLASH_OPERATION_FAILED;
+
+    if (!flashServLockAfterOp(0, FLASH_SIZE))
+    {
+        return FLASH_IS_BUSY;
+    }
+
+    msg = flashServBufferFlushAll(false);
+
+    flashServUnlock();
+
+    return msg;
+}
+
+/*
+ * Function to check a range reads as erased
+ */
+bool FlashServ_IsBlank(uint32_t address, uint32_t length)
+{
+    uint32_t chunkLength = 0;
+    uint32_t i = 0;
+    bool blank = true;
+
+    if (address + length > FLASH_SIZE)
+    {
+        return false;
+    }
+
+    while ((length > 0) && blank)
+    {
+        chunkLength = (length > PAGE_OFFSET) ? PAGE_OFFSET : length;
+
+        // Lock each page on its own so foreground I/O can get in between
+        if (!flashServLockAfterOp(0, FLASH_SIZE))
+        {
+            return false;
+        }
+
+        // Straight from the device: a page cached before the erase must not hide a bad one
+        if (MX25_READ(&xFlashDevice, address, xScanBuffer, chunkLength) != FLASH_OPERATION_SUCCESS)
+        {
+            blank = false;
+        }
+
+        for (i = 0; (i < chunkLength) && blank; i++)
+        {
+            blank = (xScanBuffer[i] == 0xFF);
+        }
+
+        flashServUnlock();
+
+        address += chunkLength;
+        length -= chunkLength;
+    }
+
+    return blank;
+}
+
+/*
+ * Function to compute the CRC of a range without holding it in RAM
+ */
+flashReturnMsg_t FlashServ_ComputeCrc(uint32_t address, uint32_t length, uint32_t *crc)
+{
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+    uint32_t chunkLength = 0;
+
+    *crc = CRC_INITIAL_VALUE;
+
+    if (address + length > FLASH_SIZE)
+    {
+        return FLASH_ADDRESS_INVALID;
+    }
+
+    while ((length > 0) && (msg == FLASH_OPERATION_SUCCESS))
+    {
+        chunkLength = (length > PAGE_OFFSET) ? PAGE_OFFSET : length;
+
+        // Lock each page on its own so other clients can get in between
+        if (!flashServLockAfterOp(0, FLASH_SIZE))
+        {
+            return FLASH_IS_BUSY;
+        }
+
+        // Straight from the device so the check covers what is stored, not what is cached
+        msg = MX25_READ(&xFlashDevice, address, xScanBuffer, chunkLength);
+        if (msg == FLASH_OPERATION_SUCCESS)
+        {
+            *crc = CRC_Accumulate(*crc, xScanBuffer, chunkLength);
+        }
+
+        flashServUnlock();
+
+        address += chunkLength;
+        length -= chunkLength;
+    }
+
+    return msg;
+}
+
+/*
+ * Function to check a range against a CRC
+ */
+bool FlashServ_VerifyCrc(uint32_t address, uint32_t length, uint32_t expectedCrc)
+{
+    uint32_t crc = 0;
+
+    return (FlashServ_ComputeCrc(address, length, &crc) == FLASH_OPERATION_SUCCESS) && (crc == expectedCrc);
+}
+
+/*
+ * Function to mark the calling task as background maintenance
+ */
+void FlashServ_MarkBackgroundTask(void)
+{
+    uint32_t i = 0;
+
+    taskENTER_CRITICAL();
+    for (i = 0; i < FLASH_SERV_MAX_BACKGROUND_TASKS; i++)
+    {
+        if (xBackgroundTasks[i] == NULL)
+        {
+            xBackgroundTasks[i] = xTaskGetCurrentTaskHandle();
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * Function to get the time since a foreground task last used the flash
+ */
+uint32_t FlashServ_MsSinceForegroundAccess(void)
+{
+    return (xTaskGetTickCount() - xLastForegroundTick) * portTICK_PERIOD_MS;
+}
+
+/*
+ * Function to get the wear and error history of a sector
+ */
+void FlashServ_GetSectorHealth(uint32_t sector, FlashServSectorHealth_t *health)
+{
+    if (sector >= FLASH_SERV_SECTOR_COUNT)
+    {
+        memset(health, 0, sizeof(*health));
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    *health = xSectorHealth[sector];
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * Function to add the wear and error history saved before a reset
+ */
+void FlashServ_RestoreSectorHealth(uint32_t sector, const FlashServSectorHealth_t *health)
+{
+    if (sector >= FLASH_SERV_SECTOR_COUNT)
+    {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    xSectorHealth[sector].EraseCount += health->EraseCount;
+    xSectorHealth[sector].Errors += health->Errors;
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * Function to count errors against the sector holding an address
+ */
+void FlashServ_RecordSectorErrors(uint32_t address, uint32_t errors)
+{
+    if (address >= FLASH_SIZE)
+    {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    xSectorHealth[address / SECTOR_OFFSET].Errors += errors;
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * Function to plan the erases covering a sector aligned range
+ */
+bool FlashServ_PlanErase(uint32_t startAddress, uint32_t endAddress, FlashServErasePlan_t *plan)
+{
+    const FlashEraseType_t *erase = NULL;
+    uint32_t address = startAddress;
+
+    if ((plan == NULL) || (startAddress > endAddress) || (endAddress > FLASH_SIZE) ||
+        ((startAddress % SECTOR_OFFSET) != 0) || ((endAddress % SECTOR_OFFSET) != 0))
+    {
+        return false;
+    }
+
+    memset(plan, 0, sizeof(*plan));
+
+    while (address < endAddress)
+    {
+        erase = flashServNextErase(address, endAddress);
+
+        switch (erase->Size)
+        {
+        case BLOCK_OFFSET:
+            plan->BlockErases++;
+            break;
+        case BLOCK_32K_OFFSET:
+            plan->Block32KErases++;
+            break;
+        default:
+            plan->SectorErases++;
+            break;
+        }
+
+        plan->EstimatedMs += erase->TypicalMs;
+        address += erase->Size;
+    }
+
+    return true;
+}
+
+/*
+ * Function to erase a sector aligned range with the fewest erases
+ */
+flashReturnMsg_t FlashServ_EraseRange(uint32_t startAddress, uint32_t endAddress, FlashServErasePlan_t *plan)
+{
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+    FlashServErasePlan_t localPlan = {0};
+    const FlashEraseType_t *erase = NULL;
+    uint32_t address = startAddress;
+    TickType_t startTick = 0;
+
+    if (plan == NULL)
+    {
+        plan = &localPlan;
+    }
+
+    if (!FlashServ_PlanErase(startAddress, endAddress, plan))
+    {
+        return FLASH_ADDRESS_INVALID;
+    }
+
+    // The device belongs to the asynchronous operation until it completes
+    if (!flashServLockAfterOp(0, FLASH_SIZE))
+    {
+        return FLASH_IS_BUSY;
+    }
+
+    startTick = xTaskGetTickCount();
+
+    FlashCache_Invalidate(startAddress, endAddress - startAddress);
+    flashServBufferDiscard(startAddress, endAddress - startAddress);
+
+    while ((address < endAddress) && (msg == FLASH_OPERATION_SUCCESS))
+    {
+        erase = flashServNextErase(address, endAddress);
+        msg = MX25_Erase(&xFlashDevice, address, erase->Size);
+        flashServCountErase(address, erase->Size, msg);
+        address += erase->Size;
+    }
+
+    plan->ActualMs = (xTaskGetTickCount() - startTick) * portTICK_PERIOD_MS;
+
+    flashServUnlock();
+
+    return msg;
+}
+
+/*
+ * Function to queue a write of any length of data to erased flash
+ */
+FlashServOpHandle_t FlashServ_WriteAsync(uint32_t address, const uint8_t *data, uint32_t length,
+                                         FlashServOpCallback_t callback, void *context)
+{
+    flashOp_t op = {0};
+
+    if ((data == NULL) || (length == 0) || (address + length > FLASH_SIZE))
+    {
+        return FLASH_SERV_INVALID_HANDLE;
+    }
+
+    op.Type = FLASH_OP_WRITE;
+    op.Address = address;
+    op.Data = data;
+    op.Length = length;
+    op.Callback = callback;
+    op.Context = context;
+
+    return flashServSubmitOp(&op);
+}
+
+/*
+ * Function to queue a sector erase
+ */
+FlashServOpHandle_t FlashServ_EraseSectorAsync(uint32_t address, FlashServOpCallback_t callback, void *context)
+{
+    flashOp_t op = {0};
+
+    if (address >= FLASH_SIZE)
+    {
+        return FLASH_SERV_INVALID_HANDLE;
+    }
+
+    op.Type = FLASH_OP_ERASE_SECTOR;
+    op.Address = address;
+    op.Callback = callback;
+    op.Context = context;
+
+    return flashServSubmitOp(&op);
+}
+
+/*
+ * Function to queue a full chip erase
+ */
+FlashServOpHandle_t FlashServ_EraseAllAsync(FlashServOpCallback_t callback, void *context)
+{
+    flashOp_t op = {0};
+
+    op.Type = FLASH_OP_ERASE_ALL;
+    op.Callback = callback;
+    op.Context = context;
+
+    return flashServSubmitOp(&op);
+}
+
+/*
+ * Function to get write throughput statistics
+ */
+void FlashServ_GetWriteStats(FlashServWriteStats_t *stats)
+{
+    taskENTER_CRITICAL();
+    *stats = xWriteStats;
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * Function to get write-combining statistics
+ */
+void FlashServ_GetWriteBufferStats(FlashServWriteBufferStats_t *stats)
+{
+    taskENTER_CRITICAL();
+    *stats = xWriteBufferStats;
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * Function to get the flash part behind these services, for the self-tests
+ */
+Mx25Device_t *FlashServ_GetDevice(void)
+{
+    return &xFlashDevice;
+}
+
+/*
+ * Function to take exclusive access to the flash, for the self-tests
+ */
+bool FlashServ_Lock(void)
+{
+    return flashServLock();
+}
+
+/*
+ * Function to release exclusive access to the flash. The part may still be busy with what the
+ * self-test started on it, so write buffers are left for the next access.
+ */
+void FlashServ_Unlock(void)
+{
+    xSemaphoreGive(xFlashServMutex);
+}
+
+/*
+ * Function to count an erase issued on the part directly in the sector health
+ */
+void FlashServ_CountErase(uint32_t address, uint32_t size, flashReturnMsg_t msg)
+{
+    flashServCountErase(address, size, msg);
+}
+
+/*
+ * Function to start a sector erase on the device without going through the flash task
+ */
+flashReturnMsg_t FlashServ_StartEraseSector(uint32_t address)
+{
+    flashOp_t op = {0};
+
+    op.Type = FLASH_OP_ERASE_SECTOR;
+    op.Address = address;
+
+    return flashServStartOp(&op);
+}
+
+/*
+ * Function to check on an erase started with FlashServ_StartEraseSector
+ */
+bool FlashServ_PollOp(flashReturnMsg_t *result)
+{
+    return flashServPollOp(result);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Init the flash services module
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+void FlashServ_Init(void)
+{
+    // ---------------------------------------------------------------------+-
+    // Mutex to serialize clients of the flash
+    // ---------------------------------------------------------------------+-
+    xFlashServMutex = xSemaphoreCreateMutexStatic(&xFlashServMutexControlBlock);
+
+    // ---------------------------------------------------------------------+-
+    // Write-combining buffers start empty
+    // ---------------------------------------------------------------------+-
+    for (uint32_t i = 0; i < FLASH_WRITE_BUFFER_PAGES; i++)
+    {
+        flashServBufferRelease(&xWriteBuffers[i]);
+    }
+
+    // ---------------------------------------------------------------------+-
+    // Queue of asynchronous program/erase requests for the flash task
+    // ---------------------------------------------------------------------+-
+    xFlashOpQueue = xQueueCreateStatic(FLASH_OP_QUEUE_LENGTH, sizeof(flashOp_t),
+                                       xFlashOpQueueStorage, &xFlashOpQueueControlBlock);
 
-// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
-// Init the flash services module
-// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
-void FlashServ_Init(void)
-{
     // ---------------------------------------------------------------------+-
     // Create flash task to receive and dispatch commands.
     // ---------------------------------------------------------------------+--
@@ -375,7 +1589,7 @@ void FlashServ_Init(void)
     void *flashTaskNoParams = NULL;
     UBaseType_t flashTaskPriority = tskIDLE_PRIORITY + 1;
 
-    xTaskCreateStatic(flashTaskCode, flashTaskName, FLASH_STACK_SIZE_IN_WORDS,
-                      flashTaskNoParams, flashTaskPriority, xFlashTaskStack,
-                      &xFlashTaskControlBlock);
+    xFlashTask = xTaskCreateStatic(flashTaskCode, flashTaskName, FLASH_STACK_SIZE_IN_WORDS,
+                                   flashTaskNoParams, flashTaskPriority, xFlashTaskStack,
+                                   &xFlashTaskControlBlock);
 }
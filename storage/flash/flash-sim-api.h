@@ -0,0 +1,46 @@
+#pragma once
+/*
+================================================================================================#=
+FILE:
+flash-sim-api.h
+
+DESCRIPTION:
+    The FlashSim module models the timing of MX25 class parts on a virtual clock, so code
+    driving several parts at once can be measured on a board that carries only one. Each
+    simulated part charges the bus time of every command and data byte to the clock and
+    stays busy for the typical program or erase time of the part it models.
+    This file defines the API to access those services.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+// FLASH information other modules may need to access:
+#include "flash-volume-api.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FLASH_SIM_MAX_CHIPS FLASH_VOLUME_MAX_CHIPS
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Set the clock back to 0 with every part idle and no contents kept. The parts take their
+// program and erase times from geometry and shift commands and data at busClockHz.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+void FlashSim_Reset(const FlashGeometry_t *geometry, uint32_t busClockHz);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Keep the contents of a part in data, size bytes from address 0, a whole number of
+// pages. The memory starts erased; accesses past it fail. Until the next reset,
+// programs wrap within their page as on the MX25, so a write not split on page
+// boundaries reads back corrupt. Returns false if the arguments are invalid.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashSim_AttachData(uint32_t chip, uint8_t *data, uint32_t size);
+
+// Time on the virtual clock since the last reset
+uint32_t FlashSim_GetNowUs(void);
+
+// Get the functions driving simulated part chip as part of a volume
+void FlashSim_GetVolumeChip(uint32_t chip, FlashVolumeChip_t *volumeChip);
@@ -0,0 +1,224 @@
+/*
+================================================================================================#=
+FILE:
+flash-sim.c
+
+DESCRIPTION:
+    The FlashSim module models the timing of MX25 class parts on a virtual clock.
+    This file implements those services.
+
+Adaptations Notes:  The model is the one a single master sees on a shared bus: commands and data
+                    take the bus, and so the clock, one after another, while programs and erases
+                    run on each part in parallel once started. A part only moves the clock
+                    forward when it is waited on before its cycle is over.
+
+                    Contents are only kept for a part given memory with FlashSim_AttachData.
+                    A program is latched into a page buffer whose address wraps at the end of
+                    the page, as on the MX25, then ANDed into the page. A write that isn't split
+                    on page boundaries corrupts the data just as it would on the part.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+#include "flash-sim-api.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define SIM_FRAME_BYTES 4  // Opcode and 3 address bytes
+#define SIM_STATUS_BYTES 2 // RDSR and the status byte
+#define US_PER_SECOND 1000000
+#define BITS_PER_BYTE 8
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Internal Private Data
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+typedef struct
+{
+    uint32_t ReadyAtUs; // End of the program/erase in progress
+    uint8_t *Data;      // Contents from address 0, NULL when not modelled
+    uint32_t DataSize;
+} flashSimChip_t;
+
+static flashSimChip_t xSimChips[FLASH_SIM_MAX_CHIPS];
+static uint32_t xSimNowUs = 0;
+
+// Part and bus being modelled
+static const FlashGeometry_t *xSimGeometry = NULL;
+static uint32_t xSimBusClockHz = 1;
+
+/*** Private Functions ***/
+
+// Helper function to get the bus time of a transfer with a simulated part
+static uint32_t flashSimBusUs(uint32_t bytes)
+{
+    return (uint32_t)(((uint64_t)bytes * BITS_PER_BYTE * US_PER_SECOND) / xSimBusClockHz);
+}
+
+// Helper function to check that a range lies within the contents of a part
+static bool flashSimInData(const flashSimChip_t *chip, uint32_t address, uint32_t length)
+{
+    return (address <= chip->DataSize) && (length <= (chip->DataSize - address));
+}
+
+// Simulated part read: the bus time of the frame and data, and the contents if modelled
+static flashReturnMsg_t flashSimRead(void *context, uint32_t address, uint8_t *data, uint32_t length)
+{
+    flashSimChip_t *chip = context;
+
+    if (chip->Data != NULL)
+    {
+        if (!flashSimInData(chip, address, length))
+        {
+            return FLASH_ADDRESS_INVALID;
+        }
+        memcpy(data, &chip->Data[address], length);
+    }
+
+    xSimNowUs += flashSimBusUs(SIM_FRAME_BYTES + length);
+    return FLASH_OPERATION_SUCCESS;
+}
+
+/*
+ * Program the contents of a part as the MX25 does: bytes go into a page buffer from the
+ * address offset, wrapping at the end of the page, so only the last page worth is kept
+ */
+static void flashSimProgramData(flashSimChip_t *chip, uint32_t address, const uint8_t *data, uint32_t length)
+{
+    uint8_t page[PAGE_OFFSET];
+    uint32_t pageAddress = address - (address % PAGE_OFFSET);
+    uint32_t i = 0;
+
+    memset(page, 0xFF, sizeof(page));
+    for (i = 0; i < length; i++)
+    {
+        page[(address + i) % PAGE_OFFSET] = data[i];
+    }
+
+    for (i = 0; i < PAGE_OFFSET; i++)
+    {
+        chip->Data[pageAddress + i] &= page[i];
+    }
+}
+
+// Simulated part page program: WREN and the page on the bus, then the typical tPP on its own
+static flashReturnMsg_t flashSimProgramStart(void *context, uint32_t address, const uint8_t *data, uint32_t length)
+{
+    flashSimChip_t *chip = context;
+
+    if ((chip->Data != NULL) && !flashSimInData(chip, address - (address % PAGE_OFFSET), PAGE_OFFSET))
+    {
+        return FLASH_ADDRESS_INVALID;
+    }
+
+    if (xSimNowUs < chip->ReadyAtUs)
+    {
+        return FLASH_IS_BUSY;
+    }
+
+    if (chip->Data != NULL)
+    {
+        flashSimProgramData(chip, address, data, length);
+    }
+
+    xSimNowUs += flashSimBusUs(1 + SIM_FRAME_BYTES + length);
+    chip->ReadyAtUs = xSimNowUs + xSimGeometry->ProgramTypicalUs;
+
+    return FLASH_OPERATION_SUCCESS;
+}
+
+// Simulated part erase: WREN and the command on the bus, then the typical erase time on its own
+static flashReturnMsg_t flashSimEraseStart(void *context, uint32_t address, uint32_t size)
+{
+    flashSimChip_t *chip = context;
+    const FlashEraseType_t *erase = SFDP_FindErase(xSimGeometry, size);
+
+    if ((erase == NULL) || ((address % size) != 0))
+    {
+        return FLASH_OPERATION_FAILED;
+    }
+
+    if (xSimNowUs < chip->ReadyAtUs)
+    {
+        return FLASH_IS_BUSY;
+    }
+
+    // Contents may cover less than the erase
+    if ((chip->Data != NULL) && (address < chip->DataSize))
+    {
+        memset(&chip->Data[address], 0xFF, ((chip->DataSize - address) < size) ? (chip->DataSize - address) : size);
+    }
+
+    xSimNowUs += flashSimBusUs(1 + SIM_FRAME_BYTES);
+    chip->ReadyAtUs = xSimNowUs + (erase->TypicalMs * 1000);
+
+    return FLASH_OPERATION_SUCCESS;
+}
+
+// Simulated part wait: one status read, then the clock runs on to the end of the cycle
+static flashReturnMsg_t flashSimWait(void *context)
+{
+    flashSimChip_t *chip = context;
+
+    xSimNowUs += flashSimBusUs(SIM_STATUS_BYTES);
+    if (xSimNowUs < chip->ReadyAtUs)
+    {
+        xSimNowUs = chip->ReadyAtUs;
+    }
+
+    return FLASH_OPERATION_SUCCESS;
+}
+
+/*** Public Functions ***/
+
+/*
+ * Function to reset the clock and the parts
+ */
+void FlashSim_Reset(const FlashGeometry_t *geometry, uint32_t busClockHz)
+{
+    memset(xSimChips, 0, sizeof(xSimChips));
+
+    xSimNowUs = 0;
+    xSimGeometry = geometry;
+    xSimBusClockHz = (busClockHz > 0) ? busClockHz : 1;
+}
+
+/*
+ * Function to keep the contents of a simulated part in memory
+ */
+bool FlashSim_AttachData(uint32_t chip, uint8_t *data, uint32_t size)
+{
+    if ((chip >= FLASH_SIM_MAX_CHIPS) || (data == NULL) || (size == 0) || ((size % PAGE_OFFSET) != 0))
+    {
+        return false;
+    }
+
+    memset(data, 0xFF, size);
+    xSimChips[chip].Data = data;
+    xSimChips[chip].DataSize = size;
+
+    return true;
+}
+
+/*
+ * Function to get the time on the virtual clock
+ */
+uint32_t FlashSim_GetNowUs(void)
+{
+    return xSimNowUs;
+}
+
+/*
+ * Function to get the volume functions of a simulated part
+ */
+void FlashSim_GetVolumeChip(uint32_t chip, FlashVolumeChip_t *volumeChip)
+{
+    volumeChip->Context = &xSimChips[chip % FLASH_SIM_MAX_CHIPS];
+    volumeChip->Read = flashSimRead;
+    volumeChip->ProgramStart = flashSimProgramStart;
+    volumeChip->EraseStart = flashSimEraseStart;
+    volumeChip->Wait = flashSimWait;
+}
@@ -0,0 +1,99 @@
+#pragma once
+/*
+================================================================================================#=
+FILE:
+flash-ts-api.h
+
+DESCRIPTION:
+    The FlashTs module stores timestamped samples, such as sensor summaries, in the TS region
+    of the MX25 flash and answers time range queries. Samples are packed into one sector
+    chunks; each full chunk gets a header with its minimum and maximum timestamp, so a query
+    only reads the chunks that overlap the range. The oldest chunk is dropped when the
+    region is full.
+    This file defines the API to access those services.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+// FLASH information other modules may need to access:
+#include "flash-services-api.h"
+#include "flash-layout.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FLASH_TS_DATA_LENGTH 24 // Payload bytes of a sample
+#define FLASH_TS_CHUNK_COUNT (FLASH_LAYOUT_TS_SIZE / SECTOR_OFFSET)
+
+// One sample
+typedef struct
+{
+    uint32_t Timestamp;
+    uint8_t Data[FLASH_TS_DATA_LENGTH];
+} FlashTsSample_t;
+
+// Called for each sample a query finds, in the order they were appended. Return false to stop.
+// It runs with the store locked, so it must not call back into FlashTs.
+typedef bool (*FlashTsVisitor_t)(const FlashTsSample_t *sample, void *context);
+
+// Time-series statistics
+typedef struct
+{
+    uint32_t Samples; // Held in the store
+    uint32_t Chunks;  // Holding samples, including the open one
+    uint32_t ChunksSealed;
+    uint32_t ChunksDropped; // Oldest chunk erased to make room
+    uint32_t TornSamples;   // Found at mount and skipped
+    uint32_t Queries;
+    uint32_t LastQueryChunksRead;
+    uint32_t LastQueryUs;
+    uint32_t MountUs;
+} FlashTsStats_t;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Rebuild the chunk index from the chunk headers. Call once the flash is initialized.
+// Only the open chunk, which has no header yet, is read sample by sample.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashTs_Mount(void);
+
+// Erase the whole region and start with an empty store
+bool FlashTs_Format(void);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Append a sample. Samples are staged a page at a time; FlashTs_Flush programs the staged
+// ones so they survive a reset. Timestamps need not increase, but queries read fewer
+// chunks when they do.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+flashReturnMsg_t FlashTs_Append(const FlashTsSample_t *sample);
+flashReturnMsg_t FlashTs_Flush(void);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Visit every sample with startTs <= Timestamp <= endTs. Query reads only the chunks the
+// index says overlap the range; QueryScan reads every chunk and is kept to measure the
+// index against. Both return the number of samples visited.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+uint32_t FlashTs_Query(uint32_t startTs, uint32_t endTs, FlashTsVisitor_t visitor, void *context);
+uint32_t FlashTs_QueryScan(uint32_t startTs, uint32_t endTs, FlashTsVisitor_t visitor, void *context);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Scrub: check the CRC of every programmed sample in one chunk, counting from 0 at the
+// start of the region. Samples are never moved; the chunk is dropped in its turn when the
+// region wraps. Returns false if the chunk is out of range or the store is not available.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashTs_Scrub(uint32_t chunk, FlashServScrubReport_t *report);
+
+// Get time-series statistics
+void FlashTs_GetStats(FlashTsStats_t *stats);
+
+#ifdef FLASH_SELF_TEST
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Test support, in FLASH_SELF_TEST builds only: mount the store on another region of
+// FLASH_LAYOUT_TS_SIZE bytes, sector aligned, so it can be tested without touching the
+// time-series region. FlashTs_Mount mounts the last region given here.
+// Pass FLASH_LAYOUT_TS_START to go back to the time-series region.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashTs_MountAt(uint32_t start);
+#endif
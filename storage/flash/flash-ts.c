@@ -0,0 +1,844 @@
+/*
+================================================================================================#=
+FILE:
+flash-ts.c
+
+DESCRIPTION:
+    The FlashTs module stores timestamped samples in the TS region and answers range queries.
+    This file implements those services.
+
+Adaptations Notes:  Each sector of the region is one chunk: a 32 byte header, then
+                    TS_SAMPLES_PER_CHUNK sample slots of 32 bytes
+                        Header: Magic (4) | Sequence (4) | ~Sequence (4) |
+                                Min ts (4) | Max ts (4) | Count (4) | Reserved (4) | CRC-32 (4)
+                        Slot:   Timestamp (4) | Data (24) | CRC-32 (4)
+                    The first line of the header is programmed when the chunk is opened, before
+                    any sample, so every chunk holding samples has a sequence even if it was
+                    never sealed. The rest is programmed once the chunk is full. Samples are
+                    staged in RAM and programmed a page at a time.
+
+                    The index is one entry per chunk, {Sequence, Min ts, Max ts, Count}, 16
+                    bytes each. Mount rebuilds it from the headers alone. A chunk opened but not
+                    sealed is the one being written at reset, or one whose seal was torn; only
+                    that chunk is read slot by slot, up to the first slot that is blank or fails
+                    its CRC.
+
+                    Chunks are opened in ring order, so the oldest chunk always follows the
+                    newest and a query visits the ring from there to deliver samples in the
+                    order they were appended.
+
+                    Reads go through a one page buffer, so a chunk costs 16 page reads whatever
+                    the number of samples a query wants from it.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+#include "flash-ts-api.h"
+
+#include "crc/crc.h"
+#include "timing/timing.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define TS_MAGIC 0x54534331 // "TSC1"
+#define TS_ERASED_BYTE 0xFF
+#define TS_ERASED_WORD 0xFFFFFFFF
+#define TS_NO_CHUNK 0xFFFF
+#define TS_NO_PAGE 0xFFFFFFFF
+#define TS_MUTEX_TIMEOUT_MS 5000
+
+#define TS_SLOT_SIZE 32
+#define TS_HEADER_SIZE TS_SLOT_SIZE
+#define TS_SAMPLES_PER_CHUNK ((SECTOR_OFFSET - TS_HEADER_SIZE) / TS_SLOT_SIZE)
+
+// Self-test builds can mount the store on another region, see FlashTs_MountAt
+#ifdef FLASH_SELF_TEST
+#define TS_REGION_START xRegionStart
+#else
+#define TS_REGION_START FLASH_LAYOUT_TS_START
+#endif
+
+#if (FLASH_LAYOUT_TS_SIZE % SECTOR_OFFSET) != 0
+#error "Time-series region must be a whole number of sectors"
+#endif
+
+#if (PAGE_OFFSET % TS_SLOT_SIZE) != 0
+#error "Time-series slots must not cross a page"
+#endif
+
+typedef struct
+{
+    // Programmed when the chunk is opened
+    uint32_t Magic;
+    uint32_t Sequence;
+    uint32_t SequenceInverse;
+    // Programmed when the chunk is sealed
+    uint32_t MinTs;
+    uint32_t MaxTs;
+    uint32_t Count;
+    uint32_t Reserved;
+    uint32_t HeaderCrc; // Over the fields above
+} tsChunkHeader_t;
+
+#define TS_SEAL_OFFSET offsetof(tsChunkHeader_t, MinTs)
+
+typedef struct
+{
+    FlashTsSample_t Sample;
+    uint32_t Crc; // Over the sample
+} tsSlot_t;
+
+typedef enum
+{
+    TS_CHUNK_DIRTY,  // No samples, needs an erase before use
+    TS_CHUNK_ERASED, // No samples, ready for use
+    TS_CHUNK_OPEN,   // Being appended to
+    TS_CHUNK_SEALED  // Holds samples, takes no more
+} tsChunkState_t;
+
+typedef enum
+{
+    TS_SLOT_VALID,
+    TS_SLOT_ERASED,
+    TS_SLOT_TORN,
+    TS_SLOT_READ_FAILED
+} tsSlotState_t;
+
+typedef struct
+{
+    uint32_t Sequence; // TS_ERASED_WORD when the chunk was never opened
+    uint32_t MinTs;
+    uint32_t MaxTs;
+    uint16_t Count;
+    uint8_t State;
+    uint8_t Reserved;
+} tsIndexEntry_t;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Internal Private Data
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+static tsIndexEntry_t xIndex[FLASH_TS_CHUNK_COUNT];
+static uint16_t xHeadChunk = FLASH_TS_CHUNK_COUNT - 1; // Newest chunk, the next one opened follows it
+static uint16_t xOpenChunk = TS_NO_CHUNK;
+static uint32_t xNextSequence = 1;
+
+// Page of the open chunk being staged; bytes from xStageFrom up are not programmed yet
+static uint8_t xStage[PAGE_OFFSET];
+static uint32_t xStageAddress = 0;
+static uint32_t xStageFrom = 0;
+static uint32_t xStageTo = 0;
+
+// Read buffer
+static uint8_t xPage[PAGE_OFFSET];
+static uint32_t xPageAddress = TS_NO_PAGE;
+
+static FlashTsStats_t xStats = {0};
+
+static SemaphoreHandle_t xTsMutex = NULL;
+static StaticSemaphore_t xTsMutexControlBlock;
+static bool xMounted = false;
+
+#ifdef FLASH_SELF_TEST
+// Region mounted, see FlashTs_MountAt
+static uint32_t xRegionStart = FLASH_LAYOUT_TS_START;
+#endif
+
+/*** Private Functions ***/
+
+// Helper function to get the flash address of a chunk
+static uint32_t tsChunkAddress(uint16_t chunk)
+{
+    return TS_REGION_START + ((uint32_t)chunk * SECTOR_OFFSET);
+}
+
+// Helper function to get the offset of a slot in its chunk
+static uint32_t tsSlotOffset(uint32_t slot)
+{
+    return TS_HEADER_SIZE + (slot * TS_SLOT_SIZE);
+}
+
+// Helper function to get the chunk after one in ring order
+static uint16_t tsNextChunk(uint16_t chunk)
+{
+    return (uint16_t)((chunk + 1) % FLASH_TS_CHUNK_COUNT);
+}
+
+// Helper function to get the CRC of a chunk header
+static uint32_t tsHeaderCrc(const tsChunkHeader_t *header)
+{
+    return CRC_Compute((const uint8_t *)header, offsetof(tsChunkHeader_t, HeaderCrc));
+}
+
+// Helper function to check that a buffer is all erased bytes
+static bool tsIsErased(const uint8_t *data, uint32_t length)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < length; i++)
+    {
+        if (data[i] != TS_ERASED_BYTE)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Helper function to create the store mutex once
+static void tsCreateMutex(void)
+{
+    if (xTsMutex == NULL)
+    {
+        xTsMutex = xSemaphoreCreateMutexStatic(&xTsMutexControlBlock);
+    }
+}
+
+// Helper function to take exclusive access to the store
+static bool tsLock(void)
+{
+    if (!xMounted)
+    {
+        return false;
+    }
+
+    if (xSemaphoreTake(xTsMutex, pdMS_TO_TICKS(TS_MUTEX_TIMEOUT_MS)))
+    {
+        return true;
+    }
+
+    return false;
+}
+
+// Helper function to release exclusive access to the store
+static void tsUnlock(void)
+{
+    xSemaphoreGive(xTsMutex);
+}
+
+// Helper function to set an index entry to hold no samples
+static void tsResetEntry(uint16_t chunk, tsChunkState_t state)
+{
+    xIndex[chunk].Sequence = TS_ERASED_WORD;
+    xIndex[chunk].MinTs = TS_ERASED_WORD;
+    xIndex[chunk].MaxTs = 0;
+    xIndex[chunk].Count = 0;
+    xIndex[chunk].State = (uint8_t)state;
+}
+
+// Helper function to add a timestamp to an index entry
+static void tsAddToEntry(uint16_t chunk, uint32_t timestamp)
+{
+    if (timestamp < xIndex[chunk].MinTs)
+    {
+        xIndex[chunk].MinTs = timestamp;
+    }
+    if (timestamp > xIndex[chunk].MaxTs)
+    {
+        xIndex[chunk].MaxTs = timestamp;
+    }
+    xIndex[chunk].Count++;
+}
+
+/*
+ * Read a sample slot through the page buffer
+ */
+static tsSlotState_t tsReadSlot(uint16_t chunk, uint32_t slot, tsSlot_t *data)
+{
+    uint32_t offset = tsSlotOffset(slot);
+    uint32_t pageAddress = tsChunkAddress(chunk) + (offset & ~(PAGE_OFFSET - 1));
+
+    if (pageAddress != xPageAddress)
+    {
+        xPageAddress = TS_NO_PAGE;
+        if (FlashServ_Read(pageAddress, xPage, sizeof(xPage)) != FLASH_OPERATION_SUCCESS)
+        {
+            return TS_SLOT_READ_FAILED;
+        }
+        xPageAddress = pageAddress;
+    }
+
+    memcpy(data, &xPage[offset % PAGE_OFFSET], sizeof(*data));
+
+    if (data->Crc == CRC_Compute((const uint8_t *)&data->Sample, sizeof(data->Sample)))
+    {
+        return TS_SLOT_VALID;
+    }
+
+    return tsIsErased((const uint8_t *)data, sizeof(*data)) ? TS_SLOT_ERASED : TS_SLOT_TORN;
+}
+
+/*
+ * Rebuild the index entry of a chunk without a good header from its slots.
+ * Returns false on a read failure; *torn tells whether the slots end in a torn one.
+ */
+static bool tsScanChunk(uint16_t chunk, bool *torn)
+{
+    tsSlot_t data;
+    tsSlotState_t state = TS_SLOT_VALID;
+    uint32_t slot = 0;
+
+    *torn = false;
+
+    for (slot = 0; slot < TS_SAMPLES_PER_CHUNK; slot++)
+    {
+        state = tsReadSlot(chunk, slot, &data);
+        if (state != TS_SLOT_VALID)
+        {
+            break;
+        }
+        tsAddToEntry(chunk, data.Sample.Timestamp);
+    }
+
+    if (state == TS_SLOT_READ_FAILED)
+    {
+        return false;
+    }
+
+    *torn = (state == TS_SLOT_TORN);
+    return true;
+}
+
+/*
+ * Program the staged bytes not yet on flash, moving on to the next page once one is full
+ */
+static flashReturnMsg_t tsProgramStaged(void)
+{
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if (xStageTo > xStageFrom)
+    {
+        xPageAddress = TS_NO_PAGE;
+        msg = FlashServ_Write(xStageAddress + xStageFrom, &xStage[xStageFrom], xStageTo - xStageFrom);
+        if (msg != FLASH_OPERATION_SUCCESS)
+        {
+            return msg;
+        }
+        xStageFrom = xStageTo;
+    }
+
+    if (xStageFrom == PAGE_OFFSET)
+    {
+        xStageAddress += PAGE_OFFSET;
+        xStageFrom = 0;
+        xStageTo = 0;
+        memset(xStage, TS_ERASED_BYTE, sizeof(xStage));
+    }
+
+    return msg;
+}
+
+// Helper function to start staging at a slot of the open chunk
+static void tsStageAt(uint16_t chunk, uint32_t slot)
+{
+    uint32_t offset = tsSlotOffset(slot);
+
+    memset(xStage, TS_ERASED_BYTE, sizeof(xStage));
+    xStageAddress = tsChunkAddress(chunk) + (offset & ~(PAGE_OFFSET - 1));
+    xStageFrom = offset % PAGE_OFFSET;
+    xStageTo = xStageFrom;
+}
+
+// Helper function to get the number of samples of the open chunk already programmed
+static uint32_t tsProgrammedCount(void)
+{
+    return (xStageAddress + xStageFrom - tsChunkAddress(xOpenChunk) - TS_HEADER_SIZE) / TS_SLOT_SIZE;
+}
+
+/*
+ * Program the header of a chunk from its index entry and close it
+ */
+static flashReturnMsg_t tsSealChunk(uint16_t chunk)
+{
+    tsChunkHeader_t header;
+
+    header.Magic = TS_MAGIC;
+    header.Sequence = xIndex[chunk].Sequence;
+    header.SequenceInverse = ~header.Sequence;
+    header.MinTs = xIndex[chunk].MinTs;
+    header.MaxTs = xIndex[chunk].MaxTs;
+    header.Count = xIndex[chunk].Count;
+    header.Reserved = TS_ERASED_WORD;
+    header.HeaderCrc = tsHeaderCrc(&header);
+
+    // Mount rebuilds the entry from the slots if the seal doesn't make it
+    xIndex[chunk].State = TS_CHUNK_SEALED;
+    if (chunk == xOpenChunk)
+    {
+        xOpenChunk = TS_NO_CHUNK;
+    }
+    xStats.ChunksSealed++;
+
+    xPageAddress = TS_NO_PAGE;
+    return FlashServ_Write(tsChunkAddress(chunk) + TS_SEAL_OFFSET, (const uint8_t *)&header + TS_SEAL_OFFSET,
+                           sizeof(header) - TS_SEAL_OFFSET);
+}
+
+/*
+ * Open the chunk after the newest one, dropping its samples if it holds the oldest
+ */
+static flashReturnMsg_t tsOpenChunk(void)
+{
+    tsChunkHeader_t header;
+    uint16_t chunk = tsNextChunk(xHeadChunk);
+    uint32_t address = tsChunkAddress(chunk);
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if (xIndex[chunk].State == TS_CHUNK_SEALED)
+    {
+        xStats.Samples -= xIndex[chunk].Count;
+        xStats.Chunks--;
+        xStats.ChunksDropped++;
+    }
+
+    if (xIndex[chunk].State != TS_CHUNK_ERASED)
+    {
+        tsResetEntry(chunk, TS_CHUNK_DIRTY);
+        xPageAddress = TS_NO_PAGE;
+        msg = FlashServ_EraseRange(address, address + SECTOR_OFFSET, NULL);
+        if (msg != FLASH_OPERATION_SUCCESS)
+        {
+            return msg;
+        }
+    }
+
+    // Stamp the sequence before any sample goes in
+    xIndex[chunk].State = TS_CHUNK_DIRTY;
+    header.Magic = TS_MAGIC;
+    header.Sequence = xNextSequence++;
+    header.SequenceInverse = ~header.Sequence;
+    xPageAddress = TS_NO_PAGE;
+    msg = FlashServ_Write(address, (const uint8_t *)&header, TS_SEAL_OFFSET);
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        return msg;
+    }
+
+    tsResetEntry(chunk, TS_CHUNK_OPEN);
+    xIndex[chunk].Sequence = header.Sequence;
+    xHeadChunk = chunk;
+    xOpenChunk = chunk;
+    xStats.Chunks++;
+    tsStageAt(chunk, 0);
+
+    return msg;
+}
+
+/*
+ * Visit the samples of one chunk in the range, the staged ones of the open chunk included.
+ * Slots are read up to limit or the first one that isn't valid. Returns false once the
+ * visitor asks to stop.
+ */
+static bool tsVisitChunk(uint16_t chunk, uint32_t limit, uint32_t startTs, uint32_t endTs, FlashTsVisitor_t visitor,
+                         void *context, uint32_t *visited)
+{
+    tsSlot_t data;
+    uint32_t slot = 0;
+    uint32_t programmed = limit;
+
+    if (chunk == xOpenChunk)
+    {
+        programmed = tsProgrammedCount();
+    }
+
+    for (slot = 0; slot < programmed; slot++)
+    {
+        if (tsReadSlot(chunk, slot, &data) != TS_SLOT_VALID)
+        {
+            return true;
+        }
+
+        if ((data.Sample.Timestamp >= startTs) && (data.Sample.Timestamp <= endTs))
+        {
+            (*visited)++;
+            if (!visitor(&data.Sample, context))
+            {
+                return false;
+            }
+        }
+    }
+
+    if (chunk == xOpenChunk)
+    {
+        for (; slot < xIndex[chunk].Count; slot++)
+        {
+            memcpy(&data, &xStage[tsSlotOffset(slot) % PAGE_OFFSET], sizeof(data));
+            if ((data.Sample.Timestamp >= startTs) && (data.Sample.Timestamp <= endTs))
+            {
+                (*visited)++;
+                if (!visitor(&data.Sample, context))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Visit the samples in the range, oldest chunk first, with or without the index
+ */
+static uint32_t tsQuery(uint32_t startTs, uint32_t endTs, FlashTsVisitor_t visitor, void *context, bool useIndex)
+{
+    uint32_t startCycles = 0;
+    uint32_t visited = 0;
+    uint32_t chunksRead = 0;
+    uint32_t limit = 0;
+    uint16_t chunk = 0;
+    uint16_t i = 0;
+
+    if ((visitor == NULL) || (startTs > endTs) || !tsLock())
+    {
+        return 0;
+    }
+
+    startCycles = TIMING_GetCycles();
+    chunk = xHeadChunk;
+    for (i = 0; i < FLASH_TS_CHUNK_COUNT; i++)
+    {
+        chunk = tsNextChunk(chunk);
+        limit = TS_SAMPLES_PER_CHUNK;
+
+        if (useIndex)
+        {
+            if ((xIndex[chunk].Count == 0) || (xIndex[chunk].MaxTs < startTs) || (xIndex[chunk].MinTs > endTs))
+            {
+                continue;
+            }
+            limit = xIndex[chunk].Count;
+        }
+
+        chunksRead++;
+        if (!tsVisitChunk(chunk, limit, startTs, endTs, visitor, context, &visited))
+        {
+            break;
+        }
+    }
+
+    taskENTER_CRITICAL();
+    xStats.Queries++;
+    xStats.LastQueryChunksRead = chunksRead;
+    xStats.LastQueryUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+    taskEXIT_CRITICAL();
+
+    tsUnlock();
+
+    return visited;
+}
+
+/*** Public Functions ***/
+
+/*
+ * Function to rebuild the chunk index from the chunk headers
+ */
+bool FlashTs_Mount(void)
+{
+    tsChunkHeader_t header;
+    bool sealBlank[FLASH_TS_CHUNK_COUNT] = {false};
+    bool torn[FLASH_TS_CHUNK_COUNT] = {false};
+    uint32_t startCycles = TIMING_GetCycles();
+    uint16_t newest = TS_NO_CHUNK;
+    uint16_t chunk = 0;
+
+    tsCreateMutex();
+
+    xMounted = false;
+    xOpenChunk = TS_NO_CHUNK;
+    xNextSequence = 1;
+    xPageAddress = TS_NO_PAGE;
+    memset(&xStats, 0, sizeof(xStats));
+
+    for (chunk = 0; chunk < FLASH_TS_CHUNK_COUNT; chunk++)
+    {
+        tsResetEntry(chunk, TS_CHUNK_DIRTY);
+
+        if (FlashServ_Read(tsChunkAddress(chunk), (uint8_t *)&header, sizeof(header)) != FLASH_OPERATION_SUCCESS)
+        {
+            return false;
+        }
+
+        // Never opened, or torn while being opened, so it holds no samples
+        if ((header.Magic != TS_MAGIC) || (header.SequenceInverse != ~header.Sequence))
+        {
+            continue;
+        }
+
+        xIndex[chunk].Sequence = header.Sequence;
+        if ((newest == TS_NO_CHUNK) || (header.Sequence > xIndex[newest].Sequence))
+        {
+            newest = chunk;
+        }
+        if (header.Sequence >= xNextSequence)
+        {
+            xNextSequence = header.Sequence + 1;
+        }
+
+        if ((header.HeaderCrc == tsHeaderCrc(&header)) && (header.Count > 0) &&
+            (header.Count <= TS_SAMPLES_PER_CHUNK))
+        {
+            xIndex[chunk].MinTs = header.MinTs;
+            xIndex[chunk].MaxTs = header.MaxTs;
+            xIndex[chunk].Count = (uint16_t)header.Count;
+            xIndex[chunk].State = TS_CHUNK_SEALED;
+            continue;
+        }
+
+        // Written at reset, or its seal was torn
+        sealBlank[chunk] = tsIsErased((const uint8_t *)&header + TS_SEAL_OFFSET, sizeof(header) - TS_SEAL_OFFSET);
+        if (!tsScanChunk(chunk, &torn[chunk]))
+        {
+            return false;
+        }
+        if (torn[chunk])
+        {
+            xStats.TornSamples++;
+        }
+        if (xIndex[chunk].Count > 0)
+        {
+            xIndex[chunk].State = TS_CHUNK_SEALED;
+        }
+    }
+
+    xHeadChunk = (newest == TS_NO_CHUNK) ? (FLASH_TS_CHUNK_COUNT - 1) : newest;
+
+    // Carry on appending in the newest chunk where the writer left off, seal any other
+    for (chunk = 0; chunk < FLASH_TS_CHUNK_COUNT; chunk++)
+    {
+        if (!sealBlank[chunk])
+        {
+            continue;
+        }
+
+        if ((chunk == xHeadChunk) && !torn[chunk] && (xIndex[chunk].Count < TS_SAMPLES_PER_CHUNK))
+        {
+            xIndex[chunk].State = TS_CHUNK_OPEN;
+            xOpenChunk = chunk;
+            tsStageAt(chunk, xIndex[chunk].Count);
+        }
+        else if (xIndex[chunk].Count > 0)
+        {
+            tsSealChunk(chunk);
+        }
+    }
+
+    for (chunk = 0; chunk < FLASH_TS_CHUNK_COUNT; chunk++)
+    {
+        if (xIndex[chunk].Count > 0)
+        {
+            xStats.Samples += xIndex[chunk].Count;
+            xStats.Chunks++;
+        }
+    }
+
+    xStats.MountUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+    xMounted = true;
+
+    return true;
+}
+
+/*
+ * Function to erase the region and start with an empty store
+ */
+bool FlashTs_Format(void)
+{
+    uint16_t chunk = 0;
+    bool wasMounted = xMounted;
+    bool erased = false;
+
+    tsCreateMutex();
+
+    if (wasMounted && !tsLock())
+    {
+        return false;
+    }
+
+    xMounted = false;
+    xOpenChunk = TS_NO_CHUNK;
+    xHeadChunk = FLASH_TS_CHUNK_COUNT - 1;
+    xNextSequence = 1;
+    xPageAddress = TS_NO_PAGE;
+
+    erased = (FlashServ_EraseRange(TS_REGION_START, TS_REGION_START + FLASH_LAYOUT_TS_SIZE, NULL) ==
+              FLASH_OPERATION_SUCCESS);
+    for (chunk = 0; chunk < FLASH_TS_CHUNK_COUNT; chunk++)
+    {
+        tsResetEntry(chunk, erased ? TS_CHUNK_ERASED : TS_CHUNK_DIRTY);
+    }
+
+    xStats.Samples = 0;
+    xStats.Chunks = 0;
+    xMounted = true;
+
+    if (wasMounted)
+    {
+        tsUnlock();
+    }
+
+    return erased;
+}
+
+/*
+ * Function to append a sample
+ */
+flashReturnMsg_t FlashTs_Append(const FlashTsSample_t *sample)
+{
+    tsSlot_t data;
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if (sample == NULL)
+    {
+        return FLASH_OPERATION_FAILED;
+    }
+
+    if (!tsLock())
+    {
+        return FLASH_OPERATION_FAILED;
+    }
+
+    // Finish a page program or a seal that failed on an earlier append
+    if ((xOpenChunk != TS_NO_CHUNK) && (xStageTo == PAGE_OFFSET))
+    {
+        msg = tsProgramStaged();
+    }
+    if ((msg == FLASH_OPERATION_SUCCESS) && (xOpenChunk != TS_NO_CHUNK) &&
+        (xIndex[xOpenChunk].Count == TS_SAMPLES_PER_CHUNK))
+    {
+        msg = tsSealChunk(xOpenChunk);
+    }
+
+    if ((msg == FLASH_OPERATION_SUCCESS) && (xOpenChunk == TS_NO_CHUNK))
+    {
+        msg = tsOpenChunk();
+    }
+
+    if (msg == FLASH_OPERATION_SUCCESS)
+    {
+        data.Sample = *sample;
+        data.Crc = CRC_Compute((const uint8_t *)&data.Sample, sizeof(data.Sample));
+        memcpy(&xStage[xStageTo], &data, sizeof(data));
+        xStageTo += sizeof(data);
+        tsAddToEntry(xOpenChunk, sample->Timestamp);
+        xStats.Samples++;
+
+        if (xStageTo == PAGE_OFFSET)
+        {
+            msg = tsProgramStaged();
+        }
+
+        if ((msg == FLASH_OPERATION_SUCCESS) && (xIndex[xOpenChunk].Count == TS_SAMPLES_PER_CHUNK))
+        {
+            msg = tsSealChunk(xOpenChunk);
+        }
+    }
+
+    tsUnlock();
+
+    return msg;
+}
+
+/*
+ * Function to program the staged samples
+ */
+flashReturnMsg_t FlashTs_Flush(void)
+{
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+
+    if (!tsLock())
+    {
+        return FLASH_OPERATION_FAILED;
+    }
+
+    if (xOpenChunk != TS_NO_CHUNK)
+    {
+        msg = tsProgramStaged();
+    }
+
+    tsUnlock();
+
+    return msg;
+}
+
+/*
+ * Function to visit the samples in a range, reading only the chunks that overlap it
+ */
+uint32_t FlashTs_Query(uint32_t startTs, uint32_t endTs, FlashTsVisitor_t visitor, void *context)
+{
+    return tsQuery(startTs, endTs, visitor, context, true);
+}
+
+/*
+ * Function to visit the samples in a range, reading every chunk
+ */
+uint32_t FlashTs_QueryScan(uint32_t startTs, uint32_t endTs, FlashTsVisitor_t visitor, void *context)
+{
+    return tsQuery(startTs, endTs, visitor, context, false);
+}
+
+/*
+ * Function to check the samples of a chunk
+ */
+bool FlashTs_Scrub(uint32_t chunk, FlashServScrubReport_t *report)
+{
+    tsSlot_t data;
+    uint32_t count = 0;
+    uint32_t slot = 0;
+
+    if ((report == NULL) || (chunk >= FLASH_TS_CHUNK_COUNT) || !tsLock())
+    {
+        return false;
+    }
+
+    memset(report, 0, sizeof(*report));
+    report->Address = tsChunkAddress((uint16_t)chunk);
+
+    count = (chunk == xOpenChunk) ? tsProgrammedCount() : xIndex[chunk].Count;
+    for (slot = 0; slot < count; slot++)
+    {
+        report->Checked++;
+        if (tsReadSlot((uint16_t)chunk, slot, &data) != TS_SLOT_VALID)
+        {
+            report->Failed++;
+        }
+    }
+
+    tsUnlock();
+
+    return true;
+}
+
+/*
+ * Function to get time-series statistics
+ */
+void FlashTs_GetStats(FlashTsStats_t *stats)
+{
+    taskENTER_CRITICAL();
+    *stats = xStats;
+    taskEXIT_CRITICAL();
+}
+
+#ifdef FLASH_SELF_TEST
+/*
+ * Function to mount the store on another region
+ */
+bool FlashTs_MountAt(uint32_t start)
+{
+    if (((start % SECTOR_OFFSET) != 0) || (start > (FLASH_SIZE - FLASH_LAYOUT_TS_SIZE)))
+    {
+        return false;
+    }
+
+    xRegionStart = start;
+
+    return FlashTs_Mount();
+}
+#endif
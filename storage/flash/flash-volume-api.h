@@ -0,0 +1,93 @@
+#pragma once
+/*
+================================================================================================#=
+FILE:
+flash-volume-api.h
+
+DESCRIPTION:
+    The FlashVolume module joins several MX25 class parts on the shared bus into one
+    volume, striping consecutive pages across them. A program shifts the next page into
+    the next part while the previous ones are still busy programming, so write throughput
+    grows with the number of parts until the bus is saturated. Erases fan out the same way,
+    one erase running on every part at once.
+    Parts are reached through a table of functions, so the volume runs on MX25 instances
+    through flash-services or against the simulated parts of flash-sim.c.
+    This file defines the API to access those services.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+// FLASH information other modules may need to access:
+#include "flash-services-api.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FLASH_VOLUME_MAX_CHIPS 8
+
+// One part of a volume. Context is passed back to every function.
+typedef struct
+{
+    void *Context;
+    flashReturnMsg_t (*Read)(void *context, uint32_t address, uint8_t *data, uint32_t length);
+    flashReturnMsg_t (*ProgramStart)(void *context, uint32_t address, const uint8_t *data, uint32_t length);
+    flashReturnMsg_t (*EraseStart)(void *context, uint32_t address, uint32_t size); // One aligned region of size
+    flashReturnMsg_t (*Wait)(void *context); // Until the started program/erase ends, with its result
+} FlashVolumeChip_t;
+
+// Volume statistics
+typedef struct
+{
+    uint32_t PagesProgrammed;
+    uint32_t Erases;
+    uint32_t OverlappedStarts; // Programs/erases started while another part was busy
+    uint32_t Waits;            // Parts waited for before their next command
+} FlashVolumeStats_t;
+
+// A volume. Set up with FlashVolume_Init; the fields are private to the module.
+typedef struct
+{
+    FlashVolumeChip_t Chips[FLASH_VOLUME_MAX_CHIPS];
+    bool Pending[FLASH_VOLUME_MAX_CHIPS]; // Program/erase started and not yet waited for
+    uint32_t ChipCount;
+    uint32_t ChipStart; // Region used on every part
+    uint32_t ChipSize;
+    bool Failed; // A program/erase failed since the last sync
+    FlashVolumeStats_t Stats;
+} FlashVolume_t;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Set up a volume over chipCount parts, using [chipStart, chipStart + chipSize) on each.
+// chipStart and chipSize must be sector aligned. Returns false if the layout is invalid.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FlashVolume_Init(FlashVolume_t *volume, const FlashVolumeChip_t *chips, uint32_t chipCount, uint32_t chipStart,
+                      uint32_t chipSize);
+
+// Size of the volume in bytes, and the erase unit: one sector on every part
+uint32_t FlashVolume_GetSize(const FlashVolume_t *volume);
+uint32_t FlashVolume_GetSectorSize(const FlashVolume_t *volume);
+
+// Read any range of the volume. Parts still busy with a program/erase are waited for.
+flashReturnMsg_t FlashVolume_Read(FlashVolume_t *volume, uint32_t address, uint8_t *data, uint32_t length);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Program any range of erased volume space. Returns once every page is shifted into its
+// part, so the data buffer can be reused; the last pages may still be programming.
+// FlashVolume_Sync waits for them and reports any program/erase that failed since the
+// previous sync.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+flashReturnMsg_t FlashVolume_Program(FlashVolume_t *volume, uint32_t address, const uint8_t *data, uint32_t length);
+flashReturnMsg_t FlashVolume_Sync(FlashVolume_t *volume);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Erase [address, address + size), both aligned to FlashVolume_GetSectorSize. Every part
+// erases its share with the largest erases that fit, all parts at once. Like a program,
+// the last erases may still be running on return.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+flashReturnMsg_t FlashVolume_Erase(FlashVolume_t *volume, uint32_t address, uint32_t size);
+
+// Get volume statistics
+void FlashVolume_GetStats(const FlashVolume_t *volume, FlashVolumeStats_t *stats);
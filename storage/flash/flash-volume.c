@@ -0,0 +1,307 @@
+/*
+================================================================================================#=
+FILE:
+flash-volume.c
+
+DESCRIPTION:
+    The FlashVolume module stripes a volume across several flash parts.
+    This file implements those services.
+
+Adaptations Notes:  Volume page p lives on part (p % ChipCount) at page (p / ChipCount) of that
+                    part's region, so a volume sector, one sector on every part, maps to the same
+                    sector on each part and erases need no bookkeeping.
+
+                    A page program holds the bus only while the page is shifted in; the part then
+                    programs on its own for tPP. The volume starts the next page on the next part
+                    right away and only waits for a part when it comes round to it again, so with
+                    N parts one tPP is spread over N page transfers. The bus saturates when a
+                    round of transfers takes as long as tPP, about five parts at 21MHz SCLK.
+
+                    Reads can't overlap: they need the bus for their whole length. They are split
+                    at page boundaries and wait for their part only if it is still busy.
+
+                    The module only uses the part table and the C library, so a host build can
+                    link it with simulated parts.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+#include "flash-volume-api.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/*** Private Functions ***/
+
+// Helper function to get the part holding a volume address
+static uint32_t volumeChip(const FlashVolume_t *volume, uint32_t address)
+{
+    return (address / PAGE_OFFSET) % volume->ChipCount;
+}
+
+// Helper function to get the address on its part of a volume address
+static uint32_t volumeChipAddress(const FlashVolume_t *volume, uint32_t address)
+{
+    return volume->ChipStart + (((address / PAGE_OFFSET) / volume->ChipCount) * PAGE_OFFSET) +
+           (address % PAGE_OFFSET);
+}
+
+// Helper function to check whether any part has a program/erase running
+static bool volumeAnyPending(const FlashVolume_t *volume)
+{
+    uint32_t chip = 0;
+
+    for (chip = 0; chip < volume->ChipCount; chip++)
+    {
+        if (volume->Pending[chip])
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Wait for the program/erase running on a part, noting a failure for the next sync
+ */
+static void volumeWait(FlashVolume_t *volume, uint32_t chip)
+{
+    if (!volume->Pending[chip])
+    {
+        return;
+    }
+
+    volume->Stats.Waits++;
+    if (volume->Chips[chip].Wait(volume->Chips[chip].Context) != FLASH_OPERATION_SUCCESS)
+    {
+        volume->Failed = true;
+    }
+    volume->Pending[chip] = false;
+}
+
+// Helper function to check that a range lies within the volume
+static bool volumeInRange(const FlashVolume_t *volume, uint32_t address, uint32_t length)
+{
+    uint32_t size = FlashVolume_GetSize(volume);
+
+    return (address <= size) && (length <= (size - address));
+}
+
+/*** Public Functions ***/
+
+/*
+ * Function to set up a volume
+ */
+bool FlashVolume_Init(FlashVolume_t *volume, const FlashVolumeChip_t *chips, uint32_t chipCount, uint32_t chipStart,
+                      uint32_t chipSize)
+{
+    uint32_t chip = 0;
+
+    memset(volume, 0, sizeof(*volume));
+
+    if ((chips == NULL) || (chipCount == 0) || (chipCount > FLASH_VOLUME_MAX_CHIPS) ||
+        ((chipStart % SECTOR_OFFSET) != 0) || (chipSize == 0) || ((chipSize % SECTOR_OFFSET) != 0))
+    {
+        return false;
+    }
+
+    for (chip = 0; chip < chipCount; chip++)
+    {
+        if ((chips[chip].Read == NULL) || (chips[chip].ProgramStart == NULL) || (chips[chip].EraseStart == NULL) ||
+            (chips[chip].Wait == NULL))
+        {
+            return false;
+        }
+        volume->Chips[chip] = chips[chip];
+    }
+
+    volume->ChipCount = chipCount;
+    volume->ChipStart = chipStart;
+    volume->ChipSize = chipSize;
+
+    return true;
+}
+
+/*
+ * Function to get the size of a volume
+ */
+uint32_t FlashVolume_GetSize(const FlashVolume_t *volume)
+{
+    return volume->ChipSize * volume->ChipCount;
+}
+
+/*
+ * Function to get the erase unit of a volume
+ */
+uint32_t FlashVolume_GetSectorSize(const FlashVolume_t *volume)
+{
+    return SECTOR_OFFSET * volume->ChipCount;
+}
+
+/*
+ * Function to read from a volume
+ */
+flashReturnMsg_t FlashVolume_Read(FlashVolume_t *volume, uint32_t address, uint8_t *data, uint32_t length)
+{
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+    uint32_t chip = 0;
+    uint32_t chunkLength = 0;
+
+    if (!volumeInRange(volume, address, length))
+    {
+        return FLASH_ADDRESS_INVALID;
+    }
+
+    while ((length > 0) && (msg == FLASH_OPERATION_SUCCESS))
+    {
+        chunkLength = PAGE_OFFSET - (address % PAGE_OFFSET);
+        if (chunkLength > length)
+        {
+            chunkLength = length;
+        }
+
+        chip = volumeChip(volume, address);
+        volumeWait(volume, chip);
+        msg = volume->Chips[chip].Read(volume->Chips[chip].Context, volumeChipAddress(volume, address), data,
+                                       chunkLength);
+
+        address += chunkLength;
+        data += chunkLength;
+        length -= chunkLength;
+    }
+
+    return msg;
+}
+
+/*
+ * Function to program a range of a volume, a page on each part in turn
+ */
+flashReturnMsg_t FlashVolume_Program(FlashVolume_t *volume, uint32_t address, const uint8_t *data, uint32_t length)
+{
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+    uint32_t chip = 0;
+    uint32_t chunkLength = 0;
+
+    if (!volumeInRange(volume, address, length))
+    {
+        return FLASH_ADDRESS_INVALID;
+    }
+
+    while ((length > 0) && (msg == FLASH_OPERATION_SUCCESS))
+    {
+        chunkLength = PAGE_OFFSET - (address % PAGE_OFFSET);
+        if (chunkLength > length)
+        {
+            chunkLength = length;
+        }
+
+        chip = volumeChip(volume, address);
+        volumeWait(volume, chip);
+
+        if (volumeAnyPending(volume))
+        {
+            volume->Stats.OverlappedStarts++;
+        }
+
+        msg = volume->Chips[chip].ProgramStart(volume->Chips[chip].Context, volumeChipAddress(volume, address), data,
+                                               chunkLength);
+        if (msg == FLASH_OPERATION_SUCCESS)
+        {
+            volume->Pending[chip] = true;
+            volume->Stats.PagesProgrammed++;
+        }
+
+        address += chunkLength;
+        data += chunkLength;
+        length -= chunkLength;
+    }
+
+    return msg;
+}
+
+/*
+ * Function to wait for every part and report failures since the last sync
+ */
+flashReturnMsg_t FlashVolume_Sync(FlashVolume_t *volume)
+{
+    uint32_t chip = 0;
+    bool failed = false;
+
+    for (chip = 0; chip < volume->ChipCount; chip++)
+    {
+        volumeWait(volume, chip);
+    }
+
+    failed = volume->Failed;
+    volume->Failed = false;
+
+    return failed ? FLASH_OPERATION_FAILED : FLASH_OPERATION_SUCCESS;
+}
+
+/*
+ * Function to erase a range of a volume, every part erasing its share at once
+ */
+flashReturnMsg_t FlashVolume_Erase(FlashVolume_t *volume, uint32_t address, uint32_t size)
+{
+    flashReturnMsg_t msg = FLASH_OPERATION_SUCCESS;
+    uint32_t sectorSize = FlashVolume_GetSectorSize(volume);
+    uint32_t chipAddress = 0;
+    uint32_t chipEnd = 0;
+    uint32_t eraseSize = 0;
+    uint32_t chip = 0;
+
+    if (((address % sectorSize) != 0) || ((size % sectorSize) != 0) || !volumeInRange(volume, address, size))
+    {
+        return FLASH_ADDRESS_INVALID;
+    }
+
+    // A volume sector is the same sector on every part
+    chipAddress = volume->ChipStart + (address / volume->ChipCount);
+    chipEnd = chipAddress + (size / volume->ChipCount);
+
+    while ((chipAddress < chipEnd) && (msg == FLASH_OPERATION_SUCCESS))
+    {
+        eraseSize = SECTOR_OFFSET;
+        if (((chipAddress % BLOCK_OFFSET) == 0) && ((chipEnd - chipAddress) >= BLOCK_OFFSET))
+        {
+            eraseSize = BLOCK_OFFSET;
+        }
+        else if (((chipAddress % BLOCK_32K_OFFSET) == 0) && ((chipEnd - chipAddress) >= BLOCK_32K_OFFSET))
+        {
+            eraseSize = BLOCK_32K_OFFSET;
+        }
+
+        for (chip = 0; (chip < volume->ChipCount) && (msg == FLASH_OPERATION_SUCCESS); chip++)
+        {
+            volumeWait(volume, chip);
+
+            if (volumeAnyPending(volume))
+            {
+                volume->Stats.OverlappedStarts++;
+            }
+
+            msg = volume->Chips[chip].EraseStart(volume->Chips[chip].Context, chipAddress, eraseSize);
+            if (msg == FLASH_OPERATION_SUCCESS)
+            {
+                volume->Pending[chip] = true;
+                volume->Stats.Erases++;
+            }
+        }
+
+        chipAddress += eraseSize;
+    }
+
+    return msg;
+}
+
+/*
+ * Function to get volume statistics
+ */
+void FlashVolume_GetStats(const FlashVolume_t *volume, FlashVolumeStats_t *stats)
+{
+    *stats = volume->Stats;
+}
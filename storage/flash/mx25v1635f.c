@@ -7,63 +7,63 @@
 
 #include "mx25v1635f.h"
 
-#include "board-model.h"
 #include "../platform/gpio/gpio.h"
 #include "../platform/spi/spi-core.h"
+#include "../platform/timing/timing.h"
 
 #include "stm32f4xx_hal_gpio.h"
 
 #include "FreeRTOS.h"
 #include "task.h"
 
+#include <string.h>
+
+/*** Private  Variables ***/
+
+#define FLASH_CMD_FRAME_MAX_LENGTH 6 // Opcode + 4 address bytes + 1 dummy byte
+#define FLASH_DUMMY_BYTE 0xFF
+
+// Datasheet geometry and timings, used until MX25_Init reads the SFDP table
+static const FlashGeometry_t xDefaultGeometry = {
+    .DeviceSize = FLASH_SIZE,
+    .PageSize = PAGE_OFFSET,
+    .Erase = {
+        {BLOCK_OFFSET, FLASH_CMD_BE, tBE_TYP, BLOCK_ERASE_CYCLE_TIME},
+        {BLOCK_32K_OFFSET, FLASH_CMD_BE32K, tBE32K_TYP, BLOCK_32K_ERASE_CYCLE_TIME},
+        {SECTOR_OFFSET, FLASH_CMD_SE, tSE_TYP, SECTOR_ERASE_CYCLE_TIME},
+    },
+    .ProgramTypicalUs = tPP_TYP_US,
+    .ProgramMaxUs = PAGE_PROGRAM_CYCLE_TIME * 1000,
+    .ChipEraseTypicalMs = tCE_TYP,
+    .ChipEraseMaxMs = CHIP_ERASE_CYCLE_TIME,
+    .AddressBytes = 3,
+    .FastReadModes = SFDP_READ_1_1_2 | SFDP_READ_1_2_2 | SFDP_READ_1_1_4 | SFDP_READ_1_4_4,
+    .FromSfdp = false,
+};
+
 /*** Private  Functions ***/
 
 // Helper function to set CS pin high
-static void flashChipSelectHigh(void)
+static void flashChipSelectHigh(Mx25Device_t *device)
 {
-    HAL_GPIO_WritePin(PORT(FLASH_CS), PIN(FLASH_CS), GPIO_PIN_SET);
+    HAL_GPIO_WritePin(device->CsPort, device->CsPin, GPIO_PIN_SET);
 }
 
 // Helper function to set CS pin low
-static void flashChipSelectLow(void)
-{
-    HAL_GPIO_WritePin(PORT(FLASH_CS), PIN(FLASH_CS), GPIO_PIN_RESET);
-}
-
-/*
- * Function:       flashInsertDummyCycle
- * Arguments:      dummyCycle, number of dummy clock cycle
- * Description:    Insert dummy cycle of SCLK
- * Return Message: None.
- */
-static bool flashInsertDummyCycle(uint8_t dummyCycle)
+static void flashChipSelectLow(Mx25Device_t *device)
 {
-    uint8_t dummyClockCycleValue = 0xFF;
-    bool status = true;
-
-    for (uint8_t i = 0; i < dummyCycle; i++)
-    {
-        if (status)
-        {
-            status = SPI_Transfer(MX25_FLASH, &dummyClockCycleValue, sizeof(dummyClockCycleValue), NULL, 0);
-        }
-        else
-        {
-            return status;
-        }
-    }
-    return status;
+    HAL_GPIO_WritePin(device->CsPort, device->CsPin, GPIO_PIN_RESET);
 }
 
 /*
- * Function:       flashIs4Byte
- * Arguments:      None
- * Description:    Check flash address is 3-byte or 4-byte.
- *                 If flash 4BYTE bit = 1: return true
- *                                    = 0: return false.
- * Return Message: true, false
+ * Function:       flashDetectAddressMode
+ * Arguments:      device, the flash instance
+ * Description:    Determine whether the flash uses 3-byte or 4-byte addresses.
+ *                 Fixed at compile time when the part supports only one mode,
+ *                 otherwise read once from the security register 4BYTE bit.
+ * Return Message: true if 4-byte mode, false if 3-byte mode
  */
-static bool flashIs4Byte(void)
+static bool flashDetectAddressMode(Mx25Device_t *device)
 {
 #ifdef FLASH_CMD_RDSCUR
 #ifdef FLASH_4BYTE_ONLY
@@ -72,7 +72,9 @@ static bool flashIs4Byte(void)
     return false;
 #else
     uint8_t dataBuffer;
-    MX25_RDSCUR(&dataBuffer);
+    if (MX25_RDSCUR(device, &dataBuffer) != FLASH_OPERATION_SUCCESS)
+        return false;
+
     if ((dataBuffer & FLASH_4BYTE_MASK) == FLASH_4BYTE_MASK)
         return true;
     else
@@ -83,141 +85,414 @@ static bool flashIs4Byte(void)
 #endif
 }
 
+/*
+ * Function:       flashIs4Byte
+ * Arguments:      device, the flash instance
+ * Description:    Return the address mode cached by MX25_Init.
+ *                 If flash 4BYTE bit = 1: return true
+ *                                    = 0: return false.
+ * Return Message: true, false
+ */
+static bool flashIs4Byte(Mx25Device_t *device)
+{
+    return device->Addr4ByteMode;
+}
+
 /*
  * Function:       Read FLASH Identification
- * Arguments:      regToRead, commandLength, dataReceived, lengthToReceive
+ * Arguments:      device, the flash instance
+ *                 regToRead, commandLength, dataReceived, lengthToReceive
  * Description:    Sends FLASH command and stores data read in dataReceived
  * Return Message: Bool
  */
-static bool flashRead(uint8_t *command, uint8_t commandLength, uint8_t *dataReceived, uint8_t lengthToReceive)
+static bool flashRead(Mx25Device_t *device, uint8_t *command, uint8_t commandLength, uint8_t *dataReceived,
+                      uint8_t lengthToReceive)
 {
     bool status = false;
     uint8_t readCommand = (uint8_t)*command;
 
-    flashChipSelectLow();
-    status = SPI_Transfer(MX25_FLASH, (uint8_t *)&readCommand, commandLength, dataReceived,
+    if (!SPI_BusAcquire(device->Bus))
+    {
+        return false;
+    }
+
+    flashChipSelectLow(device);
+    status = SPI_Transfer(device->Bus, (uint8_t *)&readCommand, commandLength, dataReceived,
                           lengthToReceive);
-    flashChipSelectHigh();
+    flashChipSelectHigh(device);
+
+    SPI_BusRelease(device->Bus);
 
     return status;
 }
 
 /*
  * Function:       Write FLASH Identification
- * Arguments:      regToRead, commandLength
+ * Arguments:      device, the flash instance
+ *                 regToRead, commandLength
  * Description:    Sends FLASH command
  * Return Message: Bool
  */
-static bool flashWrite(uint8_t *command, uint8_t commandLength)
+static bool flashWrite(Mx25Device_t *device, uint8_t *command, uint8_t commandLength)
 {
     bool status = false;
 
-    flashChipSelectLow();
-    status = SPI_Transfer(MX25_FLASH, command, commandLength, NULL,
+    if (!SPI_BusAcquire(device->Bus))
+    {
+        return false;
+    }
+
+    flashChipSelectLow(device);
+    status = SPI_Transfer(device->Bus, command, commandLength, NULL,
                           0);
-    flashChipSelectHigh();
+    flashChipSelectHigh(device);
+
+    SPI_BusRelease(device->Bus);
 
     return status;
 }
 
 /*
- * Function:       flashSendAddr
- * Arguments:      flashAddress, 32 bit flash memory address
- *                 io_mode, I/O mode to transfer address
- *                 addr4ByteMode,
- * Description:    Send flash address with 3-byte or 4-byte mode.
- *                  Assumes that the chip select is already low when calling this
- * Return Message: None
+ * Function:       flashBuildAddressFrame
+ * Arguments:      device, the flash instance
+ *                 frame, buffer of at least FLASH_CMD_FRAME_MAX_LENGTH bytes
+ *                 command, flash command opcode
+ *                 flashAddress, 32 bit flash memory address
+ *                 dummyBytes, number of dummy bytes to append after the address
+ * Description:    Build opcode, address (3-byte or 4-byte mode) and dummy bytes
+ *                 into a single frame so a command goes out in one SPI transfer.
+ * Return Message: Length of the frame in bytes
  */
-static bool flashSendAddr(uint32_t flashAddress, bool addr4ByteMode)
+static uint8_t flashBuildAddressFrame(Mx25Device_t *device, uint8_t *frame, uint8_t command, uint32_t flashAddress,
+                                      uint8_t dummyBytes)
 {
-    uint8_t length = 3;
-    uint8_t address[4];
-    bool status = false;
+    uint8_t length = 0;
+
+    frame[length++] = command;
 
     /* Check flash is 3-byte or 4-byte mode.
        4-byte mode: Send 4-byte address (A31-A0)
        3-byte mode: Send 3-byte address (A23-A0) */
-    if (addr4ByteMode == true)
+    if (flashIs4Byte(device))
     {
-        length = 4;
-        address[0] = flashAddress >> 24;
-        address[1] = flashAddress >> 16;
-        address[2] = flashAddress >> 8;
-        address[3] = flashAddress;
+        frame[length++] = flashAddress >> 24;
     }
-    else
+    frame[length++] = flashAddress >> 16;
+    frame[length++] = flashAddress >> 8;
+    frame[length++] = flashAddress;
+
+    for (uint8_t i = 0; i < dummyBytes; i++)
+    {
+        frame[length++] = FLASH_DUMMY_BYTE;
+    }
+
+    return length;
+}
+
+/*
+ * Function:       flashSendFrame
+ * Arguments:      device, the flash instance
+ *                 frame, command frame to send
+ *                 frameLength, length of the command frame
+ *                 data, payload to send after the frame (may be NULL)
+ *                 dataLength, length of the payload
+ * Description:    Send a command frame followed by an optional payload in one
+ *                 chip select window while holding the bus.
+ * Return Message: true, false
+ */
+static bool flashSendFrame(Mx25Device_t *device, uint8_t *frame, uint8_t frameLength, uint8_t *data,
+                           uint32_t dataLength)
+{
+    bool status = false;
+
+    if (!SPI_BusAcquire(device->Bus))
     {
-        address[0] = flashAddress >> 16;
-        address[1] = flashAddress >> 8;
-        address[2] = flashAddress;
+        return false;
     }
 
-    status = SPI_Transfer(MX25_FLASH, address, length, NULL, 0);
+    flashChipSelectLow(device);
+
+    status = SPI_Transfer(device->Bus, frame, frameLength, NULL, 0);
+
+    if (status && (dataLength > 0))
+    {
+        status = SPI_Transfer(device->Bus, data, dataLength, NULL, 0);
+    }
+
+    flashChipSelectHigh(device);
+
+    SPI_BusRelease(device->Bus);
+
+    return status;
+}
+
+/*
+ * Function:       flashReadFrame
+ * Arguments:      device, the flash instance
+ *                 frame, command frame to send
+ *                 frameLength, length of the command frame
+ *                 dataReceived, buffer to store the data read
+ *                 lengthToReceive, number of bytes to read
+ * Description:    Send a command frame, then clock in lengthToReceive bytes in
+ *                 FLASH_READ_CHUNK_SIZE pieces. Chip select stays low for the whole
+ *                 read so the flash keeps incrementing the address across chunks.
+ * Return Message: true, false
+ */
+static bool flashReadFrame(Mx25Device_t *device, uint8_t *frame, uint8_t frameLength, uint8_t *dataReceived,
+                           uint32_t lengthToReceive)
+{
+    bool status = false;
+    uint32_t chunkLength = 0;
+
+    if (!SPI_BusAcquire(device->Bus))
+    {
+        return false;
+    }
+
+    flashChipSelectLow(device);
+
+    status = SPI_Transfer(device->Bus, frame, frameLength, NULL, 0);
+
+    while (status && (lengthToReceive > 0))
+    {
+        chunkLength = (lengthToReceive > FLASH_READ_CHUNK_SIZE) ? FLASH_READ_CHUNK_SIZE : lengthToReceive;
+
+        status = SPI_Transfer(device->Bus, NULL, 0, dataReceived, chunkLength);
+
+        dataReceived += chunkLength;
+        lengthToReceive -= chunkLength;
+    }
+
+    flashChipSelectHigh(device);
+
+    SPI_BusRelease(device->Bus);
 
     return status;
 }
 
 /*
  * Function:       flashIsBusy
- * Arguments:      None.
+ * Arguments:      device, the flash instance
  * Description:    Check status register WIP bit.
  *                 If  WIP bit = 1: return true ( Busy )
  *                             = 0: return false ( Ready ).
  * Return Message: true, false
  */
-static bool flashIsBusy(void)
+static bool flashIsBusy(Mx25Device_t *device)
 {
     uint8_t dataBuffer;
 
-    MX25_RDSR(&dataBuffer);
+    MX25_RDSR(device, &dataBuffer);
     if ((dataBuffer & FLASH_WIP_MASK) == FLASH_WIP_MASK)
         return true;
     else
         return false;
 }
 
+// Helper function to note the operation just started, for the wait that follows
+static void flashWaitStart(Mx25Device_t *device, flashWaitOp_t op)
+{
+    device->WaitOp = op;
+    device->WaitStartCycles = TIMING_GetCycles();
+    device->WaitStartTick = xTaskGetTickCount();
+    device->WaitTracked = true;
+}
+
+// Helper function to get the typical time of an operation from the geometry
+static uint32_t flashWaitTypicalUs(Mx25Device_t *device, flashWaitOp_t op)
+{
+    switch (op)
+    {
+    case FLASH_WAIT_PROGRAM:
+        return device->Geometry.ProgramTypicalUs;
+    case FLASH_WAIT_CHIP_ERASE:
+        return device->Geometry.ChipEraseTypicalMs * 1000;
+    default:
+        return device->Geometry.Erase[op - FLASH_WAIT_ERASE_1].TypicalMs * 1000;
+    }
+}
+
+// Helper function to get the time since the operation started, from the cycle counter
+// while it can't have wrapped and from the tick count after
+static uint32_t flashWaitElapsedUs(Mx25Device_t *device)
+{
+    TickType_t elapsedTicks = xTaskGetTickCount() - device->WaitStartTick;
+
+    if (elapsedTicks < pdMS_TO_TICKS(FLASH_WAIT_CYCLE_COUNT_MAX_MS))
+    {
+        return TIMING_CyclesToUs(TIMING_GetCycles() - device->WaitStartCycles);
+    }
+
+    return elapsedTicks * portTICK_PERIOD_MS * 1000;
+}
+
+// Helper function to sleep on the microsecond timer, or on the RTOS tick when long
+static void flashWaitSleepUs(uint32_t sleepUs)
+{
+    if (sleepUs >= FLASH_WAIT_TICK_SLEEP_US)
+    {
+        vTaskDelay(pdMS_TO_TICKS(sleepUs / 1000));
+    }
+    else if (sleepUs > 0)
+    {
+        TIMING_SleepUs(sleepUs);
+    }
+}
+
+// Helper function to add a completed wait to the statistics of its operation
+static void flashWaitLearn(Mx25Device_t *device, uint32_t elapsedUs, uint32_t polls)
+{
+    FlashWaitStats_t *stats = &device->WaitStats[device->WaitOp];
+
+    taskENTER_CRITICAL();
+    stats->Polls += polls;
+    if (device->WaitTracked)
+    {
+        if (stats->Samples == 0)
+        {
+            stats->AverageUs = elapsedUs;
+            stats->MinUs = elapsedUs;
+            stats->MaxUs = elapsedUs;
+        }
+        else
+        {
+            stats->AverageUs = stats->AverageUs - (stats->AverageUs >> FLASH_WAIT_AVERAGE_SHIFT) +
+                               (elapsedUs >> FLASH_WAIT_AVERAGE_SHIFT);
+            stats->MinUs = (elapsedUs < stats->MinUs) ? elapsedUs : stats->MinUs;
+            stats->MaxUs = (elapsedUs > stats->MaxUs) ? elapsedUs : stats->MaxUs;
+        }
+        stats->Samples++;
+    }
+    taskEXIT_CRITICAL();
+
+    device->WaitTracked = false;
+}
+
 /*
  * Function:       flashWaitTillReady
- * Arguments:      expectTimeMs, expected time-out value of flash operations in ms.
+ * Arguments:      device, the flash instance
+ *                 expectTimeMs, expected time-out value of flash operations in ms.
  *                 No use at non-synchronous IO mode.
  * Description:    Synchronous IO:
+ *                 Sleep through most of the time the operation is expected to take,
+ *                 then poll WIP at a fine interval on the microsecond sleep timer.
+ *                 The expected time is the running average of past completions of
+ *                 the same operation, or its typical time until there is one.
  *                 If flash is ready return true.
  *                 If flash is time-out return FALSE.
  *                 Non-synchronous IO:
  *                 Always return true
  * Return Message: true, false
  */
-static bool flashWaitTillReady(uint32_t expectTimeMs)
+static bool flashWaitTillReady(Mx25Device_t *device, uint32_t expectTimeMs)
 {
 #ifndef NON_SYNCHRONOUS_IO
-    uint32_t startTime = xTaskGetTickCount();
+    uint32_t expectedUs = flashWaitTypicalUs(device, device->WaitOp);
     uint32_t timeoutTicks = pdMS_TO_TICKS(expectTimeMs);
+    uint32_t earlyUs = 0;
+    uint32_t elapsedUs = 0;
+    uint32_t pollUs = 0;
+    uint32_t polls = 0;
+
+    if (device->WaitStats[device->WaitOp].Samples > 0)
+    {
+        expectedUs = device->WaitStats[device->WaitOp].AverageUs;
+    }
 
-    while (flashIsBusy())
+    pollUs = expectedUs / FLASH_WAIT_POLLS_PER_EXPECTED;
+    if (pollUs < FLASH_WAIT_POLL_MIN_US)
     {
-        vTaskDelay(pdMS_TO_TICKS(1));
-        if ((xTaskGetTickCount() - startTime) > timeoutTicks)
+        pollUs = FLASH_WAIT_POLL_MIN_US;
+    }
+
+    // Stay off the bus until the operation is nearly due
+    if (device->AdaptiveWait)
+    {
+        earlyUs = (expectedUs / 100) * FLASH_WAIT_EARLY_PERCENT;
+        elapsedUs = flashWaitElapsedUs(device);
+        if (elapsedUs < earlyUs)
+        {
+            flashWaitSleepUs(earlyUs - elapsedUs);
+        }
+    }
+
+    for (;;)
+    {
+        polls++;
+        if (!flashIsBusy(device))
+        {
+            break;
+        }
+
+        if ((xTaskGetTickCount() - device->WaitStartTick) > timeoutTicks)
         {
+            device->WaitTracked = false;
+            flashWaitLearn(device, 0, polls);
             return false;
         }
+
+        if (device->AdaptiveWait)
+        {
+            flashWaitSleepUs(pollUs);
+        }
+        else
+        {
+            vTaskDelay(pdMS_TO_TICKS(1));
+        }
     }
+
+    flashWaitLearn(device, flashWaitElapsedUs(device), polls);
     return true;
 #else
     return true;
 #endif
 }
 
+/*
+ * Function:       flashReadGeometry
+ * Arguments:      device, the flash instance
+ * Description:    Read the SFDP header and basic flash parameter table and take the
+ *                 geometry and timings from them. The defaults are kept if the part
+ *                 has no usable table or lacks the 4KB erase and 256 byte program
+ *                 the flash services are built on.
+ * Return Message: true if the geometry came from SFDP
+ */
+static bool flashReadGeometry(Mx25Device_t *device)
+{
+    uint8_t header[SFDP_HEADER_LENGTH];
+    uint8_t bfpt[SFDP_BFPT_MAX_DWORDS * sizeof(uint32_t)];
+    uint32_t bfptAddress = 0;
+    uint32_t bfptDwords = 0;
+    FlashGeometry_t geometry = device->Geometry;
+
+    if ((MX25_RDSFDP(device, 0, header, sizeof(header)) != FLASH_OPERATION_SUCCESS) ||
+        !SFDP_ParseHeader(header, &bfptAddress, &bfptDwords) ||
+        (MX25_RDSFDP(device, bfptAddress, bfpt, bfptDwords * sizeof(uint32_t)) != FLASH_OPERATION_SUCCESS) ||
+        !SFDP_ParseBfpt(bfpt, bfptDwords, &geometry))
+    {
+        return false;
+    }
+
+    if ((SFDP_FindErase(&geometry, SECTOR_OFFSET) == NULL) || (geometry.PageSize < PAGE_OFFSET))
+    {
+        return false;
+    }
+
+    device->Geometry = geometry;
+    return true;
+}
+
 /*** Public  Functions ***/
 
 /*
  * Function:       MX25_RDID
- * Arguments:      identification, 32 bit buffer to store id
+ * Arguments:      device, the flash instance
+ *                 identification, 32 bit buffer to store id
  * Description:    The RDID instruction is to read the manufacturer ID
  *                 of 1-byte and followed by Device ID of 2-byte.
  * Return Message: FLASH_OPERATION_SUCCESS, FLASH_OPERATION_FAILED if failed
  */
-flashReturnMsg_t MX25_RDID(uint32_t *identification)
+flashReturnMsg_t MX25_RDID(Mx25Device_t *device, uint32_t *identification)
 {
     uint32_t tempBuffer;
     uint8_t rdidCmd = FLASH_CMD_RDID;
@@ -225,7 +500,7 @@ flashReturnMsg_t MX25_RDID(uint32_t *identification)
     uint8_t dataBuffer[3];
 
     // SPI transfer RDID command
-    status = flashRead(&rdidCmd, sizeof(rdidCmd), dataBuffer, sizeof(dataBuffer));
+    status = flashRead(device, &rdidCmd, sizeof(rdidCmd), dataBuffer, sizeof(dataBuffer));
 
     if (status)
     {
@@ -248,38 +523,20 @@ flashReturnMsg_t MX25_RDID(uint32_t *identification)
 
 /*
  * Function:       MX25_RES
- * Arguments:      electronicIdentification, 8 bit buffer to store electric id
+ * Arguments:      device, the flash instance
+ *                 electronicIdentification, 8 bit buffer to store electric id
  * Description:    The RES instruction is to read the Device
  *                 electric identification of 1-byte.
  * Return Message: FLASH_OPERATION_SUCCESS, FLASH_OPERATION_FAILED if failed
  */
-flashReturnMsg_t MX25_RES(uint8_t *electronicIdentification)
+flashReturnMsg_t MX25_RES(Mx25Device_t *device, uint8_t *electronicIdentification)
 {
-    uint8_t resCmd = FLASH_CMD_RES;
+    // RES opcode followed by 3 dummy bytes, then the ID is clocked out
+    uint8_t resFrame[] = {FLASH_CMD_RES, FLASH_DUMMY_BYTE, FLASH_DUMMY_BYTE, FLASH_DUMMY_BYTE};
     bool status = false;
 
-    // Chip Select Low
-    flashChipSelectLow();
-
-    // SPI transfer RES command
-    status = SPI_Transfer(MX25_FLASH, (uint8_t *)&resCmd, sizeof(resCmd), NULL,
-                          0);
-
-    if (status)
-    {
-        // Insert 3 dummy cycles
-        status = flashInsertDummyCycle(3);
-    }
-
-    if (status)
-    {
-        // Receive Electronic ID
-        SPI_Transfer(MX25_FLASH, NULL, 0, electronicIdentification,
-                     sizeof(electronicIdentification));
-    }
-
-    // Chip Select High
-    flashChipSelectHigh();
+    status = flashReadFrame(device, resFrame, sizeof(resFrame), electronicIdentification,
+                            sizeof(*electronicIdentification));
 
     if (status)
     {
@@ -294,42 +551,23 @@ flashReturnMsg_t MX25_RES(uint8_t *electronicIdentification)
 
 /*
  * Function:       MX25_REMS
- * Arguments:      remsIdentification, 16 bit buffer to store id
+ * Arguments:      device, the flash instance
+ *                 remsIdentification, 16 bit buffer to store id
  *                 fsptr, pointer of flash status structure
  * Description:    The REMS instruction is to read the Device
  *                 manufacturer ID and electric ID of 1-byte.
  * Return Message: FLASH_OPERATION_SUCCESS, FLASH_OPERATION_FAILED if failed
  */
-flashReturnMsg_t MX25_REMS(uint16_t *remsIdentification, FlashStatus_t *fsptr)
+flashReturnMsg_t MX25_REMS(Mx25Device_t *device, uint16_t *remsIdentification, FlashStatus_t *fsptr)
 {
-    uint8_t remsCmd = FLASH_CMD_REMS;
+    // REMS opcode, 2 dummy bytes, then the data arrange option
+    // ArrangeOpt = 0x00 will output the manufacturer's ID first
+    //            = 0x01 will output electric ID first
+    uint8_t remsFrame[] = {FLASH_CMD_REMS, FLASH_DUMMY_BYTE, FLASH_DUMMY_BYTE, (uint8_t)fsptr->ArrangeOpt};
     bool status = false;
     uint8_t dataBuffer[2];
 
-    // Chip Select Low
-    flashChipSelectLow();
-
-    // SPI transfer REMS command
-    status = SPI_Transfer(MX25_FLASH, (uint8_t *)&remsCmd, sizeof(remsCmd), NULL,
-                          0);
-
-    if (status)
-    {
-        // Insert 2 dummy cycles
-        status = flashInsertDummyCycle(2);
-    }
-
-    if (status)
-    {
-        // Send flash command for data arrange option and receive REMS ID
-        // ArrangeOpt = 0x00 will output the manufacturer's ID first
-        //            = 0x01 will output electric ID first
-        status = SPI_Transfer(MX25_FLASH, (uint8_t *)&fsptr->ArrangeOpt, sizeof(fsptr->ArrangeOpt), dataBuffer,
-                              sizeof(dataBuffer));
-    }
-
-    // Chip Select High
-    flashChipSelectHigh();
+    status = flashReadFrame(device, remsFrame, sizeof(remsFrame), dataBuffer, sizeof(dataBuffer));
 
     if (status)
     {
@@ -345,12 +583,13 @@ flashReturnMsg_t MX25_REMS(uint16_t *remsIdentification, FlashStatus_t *fsptr)
 
 /*
  * Function:       MX25_RDSCUR
- * Arguments:      securityReg, 8 bit buffer to store security register value
+ * Arguments:      device, the flash instance
+ *                 securityReg, 8 bit buffer to store security register value
  * Description:    The RDSCUR instruction is for reading the value of
  *                 Security Register bits.
  * Return Message: FLASH_OPERATION_SUCCESS, FLASH_OPERATION_FAILED if failed
  */
-flashReturnMsg_t MX25_RDSCUR(uint8_t *securityReg)
+flashReturnMsg_t MX25_RDSCUR(Mx25Device_t *device, uint8_t *securityReg)
 {
     uint8_t dataBuffer;
     uint8_t rdscurCmd = FLASH_CMD_RDSCUR;
@@ -361,7 +600,7 @@ flashReturnMsg_t MX25_RDSCUR(uint8_t *securityReg)
         return FLASH_OPERATION_FAILED;
     }
 
-    status = flashRead(&rdscurCmd, sizeof(rdscurCmd), &dataBuffer, sizeof(dataBuffer));
+    status = flashRead(device, &rdscurCmd, sizeof(rdscurCmd), &dataBuffer, sizeof(dataBuffer));
 
     if (status)
     {
@@ -374,52 +613,72 @@ flashReturnMsg_t MX25_RDSCUR(uint8_t *securityReg)
     }
 }
 
+/*
+ * Function:       MX25_RDSFDP
+ * Arguments:      device, the flash instance
+ *                 sfdpAddress, address in the SFDP space
+ *                 data, buffer to store the data read
+ *                 length, number of bytes to read
+ * Description:    The RDSFDP instruction reads the JEDEC Serial Flash Discoverable
+ *                 Parameters. It always takes a 3 byte address and 8 dummy cycles.
+ * Return Message: FLASH_OPERATION_SUCCESS, FLASH_OPERATION_FAILED if failed
+ */
+flashReturnMsg_t MX25_RDSFDP(Mx25Device_t *device, uint32_t sfdpAddress, uint8_t *data, uint32_t length)
+{
+    uint8_t frame[FLASH_CMD_FRAME_MAX_LENGTH];
+    uint8_t frameLength = 0;
+
+    frame[frameLength++] = FLASH_CMD_RDSFDP;
+    frame[frameLength++] = sfdpAddress >> 16;
+    frame[frameLength++] = sfdpAddress >> 8;
+    frame[frameLength++] = sfdpAddress;
+
+    for (uint8_t i = 0; i < FLASH_SFDP_DUMMY_BYTES; i++)
+    {
+        frame[frameLength++] = FLASH_DUMMY_BYTE;
+    }
+
+    if (flashReadFrame(device, frame, frameLength, data, length))
+    {
+        return FLASH_OPERATION_SUCCESS;
+    }
+    else
+    {
+        return FLASH_OPERATION_FAILED;
+    }
+}
+
 /*
  * Function:       MX25_READ
- * Arguments:      flashAddress, 32 bit flash memory address
+ * Arguments:      device, the flash instance
+ *                 flashAddress, 32 bit flash memory address
  *                 targetAddress, buffer address to store returned data
  *                 byteLength, length of returned data in byte unit
- * Description:    The READ instruction is for reading data out.
+ * Description:    The READ instruction is for reading data out. FAST_READ is used
+ *                 instead when the bus runs above the READ frequency limit.
+ *                 Any length can be read in one command; the data is streamed in
+ *                 FLASH_READ_CHUNK_SIZE pieces within a single chip select window.
  * Return Message: FLASH_ADDRESS_INVALID, FLASH_OPERATION_SUCCESS, FLASH_OPERATION_FAILED
  */
-flashReturnMsg_t MX25_READ(uint32_t flashAddress, uint8_t *targetAddress, uint32_t byteLength)
+flashReturnMsg_t MX25_READ(Mx25Device_t *device, uint32_t flashAddress, uint8_t *targetAddress, uint32_t byteLength)
 {
-    uint8_t addr4ByteMode;
-    uint8_t readCmd = FLASH_CMD_READ;
+    uint8_t frame[FLASH_CMD_FRAME_MAX_LENGTH];
+    uint8_t frameLength = 0;
     bool status = false;
 
     // Check flash address
-    if (flashAddress > FLASH_SIZE)
+    if (flashAddress > device->Geometry.DeviceSize)
         return FLASH_ADDRESS_INVALID;
 
-    // Check 3-byte or 4-byte mode
-    if (flashIs4Byte())
-        addr4ByteMode = true; // 4-byte mode
+    // FAST_READ needs a dummy byte after the address but isn't limited to fR
+    if (device->UseFastRead)
+        frameLength =
+            flashBuildAddressFrame(device, frame, FLASH_CMD_FASTREAD, flashAddress, FLASH_FASTREAD_DUMMY_BYTES);
     else
-        addr4ByteMode = false; // 3-byte mode
-
-    // Chip Select Low
-    flashChipSelectLow();
-
-    // Write READ command and address
-    status = SPI_Transfer(MX25_FLASH, (uint8_t *)&readCmd, sizeof(readCmd), NULL,
-                          0);
-
-    if (status)
-    {
-        // Send flash address
-        status = flashSendAddr(flashAddress, addr4ByteMode);
-    }
-
-    if (status)
-    {
-        // Receive data from target address
-        SPI_Transfer(MX25_FLASH, NULL, 0, targetAddress,
-                     byteLength);
-    }
+        frameLength = flashBuildAddressFrame(device, frame, FLASH_CMD_READ, flashAddress, 0);
 
-    // Chip select go high to end a flash command
-    flashChipSelectHigh();
+    // Send command and address, then stream the data in one chip select window
+    status = flashReadFrame(device, frame, frameLength, targetAddress, byteLength);
 
     if (status)
     {
@@ -433,11 +692,12 @@ flashReturnMsg_t MX25_READ(uint32_t flashAddress, uint8_t *targetAddress, uint32
 
 /*
  * Function:       MX25_RDSR
- * Arguments:      StatusReg, 8 bit buffer to store status register value
+ * Arguments:      device, the flash instance
+ *                 StatusReg, 8 bit buffer to store status register value
  * Description:    The RDSR instruction is for reading Status Register Bits.
  * Return Message: FLASH_OPERATION_SUCCESS, FLASH_OPERATION_FAILED if failed
  */
-flashReturnMsg_t MX25_RDSR(uint8_t *StatusReg)
+flashReturnMsg_t MX25_RDSR(Mx25Device_t *device, uint8_t *StatusReg)
 {
     uint8_t dataBuffer;
     uint8_t rdsrCmd = FLASH_CMD_RDSR;
@@ -448,7 +708,7 @@ flashReturnMsg_t MX25_RDSR(uint8_t *StatusReg)
         return FLASH_OPERATION_FAILED;
     }
 
-    status = flashRead(&rdsrCmd, sizeof(rdsrCmd), &dataBuffer, sizeof(dataBuffer));
+    status = flashRead(device, &rdsrCmd, sizeof(rdsrCmd), &dataBuffer, sizeof(dataBuffer));
 
     if (status)
     {
@@ -464,17 +724,17 @@ flashReturnMsg_t MX25_RDSR(uint8_t *StatusReg)
 
 /*
  * Function:       MX25_WREN
- * Arguments:      None.
+ * Arguments:      device, the flash instance
  * Description:    The WREN instruction is for setting
  *                 Write Enable Latch (WEL) bit.
  * Return Message: FLASH_OPERATION_SUCCESS, FLASH_OPERATION_FAILED if failed
  */
-flashReturnMsg_t MX25_WREN(void)
+flashReturnMsg_t MX25_WREN(Mx25Device_t *device)
 {
     uint8_t wrenCmd = FLASH_CMD_WREN;
     bool status = false;
 
-    status = flashWrite((uint8_t *)&wrenCmd, sizeof(wrenCmd));
+    status = flashWrite(device, (uint8_t *)&wrenCmd, sizeof(wrenCmd));
 
     if (status)
     {
@@ -487,206 +747,489 @@ flashReturnMsg_t MX25_WREN(void)
 }
 
 /*
- * Function:       MX25_CE
- * Arguments:      None.
- * Description:    The CE instruction is for erasing the data
- *                 of the whole chip to be "1".
- * Return Message: FlashIsBusy, FlashOperationSuccess, FlashTimeOut
+ * Function:       MX25_CEStart
+ * Arguments:      device, the flash instance
+ * Description:    Issue the CE instruction without waiting for the erase cycle
+ *                 to finish. Completion is checked with MX25_IsBusy or MX25_WaitReady.
+ * Return Message: FLASH_IS_BUSY, FLASH_OPERATION_SUCCESS, FLASH_OPERATION_FAILED
  */
-flashReturnMsg_t MX25_CE(void)
+flashReturnMsg_t MX25_CEStart(Mx25Device_t *device)
 {
     flashReturnMsg_t msg = FLASH_OPERATION_FAILED;
     bool status = false;
     uint8_t ceCmd = FLASH_CMD_CE;
 
     // Check flash is busy or not
-    if (flashIsBusy())
+    if (flashIsBusy(device))
     {
         return FLASH_IS_BUSY;
     }
 
     // Setting Write Enable Latch bit
-    msg = MX25_WREN();
+    msg = MX25_WREN(device);
 
     if (msg != FLASH_OPERATION_SUCCESS)
     {
         return msg;
     }
 
-    // Chip select go low to start a flash command
-    flashChipSelectLow();
-
     // Write Chip Erase command = 0x60;
-    status = SPI_Transfer(MX25_FLASH, &ceCmd, sizeof(ceCmd), NULL,
-                          0);
-
-    // Chip select go high to end a flash command
-    flashChipSelectHigh();
+    status = flashWrite(device, &ceCmd, sizeof(ceCmd));
 
     if (!status)
     {
         return FLASH_OPERATION_FAILED;
     }
 
-    if (flashWaitTillReady(CHIP_ERASE_CYCLE_TIME))
-        return FLASH_OPERATION_SUCCESS;
-    else
+    flashWaitStart(device, FLASH_WAIT_CHIP_ERASE);
+
+    return FLASH_OPERATION_SUCCESS;
+}
+
+/*
+ * Function:       MX25_CE
+ * Arguments:      device, the flash instance
+ * Description:    The CE instruction is for erasing the data
+ *                 of the whole chip to be "1".
+ * Return Message: FlashIsBusy, FlashOperationSuccess, FlashTimeOut
+ */
+flashReturnMsg_t MX25_CE(Mx25Device_t *device)
+{
+    flashReturnMsg_t msg = MX25_CEStart(device);
+
+    if (msg != FLASH_OPERATION_SUCCESS)
+    {
+        return msg;
+    }
+
+    if (!flashWaitTillReady(device, device->Geometry.ChipEraseMaxMs))
+    {
         return FLASH_TIME_OUT;
+    }
+
+    return FLASH_OPERATION_SUCCESS;
 }
 
 /*
- * Function:       MX25_SE
- * Arguments:      flashAddress, 32 bit flash memory address
- * Description:    The SE instruction is for erasing the data
- *                 of the chosen sector (4KB) to be "1".
+ * Function:       flashEraseStart
+ * Arguments:      device, the flash instance
+ *                 op, wait statistics the erase is learned under
+ *                 command, erase opcode of one of the part's erase types
+ *                 flashAddress, 32 bit flash memory address
+ * Description:    Issue an address based erase without waiting for the
+ *                 erase cycle to finish.
  * Return Message: FLASH_ADDRESS_INVALID, FLASH_IS_BUSY, FLASH_OPERATION_SUCCESS,
  *                 FLASH_TIME_OUT
  */
-flashReturnMsg_t MX25_SE(uint32_t flashAddress)
+static flashReturnMsg_t flashEraseStart(Mx25Device_t *device, flashWaitOp_t op, uint8_t command, uint32_t flashAddress)
 {
-    uint8_t addr4ByteMode;
-    uint8_t seCmd = FLASH_CMD_SE;
+    uint8_t frame[FLASH_CMD_FRAME_MAX_LENGTH];
+    uint8_t frameLength = 0;
     bool status = false;
 
     // Check flash address
-    if (flashAddress > FLASH_SIZE)
+    if (flashAddress > device->Geometry.DeviceSize)
         return FLASH_ADDRESS_INVALID;
 
     // Check flash is busy or not
-    if (flashIsBusy())
+    if (flashIsBusy(device))
         return FLASH_IS_BUSY;
 
-    // Check 3-byte or 4-byte mode
-    if (flashIs4Byte())
-        addr4ByteMode = true; // 4-byte mode
-    else
-        addr4ByteMode = false; // 3-byte mode
-
     // Setting Write Enable Latch bit
-    if (MX25_WREN() != FLASH_OPERATION_SUCCESS)
+    if (MX25_WREN(device) != FLASH_OPERATION_SUCCESS)
     {
         return FLASH_TIME_OUT;
     }
 
-    // Chip select go low to start a flash command
-    flashChipSelectLow();
-
-    // Write Sector Erase command = 0x20;
-    status = SPI_Transfer(MX25_FLASH, &seCmd, sizeof(seCmd), NULL,
-                          0);
+    // Write erase command and address
+    frameLength = flashBuildAddressFrame(device, frame, command, flashAddress, 0);
+    status = flashSendFrame(device, frame, frameLength, NULL, 0);
 
-    if (status)
+    if (!status)
     {
-        status = flashSendAddr(flashAddress, addr4ByteMode);
+        return FLASH_OPERATION_FAILED;
     }
 
-    // Chip select go high to end a flash command
-    flashChipSelectHigh();
+    flashWaitStart(device, op);
 
-    if (!status)
+    return FLASH_OPERATION_SUCCESS;
+}
+
+/*
+ * Function:       MX25_SEStart
+ * Arguments:      device, the flash instance
+ *                 flashAddress, 32 bit flash memory address
+ * Description:    Issue the SE instruction without waiting for the erase cycle
+ *                 to finish. Completion is checked with MX25_IsBusy or MX25_WaitReady.
+ * Return Message: FLASH_ADDRESS_INVALID, FLASH_IS_BUSY, FLASH_OPERATION_SUCCESS,
+ *                 FLASH_TIME_OUT
+ */
+flashReturnMsg_t MX25_SEStart(Mx25Device_t *device, uint32_t flashAddress)
+{
+    return MX25_EraseStart(device, flashAddress, SECTOR_OFFSET);
+}
+
+/*
+ * Function:       MX25_SE
+ * Arguments:      device, the flash instance
+ *                 flashAddress, 32 bit flash memory address
+ * Description:    The SE instruction is for erasing the data
+ *                 of the chosen sector (4KB) to be "1".
+ * Return Message: FLASH_ADDRESS_INVALID, FLASH_IS_BUSY, FLASH_OPERATION_SUCCESS,
+ *                 FLASH_TIME_OUT
+ */
+flashReturnMsg_t MX25_SE(Mx25Device_t *device, uint32_t flashAddress)
+{
+    return MX25_Erase(device, flashAddress, SECTOR_OFFSET);
+}
+
+/*
+ * Function:       MX25_BE32KStart
+ * Arguments:      device, the flash instance
+ *                 flashAddress, 32 bit flash memory address
+ * Description:    Issue the BE32K instruction without waiting for the erase cycle
+ *                 to finish. Completion is checked with MX25_IsBusy or MX25_WaitReady.
+ * Return Message: FLASH_ADDRESS_INVALID, FLASH_IS_BUSY, FLASH_OPERATION_SUCCESS,
+ *                 FLASH_TIME_OUT
+ */
+flashReturnMsg_t MX25_BE32KStart(Mx25Device_t *device, uint32_t flashAddress)
+{
+    return MX25_EraseStart(device, flashAddress, BLOCK_32K_OFFSET);
+}
+
+/*
+ * Function:       MX25_BE32K
+ * Arguments:      device, the flash instance
+ *                 flashAddress, 32 bit flash memory address
+ * Description:    The BE32K instruction is for erasing the data
+ *                 of the chosen block (32KB) to be "1".
+ * Return Message: FLASH_ADDRESS_INVALID, FLASH_IS_BUSY, FLASH_OPERATION_SUCCESS,
+ *                 FLASH_TIME_OUT
+ */
+flashReturnMsg_t MX25_BE32K(Mx25Device_t *device, uint32_t flashAddress)
+{
+    return MX25_Erase(device, flashAddress, BLOCK_32K_OFFSET);
+}
+
+/*
+ * Function:       MX25_BEStart
+ * Arguments:      device, the flash instance
+ *                 flashAddress, 32 bit flash memory address
+ * Description:    Issue the BE instruction without waiting for the erase cycle
+ *                 to finish. Completion is checked with MX25_IsBusy or MX25_WaitReady.
+ * Return Message: FLASH_ADDRESS_INVALID, FLASH_IS_BUSY, FLASH_OPERATION_SUCCESS,
+ *                 FLASH_TIME_OUT
+ */
+flashReturnMsg_t MX25_BEStart(Mx25Device_t *device, uint32_t flashAddress)
+{
+    return MX25_EraseStart(device, flashAddress, BLOCK_OFFSET);
+}
+
+/*
+ * Function:       MX25_BE
+ * Arguments:      device, the flash instance
+ *                 flashAddress, 32 bit flash memory address
+ * Description:    The BE instruction is for erasing the data
+ *                 of the chosen block (64KB) to be "1".
+ * Return Message: FLASH_ADDRESS_INVALID, FLASH_IS_BUSY, FLASH_OPERATION_SUCCESS,
+ *                 FLASH_TIME_OUT
+ */
+flashReturnMsg_t MX25_BE(Mx25Device_t *device, uint32_t flashAddress)
+{
+    return MX25_Erase(device, flashAddress, BLOCK_OFFSET);
+}
+
+/*
+ * Function:       MX25_EraseStart
+ * Arguments:      device, the flash instance
+ *                 flashAddress, 32 bit flash memory address
+ *                 eraseSize, size of the region to erase in bytes
+ * Description:    Issue the erase command of the part's erase type of that size
+ *                 without waiting for the erase cycle to finish.
+ * Return Message: FLASH_ADDRESS_INVALID, FLASH_IS_BUSY, FLASH_OPERATION_SUCCESS,
+ *                 FLASH_OPERATION_FAILED if the part has no erase of that size,
+ *                 FLASH_TIME_OUT
+ */
+flashReturnMsg_t MX25_EraseStart(Mx25Device_t *device, uint32_t flashAddress, uint32_t eraseSize)
+{
+    const FlashEraseType_t *eraseType = SFDP_FindErase(&device->Geometry, eraseSize);
+
+    if (eraseType == NULL)
     {
         return FLASH_OPERATION_FAILED;
     }
 
-    if (flashWaitTillReady(SECTOR_ERASE_CYCLE_TIME))
+    return flashEraseStart(device, FLASH_WAIT_ERASE_1 + (eraseType - device->Geometry.Erase), eraseType->Opcode,
+                           flashAddress);
+}
+
+/*
+ * Function:       MX25_Erase
+ * Arguments:      device, the flash instance
+ *                 flashAddress, 32 bit flash memory address
+ *                 eraseSize, size of the region to erase in bytes
+ * Description:    Erase the region of that size at flashAddress to "1", polling
+ *                 for completion at a rate set by the erase type's typical time.
+ * Return Message: FLASH_ADDRESS_INVALID, FLASH_IS_BUSY, FLASH_OPERATION_SUCCESS,
+ *                 FLASH_OPERATION_FAILED, FLASH_TIME_OUT
+ */
+flashReturnMsg_t MX25_Erase(Mx25Device_t *device, uint32_t flashAddress, uint32_t eraseSize)
+{
+    const FlashEraseType_t *eraseType = SFDP_FindErase(&device->Geometry, eraseSize);
+    flashReturnMsg_t msg = MX25_EraseStart(device, flashAddress, eraseSize);
+
+    if (msg != FLASH_OPERATION_SUCCESS)
     {
-        return FLASH_OPERATION_SUCCESS;
+        return msg;
     }
-    else
+
+    if (!flashWaitTillReady(device, eraseType->MaxMs))
     {
         return FLASH_TIME_OUT;
     }
+
+    return FLASH_OPERATION_SUCCESS;
 }
 
 /*
- * Function:       MX25_PP
- * Arguments:      flashAddress, 32 bit flash memory address
+ * Function:       MX25_PPStart
+ * Arguments:      device, the flash instance
+ *                 flashAddress, 32 bit flash memory address
  *                 sourceAddress, buffer address of source data to program
  *                 byteLength, byte length of data to programm
- * Description:    The PP instruction is for programming
- *                 the memory to be "0".
- *                 The device only accept the last 256 byte ( or 32 byte ) to program.
- *                 If the page address ( flashAddress[7:0] ) reach 0xFF, it will
- *                 program next at 0x00 of the same page.
- *                 Some products have smaller page size ( 32 byte )
+ * Description:    Issue the PP instruction without waiting for the program cycle
+ *                 to finish. The caller must wait with MX25_WaitReady before the
+ *                 next program or erase.
+ *                 The data must not cross a page boundary: the device would wrap
+ *                 to 0x00 of the same page and overwrite the start of it.
  * Return Message: FLASH_ADDRESS_INVALID, FLASH_IS_BUSY, FLASH_OPERATION_SUCCESS,
  *                 FLASH_TIME_OUT
  */
-flashReturnMsg_t MX25_PP(uint32_t flashAddress, uint8_t *sourceAddress, uint32_t byteLength)
+flashReturnMsg_t MX25_PPStart(Mx25Device_t *device, uint32_t flashAddress, uint8_t *sourceAddress, uint32_t byteLength)
 {
-    uint8_t addr4ByteMode;
-    uint8_t ppCmd = FLASH_CMD_PP;
+    uint8_t frame[FLASH_CMD_FRAME_MAX_LENGTH];
+    uint8_t frameLength = 0;
     bool status = false;
 
     // Check flash address
-    if (flashAddress > FLASH_SIZE)
+    if (flashAddress > device->Geometry.DeviceSize)
+        return FLASH_ADDRESS_INVALID;
+
+    // Check the data stays within one page
+    if (((flashAddress % PAGE_OFFSET) + byteLength) > PAGE_OFFSET)
         return FLASH_ADDRESS_INVALID;
 
     // Check flash is busy or not
-    if (flashIsBusy())
+    if (flashIsBusy(device))
         return FLASH_IS_BUSY;
 
-    // Check 3-byte or 4-byte mode
-    if (flashIs4Byte())
-        addr4ByteMode = true; // 4-byte mode
-    else
-        addr4ByteMode = false; // 3-byte mode
-
     // Setting Write Enable Latch bit
-    if (MX25_WREN() != FLASH_OPERATION_SUCCESS)
+    if (MX25_WREN(device) != FLASH_OPERATION_SUCCESS)
     {
         return FLASH_TIME_OUT;
     }
 
-    // Chip select go low to start a flash command
-    flashChipSelectLow();
+    // Write Page Program command = 0x02, address and data in one chip select window
+    frameLength = flashBuildAddressFrame(device, frame, FLASH_CMD_PP, flashAddress, 0);
+    status = flashSendFrame(device, frame, frameLength, sourceAddress, byteLength);
 
-    // Write Sector Erase command = 0x20;
-    status = SPI_Transfer(MX25_FLASH, &ppCmd, sizeof(ppCmd), NULL,
-                          0);
+    if (!status)
+    {
+        return FLASH_TIME_OUT;
+    }
 
-    if (status)
+    flashWaitStart(device, FLASH_WAIT_PROGRAM);
+
+    return FLASH_OPERATION_SUCCESS;
+}
+
+/*
+ * Function:       MX25_PP
+ * Arguments:      device, the flash instance
+ *                 flashAddress, 32 bit flash memory address
+ *                 sourceAddress, buffer address of source data to program
+ *                 byteLength, byte length of data to programm
+ * Description:    The PP instruction is for programming
+ *                 the memory to be "0".
+ *                 The device only accept the last 256 byte ( or 32 byte ) to program.
+ *                 Writes that would wrap past the end of the page are rejected.
+ *                 Some products have smaller page size ( 32 byte )
+ * Return Message: FLASH_ADDRESS_INVALID, FLASH_IS_BUSY, FLASH_OPERATION_SUCCESS,
+ *                 FLASH_TIME_OUT
+ */
+flashReturnMsg_t MX25_PP(Mx25Device_t *device, uint32_t flashAddress, uint8_t *sourceAddress, uint32_t byteLength)
+{
+    flashReturnMsg_t msg = MX25_PPStart(device, flashAddress, sourceAddress, byteLength);
+
+    if (msg != FLASH_OPERATION_SUCCESS)
     {
-        flashSendAddr(flashAddress, addr4ByteMode);
+        return msg;
     }
 
-    if (status)
+    // Wait for flash to reset busy flag
+    return MX25_WaitReady(device, (device->Geometry.ProgramMaxUs + 999) / 1000);
+}
+
+/*
+ * Function:       MX25_WaitReady
+ * Arguments:      device, the flash instance
+ *                 timeoutMs, maximum time to wait in ms
+ * Description:    Wait for a program or erase cycle started earlier to finish.
+ * Return Message: FLASH_OPERATION_SUCCESS, FLASH_TIME_OUT
+ */
+flashReturnMsg_t MX25_WaitReady(Mx25Device_t *device, uint32_t timeoutMs)
+{
+    if (flashWaitTillReady(device, timeoutMs))
+        return FLASH_OPERATION_SUCCESS;
+    else
+        return FLASH_TIME_OUT;
+}
+
+/*
+ * Function:       MX25_IsBusy
+ * Arguments:      device, the flash instance
+ * Description:    Check whether a program or erase cycle is still running.
+ *                 Returns false while the cycle is suspended.
+ * Return Message: true, false
+ */
+bool MX25_IsBusy(Mx25Device_t *device)
+{
+    return flashIsBusy(device);
+}
+
+/*
+ * Function:       MX25_CheckResult
+ * Arguments:      device, the flash instance
+ * Description:    Check the security register fail bits after a program
+ *                 or erase cycle has finished.
+ * Return Message: FLASH_OPERATION_SUCCESS, FLASH_OPERATION_FAILED
+ */
+flashReturnMsg_t MX25_CheckResult(Mx25Device_t *device)
+{
+    uint8_t securityReg = 0;
+
+    if (MX25_RDSCUR(device, &securityReg) != FLASH_OPERATION_SUCCESS)
     {
-        status = SPI_Transfer(MX25_FLASH, sourceAddress, byteLength, NULL,
-                              0);
+        return FLASH_OPERATION_FAILED;
     }
 
-    // Chip select go high to end a flash command
-    flashChipSelectHigh();
+    if ((securityReg & (FLASH_PFAIL_MASK | FLASH_EFAIL_MASK)) != 0)
+    {
+        return FLASH_OPERATION_FAILED;
+    }
 
-    if (!status)
+    return FLASH_OPERATION_SUCCESS;
+}
+
+/*
+ * Function:       MX25_Suspend
+ * Arguments:      device, the flash instance
+ * Description:    Suspend the program or erase cycle in progress so the array
+ *                 can be read. Waits out the minimum interval since the last
+ *                 resume and the suspend latency, then confirms the suspend
+ *                 from the security register.
+ * Return Message: FLASH_OPERATION_SUCCESS if suspended,
+ *                 FLASH_OPERATION_FAILED if no cycle was in progress,
+ *                 FLASH_TIME_OUT if the device is still busy
+ */
+flashReturnMsg_t MX25_Suspend(Mx25Device_t *device)
+{
+    uint8_t suspendCmd = FLASH_CMD_PGM_ERS_S;
+    uint8_t securityReg = 0;
+    uint32_t sinceResumeUs = 0;
+
+    if (device->Suspended)
+    {
+        return FLASH_OPERATION_SUCCESS;
+    }
+
+    if (!flashIsBusy(device))
+    {
+        return FLASH_OPERATION_FAILED;
+    }
+
+    // A suspend issued too soon after a resume stops the cycle from making progress
+    sinceResumeUs = TIMING_CyclesToUs(TIMING_GetCycles() - device->ResumeCycles);
+    if (sinceResumeUs < device->ResumeHoldUs)
+    {
+        TIMING_DelayUs(device->ResumeHoldUs - sinceResumeUs);
+    }
+
+    if (!flashWrite(device, &suspendCmd, sizeof(suspendCmd)))
+    {
+        return FLASH_OPERATION_FAILED;
+    }
+
+    // Both latencies are well below a tick, so busy-wait them
+    TIMING_DelayUs(ERASE_SUSPEND_LATENCY_US > PROGRAM_SUSPEND_LATENCY_US ? ERASE_SUSPEND_LATENCY_US
+                                                                         : PROGRAM_SUSPEND_LATENCY_US);
+
+    if (flashIsBusy(device))
     {
         return FLASH_TIME_OUT;
     }
 
-    // Wait for flash to reset busy flag
-    if (flashWaitTillReady(PAGE_PROGRAM_CYCLE_TIME))
+    if (MX25_RDSCUR(device, &securityReg) != FLASH_OPERATION_SUCCESS)
+    {
+        return FLASH_OPERATION_FAILED;
+    }
+
+    // The cycle may have finished just before the suspend arrived
+    if ((securityReg & (FLASH_ESB_MASK | FLASH_PSB_MASK)) == 0)
+    {
+        return FLASH_OPERATION_FAILED;
+    }
+
+    device->Suspended = true;
+    device->SuspendedErase = ((securityReg & FLASH_ESB_MASK) != 0);
+    device->WaitTracked = false;
+
+    return FLASH_OPERATION_SUCCESS;
+}
+
+/*
+ * Function:       MX25_Resume
+ * Arguments:      device, the flash instance
+ * Description:    Resume a program or erase cycle suspended by MX25_Suspend.
+ * Return Message: FLASH_OPERATION_SUCCESS, FLASH_OPERATION_FAILED
+ */
+flashReturnMsg_t MX25_Resume(Mx25Device_t *device)
+{
+    uint8_t resumeCmd = FLASH_CMD_PGM_ERS_R;
+
+    if (!device->Suspended)
+    {
         return FLASH_OPERATION_SUCCESS;
-    else
-        return FLASH_TIME_OUT;
+    }
+
+    if (!flashWrite(device, &resumeCmd, sizeof(resumeCmd)))
+    {
+        return FLASH_OPERATION_FAILED;
+    }
+
+    device->Suspended = false;
+    device->ResumeCycles = TIMING_GetCycles();
+    device->ResumeHoldUs = device->SuspendedErase ? ERASE_RESUME_TO_SUSPEND_US : PROGRAM_RESUME_TO_SUSPEND_US;
+
+    return FLASH_OPERATION_SUCCESS;
 }
 
 /*
  * Function:       MX25_DP
- * Arguments:      None.
+ * Arguments:      device, the flash instance
  * Description:    The Deep Power Down instruction is for setting the
  *                 device on the minimizing the power consumption.
  * Return Message: None.
  */
-flashReturnMsg_t MX25_DP(void)
+flashReturnMsg_t MX25_DP(Mx25Device_t *device)
 {
     uint8_t dpCmd = FLASH_CMD_DP;
     bool status = false;
 
-    status = flashWrite((uint8_t *)&dpCmd, sizeof(dpCmd));
+    status = flashWrite(device, (uint8_t *)&dpCmd, sizeof(dpCmd));
 
     // Give the device time to transition from standby mode to power down mode
-    vTaskDelay(pdMS_TO_TICKS(STANDBY_TO_DP_MODE_DELAY));
+    TIMING_DelayUs(STANDBY_TO_DP_MODE_DELAY_US);
 
     if (status)
     {
@@ -700,45 +1243,165 @@ flashReturnMsg_t MX25_DP(void)
 
 /*
  * Function:       MX25_WAKE
- * Arguments:      None.
+ * Arguments:      device, the flash instance
  * Description:    The wake up function sets CS pin low to wake up flash from deep power down
  * Return Message: None.
  */
-void MX25_WAKE(void)
+void MX25_WAKE(Mx25Device_t *device)
 {
+    // Keep other devices off the bus while CS is low
+    if (!SPI_BusAcquire(device->Bus))
+    {
+        return;
+    }
+
     // Clear CS
-    flashChipSelectLow();
+    flashChipSelectLow(device);
 
     // Wake the device by leaving CS low
-    vTaskDelay(pdMS_TO_TICKS(WAKE_UP_CS_PIN_LOW_TIME));
+    TIMING_DelayUs(WAKE_UP_CS_PIN_LOW_TIME_US);
 
     // Set CS
-    flashChipSelectHigh();
+    flashChipSelectHigh(device);
+
+    SPI_BusRelease(device->Bus);
+
+    // Give the device time to transition from power down mode to standby mode,
+    // sleeping on the microsecond timer rather than a whole tick
+    TIMING_SleepUs(DP_TO_STANDBY_MODE_DELAY_US);
+}
+
+/*
+ * Function:       MX25_GetGeometry
+ * Arguments:      device, the flash instance
+ * Description:    Geometry and timings in use, from SFDP when the part has a usable
+ *                 table, otherwise the datasheet defaults in mx25v1635f.h.
+ * Return Message: Pointer to the geometry
+ */
+const FlashGeometry_t *MX25_GetGeometry(const Mx25Device_t *device)
+{
+    return &device->Geometry;
+}
+
+/*
+ * Function:       MX25_PollIntervalMs
+ * Arguments:      typicalMs, typical duration of the operation being waited on
+ * Description:    Time between busy polls: a few polls per typical duration, so a
+ *                 long erase doesn't keep the bus busy and a short one isn't overslept.
+ * Return Message: Poll interval in ms, at least 1
+ */
+uint32_t MX25_PollIntervalMs(uint32_t typicalMs)
+{
+    uint32_t pollMs = typicalMs / FLASH_POLLS_PER_TYPICAL;
+
+    if (pollMs < 1)
+    {
+        pollMs = 1;
+    }
+    else if (pollMs > FLASH_POLL_MAX_INTERVAL_MS)
+    {
+        pollMs = FLASH_POLL_MAX_INTERVAL_MS;
+    }
 
-    // Give the device time to transition from power down mode to standby mode
-    vTaskDelay(pdMS_TO_TICKS(DP_TO_STANDBY_MODE_DELAY));
+    return pollMs;
+}
+
+/*
+ * Function:       MX25_GetWaitStats
+ * Arguments:      device, the flash instance
+ *                 op, operation to get the statistics of
+ *                 stats, filled with the completion times learned for it
+ * Description:    Completion times of the synchronous waits on an operation.
+ *                 Suspended operations are not learned.
+ * Return Message: None
+ */
+void MX25_GetWaitStats(const Mx25Device_t *device, flashWaitOp_t op, FlashWaitStats_t *stats)
+{
+    if (op >= FLASH_WAIT_OPS)
+    {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    *stats = device->WaitStats[op];
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * Function:       MX25_ResetWaitStats
+ * Arguments:      device, the flash instance
+ * Description:    Forget the learned completion times, so the next waits start
+ *                 from the typical times again.
+ * Return Message: None
+ */
+void MX25_ResetWaitStats(Mx25Device_t *device)
+{
+    taskENTER_CRITICAL();
+    memset(device->WaitStats, 0, sizeof(device->WaitStats));
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * Function:       MX25_SetAdaptiveWait
+ * Arguments:      device, the flash instance
+ *                 enabled, false to poll once per tick from the start of the wait
+ * Description:    Turn the adaptive wait on or off. Statistics are kept either way.
+ * Return Message: None
+ */
+void MX25_SetAdaptiveWait(Mx25Device_t *device, bool enabled)
+{
+    device->AdaptiveWait = enabled;
 }
 
 /*
  * Function:       MX25_Init
- * Arguments:      None
- * Description:    Initialize Chip Select pin for MX25 flash,
- *                  Set Chip Select pin high
+ * Arguments:      device, the instance to set up
+ *                 csPort, csPin, chip select of the part
+ *                 bus, SPI bus the part is on
+ * Description:    Set up an instance with its wiring and the datasheet defaults,
+ *                  initialize its Chip Select pin and set it high, read the geometry
+ *                  from SFDP, cache the address mode and the read command to use.
+ *                  Each part on the board gets its own instance.
  * Return Message: true
  */
-bool MX25_Init(void)
+bool MX25_Init(Mx25Device_t *device, GPIO_TypeDef *csPort, uint16_t csPin, SpiDevice_t bus)
 {
     GPIO_InitTypeDef GPIO_InitStruct = {0};
 
+    memset(device, 0, sizeof(*device));
+    device->CsPort = csPort;
+    device->CsPin = csPin;
+    device->Bus = bus;
+    device->Geometry = xDefaultGeometry;
+    device->AdaptiveWait = true;
+
     // Init FLASH CS pin
-    GPIO_ClockEnable(PORT(FLASH_CS));
-    GPIO_InitStruct.Pin = PIN(FLASH_CS);
+    GPIO_ClockEnable(device->CsPort);
+    GPIO_InitStruct.Pin = device->CsPin;
     GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
     GPIO_InitStruct.Pull = GPIO_PULLUP;
-    HAL_GPIO_Init(PORT(FLASH_CS), &GPIO_InitStruct);
+    HAL_GPIO_Init(device->CsPort, &GPIO_InitStruct);
 
     // Set CS pin high (Set it low during SPI comm)
-    flashChipSelectHigh();
+    flashChipSelectHigh(device);
+
+    // A reset of the MCU alone leaves the flash in deep power down if it was put there
+    MX25_WAKE(device);
+
+    // Take geometry and timings from the part itself so second source parts run unchanged
+    flashReadGeometry(device);
+
+    // Detect the addressing mode once so read/program/erase don't need an RDSCUR each time.
+    // A part that only takes 4 byte addresses says so in its SFDP table.
+    device->Addr4ByteMode = flashDetectAddressMode(device) || (device->Geometry.AddressBytes == 4);
+
+    // Legacy READ is limited to fR, switch to FAST_READ when the bus runs faster
+#ifdef FLASH_FORCE_FAST_READ
+    device->UseFastRead = true;
+#else
+    device->UseFastRead = (SPI_GetClockHz(device->Bus) > FLASH_READ_MAX_CLOCK_HZ);
+#endif
 
     return true;
 }
@@ -6,6 +6,10 @@
  *      Author: Belina Sainju
  */
 
+#include "sfdp.h"
+#include "../platform/gpio/gpio.h"
+#include "../platform/spi/spi-core.h"
+
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -15,25 +19,76 @@
 #define ELECTRONIC_ID 0x15
 #define REMS_ID_0 0xC215
 #define REMS_ID_1 0x15C2
-#define FLASH_SIZE 0x200000 // 2MB
+#define FLASH_SIZE 0x200000 // 2MB, the size the flash layout is built for
+
+// Addressing mode
+// The MX25V1635F only supports 3-byte addresses. Fix it at compile time so the driver never
+// has to ask the part (bit 2 of this part's security register is PSB, not 4BYTE).
+// Parts that can switch modes should leave both undefined so the mode is read once at init.
+#define FLASH_3BYTE_ONLY 1
+// #define FLASH_4BYTE_ONLY 1
 
-// Timing values taken from datasheet
+// Timing values taken from datasheet. These and the geometry below are defaults: MX25_Init
+// replaces them with the values the part reports in its SFDP table, see MX25_GetGeometry.
 #define tPP 4     // 4ms
 #define tSE 240   // Sector Erase Cycle time max 240ms
 #define tPUW 10   // 10 ms (Value taken from Macronix LLD reference)
-#define tDP 1     // 10us (Transition time from StandBy mode to DeepPowerDown mode)
-#define tDPDD 1   // 30us (Delay time to release from deep power down mode)
-#define tCRDP 1   // 20ns (Min time CS needs to be low to wake flash)
-#define tRDP 1    // 45us (Transition time from DeepPowerDown mode to StandBy mode)
+#define tDP 10    // 10us (Transition time from StandBy mode to DeepPowerDown mode)
+#define tDPDD 30  // 30us (Delay time to release from deep power down mode)
+#define tCRDP 1   // 20ns, rounded up to 1us (Min time CS needs to be low to wake flash)
+#define tRDP 45   // 45us (Transition time from DeepPowerDown mode to StandBy mode)
+#define tBE32K 1000 // 32KB Block Erase Cycle time max 1s
+#define tBE 2000    // 64KB Block Erase Cycle time max 2s
 #define tCE 38000 // 38sec
 
+// Typical times, used to estimate how long an operation will take and how often to poll
+#define tPP_TYP_US 500
+#define tSE_TYP 25
+#define tBE32K_TYP 150
+#define tBE_TYP 300
+#define tCE_TYP 5000
+
+// Busy polls per typical operation time, and the longest gap between polls, for callers
+// polling with MX25_IsBusy
+#define FLASH_POLLS_PER_TYPICAL 4
+#define FLASH_POLL_MAX_INTERVAL_MS 16
+
+// Adaptive wait: sleep through most of the expected time, learned from past completions,
+// then poll finely on the microsecond sleep timer instead of once per RTOS tick
+#define FLASH_WAIT_EARLY_PERCENT 90        // Share of the expected time slept before the first poll
+#define FLASH_WAIT_POLLS_PER_EXPECTED 16   // Poll interval after that, as a fraction of expected
+#define FLASH_WAIT_POLL_MIN_US 25          // About four status reads worth of bus time
+#define FLASH_WAIT_TICK_SLEEP_US 10000     // Longer sleeps go on the RTOS tick
+#define FLASH_WAIT_AVERAGE_SHIFT 3         // Each completion moves the average 1/8 of the way
+#define FLASH_WAIT_CYCLE_COUNT_MAX_MS 10000 // Cycle counter wraps after ~25s, use ticks beyond this
+
+// Suspend/resume timing in microseconds
+#define tPSL_US 20  // Program suspend latency
+#define tESL_US 20  // Erase suspend latency
+#define tPRS_US 100 // Min time from program resume to the next suspend
+#define tERS_US 400 // Min time from erase resume to the next suspend
+
+// Max SCLK for the legacy READ (0x03) command. Above this FAST_READ (0x0B) must be used.
+#define FLASH_READ_MAX_CLOCK_HZ 33000000
+#define FLASH_FASTREAD_DUMMY_BYTES 1 // 8 dummy cycles after the address
+#define FLASH_SFDP_DUMMY_BYTES 1     // RDSFDP always takes a 3 byte address and 8 dummy cycles
+
+// Largest data chunk moved per SPI transfer while streaming a read (must fit a DMA transfer)
+#define FLASH_READ_CHUNK_SIZE 0x8000
+
 #define PAGE_PROGRAM_CYCLE_TIME tPP
 #define SECTOR_ERASE_CYCLE_TIME tSE
 #define FLASH_FULL_ACCESS_TIME tPUW
-#define STANDBY_TO_DP_MODE_DELAY tDP
-#define WAKE_UP_CS_PIN_LOW_TIME tCRDP
-#define DP_TO_STANDBY_MODE_DELAY tRDP
+#define STANDBY_TO_DP_MODE_DELAY_US tDP
+#define WAKE_UP_CS_PIN_LOW_TIME_US tCRDP
+#define DP_TO_STANDBY_MODE_DELAY_US tRDP
+#define BLOCK_32K_ERASE_CYCLE_TIME tBE32K
+#define BLOCK_ERASE_CYCLE_TIME tBE
 #define CHIP_ERASE_CYCLE_TIME tCE
+#define PROGRAM_SUSPEND_LATENCY_US tPSL_US
+#define ERASE_SUSPEND_LATENCY_US tESL_US
+#define PROGRAM_RESUME_TO_SUSPEND_US tPRS_US
+#define ERASE_RESUME_TO_SUSPEND_US tERS_US
 
 /*
   Flash Related Parameter Define
@@ -54,6 +109,10 @@
 // security register
 #define FLASH_OTPLOCK_MASK 0x03
 #define FLASH_4BYTE_MASK 0x04
+#define FLASH_PSB_MASK 0x04   // Program suspended (MX25V1635F)
+#define FLASH_ESB_MASK 0x08   // Erase suspended (MX25V1635F)
+#define FLASH_PFAIL_MASK 0x20 // Last program failed
+#define FLASH_EFAIL_MASK 0x40 // Last erase failed
 #define FLASH_WPSEL_MASK 0x80
 // configuration reigster
 #define FLASH_DC_MASK 0x80
@@ -135,6 +194,28 @@ typedef enum
     FLASH_ADDRESS_INVALID
 } flashReturnMsg_t;
 
+// Operations whose completion times are learned by the adaptive wait
+typedef enum
+{
+    FLASH_WAIT_PROGRAM,
+    FLASH_WAIT_ERASE_1, // Erase types in MX25_GetGeometry order, largest first
+    FLASH_WAIT_ERASE_2,
+    FLASH_WAIT_ERASE_3,
+    FLASH_WAIT_ERASE_4,
+    FLASH_WAIT_CHIP_ERASE,
+    FLASH_WAIT_OPS
+} flashWaitOp_t;
+
+// Completion time statistics of one operation
+typedef struct
+{
+    uint32_t Samples;
+    uint32_t AverageUs; // Running average the next wait sleeps on
+    uint32_t MinUs;
+    uint32_t MaxUs;
+    uint32_t Polls; // Status register reads over all waits
+} FlashWaitStats_t;
+
 // Flash status structure define
 typedef struct
 {
@@ -154,39 +235,105 @@ typedef struct
     bool ArrangeOpt;
 } FlashStatus_t;
 
+// One MX25 part. MX25_Init sets the wiring; the rest is driver state, only touched through the
+// MX25_ functions. Each part on the board has its own instance, so parts sharing a bus
+// differ only in their chip select.
+typedef struct
+{
+    // Wiring
+    GPIO_TypeDef *CsPort;
+    uint16_t CsPin;
+    SpiDevice_t Bus;
+
+    // Geometry and timings, the datasheet values until MX25_Init reads the SFDP table
+    FlashGeometry_t Geometry;
+
+    // Address mode and read command, detected once at init
+    bool Addr4ByteMode;
+    bool UseFastRead;
+
+    // Set while a program/erase is suspended by MX25_Suspend
+    bool Suspended;
+    bool SuspendedErase;
+
+    // Earliest cycle count a new suspend may be issued after the last resume
+    uint32_t ResumeCycles;
+    uint32_t ResumeHoldUs;
+
+    // Operation the next wait is for, noted when its command is sent
+    flashWaitOp_t WaitOp;
+    uint32_t WaitStartCycles;
+    uint32_t WaitStartTick;
+    bool WaitTracked; // Cleared by a suspend, whose time would skew the average
+
+    bool AdaptiveWait;
+    FlashWaitStats_t WaitStats[FLASH_WAIT_OPS];
+} Mx25Device_t;
+
 // =============================================================================================#=
 // Public API Functions
 // =============================================================================================#=
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
-// One-time startup initialization for the MX25V1635F Flash
+// One-time startup initialization of one MX25V1635F Flash on the given chip select and bus
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
-bool MX25_Init(void);
+bool MX25_Init(Mx25Device_t *device, GPIO_TypeDef *csPort, uint16_t csPin, SpiDevice_t bus);
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
 // Functions for ID commands
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
-flashReturnMsg_t MX25_RDID(uint32_t *identification);
-flashReturnMsg_t MX25_RES(uint8_t *electronicIdentification);
-flashReturnMsg_t MX25_REMS(uint16_t *remsIdentification, FlashStatus_t *fsptr);
+flashReturnMsg_t MX25_RDID(Mx25Device_t *device, uint32_t *identification);
+flashReturnMsg_t MX25_RES(Mx25Device_t *device, uint8_t *electronicIdentification);
+flashReturnMsg_t MX25_REMS(Mx25Device_t *device, uint16_t *remsIdentification, FlashStatus_t *fsptr);
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
 // Functions for register setting commands
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
-flashReturnMsg_t MX25_RDSR(uint8_t *statusReg);
-flashReturnMsg_t MX25_RDSCUR(uint8_t *securityReg);
-flashReturnMsg_t MX25_WREN(void);
-flashReturnMsg_t MX25_DP(void);
+flashReturnMsg_t MX25_RDSR(Mx25Device_t *device, uint8_t *statusReg);
+flashReturnMsg_t MX25_RDSCUR(Mx25Device_t *device, uint8_t *securityReg);
+flashReturnMsg_t MX25_RDSFDP(Mx25Device_t *device, uint32_t sfdpAddress, uint8_t *data, uint32_t length);
+flashReturnMsg_t MX25_WREN(Mx25Device_t *device);
+flashReturnMsg_t MX25_DP(Mx25Device_t *device);
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
 // Functions for read/write array commands
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
-flashReturnMsg_t MX25_READ(uint32_t flashAddress, uint8_t *targetAddress, uint32_t byteLength);
-flashReturnMsg_t MX25_PP(uint32_t flashAddress, uint8_t *sourceAddress, uint32_t byteLength);
-flashReturnMsg_t MX25_SE(uint32_t flashAddress);
-flashReturnMsg_t MX25_CE(void);
+flashReturnMsg_t MX25_READ(Mx25Device_t *device, uint32_t flashAddress, uint8_t *targetAddress, uint32_t byteLength);
+flashReturnMsg_t MX25_PP(Mx25Device_t *device, uint32_t flashAddress, uint8_t *sourceAddress, uint32_t byteLength);
+flashReturnMsg_t MX25_PPStart(Mx25Device_t *device, uint32_t flashAddress, uint8_t *sourceAddress, uint32_t byteLength);
+flashReturnMsg_t MX25_SE(Mx25Device_t *device, uint32_t flashAddress);
+flashReturnMsg_t MX25_SEStart(Mx25Device_t *device, uint32_t flashAddress);
+flashReturnMsg_t MX25_BE32K(Mx25Device_t *device, uint32_t flashAddress);
+flashReturnMsg_t MX25_BE32KStart(Mx25Device_t *device, uint32_t flashAddress);
+flashReturnMsg_t MX25_BE(Mx25Device_t *device, uint32_t flashAddress);
+flashReturnMsg_t MX25_BEStart(Mx25Device_t *device, uint32_t flashAddress);
+flashReturnMsg_t MX25_CE(Mx25Device_t *device);
+flashReturnMsg_t MX25_CEStart(Mx25Device_t *device);
+
+// Erase with whichever erase type of the part has the given size
+flashReturnMsg_t MX25_Erase(Mx25Device_t *device, uint32_t flashAddress, uint32_t eraseSize);
+flashReturnMsg_t MX25_EraseStart(Mx25Device_t *device, uint32_t flashAddress, uint32_t eraseSize);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Functions to suspend a program/erase in progress so the array can be read
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+flashReturnMsg_t MX25_Suspend(Mx25Device_t *device);
+flashReturnMsg_t MX25_Resume(Mx25Device_t *device);
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
 // Other Public API functions
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
-void MX25_WAKE(void);
+void MX25_WAKE(Mx25Device_t *device);
+const FlashGeometry_t *MX25_GetGeometry(const Mx25Device_t *device);
+uint32_t MX25_PollIntervalMs(uint32_t typicalMs);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Completion time statistics of the waits in MX25_WaitReady, MX25_PP, MX25_Erase and MX25_CE.
+// The adaptive wait can be turned off to compare against polling once per tick.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+void MX25_GetWaitStats(const Mx25Device_t *device, flashWaitOp_t op, FlashWaitStats_t *stats);
+void MX25_ResetWaitStats(Mx25Device_t *device);
+void MX25_SetAdaptiveWait(Mx25Device_t *device, bool enabled);
+flashReturnMsg_t MX25_WaitReady(Mx25Device_t *device, uint32_t timeoutMs);
+bool MX25_IsBusy(Mx25Device_t *device);
+flashReturnMsg_t MX25_CheckResult(Mx25Device_t *device);
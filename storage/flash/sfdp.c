@@ -0,0 +1,214 @@
+/*
+ * sfdp.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Belina Sainju
+ */
+
+#include "sfdp.h"
+
+#include <string.h>
+
+/* Private Defines ----------------------------------------------------------*/
+// Basic flash parameter table DWORDs, numbered from 1 as in JESD216
+#define BFPT_DWORD_FEATURES 1
+#define BFPT_DWORD_DENSITY 2
+#define BFPT_DWORD_ERASE_TYPES_1_2 8
+#define BFPT_DWORD_ERASE_TYPES_3_4 9
+#define BFPT_DWORD_ERASE_TIMES 10
+#define BFPT_DWORD_PROGRAM_TIMES 11
+
+#define BFPT_ADDRESS_BYTES_4_ONLY 2
+
+/* Private functions ----------------------------------------------------------*/
+
+// Helper function to get a little-endian DWORD of a parameter table
+static uint32_t sfdpDword(const uint8_t *table, uint32_t dword)
+{
+    const uint8_t *bytes = &table[(dword - 1) * sizeof(uint32_t)];
+
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+// Helper function to get a bit field of a DWORD
+static uint32_t sfdpField(uint32_t value, uint8_t lowBit, uint8_t width)
+{
+    return (value >> lowBit) & ((1U << width) - 1);
+}
+
+// Helper function to order the erase types largest first, unsupported types last
+static void sfdpSortErase(FlashEraseType_t *erase)
+{
+    FlashEraseType_t swap = {0};
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    for (i = 0; i < SFDP_ERASE_TYPES; i++)
+    {
+        for (j = i + 1; j < SFDP_ERASE_TYPES; j++)
+        {
+            if (erase[j].Size > erase[i].Size)
+            {
+                swap = erase[i];
+                erase[i] = erase[j];
+                erase[j] = swap;
+            }
+        }
+    }
+}
+
+/* Public functions ----------------------------------------------------------*/
+bool SFDP_ParseHeader(const uint8_t *header, uint32_t *bfptAddress, uint32_t *bfptDwords)
+{
+    uint16_t parameterId = 0;
+
+    // Signature, then major revision 1 (minor revisions only add fields)
+    if ((sfdpDword(header, 1) != SFDP_SIGNATURE) || (header[5] != 1))
+    {
+        return false;
+    }
+
+    // The first parameter header always describes the basic flash parameter table
+    parameterId = ((uint16_t)header[15] << 8) | header[8];
+    if ((parameterId != SFDP_BFPT_ID) || (header[11] < SFDP_BFPT_MIN_DWORDS))
+    {
+        return false;
+    }
+
+    *bfptDwords = (header[11] > SFDP_BFPT_MAX_DWORDS) ? SFDP_BFPT_MAX_DWORDS : header[11];
+    *bfptAddress = (uint32_t)header[12] | ((uint32_t)header[13] << 8) | ((uint32_t)header[14] << 16);
+
+    return true;
+}
+
+bool SFDP_ParseBfpt(const uint8_t *bfpt, uint32_t bfptDwords, FlashGeometry_t *geometry)
+{
+    const uint32_t eraseUnitsMs[] = {1, 16, 128, 1000};
+    const uint32_t chipEraseUnitsMs[] = {16, 256, 4000, 64000};
+    FlashGeometry_t parsed = *geometry;
+    uint32_t value = 0;
+    uint32_t multiplier = 0;
+    uint32_t exponent = 0;
+    uint32_t i = 0;
+
+    if (bfptDwords < SFDP_BFPT_MIN_DWORDS)
+    {
+        return false;
+    }
+
+    value = sfdpDword(bfpt, BFPT_DWORD_FEATURES);
+    parsed.AddressBytes = (sfdpField(value, 17, 2) == BFPT_ADDRESS_BYTES_4_ONLY) ? 4 : 3;
+    parsed.FastReadModes = 0;
+    parsed.FastReadModes |= sfdpField(value, 16, 1) ? SFDP_READ_1_1_2 : 0;
+    parsed.FastReadModes |= sfdpField(value, 20, 1) ? SFDP_READ_1_2_2 : 0;
+    parsed.FastReadModes |= sfdpField(value, 21, 1) ? SFDP_READ_1_4_4 : 0;
+    parsed.FastReadModes |= sfdpField(value, 22, 1) ? SFDP_READ_1_1_4 : 0;
+
+    // Density in bits, either N - 1 or, with bit 31 set, 2^N
+    value = sfdpDword(bfpt, BFPT_DWORD_DENSITY);
+    if (value & 0x80000000U)
+    {
+        exponent = value & 0x7FFFFFFFU;
+        if ((exponent < 3) || (exponent > 34))
+        {
+            return false;
+        }
+        parsed.DeviceSize = 1U << (exponent - 3);
+    }
+    else
+    {
+        parsed.DeviceSize = (uint32_t)(((uint64_t)value + 1) / 8);
+    }
+
+    // Erase types as size exponent and opcode pairs
+    for (i = 0; i < SFDP_ERASE_TYPES; i++)
+    {
+        value = sfdpDword(bfpt, (i < 2) ? BFPT_DWORD_ERASE_TYPES_1_2 : BFPT_DWORD_ERASE_TYPES_3_4);
+        exponent = sfdpField(value, (i % 2) * 16, 8);
+
+        parsed.Erase[i].Size = ((exponent > 0) && (exponent < 32)) ? (1U << exponent) : 0;
+        parsed.Erase[i].Opcode = sfdpField(value, ((i % 2) * 16) + 8, 8);
+    }
+
+    // Typical and max times were added in JESD216A, older tables keep the defaults
+    if (bfptDwords >= BFPT_DWORD_PROGRAM_TIMES)
+    {
+        value = sfdpDword(bfpt, BFPT_DWORD_ERASE_TIMES);
+        multiplier = 2 * (sfdpField(value, 0, 4) + 1);
+
+        for (i = 0; i < SFDP_ERASE_TYPES; i++)
+        {
+            parsed.Erase[i].TypicalMs =
+                (sfdpField(value, 4 + (i * 7), 5) + 1) * eraseUnitsMs[sfdpField(value, 9 + (i * 7), 2)];
+            parsed.Erase[i].MaxMs = multiplier * parsed.Erase[i].TypicalMs;
+        }
+
+        value = sfdpDword(bfpt, BFPT_DWORD_PROGRAM_TIMES);
+        multiplier = 2 * (sfdpField(value, 0, 4) + 1);
+
+        parsed.PageSize = 1U << sfdpField(value, 4, 4);
+        parsed.ProgramTypicalUs = (sfdpField(value, 8, 5) + 1) * (sfdpField(value, 13, 1) ? 64 : 8);
+        parsed.ProgramMaxUs = multiplier * parsed.ProgramTypicalUs;
+        parsed.ChipEraseTypicalMs = (sfdpField(value, 24, 5) + 1) * chipEraseUnitsMs[sfdpField(value, 29, 2)];
+        parsed.ChipEraseMaxMs = multiplier * parsed.ChipEraseTypicalMs;
+    }
+    else
+    {
+        // Without timings, only the default times of erase sizes the defaults also have are known
+        for (i = 0; i < SFDP_ERASE_TYPES; i++)
+        {
+            const FlashEraseType_t *known = SFDP_FindErase(geometry, parsed.Erase[i].Size);
+
+            parsed.Erase[i].TypicalMs = (known != NULL) ? known->TypicalMs : 0;
+            parsed.Erase[i].MaxMs = (known != NULL) ? known->MaxMs : geometry->ChipEraseMaxMs;
+        }
+    }
+
+    for (i = 0; i < SFDP_ERASE_TYPES; i++)
+    {
+        if (parsed.Erase[i].Size == 0)
+        {
+            memset(&parsed.Erase[i], 0, sizeof(parsed.Erase[i]));
+        }
+    }
+    sfdpSortErase(parsed.Erase);
+
+    if ((parsed.DeviceSize == 0) || (parsed.Erase[0].Size == 0) || (parsed.PageSize == 0))
+    {
+        return false;
+    }
+
+    parsed.FromSfdp = true;
+    *geometry = parsed;
+
+    return true;
+}
+
+bool SFDP_Parse(const uint8_t *sfdp, uint32_t length, FlashGeometry_t *geometry)
+{
+    uint32_t bfptAddress = 0;
+    uint32_t bfptDwords = 0;
+
+    if ((length < SFDP_HEADER_LENGTH) || !SFDP_ParseHeader(sfdp, &bfptAddress, &bfptDwords) ||
+        ((bfptAddress + (bfptDwords * sizeof(uint32_t))) > length))
+    {
+        return false;
+    }
+
+    return SFDP_ParseBfpt(&sfdp[bfptAddress], bfptDwords, geometry);
+}
+
+const FlashEraseType_t *SFDP_FindErase(const FlashGeometry_t *geometry, uint32_t size)
+{
+    uint32_t i = 0;
+
+    for (i = 0; (i < SFDP_ERASE_TYPES) && (size > 0); i++)
+    {
+        if (geometry->Erase[i].Size == size)
+        {
+            return &geometry->Erase[i];
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+/*
+ * sfdp.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Belina Sainju
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// JEDEC JESD216 Serial Flash Discoverable Parameters
+#define SFDP_SIGNATURE 0x50444653       // "SFDP", little-endian
+#define SFDP_HEADER_LENGTH 16           // SFDP header + first (basic) parameter header
+#define SFDP_BFPT_ID 0xFF00             // Basic Flash Parameter Table, MSB:LSB
+#define SFDP_BFPT_MAX_DWORDS 23         // JESD216D length; longer tables are read up to this
+#define SFDP_BFPT_MIN_DWORDS 9          // JESD216 rev 1.0, without timings or page size
+#define SFDP_ERASE_TYPES 4
+
+// Fast read modes (command-address-data lines) a part reports besides 1-1-1 FAST_READ
+#define SFDP_READ_1_1_2 0x01
+#define SFDP_READ_1_2_2 0x02
+#define SFDP_READ_1_1_4 0x04
+#define SFDP_READ_1_4_4 0x08
+
+typedef struct
+{
+    uint32_t Size; // Bytes, 0 when the type is not supported
+    uint8_t Opcode;
+    uint32_t TypicalMs;
+    uint32_t MaxMs;
+} FlashEraseType_t;
+
+// Geometry and timings of a serial NOR flash
+typedef struct
+{
+    uint32_t DeviceSize; // Bytes
+    uint32_t PageSize;
+    FlashEraseType_t Erase[SFDP_ERASE_TYPES]; // Largest first
+    uint32_t ProgramTypicalUs;
+    uint32_t ProgramMaxUs;
+    uint32_t ChipEraseTypicalMs;
+    uint32_t ChipEraseMaxMs;
+    uint8_t AddressBytes; // 3, or 4 for parts that only take 4 byte addresses
+    uint8_t FastReadModes; // SFDP_READ_x flags
+    bool FromSfdp; // False while the compile time defaults are in use
+} FlashGeometry_t;
+
+// =============================================================================================#=
+// Parse the SFDP header and first parameter header read from SFDP address 0.
+// Returns the address and length of the basic flash parameter table.
+// =============================================================================================#=
+bool SFDP_ParseHeader(const uint8_t *header, uint32_t *bfptAddress, uint32_t *bfptDwords);
+
+// =============================================================================================#=
+// Parse a basic flash parameter table over a geometry holding the defaults. Fields the table
+// doesn't carry (timings before JESD216A) keep their default. Returns false if the table is
+// not usable, leaving the geometry unchanged.
+// =============================================================================================#=
+bool SFDP_ParseBfpt(const uint8_t *bfpt, uint32_t bfptDwords, FlashGeometry_t *geometry);
+
+// =============================================================================================#=
+// Parse a complete SFDP dump, as read from SFDP address 0
+// =============================================================================================#=
+bool SFDP_Parse(const uint8_t *sfdp, uint32_t length, FlashGeometry_t *geometry);
+
+// =============================================================================================#=
+// Find the erase type of a given size. Returns NULL if the part has none.
+// =============================================================================================#=
+const FlashEraseType_t *SFDP_FindErase(const FlashGeometry_t *geometry, uint32_t size);
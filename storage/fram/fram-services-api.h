@@ -6,6 +6,8 @@ fram-services-api.h
 
 DESCRIPTION:
     The FRAM Serv module provides services to read, write, and erase fram memory.
+    Records written with FramServ_WriteRecord carry a length and a CRC-32, so a record
+    torn by a power loss or corrupted in place is rejected when read back.
     This file defines the API to access those services.
 
 Copyright 2023-2024 Twisthink, INC.
@@ -25,3 +27,39 @@ See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
 // This should be called only once.
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
 void FramServ_Init(void);
+
+// Bytes a record takes on top of its data: length, length check and CRC
+#define FRAM_RECORD_OVERHEAD 8
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Write a CRC protected record of 1 to 65535 bytes at address. The record takes
+// length + FRAM_RECORD_OVERHEAD bytes of FRAM.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FramServ_WriteRecord(uint16_t address, const uint8_t *data, uint16_t length);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Read the record at address. Returns false if there is no intact record there
+// or it is longer than maxLength.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FramServ_ReadRecord(uint16_t address, uint8_t *data, uint16_t maxLength, uint16_t *length);
+
+// Most entries a FramServ_ReadV or FramServ_WriteV batch can hold
+#define FRAM_IOV_MAX_ENTRIES 32
+
+// One field of a vectored read or write
+typedef struct
+{
+    uint16_t Address;
+    uint8_t *Data;
+    uint16_t Length;
+} FramServIoVec_t;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Read or write a batch of fields while holding the bus once. The entries are sorted
+// by address and entries that continue one another go out as one FRAM command, so an
+// update of many small fields costs one bus session. The entries of a write must not
+// overlap. Returns false if an entry is out of range, the batch holds more than
+// FRAM_IOV_MAX_ENTRIES entries or the transfer failed.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FramServ_ReadV(const FramServIoVec_t *entries, uint32_t count);
+bool FramServ_WriteV(const FramServIoVec_t *entries, uint32_t count);
@@ -10,6 +10,15 @@ DESCRIPTION:
 Adaptations Notes:  This fram services module was adapted to communicate
                     with the MB85RS256TY 256KBit FRAM memory.
 
+                    A record is stored as its length, the length's complement, the data and a
+                    CRC-32 over all of them (crc/crc.h, computed on the CRC unit). FRAM writes
+                    land immediately, so nothing is staged; a write cut short leaves a record
+                    whose CRC no longer matches and the read rejects it.
+
+                    FramServ_ReadV/FramServ_WriteV hold the SPI bus for a whole batch, so other
+                    parts on the bus wait for the batch rather than for each field. Every run
+                    of adjacent fields costs one READ or WREN + WRITE command.
+
 Copyright 2022-2023 Twisthink, INC.
 This code is licensed under Twisthink license.
 See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
@@ -17,12 +26,19 @@ See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
 */
 
 #include "fram-services-api.h"
+#include "fram-store-api.h"
+
+#include "board-model.h"
+#include "crc/crc.h"
+#include "spi/spi-core.h"
+#include "timing/timing.h"
 
 #include "FreeRTOS.h"
 #include "task.h"
 #include "queue.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
 // TASK MEMORY
@@ -31,11 +47,154 @@ See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
 static StackType_t xFramTaskStack[FRAM_STACK_SIZE_IN_WORDS];
 static StaticTask_t xFramTaskControlBlock;
 
+// The FRAM part behind these services
+static Mb85Device_t xFramDevice;
+
 #define FRAM_TEST_READ_ADDR 0
 #define FRAM_TEST_WRITE_LENGTH 10
+#define FRAM_TEST_RECORD_ADDR 0x0100
+#define FRAM_TEST_RECORD_LENGTH 64
+
+#define FRAM_BENCH_ADDR 0x0200
+#define FRAM_BENCH_PASSES 32 // Writes and reads timed per access size
+#define FRAM_BENCH_MAX_LENGTH 256
+#define FRAM_BENCH_FRAME_BYTES 3 // Opcode and 2 address bytes
+#define FRAM_BENCH_WREN_BYTES 1  // Separate frame ahead of each write
+
+#define FRAM_VECTOR_TEST_ADDR 0x0400
+#define FRAM_VECTOR_TEST_FIELDS 24 // Counters, in adjacent pairs with a gap after each pair
+#define FRAM_VECTOR_TEST_PAIR_STRIDE 12
+
+#ifdef FRAM_SELF_TEST
+#define FRAM_STORE_TEST_OLD_SEED 0x31
+#define FRAM_STORE_TEST_NEW_SEED 0xC4
+#endif
+
+// Stored ahead of each record's data
+typedef struct
+{
+    uint16_t Length;
+    uint16_t LengthCheck; // 0xFFFF - Length
+} framRecordHeader_t;
 
 /*** Private Functions ***/
 
+/*
+ * Put the entries of a batch in address order, leaving out empty ones.
+ * Returns false if an entry is out of range or, for a write, overlaps the one before it.
+ */
+static bool framSortEntries(const FramServIoVec_t *entries, uint32_t count, bool write, uint8_t *order,
+                            uint32_t *orderCount)
+{
+    uint32_t sorted = 0;
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    if (count > FRAM_IOV_MAX_ENTRIES)
+    {
+        return false;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (((uint32_t)entries[i].Address + entries[i].Length) > FRAM_SIZE_IN_BYTES)
+        {
+            return false;
+        }
+
+        if (entries[i].Length == 0)
+        {
+            continue;
+        }
+
+        // Insertion sort, keeping entries at the same address in list order
+        for (j = sorted; (j > 0) && (entries[order[j - 1]].Address > entries[i].Address); j--)
+        {
+            order[j] = order[j - 1];
+        }
+        order[j] = (uint8_t)i;
+        sorted++;
+    }
+
+    for (i = 1; write && (i < sorted); i++)
+    {
+        if (((uint32_t)entries[order[i - 1]].Address + entries[order[i - 1]].Length) > entries[order[i]].Address)
+        {
+            return false;
+        }
+    }
+
+    *orderCount = sorted;
+    return true;
+}
+
+/*
+ * Run a batch under one bus hold, one FRAM command per run of entries that continue one another
+ */
+static bool framRunBatch(const FramServIoVec_t *entries, uint32_t count, bool write)
+{
+    uint8_t order[FRAM_IOV_MAX_ENTRIES];
+    Mb85Segment_t segments[FRAM_IOV_MAX_ENTRIES];
+    const FramServIoVec_t *entry = NULL;
+    uint32_t orderCount = 0;
+    uint32_t runAddress = 0;
+    uint32_t runEnd = 0;
+    uint16_t segmentCount = 0;
+    uint32_t i = 0;
+    bool result = true;
+
+    if (!framSortEntries(entries, count, write, order, &orderCount))
+    {
+        return false;
+    }
+
+    if (orderCount == 0)
+    {
+        return true;
+    }
+
+    if (!SPI_BusAcquire(xFramDevice.Bus))
+    {
+        return false;
+    }
+
+    for (i = 0; (i <= orderCount) && result; i++)
+    {
+        entry = (i < orderCount) ? &entries[order[i]] : NULL;
+
+        // Send the run once the next entry doesn't continue it
+        if ((segmentCount > 0) && ((entry == NULL) || (entry->Address != runEnd)))
+        {
+            if (write)
+            {
+                result = MB85RS256_WriteSegments(&xFramDevice, (uint16_t)runAddress, segments, segmentCount);
+            }
+            else
+            {
+                result = MB85RS256_ReadSegments(&xFramDevice, (uint16_t)runAddress, segments, segmentCount);
+            }
+            segmentCount = 0;
+        }
+
+        if (entry != NULL)
+        {
+            if (segmentCount == 0)
+            {
+                runAddress = entry->Address;
+                runEnd = runAddress;
+            }
+            segments[segmentCount].Data = entry->Data;
+            segments[segmentCount].Length = entry->Length;
+            segmentCount++;
+            runEnd += entry->Length;
+        }
+    }
+
+    SPI_BusRelease(xFramDevice.Bus);
+
+    return result;
+}
+
 /*
  * Simple fram read/write test
  */
@@ -54,11 +213,11 @@ static bool framTest(void)
         dataBuffer[i] = i + 1;
     }
 
-    result = MB85RS256_Write(readWriteAddr, dataBuffer, dataLength);
+    result = MB85RS256_Write(&xFramDevice, readWriteAddr, dataBuffer, dataLength);
 
     if (result)
     {
-        result = MB85RS256_Read(readWriteAddr, readBuffer, dataLength);
+        result = MB85RS256_Read(&xFramDevice, readWriteAddr, readBuffer, dataLength);
 
         if (result)
         {
@@ -76,17 +235,310 @@ static bool framTest(void)
     return result;
 }
 
+/*
+ * Record test: a record reads back intact, and one corrupted in place is rejected
+ */
+static bool framRecordTest(void)
+{
+    uint8_t dataBuffer[FRAM_TEST_RECORD_LENGTH] = {0};
+    uint8_t readBuffer[FRAM_TEST_RECORD_LENGTH] = {0};
+    uint16_t readLength = 0;
+    uint8_t corrupt = 0;
+    uint16_t i = 0;
+
+    for (i = 0; i < FRAM_TEST_RECORD_LENGTH; i++)
+    {
+        dataBuffer[i] = (uint8_t)(i * 3 + 1);
+    }
+
+    if (!FramServ_WriteRecord(FRAM_TEST_RECORD_ADDR, dataBuffer, FRAM_TEST_RECORD_LENGTH) ||
+        !FramServ_ReadRecord(FRAM_TEST_RECORD_ADDR, readBuffer, sizeof(readBuffer), &readLength))
+    {
+        printf("Failed to write and read back fram record\n");
+        return false;
+    }
+
+    if ((readLength != FRAM_TEST_RECORD_LENGTH) || (memcmp(dataBuffer, readBuffer, readLength) != 0))
+    {
+        printf("Fram record read back doesn't match record written\n");
+        return false;
+    }
+
+    // Flip a bit in the middle of the data
+    corrupt = dataBuffer[FRAM_TEST_RECORD_LENGTH / 2] ^ 0x10;
+    if (!MB85RS256_Write(&xFramDevice,
+                         FRAM_TEST_RECORD_ADDR + sizeof(framRecordHeader_t) + (FRAM_TEST_RECORD_LENGTH / 2), &corrupt,
+                         sizeof(corrupt)))
+    {
+        return false;
+    }
+
+    if (FramServ_ReadRecord(FRAM_TEST_RECORD_ADDR, readBuffer, sizeof(readBuffer), &readLength))
+    {
+        printf("Corrupted fram record was not detected\n");
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Access latency benchmark.
+ * Times writes and reads of 1, 16 and 256 bytes and prints them next to the time the
+ * bytes take on the wire, so the per-access overhead shows up as the difference.
+ */
+static bool framLatencyBenchmark(void)
+{
+    static const uint16_t lengths[] = {1, 16, FRAM_BENCH_MAX_LENGTH};
+    static uint8_t writeData[FRAM_BENCH_MAX_LENGTH];
+    static uint8_t readData[FRAM_BENCH_MAX_LENGTH];
+    uint32_t clockMHz = SPI_GetClockHz(MB85_FRAM) / 1000000;
+    uint32_t startCycles = 0;
+    uint32_t writeUs = 0;
+    uint32_t readUs = 0;
+    uint32_t pass = 0;
+    uint16_t length = 0;
+    uint16_t i = 0;
+    bool result = true;
+
+    for (i = 0; i < FRAM_BENCH_MAX_LENGTH; i++)
+    {
+        writeData[i] = (uint8_t)rand();
+    }
+
+    for (i = 0; (i < (sizeof(lengths) / sizeof(lengths[0]))) && result; i++)
+    {
+        length = lengths[i];
+
+        startCycles = TIMING_GetCycles();
+        for (pass = 0; (pass < FRAM_BENCH_PASSES) && result; pass++)
+        {
+            result = MB85RS256_Write(&xFramDevice, FRAM_BENCH_ADDR, writeData, length);
+        }
+        writeUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+
+        memset(readData, 0, length);
+        startCycles = TIMING_GetCycles();
+        for (pass = 0; (pass < FRAM_BENCH_PASSES) && result; pass++)
+        {
+            result = MB85RS256_Read(&xFramDevice, FRAM_BENCH_ADDR, readData, length);
+        }
+        readUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+
+        if (result && (memcmp(writeData, readData, length) != 0))
+        {
+            printf("FRAM benchmark read back doesn't match data written\n");
+            result = false;
+        }
+
+        if (result && (clockMHz > 0))
+        {
+            printf("FRAM %u byte access: write %lu us (wire %lu us), read %lu us (wire %lu us)\n", length,
+                   (unsigned long)(writeUs / FRAM_BENCH_PASSES),
+                   (unsigned long)(((FRAM_BENCH_WREN_BYTES + FRAM_BENCH_FRAME_BYTES + length) * BITS_PER_BYTE) /
+                                   clockMHz),
+                   (unsigned long)(readUs / FRAM_BENCH_PASSES),
+                   (unsigned long)(((FRAM_BENCH_FRAME_BYTES + length) * BITS_PER_BYTE) / clockMHz));
+        }
+    }
+
+    return result;
+}
+
+/*
+ * Vectored I/O test and benchmark.
+ * Updates a set of counters laid out in adjacent pairs, listed in reverse address order,
+ * once with a write per counter and once as one batch, then reads them back as a batch.
+ */
+static bool framVectorTest(void)
+{
+    static uint32_t values[FRAM_VECTOR_TEST_FIELDS];
+    static uint32_t readBack[FRAM_VECTOR_TEST_FIELDS];
+    FramServIoVec_t writes[FRAM_VECTOR_TEST_FIELDS];
+    FramServIoVec_t reads[FRAM_VECTOR_TEST_FIELDS];
+    uint32_t startCycles = 0;
+    uint32_t separateUs = 0;
+    uint32_t vectoredUs = 0;
+    uint16_t address = 0;
+    uint32_t entry = 0;
+    uint32_t i = 0;
+    bool result = true;
+
+    for (i = 0; i < FRAM_VECTOR_TEST_FIELDS; i++)
+    {
+        entry = FRAM_VECTOR_TEST_FIELDS - 1 - i;
+        address = FRAM_VECTOR_TEST_ADDR + ((i / 2) * FRAM_VECTOR_TEST_PAIR_STRIDE) + ((i % 2) * sizeof(values[0]));
+
+        values[i] = (uint32_t)rand();
+        writes[entry].Address = address;
+        writes[entry].Data = (uint8_t *)&values[i];
+        writes[entry].Length = sizeof(values[0]);
+        reads[entry].Address = address;
+        reads[entry].Data = (uint8_t *)&readBack[i];
+        reads[entry].Length = sizeof(readBack[0]);
+    }
+
+    startCycles = TIMING_GetCycles();
+    for (i = 0; (i < FRAM_VECTOR_TEST_FIELDS) && result; i++)
+    {
+        result = MB85RS256_Write(&xFramDevice, writes[i].Address, writes[i].Data, writes[i].Length);
+    }
+    separateUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+
+    for (i = 0; i < FRAM_VECTOR_TEST_FIELDS; i++)
+    {
+        values[i]++;
+    }
+
+    startCycles = TIMING_GetCycles();
+    result = result && FramServ_WriteV(writes, FRAM_VECTOR_TEST_FIELDS);
+    vectoredUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+
+    memset(readBack, 0, sizeof(readBack));
+    if (!result || !FramServ_ReadV(reads, FRAM_VECTOR_TEST_FIELDS))
+    {
+        printf("Failed to write and read back fram fields\n");
+        return false;
+    }
+
+    if (memcmp(values, readBack, sizeof(values)) != 0)
+    {
+        printf("Fram fields read back don't match fields written\n");
+        return false;
+    }
+
+    // Overlapping fields have no defined order, so a batch holding them is refused
+    writes[1].Address = writes[0].Address + 1;
+    if (FramServ_WriteV(writes, 2))
+    {
+        printf("Overlapping fram fields were written\n");
+        return false;
+    }
+
+    printf("FRAM %u field update: separate writes %lu us, vectored %lu us\n", FRAM_VECTOR_TEST_FIELDS,
+           (unsigned long)separateUs, (unsigned long)vectoredUs);
+
+    return true;
+}
+
+#ifdef FRAM_SELF_TEST
+// Helper function to fill the store test record from a seed
+static void framStoreTestFill(uint8_t *record, uint8_t seed)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < FRAM_STORE_TEST_RECORD_SIZE; i++)
+    {
+        record[i] = (uint8_t)(seed + (i * 7));
+    }
+}
+
+// Helper function to check that the store test record reads back as filled from a seed
+static bool framStoreTestCheck(uint8_t seed)
+{
+    uint8_t expected[FRAM_STORE_TEST_RECORD_SIZE];
+    uint8_t record[FRAM_STORE_TEST_RECORD_SIZE];
+
+    framStoreTestFill(expected, seed);
+
+    return FramStore_Read(FRAM_RECORD_TEST, record, sizeof(record)) && (memcmp(record, expected, sizeof(record)) == 0);
+}
+
+/*
+ * Record store test.
+ * A write torn halfway by a simulated power loss must leave the previous copy, both in
+ * the mirror and after a remount, and the next write must win over it. Also times a
+ * mirror read against a store write.
+ */
+static bool framStoreTest(void)
+{
+    uint8_t record[FRAM_STORE_TEST_RECORD_SIZE];
+    FramStoreStats_t stats = {0};
+    uint32_t startCycles = 0;
+    uint32_t readUs = 0;
+    uint32_t writeUs = 0;
+    uint32_t rejected = 0;
+    uint32_t pass = 0;
+
+    // Both slots get the old copy, so the slots rejected at the next mount are the torn one only
+    framStoreTestFill(record, FRAM_STORE_TEST_OLD_SEED);
+    if (!FramStore_Write(FRAM_RECORD_TEST, record, sizeof(record)) ||
+        !FramStore_Write(FRAM_RECORD_TEST, record, sizeof(record)) || !FramStore_Mount() ||
+        !framStoreTestCheck(FRAM_STORE_TEST_OLD_SEED))
+    {
+        printf("Failed to write and read back fram store record\n");
+        return false;
+    }
+
+    FramStore_GetStats(&stats);
+    rejected = stats.SlotsRejected;
+
+    framStoreTestFill(record, FRAM_STORE_TEST_NEW_SEED);
+    FramStore_InjectPowerLoss(0);
+    if (FramStore_Write(FRAM_RECORD_TEST, record, sizeof(record)) || !framStoreTestCheck(FRAM_STORE_TEST_OLD_SEED))
+    {
+        printf("Torn fram store write replaced the previous copy\n");
+        return false;
+    }
+
+    // Boot again: the torn slot is rejected and the previous copy loaded
+    if (!FramStore_Mount() || !framStoreTestCheck(FRAM_STORE_TEST_OLD_SEED))
+    {
+        printf("Previous fram store copy lost across a torn write\n");
+        return false;
+    }
+
+    FramStore_GetStats(&stats);
+    if (stats.SlotsRejected != (rejected + 1))
+    {
+        printf("Torn fram store slot was not detected\n");
+        return false;
+    }
+
+    startCycles = TIMING_GetCycles();
+    for (pass = 0; pass < FRAM_BENCH_PASSES; pass++)
+    {
+        if (!FramStore_Write(FRAM_RECORD_TEST, record, sizeof(record)))
+        {
+            return false;
+        }
+    }
+    writeUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+
+    startCycles = TIMING_GetCycles();
+    for (pass = 0; pass < FRAM_BENCH_PASSES; pass++)
+    {
+        FramStore_Read(FRAM_RECORD_TEST, record, sizeof(record));
+    }
+    readUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+
+    if (!FramStore_Mount() || !framStoreTestCheck(FRAM_STORE_TEST_NEW_SEED))
+    {
+        printf("Fram store record lost across remount\n");
+        return false;
+    }
+
+    FramStore_GetStats(&stats);
+    printf("FRAM store: %u byte record write %lu us, mirror read %lu us, mount %lu us\n",
+           FRAM_STORE_TEST_RECORD_SIZE, (unsigned long)(writeUs / FRAM_BENCH_PASSES),
+           (unsigned long)(readUs / FRAM_BENCH_PASSES), (unsigned long)stats.MountUs);
+
+    return true;
+}
+#endif
+
 // -----------------------------------------------------------------------------+-
 // Wait for semaphore to be given which signals data is available.
 // Once given, parse command and dispatch same.
 // -----------------------------------------------------------------------------+-
 static void framTaskCode(void *arg)
 {
+    FramStoreBoot_t boot = {0};
     bool result = false;
     uint32_t framId = 0;
 
     // Initialize fram
-    result = MB85RS256_Init();
+    result = MB85RS256_Init(&xFramDevice, PORT(FRAM_CS), PIN(FRAM_CS), MB85_FRAM);
 
     if (result == false)
     {
@@ -97,7 +549,7 @@ static void framTaskCode(void *arg)
         printf("FRAM Init Complete\n");
     }
 
-    result = MB85RS256_RDID(&framId);
+    result = MB85RS256_RDID(&xFramDevice, &framId);
 
     if (result == false)
     {
@@ -111,6 +563,23 @@ static void framTaskCode(void *arg)
         }
     }
 
+    result = FramStore_Mount();
+
+    if (result == false)
+    {
+        printf("Failed to mount FRAM store\n");
+    }
+    else
+    {
+        if (!FramStore_Read(FRAM_RECORD_BOOT, &boot, sizeof(boot)))
+        {
+            boot.BootCount = 0;
+        }
+        boot.BootCount++;
+        FramStore_Write(FRAM_RECORD_BOOT, &boot, sizeof(boot));
+        printf("FRAM store mounted, boot %lu\n", (unsigned long)boot.BootCount);
+    }
+
     result = framTest();
 
     if (result == false)
@@ -122,12 +591,155 @@ static void framTaskCode(void *arg)
         printf("FRAM test passed\n");
     }
 
+    result = framRecordTest();
+
+    if (result == false)
+    {
+        printf("FRAM record test failed\n");
+    }
+    else
+    {
+        printf("FRAM record test passed\n");
+    }
+
+    result = framLatencyBenchmark();
+
+    if (result == false)
+    {
+        printf("FRAM latency benchmark failed\n");
+    }
+    else
+    {
+        printf("FRAM latency benchmark passed\n");
+    }
+
+    result = framVectorTest();
+
+    if (result == false)
+    {
+        printf("FRAM vectored I/O test failed\n");
+    }
+    else
+    {
+        printf("FRAM vectored I/O test passed\n");
+    }
+
+#ifdef FRAM_SELF_TEST
+    result = framStoreTest();
+
+    if (result == false)
+    {
+        printf("FRAM store test failed\n");
+    }
+    else
+    {
+        printf("FRAM store test passed\n");
+    }
+#endif
+
     for (;;)
     {
         vTaskDelay(pdMS_TO_TICKS(200));
     }
 }
 
+/*** Public Functions ***/
+
+/*
+ * Function to write a CRC protected record
+ */
+bool FramServ_WriteRecord(uint16_t address, const uint8_t *data, uint16_t length)
+{
+    FramServIoVec_t entries[3];
+    framRecordHeader_t header = {0};
+    uint32_t crc = 0;
+
+    if ((length == 0) || (((uint32_t)address + length + FRAM_RECORD_OVERHEAD) > FRAM_SIZE_IN_BYTES))
+    {
+        return false;
+    }
+
+    header.Length = length;
+    header.LengthCheck = 0xFFFF - length;
+
+    crc = CRC_Compute((const uint8_t *)&header, sizeof(header));
+    crc = CRC_Accumulate(crc, data, length);
+
+    entries[0].Address = address;
+    entries[0].Data = (uint8_t *)&header;
+    entries[0].Length = sizeof(header);
+    entries[1].Address = address + sizeof(header);
+    entries[1].Data = (uint8_t *)data;
+    entries[1].Length = length;
+    entries[2].Address = address + sizeof(header) + length;
+    entries[2].Data = (uint8_t *)&crc;
+    entries[2].Length = sizeof(crc);
+
+    // Header, data and CRC are contiguous and go out as one write
+    return FramServ_WriteV(entries, 3);
+}
+
+/*
+ * Function to read and check a CRC protected record
+ */
+bool FramServ_ReadRecord(uint16_t address, uint8_t *data, uint16_t maxLength, uint16_t *length)
+{
+    FramServIoVec_t entries[2];
+    framRecordHeader_t header = {0};
+    uint32_t storedCrc = 0;
+    uint32_t crc = 0;
+
+    if (!MB85RS256_Read(&xFramDevice, address, (uint8_t *)&header, sizeof(header)))
+    {
+        return false;
+    }
+
+    if ((((uint32_t)header.Length + header.LengthCheck) != 0xFFFF) || (header.Length == 0) ||
+        (header.Length > maxLength) ||
+        (((uint32_t)address + header.Length + FRAM_RECORD_OVERHEAD) > FRAM_SIZE_IN_BYTES))
+    {
+        return false;
+    }
+
+    entries[0].Address = address + sizeof(header);
+    entries[0].Data = data;
+    entries[0].Length = header.Length;
+    entries[1].Address = address + sizeof(header) + header.Length;
+    entries[1].Data = (uint8_t *)&storedCrc;
+    entries[1].Length = sizeof(storedCrc);
+
+    if (!FramServ_ReadV(entries, 2))
+    {
+        return false;
+    }
+
+    crc = CRC_Compute((const uint8_t *)&header, sizeof(header));
+    crc = CRC_Accumulate(crc, data, header.Length);
+    if (crc != storedCrc)
+    {
+        return false;
+    }
+
+    *length = header.Length;
+    return true;
+}
+
+/*
+ * Function to read a batch of fields under one bus hold
+ */
+bool FramServ_ReadV(const FramServIoVec_t *entries, uint32_t count)
+{
+    return framRunBatch(entries, count, false);
+}
+
+/*
+ * Function to write a batch of fields under one bus hold
+ */
+bool FramServ_WriteV(const FramServIoVec_t *entries, uint32_t count)
+{
+    return framRunBatch(entries, count, true);
+}
+
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
 // Init the fram services module
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
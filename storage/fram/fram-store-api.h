@@ -0,0 +1,100 @@
+#pragma once
+/*
+================================================================================================#=
+FILE:
+fram-store-api.h
+
+DESCRIPTION:
+    The FramStore module keeps a fixed set of typed records, such as counters and state
+    updated many times a second, in the MB85RS256 FRAM. Every record has two slots written
+    in turn, each with a sequence number and a CRC-32, so a write cut short by a power loss
+    leaves the last good copy in place. Reads are served from a RAM mirror and never touch
+    the bus.
+    This file defines the API to access those services.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+// FRAM information other modules may need to access:
+#include "fram-services-api.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// FRAM region the slots are laid out in. Below it is left to the fram-services tests.
+#define FRAM_STORE_START 0x1000
+#define FRAM_STORE_END FRAM_SIZE_IN_BYTES
+
+#define FRAM_STORE_MAX_RECORD_SIZE 128 // Data bytes of the largest record
+#define FRAM_STORE_MIRROR_SIZE 512     // Data bytes of all records together
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Records in the store. A new record is added here, with its id, size and version in
+// the record table of fram-store.c. Bump the version when the layout of a record
+// changes: a stored copy of another version is not loaded.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+typedef enum
+{
+    FRAM_RECORD_BOOT, // FramStoreBoot_t
+#ifdef FRAM_SELF_TEST
+    FRAM_RECORD_TEST, // FRAM_STORE_TEST_RECORD_SIZE bytes, for the fram-services tests
+#endif
+    FRAM_RECORD_COUNT
+} FramStoreRecordId_t;
+
+// Boot record
+typedef struct
+{
+    uint32_t BootCount;
+} FramStoreBoot_t;
+
+#ifdef FRAM_SELF_TEST
+#define FRAM_STORE_TEST_RECORD_SIZE 32
+#endif
+
+// Store statistics
+typedef struct
+{
+    uint32_t Writes;
+    uint32_t FailedWrites;
+    uint32_t RecordsLoaded; // Records with a valid copy found at mount
+    uint32_t SlotsRejected; // Torn, corrupted or of another version, found at mount
+    uint32_t MountUs;
+} FramStoreStats_t;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Load the newest valid copy of every record into the RAM mirror. Call once the FRAM is
+// initialized. Returns false if the record table doesn't fit the region or the mirror,
+// or the FRAM could not be read.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FramStore_Mount(void);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Copy a record from the RAM mirror. length must be the size of the record. Returns
+// false if nothing has been stored for the record yet.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FramStore_Read(FramStoreRecordId_t id, void *data, uint32_t length);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Store a record in the slot not holding its current copy, then update the mirror.
+// length must be the size of the record. If the write fails the current copy stays.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+bool FramStore_Write(FramStoreRecordId_t id, const void *data, uint32_t length);
+
+// Get store statistics
+void FramStore_GetStats(FramStoreStats_t *stats);
+
+#ifdef FRAM_SELF_TEST
+#define FRAM_STORE_NO_POWER_LOSS 0xFFFFFFFF
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Test support, in FRAM_SELF_TEST builds only: simulate a power loss on the given slot
+// write of this module from now on, counting from 0. That write stops halfway through the
+// data and every later write fails until FramStore_Mount runs again as it would at boot.
+// FRAM_STORE_NO_POWER_LOSS turns it off.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+void FramStore_InjectPowerLoss(uint32_t write);
+#endif
@@ -0,0 +1,420 @@
+/*
+================================================================================================#=
+FILE:
+fram-store.c
+
+DESCRIPTION:
+    The FramStore module keeps typed records in two alternating FRAM slots each.
+    This file implements those services.
+
+Adaptations Notes:  The records are laid out from FRAM_STORE_START in record table order, two
+                    slots per record, each:
+                        Id (2) | Version (2) | Sequence (4) | Data (record size) | CRC-32 (4)
+                    The CRC covers the header and the data. A write goes to the slot not holding
+                    the current copy, with the next sequence number, as one FramServ_WriteV
+                    batch. FRAM writes land as the bytes arrive, so a write cut short leaves the
+                    target slot with a CRC that doesn't match and the other slot untouched.
+
+                    At mount both slots of every record are read; of the slots whose CRC, id
+                    and version check, the one with the newer sequence number is loaded into
+                    the RAM mirror. Sequence numbers are compared by their difference so they
+                    may wrap.
+
+                    Readers copy from the mirror in a critical section, so they never wait on
+                    the bus or on a writer and never see half an update.
+
+                    The test record and the simulated power loss are only built with
+                    FRAM_SELF_TEST defined, so other builds neither reserve the test slots nor
+                    carry the injection in the write path.
+
+Copyright 2023-2024 Twisthink, INC.
+This code is licensed under Twisthink license.
+See Twisthink-SoftwareLicenseAgreement-Auris.docx for details.
+================================================================================================#=
+*/
+
+#include "fram-store-api.h"
+
+#include "crc/crc.h"
+#include "timing/timing.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define STORE_SLOTS 2
+#define STORE_MUTEX_TIMEOUT_MS 1000
+
+// Stored ahead of each slot's data
+typedef struct
+{
+    uint16_t Id;
+    uint16_t Version;
+    uint32_t Sequence;
+} storeSlotHeader_t;
+
+#define STORE_SLOT_OVERHEAD (sizeof(storeSlotHeader_t) + sizeof(uint32_t))
+
+// A record as registered at compile time
+typedef struct
+{
+    uint16_t Id; // Stored in every slot, unique in the table
+    uint16_t Size;
+    uint16_t Version;
+} storeRecordInfo_t;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Record table, indexed by FramStoreRecordId_t. Appending a record keeps the slots of
+// the others where they are; inserting one or growing one moves those behind it, which
+// then start out empty.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+static const storeRecordInfo_t xRecordTable[FRAM_RECORD_COUNT] = {
+    [FRAM_RECORD_BOOT] = {.Id = 0x0001, .Size = sizeof(FramStoreBoot_t), .Version = 1},
+#ifdef FRAM_SELF_TEST
+    [FRAM_RECORD_TEST] = {.Id = 0x0002, .Size = FRAM_STORE_TEST_RECORD_SIZE, .Version = 1},
+#endif
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Internal Private Data
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
+// Where a record lives and which copy the mirror holds
+typedef struct
+{
+    uint16_t SlotAddress[STORE_SLOTS];
+    uint16_t MirrorOffset;
+    uint32_t Sequence; // Of the copy in the mirror
+    uint8_t ActiveSlot; // Slot holding the copy in the mirror
+    bool Stored;        // False until a copy is found at mount or written
+} storeRecord_t;
+
+static storeRecord_t xRecords[FRAM_RECORD_COUNT];
+static uint8_t xMirror[FRAM_STORE_MIRROR_SIZE];
+
+// Slot data read at mount
+static uint8_t xSlotBuffer[FRAM_STORE_MAX_RECORD_SIZE];
+
+static FramStoreStats_t xStats = {0};
+
+static SemaphoreHandle_t xStoreMutex = NULL;
+static StaticSemaphore_t xStoreMutexControlBlock;
+static bool xMounted = false;
+
+#ifdef FRAM_SELF_TEST
+// Simulated power loss, see FramStore_InjectPowerLoss
+static uint32_t xPowerLossCountdown = FRAM_STORE_NO_POWER_LOSS;
+static bool xPowerLost = false;
+#endif
+
+/*** Private Functions ***/
+
+// Helper function to take exclusive access to the store
+static bool storeLock(void)
+{
+    if (!xMounted)
+    {
+        return false;
+    }
+
+    if (xSemaphoreTake(xStoreMutex, pdMS_TO_TICKS(STORE_MUTEX_TIMEOUT_MS)))
+    {
+        return true;
+    }
+
+    return false;
+}
+
+// Helper function to release exclusive access to the store
+static void storeUnlock(void)
+{
+    xSemaphoreGive(xStoreMutex);
+}
+
+// Helper function to create the store mutex on first use
+static void storeCreateMutex(void)
+{
+    if (xStoreMutex == NULL)
+    {
+        xStoreMutex = xSemaphoreCreateMutexStatic(&xStoreMutexControlBlock);
+    }
+}
+
+#ifdef FRAM_SELF_TEST
+// Helper function to count down to a simulated power loss, true when this write is hit
+static bool storePowerLossNow(void)
+{
+    if (xPowerLossCountdown == FRAM_STORE_NO_POWER_LOSS)
+    {
+        return false;
+    }
+
+    if (xPowerLossCountdown-- == 0)
+    {
+        xPowerLossCountdown = FRAM_STORE_NO_POWER_LOSS;
+        xPowerLost = true;
+        return true;
+    }
+
+    return false;
+}
+#endif
+
+// Helper function to check whether sequence a is newer than b, allowing for wrap
+static bool storeSequenceNewer(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) > 0;
+}
+
+// Helper function to get the CRC of a slot
+static uint32_t storeSlotCrc(const storeSlotHeader_t *header, const uint8_t *data, uint16_t size)
+{
+    uint32_t crc = CRC_Compute((const uint8_t *)header, sizeof(*header));
+
+    return CRC_Accumulate(crc, data, size);
+}
+
+/*
+ * Lay out the slots and the mirror from the record table.
+ * Returns false if the records don't fit the region or the mirror.
+ */
+static bool storeLayout(void)
+{
+    uint32_t address = FRAM_STORE_START;
+    uint32_t mirrorOffset = 0;
+    uint32_t slot = 0;
+    uint32_t i = 0;
+
+    for (i = 0; i < FRAM_RECORD_COUNT; i++)
+    {
+        if ((xRecordTable[i].Size == 0) || (xRecordTable[i].Size > FRAM_STORE_MAX_RECORD_SIZE) ||
+            ((mirrorOffset + xRecordTable[i].Size) > FRAM_STORE_MIRROR_SIZE))
+        {
+            return false;
+        }
+
+        for (slot = 0; slot < STORE_SLOTS; slot++)
+        {
+            xRecords[i].SlotAddress[slot] = (uint16_t)address;
+            address += xRecordTable[i].Size + STORE_SLOT_OVERHEAD;
+        }
+
+        xRecords[i].MirrorOffset = (uint16_t)mirrorOffset;
+        mirrorOffset += xRecordTable[i].Size;
+    }
+
+    return address <= FRAM_STORE_END;
+}
+
+/*
+ * Read one slot of a record into the slot buffer.
+ * Returns false if the read failed; *valid tells whether the slot holds a good copy.
+ */
+static bool storeReadSlot(uint32_t record, uint32_t slot, storeSlotHeader_t *header, bool *valid)
+{
+    const storeRecordInfo_t *info = &xRecordTable[record];
+    uint16_t address = xRecords[record].SlotAddress[slot];
+    uint32_t storedCrc = 0;
+    FramServIoVec_t entries[3];
+
+    entries[0].Address = address;
+    entries[0].Data = (uint8_t *)header;
+    entries[0].Length = sizeof(*header);
+    entries[1].Address = address + sizeof(*header);
+    entries[1].Data = xSlotBuffer;
+    entries[1].Length = info->Size;
+    entries[2].Address = address + sizeof(*header) + info->Size;
+    entries[2].Data = (uint8_t *)&storedCrc;
+    entries[2].Length = sizeof(storedCrc);
+
+    if (!FramServ_ReadV(entries, 3))
+    {
+        return false;
+    }
+
+    *valid = (header->Id == info->Id) && (header->Version == info->Version) &&
+             (storeSlotCrc(header, xSlotBuffer, info->Size) == storedCrc);
+
+    return true;
+}
+
+/*** Public Functions ***/
+
+/*
+ * Function to load the newest valid copy of every record
+ */
+bool FramStore_Mount(void)
+{
+    storeSlotHeader_t header;
+    uint32_t startCycles = TIMING_GetCycles();
+    uint32_t record = 0;
+    uint32_t slot = 0;
+    bool valid = false;
+
+    storeCreateMutex();
+
+    xMounted = false;
+#ifdef FRAM_SELF_TEST
+    xPowerLost = false;
+#endif
+    memset(xRecords, 0, sizeof(xRecords));
+    memset(xMirror, 0, sizeof(xMirror));
+    xStats.RecordsLoaded = 0;
+    xStats.SlotsRejected = 0;
+
+    if (!storeLayout())
+    {
+        return false;
+    }
+
+    for (record = 0; record < FRAM_RECORD_COUNT; record++)
+    {
+        for (slot = 0; slot < STORE_SLOTS; slot++)
+        {
+            if (!storeReadSlot(record, slot, &header, &valid))
+            {
+                return false;
+            }
+
+            if (!valid)
+            {
+                xStats.SlotsRejected++;
+                continue;
+            }
+
+            if (!xRecords[record].Stored || storeSequenceNewer(header.Sequence, xRecords[record].Sequence))
+            {
+                memcpy(&xMirror[xRecords[record].MirrorOffset], xSlotBuffer, xRecordTable[record].Size);
+                xRecords[record].Sequence = header.Sequence;
+                xRecords[record].ActiveSlot = (uint8_t)slot;
+                xRecords[record].Stored = true;
+            }
+        }
+
+        if (xRecords[record].Stored)
+        {
+            xStats.RecordsLoaded++;
+        }
+    }
+
+    xStats.MountUs = TIMING_CyclesToUs(TIMING_GetCycles() - startCycles);
+    xMounted = true;
+
+    return true;
+}
+
+/*
+ * Function to copy a record from the mirror
+ */
+bool FramStore_Read(FramStoreRecordId_t id, void *data, uint32_t length)
+{
+    bool stored = false;
+
+    if ((id >= FRAM_RECORD_COUNT) || (length != xRecordTable[id].Size))
+    {
+        return false;
+    }
+
+    taskENTER_CRITICAL();
+    stored = xRecords[id].Stored;
+    if (stored)
+    {
+        memcpy(data, &xMirror[xRecords[id].MirrorOffset], length);
+    }
+    taskEXIT_CRITICAL();
+
+    return stored;
+}
+
+/*
+ * Function to store a record in its spare slot
+ */
+bool FramStore_Write(FramStoreRecordId_t id, const void *data, uint32_t length)
+{
+    storeSlotHeader_t header;
+    storeRecord_t *record = NULL;
+    FramServIoVec_t entries[3];
+    uint32_t crc = 0;
+    uint32_t count = 3;
+    uint8_t slot = 0;
+    bool result = false;
+
+    if ((id >= FRAM_RECORD_COUNT) || (length != xRecordTable[id].Size) || !storeLock())
+    {
+        return false;
+    }
+
+    record = &xRecords[id];
+    slot = record->Stored ? (uint8_t)(1 - record->ActiveSlot) : 0;
+
+    header.Id = xRecordTable[id].Id;
+    header.Version = xRecordTable[id].Version;
+    header.Sequence = record->Sequence + 1;
+    crc = storeSlotCrc(&header, data, (uint16_t)length);
+
+    entries[0].Address = record->SlotAddress[slot];
+    entries[0].Data = (uint8_t *)&header;
+    entries[0].Length = sizeof(header);
+    entries[1].Address = record->SlotAddress[slot] + sizeof(header);
+    entries[1].Data = (uint8_t *)data;
+    entries[1].Length = (uint16_t)length;
+    entries[2].Address = record->SlotAddress[slot] + sizeof(header) + length;
+    entries[2].Data = (uint8_t *)&crc;
+    entries[2].Length = sizeof(crc);
+
+#ifdef FRAM_SELF_TEST
+    if (!xPowerLost)
+    {
+        // A power loss stops the write halfway through the data
+        if (storePowerLossNow())
+        {
+            entries[1].Length /= 2;
+            count = 2;
+        }
+
+        result = FramServ_WriteV(entries, count) && !xPowerLost;
+    }
+#else
+    result = FramServ_WriteV(entries, count);
+#endif
+
+    if (result)
+    {
+        taskENTER_CRITICAL();
+        memcpy(&xMirror[record->MirrorOffset], data, length);
+        record->Sequence = header.Sequence;
+        record->ActiveSlot = slot;
+        record->Stored = true;
+        taskEXIT_CRITICAL();
+
+        xStats.Writes++;
+    }
+    else
+    {
+        xStats.FailedWrites++;
+    }
+
+    storeUnlock();
+
+    return result;
+}
+
+/*
+ * Function to get store statistics
+ */
+void FramStore_GetStats(FramStoreStats_t *stats)
+{
+    *stats = xStats;
+}
+
+#ifdef FRAM_SELF_TEST
+/*
+ * Function to simulate a power loss on a later slot write
+ */
+void FramStore_InjectPowerLoss(uint32_t write)
+{
+    xPowerLossCountdown = write;
+}
+#endif
@@ -7,7 +7,6 @@
 
 #include "mb85rs256.h"
 
-#include "board-model.h"
 #include "../platform/gpio/gpio.h"
 #include "../platform/spi/spi-core.h"
 
@@ -27,217 +26,314 @@
 
 #define FRAM_ADDRESS_LENGTH_IN_BYTES 2
 #define FRAM_OP_CODE_LENGTH_IN_BYTES 1
+#define FRAM_FRAME_HEADER_LENGTH (FRAM_OP_CODE_LENGTH_IN_BYTES + FRAM_ADDRESS_LENGTH_IN_BYTES)
+
+// Write payloads up to this length are copied behind the opcode and address and go out in one transfer
+#define FRAM_FRAME_MAX_PAYLOAD 64
 
 /*** Private  Functions ***/
 
 // Helper function to set CS pin high
-static void framChipSelectHigh(void)
+static void framChipSelectHigh(Mb85Device_t *device)
 {
-    HAL_GPIO_WritePin(PORT(FRAM_CS), PIN(FRAM_CS), GPIO_PIN_SET);
+    HAL_GPIO_WritePin(device->CsPort, device->CsPin, GPIO_PIN_SET);
 }
 
 // Helper function to set CS pin low
-static void framChipSelectLow(void)
+static void framChipSelectLow(Mb85Device_t *device)
 {
-    HAL_GPIO_WritePin(PORT(FRAM_CS), PIN(FRAM_CS), GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(device->CsPort, device->CsPin, GPIO_PIN_RESET);
 }
 
 /*
  * Function:       Read FRAM Register
- * Arguments:      command, *dataReceived, lengthToReceive
+ * Arguments:      device, the FRAM instance
+ *                 command, *dataReceived, lengthToReceive
  * Description:    Sends FRAM command and stores data read in dataReceived
  * Return Message: Bool
  */
-static bool framReadRegister(uint8_t command, uint8_t *dataReceived, uint16_t lengthToReceive)
+static bool framReadRegister(Mb85Device_t *device, uint8_t command, uint8_t *dataReceived,
+                             uint16_t lengthToReceive)
 {
     bool status = false;
 
-    framChipSelectLow();
-    status = SPI_Transfer(MB85_FRAM, &command, FRAM_OP_CODE_LENGTH_IN_BYTES, dataReceived,
+    if (!SPI_BusAcquire(device->Bus))
+    {
+        return false;
+    }
+
+    framChipSelectLow(device);
+    status = SPI_Transfer(device->Bus, &command, FRAM_OP_CODE_LENGTH_IN_BYTES, dataReceived,
                           lengthToReceive);
-    framChipSelectHigh();
+    framChipSelectHigh(device);
+
+    SPI_BusRelease(device->Bus);
 
     return status;
 }
 
 /*
  * Function:       Write FRAM Command/OpCode
- * Arguments:      command
+ * Arguments:      device, the FRAM instance
+ *                 command
  * Description:    Sends FRAM command
  * Return Message: Bool
  */
-static bool framSendCommand(uint8_t command)
+static bool framSendCommand(Mb85Device_t *device, uint8_t command)
 {
     bool status = false;
 
-    framChipSelectLow();
-    status = SPI_Transfer(MB85_FRAM, &command, FRAM_OP_CODE_LENGTH_IN_BYTES, NULL,
+    if (!SPI_BusAcquire(device->Bus))
+    {
+        return false;
+    }
+
+    framChipSelectLow(device);
+    status = SPI_Transfer(device->Bus, &command, FRAM_OP_CODE_LENGTH_IN_BYTES, NULL,
                           0);
-    framChipSelectHigh();
+    framChipSelectHigh(device);
+
+    SPI_BusRelease(device->Bus);
 
     return status;
 }
 
+/*
+ * Function:       framBuildFrame
+ * Arguments:      frame, buffer of at least FRAM_FRAME_HEADER_LENGTH bytes
+ *                 command, FRAM command opcode
+ *                 address, 16 bit FRAM memory address
+ * Description:    Build opcode and address, MSB first, into a single frame
+ * Return Message: Length of the frame in bytes
+ */
+static uint16_t framBuildFrame(uint8_t *frame, uint8_t command, uint16_t address)
+{
+    frame[0] = command;
+    frame[1] = (address >> 8) & 0xFF; // MSB
+    frame[2] = (address) & 0xFF;      // LSB
+
+    return FRAM_FRAME_HEADER_LENGTH;
+}
+
 /*** Public  Functions ***/
 
 /*
- * Function:       Read FRAM
- * Arguments:      readAddress, *dataReceived, lengthToReceive
- * Description:    Sends FRAM READ opCode, readAddress, and stores data read in dataReceived
+ * Function:       Read FRAM Segments
+ * Arguments:      device, the FRAM instance
+ *                 readAddress, first FRAM address to read
+ *                 segments, count, buffers filled one after another from readAddress on
+ * Description:    Sends FRAM READ opCode and readAddress as one frame and clocks the
+ *                 data into the segments in the same chip select window, the first
+ *                 segment in the same transfer as the frame
  * Return Message: true, false if failed
  */
-bool MB85RS256_Read(uint16_t readAddress, uint8_t *dataReceived, uint16_t lengthToReceive)
+bool MB85RS256_ReadSegments(Mb85Device_t *device, uint16_t readAddress, const Mb85Segment_t *segments,
+                            uint16_t count)
 {
     bool status = false;
-    uint8_t readOpCode = FRAM_OPCODE_READ;
-    uint8_t readAddressToSend[FRAM_ADDRESS_LENGTH_IN_BYTES];
-    readAddressToSend[0] = (readAddress >> 8) & 0xFF; // MSB
-    readAddressToSend[1] = (readAddress) & 0xFF;      // LSB
+    uint8_t frame[FRAM_FRAME_HEADER_LENGTH];
+    uint16_t frameLength = framBuildFrame(frame, FRAM_OPCODE_READ, readAddress);
+    uint16_t i = 0;
 
-    // Check the number of bytes to read
-    if (lengthToReceive > FRAM_SIZE_IN_BYTES)
+    if (count == 0)
     {
-        lengthToReceive = FRAM_SIZE_IN_BYTES;
+        return true;
     }
 
-    framChipSelectLow();
+    if (!SPI_BusAcquire(device->Bus))
+    {
+        return false;
+    }
 
-    status = SPI_Transfer(MB85_FRAM, &readOpCode, sizeof(readOpCode), NULL,
-                          0);
-    if (status)
+    framChipSelectLow(device);
+
+    status = SPI_Transfer(device->Bus, frame, frameLength, segments[0].Data, segments[0].Length);
+
+    for (i = 1; status && (i < count); i++)
     {
-        status = SPI_Transfer(MB85_FRAM, readAddressToSend, FRAM_ADDRESS_LENGTH_IN_BYTES, NULL,
-                              0);
-        if (status)
-        {
-            status = SPI_Transfer(MB85_FRAM, NULL, 0, dataReceived,
-                                  lengthToReceive);
-        }
+        status = SPI_Transfer(device->Bus, NULL, 0, segments[i].Data, segments[i].Length);
     }
 
-    framChipSelectHigh();
+    framChipSelectHigh(device);
+
+    SPI_BusRelease(device->Bus);
 
     return status;
 }
 
 /*
- * Function:       Write FRAM
- * Arguments:      writeAddress, *dataToWrite, lengthToSend
- * Description:    Sends FRAM WRITE opCode, writeAddress and dataToWrite
+ * Function:       Write FRAM Segments
+ * Arguments:      device, the FRAM instance
+ *                 writeAddress, first FRAM address to write
+ *                 segments, count, buffers written one after another from writeAddress on
+ * Description:    Sends WREN, then FRAM WRITE opCode, writeAddress and the segments,
+ *                 holding the bus for both. Leading segments that fit in
+ *                 FRAM_FRAME_MAX_PAYLOAD are copied behind the opCode and address and
+ *                 sent in one transfer, the rest follow in the same chip select window.
+ *                 The Write Enable Latch resets by itself at the end of the write, so
+ *                 no WRDI is needed.
  * Return Message: true, false if failed
  */
-bool MB85RS256_Write(uint16_t writeAddress, uint8_t *dataToWrite, uint16_t lengthToSend)
+bool MB85RS256_WriteSegments(Mb85Device_t *device, uint16_t writeAddress, const Mb85Segment_t *segments,
+                             uint16_t count)
 {
     bool status = false;
-    uint8_t writeOpCode = FRAM_OPCODE_WRITE;
-    uint8_t writeAddressToSend[FRAM_ADDRESS_LENGTH_IN_BYTES];
-    writeAddressToSend[0] = (writeAddress >> 8) & 0xFF; // MSB
-    writeAddressToSend[1] = (writeAddress) & 0xFF;      // LSB
+    uint8_t wrenOpCode = FRAM_OPCODE_WREN;
+    uint8_t frame[FRAM_FRAME_HEADER_LENGTH + FRAM_FRAME_MAX_PAYLOAD];
+    uint16_t frameLength = framBuildFrame(frame, FRAM_OPCODE_WRITE, writeAddress);
+    uint16_t i = 0;
 
-    // Check the number of bytes to write
-    if (lengthToSend > FRAM_SIZE_IN_BYTES)
+    if (count == 0)
     {
-        lengthToSend = FRAM_SIZE_IN_BYTES;
+        return true;
     }
 
-    // Set Write Enable Latch before writing to FRAM
-    status = MB85RS256_WREN();
-    if (!status)
+    for (i = 0; (i < count) && ((frameLength + segments[i].Length) <= sizeof(frame)); i++)
     {
-        printf("Failed to set WREN before writing to FRAM");
-        return status;
+        memcpy(&frame[frameLength], segments[i].Data, segments[i].Length);
+        frameLength += segments[i].Length;
     }
 
-    framChipSelectLow();
+    if (!SPI_BusAcquire(device->Bus))
+    {
+        return false;
+    }
 
-    status = SPI_Transfer(MB85_FRAM, &writeOpCode, sizeof(writeOpCode), NULL,
-                          0);
+    // The latch is set on the rising edge of CS, so WREN keeps its own chip select window
+    framChipSelectLow(device);
+    status = SPI_Transfer(device->Bus, &wrenOpCode, sizeof(wrenOpCode), NULL, 0);
+    framChipSelectHigh(device);
 
     if (status)
     {
-        status = SPI_Transfer(MB85_FRAM, writeAddressToSend, FRAM_ADDRESS_LENGTH_IN_BYTES, NULL,
-                              0);
+        framChipSelectLow(device);
+
+        status = SPI_Transfer(device->Bus, frame, frameLength, NULL, 0);
 
-        if (status)
+        for (; status && (i < count); i++)
         {
-            status = SPI_Transfer(MB85_FRAM, dataToWrite, lengthToSend, NULL, 0);
+            status = SPI_Transfer(device->Bus, segments[i].Data, segments[i].Length, NULL, 0);
         }
+
+        framChipSelectHigh(device);
+    }
+    else
+    {
+        printf("Failed to set WREN before writing to FRAM");
+    }
+
+    SPI_BusRelease(device->Bus);
+
+    return status;
+}
+
+/*
+ * Function:       Read FRAM
+ * Arguments:      device, the FRAM instance
+ *                 readAddress, *dataReceived, lengthToReceive
+ * Description:    Sends FRAM READ opCode and readAddress as one frame and clocks
+ *                 the data into dataReceived in the same transfer
+ * Return Message: true, false if failed
+ */
+bool MB85RS256_Read(Mb85Device_t *device, uint16_t readAddress, uint8_t *dataReceived, uint16_t lengthToReceive)
+{
+    Mb85Segment_t segment = {dataReceived, lengthToReceive};
+
+    // Check the number of bytes to read
+    if (segment.Length > FRAM_SIZE_IN_BYTES)
+    {
+        segment.Length = FRAM_SIZE_IN_BYTES;
     }
 
-    framChipSelectHigh();
+    return MB85RS256_ReadSegments(device, readAddress, &segment, 1);
+}
 
-    status = MB85RS256_WRDI();
-    if (!status)
+/*
+ * Function:       Write FRAM
+ * Arguments:      device, the FRAM instance
+ *                 writeAddress, *dataToWrite, lengthToSend
+ * Description:    Sends WREN, then FRAM WRITE opCode, writeAddress and dataToWrite,
+ *                 see MB85RS256_WriteSegments
+ * Return Message: true, false if failed
+ */
+bool MB85RS256_Write(Mb85Device_t *device, uint16_t writeAddress, uint8_t *dataToWrite, uint16_t lengthToSend)
+{
+    Mb85Segment_t segment = {dataToWrite, lengthToSend};
+
+    // Check the number of bytes to write
+    if (segment.Length > FRAM_SIZE_IN_BYTES)
     {
-        printf("Failed to reset Write Enable Latch");
+        segment.Length = FRAM_SIZE_IN_BYTES;
     }
 
-    return status;
+    return MB85RS256_WriteSegments(device, writeAddress, &segment, 1);
 }
 
 /*
  * Function:       Read FRAM Status Register
- * Arguments:      statusRegValue
+ * Arguments:      device, the FRAM instance
+ *                 statusRegValue
  * Description:    Sends FRAM RDSR opCode and stores register value in dataReceived
  * Return Message: true, false if failed
  */
-bool MB85RS256_RDSR(uint8_t *statusRegValue)
+bool MB85RS256_RDSR(Mb85Device_t *device, uint8_t *statusRegValue)
 {
     bool status = false;
 
-    status = framReadRegister(FRAM_OPCODE_RDSR, statusRegValue, sizeof(statusRegValue));
+    status = framReadRegister(device, FRAM_OPCODE_RDSR, statusRegValue, sizeof(statusRegValue));
 
     return status;
 }
 
 /*
  * Function:       MB85RS256_WREN
- * Arguments:      None.
+ * Arguments:      device, the FRAM instance
  * Description:    The WREN instruction is for setting
  *                 Write Enable Latch (WEL) bit.
  * Return Message: true, false if failed
  */
-bool MB85RS256_WREN(void)
+bool MB85RS256_WREN(Mb85Device_t *device)
 {
     bool status = false;
 
-    status = framSendCommand(FRAM_OPCODE_WREN);
+    status = framSendCommand(device, FRAM_OPCODE_WREN);
 
     return status;
 }
 
 /*
  * Function:       MB85RS256_WRDI
- * Arguments:      None.
+ * Arguments:      device, the FRAM instance
  * Description:    The WRDI instruction is for resetting
  *                 Write Enable Latch (WEL) bit.
  * Return Message: true, false if failed
  */
-bool MB85RS256_WRDI(void)
+bool MB85RS256_WRDI(Mb85Device_t *device)
 {
     bool status = false;
 
-    status = framSendCommand(FRAM_OPCODE_WRDI);
+    status = framSendCommand(device, FRAM_OPCODE_WRDI);
 
     return status;
 }
 
 /*
  * Function:       MB85RS256_RDID
- * Arguments:      identification, 32 bit buffer to store id
+ * Arguments:      device, the FRAM instance
+ *                 identification, 32 bit buffer to store id
  * Description:    The RDID instruction is to read the manufacturer ID
  *                 of 1-byte and followed by Continuation code of 1-byte,
  *                 followed by Product ID of 2-byte
  * Return Message: true, false if failed
  */
-bool MB85RS256_RDID(uint32_t *identification)
+bool MB85RS256_RDID(Mb85Device_t *device, uint32_t *identification)
 {
     uint32_t temp;
     bool status = false;
     uint8_t dataBuffer[4];
 
     // SPI transfer RDID command
-    status = framReadRegister(FRAM_OPCODE_RDID, dataBuffer, sizeof(dataBuffer));
+    status = framReadRegister(device, FRAM_OPCODE_RDID, dataBuffer, sizeof(dataBuffer));
 
     if (status)
     {
@@ -258,24 +354,31 @@ bool MB85RS256_RDID(uint32_t *identification)
 
 /*
  * Function:       MB85RS256_Init
- * Arguments:      None
- * Description:    Initialize Chip Select pin for MB85RS256 FRAM,
+ * Arguments:      device, the instance to set up
+ *                 csPort, csPin, chip select of the part
+ *                 bus, SPI bus the part is on
+ * Description:    Set up an instance with its wiring,
+ *                  Initialize Chip Select pin for MB85RS256 FRAM,
  *                  Set Chip Select pin high
  * Return Message: true
  */
-bool MB85RS256_Init(void)
+bool MB85RS256_Init(Mb85Device_t *device, GPIO_TypeDef *csPort, uint16_t csPin, SpiDevice_t bus)
 {
     GPIO_InitTypeDef GPIO_InitStruct = {0};
 
+    device->CsPort = csPort;
+    device->CsPin = csPin;
+    device->Bus = bus;
+
     // Init FRAM CS pin
-    GPIO_ClockEnable(PORT(FRAM_CS));
-    GPIO_InitStruct.Pin = PIN(FRAM_CS);
+    GPIO_ClockEnable(device->CsPort);
+    GPIO_InitStruct.Pin = device->CsPin;
     GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
     GPIO_InitStruct.Pull = GPIO_PULLUP;
-    HAL_GPIO_Init(PORT(FRAM_CS), &GPIO_InitStruct);
+    HAL_GPIO_Init(device->CsPort, &GPIO_InitStruct);
 
     // Set CS pin high (Set it low during SPI comm)
-    framChipSelectHigh();
+    framChipSelectHigh(device);
 
     return true;
 }
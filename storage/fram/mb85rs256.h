@@ -6,6 +6,9 @@
  *      Author: Belina Sainju
  */
 
+#include "../platform/gpio/gpio.h"
+#include "../platform/spi/spi-core.h"
+
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -21,41 +24,64 @@
 // FRAM size is 256Kbit = 32,768bytes ~ 32KB
 #define FRAM_SIZE_IN_BYTES FRAM_SIZE_IN_BITS / BITS_PER_BYTE
 
+// One MB85RS256 part, set up by MB85RS256_Init. Each part on the board has its own instance.
+typedef struct
+{
+    GPIO_TypeDef *CsPort;
+    uint16_t CsPin;
+    SpiDevice_t Bus;
+} Mb85Device_t;
+
+// One piece of a read or write that continues where the previous piece ended
+typedef struct
+{
+    uint8_t *Data;
+    uint16_t Length;
+} Mb85Segment_t;
+
 // =============================================================================================#=
 // Public API Functions
 // =============================================================================================#=
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
-// One-time startup initialization for the MX25V1635F FRAM
+// One-time startup initialization of one MB85RS256 FRAM on the given chip select and bus
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+~
-bool MB85RS256_Init(void);
+bool MB85RS256_Init(Mb85Device_t *device, GPIO_TypeDef *csPort, uint16_t csPin, SpiDevice_t bus);
 
 // =============================================================================================#=
 // Read FRAM device ID
 // =============================================================================================#=
-bool MB85RS256_RDID(uint32_t *identification);
+bool MB85RS256_RDID(Mb85Device_t *device, uint32_t *identification);
 
 // =============================================================================================#=
 // Set FRAM Write Enable Latch
 // =============================================================================================#=
-bool MB85RS256_WREN(void);
+bool MB85RS256_WREN(Mb85Device_t *device);
 
 // =============================================================================================#=
 // Reset FRAM Write Enable Latch
 // =============================================================================================#=
-bool MB85RS256_WRDI(void);
+bool MB85RS256_WRDI(Mb85Device_t *device);
 
 // =============================================================================================#=
 // Read FRAM Status Register
 // =============================================================================================#=
-bool MB85RS256_RDSR(uint8_t *statusRegValue);
+bool MB85RS256_RDSR(Mb85Device_t *device, uint8_t *statusRegValue);
 
 // =============================================================================================#=
 // Write to FRAM memory
 // =============================================================================================#=
-bool MB85RS256_Write(uint16_t writeAddress, uint8_t *dataToWrite, uint16_t lengthToSend);
+bool MB85RS256_Write(Mb85Device_t *device, uint16_t writeAddress, uint8_t *dataToWrite, uint16_t lengthToSend);
 
 // =============================================================================================#=
 // Read FRAM memory
 // =============================================================================================#=
-bool MB85RS256_Read(uint16_t readAddress, uint8_t *dataReceived, uint16_t lengthToReceive);
+bool MB85RS256_Read(Mb85Device_t *device, uint16_t readAddress, uint8_t *dataReceived, uint16_t lengthToReceive);
+
+// =============================================================================================#=
+// Read/write consecutive FRAM bytes from/to several buffers in one chip select window
+// =============================================================================================#=
+bool MB85RS256_ReadSegments(Mb85Device_t *device, uint16_t readAddress, const Mb85Segment_t *segments,
+                            uint16_t count);
+bool MB85RS256_WriteSegments(Mb85Device_t *device, uint16_t writeAddress, const Mb85Segment_t *segments,
+                             uint16_t count);